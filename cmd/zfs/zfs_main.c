@@ -321,10 +321,10 @@ get_usage(zfs_help_t idx)
 	case HELP_PROMOTE:
 		return (gettext("\tpromote <clone-filesystem>\n"));
 	case HELP_RECEIVE:
-		return (gettext("\treceive [-vMnsFhu] "
+		return (gettext("\treceive [-vMnsFhuU] "
 		    "[-o <property>=<value>] ... [-x <property>] ...\n"
 		    "\t    <filesystem|volume|snapshot>\n"
-		    "\treceive [-vMnsFhu] [-o <property>=<value>] ... "
+		    "\treceive [-vMnsFhuU] [-o <property>=<value>] ... "
 		    "[-x <property>] ... \n"
 		    "\t    [-d | -e] <filesystem>\n"
 		    "\treceive -A <filesystem|volume>\n"));
@@ -407,7 +407,7 @@ get_usage(zfs_help_t idx)
 	case HELP_RELEASE:
 		return (gettext("\trelease [-r] <tag> <snapshot> ...\n"));
 	case HELP_DIFF:
-		return (gettext("\tdiff [-FHth] <snapshot> "
+		return (gettext("\tdiff [-FHthz] <snapshot> "
 		    "[snapshot|filesystem]\n"));
 	case HELP_BOOKMARK:
 		return (gettext("\tbookmark [-r] <snapshot|bookmark> "
@@ -5191,7 +5191,7 @@ zfs_do_receive(int argc, char **argv)
 		nomem();
 
 	/* check options */
-	while ((c = getopt(argc, argv, ":o:x:dehMnuvFsAc")) != -1) {
+	while ((c = getopt(argc, argv, ":o:x:dehMnuvFsAcU")) != -1) {
 		switch (c) {
 		case 'o':
 			if (!parseprop(props, optarg)) {
@@ -5250,6 +5250,9 @@ zfs_do_receive(int argc, char **argv)
 		case 'c':
 			flags.heal = B_TRUE;
 			break;
+		case 'U':
+			flags.uncached = B_TRUE;
+			break;
 		case ':':
 			(void) fprintf(stderr, gettext("missing argument for "
 			    "'%c' option\n"), optopt);
@@ -8127,7 +8130,7 @@ zfs_do_diff(int argc, char **argv)
 	int c;
 	struct sigaction sa;
 
-	while ((c = getopt(argc, argv, "FHth")) != -1) {
+	while ((c = getopt(argc, argv, "FHthz")) != -1) {
 		switch (c) {
 		case 'F':
 			flags |= ZFS_DIFF_CLASSIFY;
@@ -8141,6 +8144,9 @@ zfs_do_diff(int argc, char **argv)
 		case 'h':
 			flags |= ZFS_DIFF_NO_MANGLE;
 			break;
+		case 'z':
+			flags |= ZFS_DIFF_MACHINE;
+			break;
 		default:
 			(void) fprintf(stderr,
 			    gettext("invalid option '%c'\n"), optopt);
@@ -30,21 +30,33 @@ zstream_usage(void)
 	    "usage: zstream command args ...\n"
 	    "Available commands are:\n"
 	    "\n"
-	    "\tzstream dump [-vCd] FILE\n"
-	    "\t... | zstream dump [-vCd]\n"
+	    "\tzstream dump [-vCd] [-i INDEX] [-o OBJECT[,OFFSET]] FILE\n"
+	    "\t... | zstream dump [-vCd] [-o OBJECT[,OFFSET]]\n"
 	    "\n"
-	    "\tzstream decompress [-v] [OBJECT,OFFSET[,TYPE]] ...\n"
+	    "\tzstream decompress [-v] [-i INDEX] [OBJECT,OFFSET[,TYPE]] ...\n"
 	    "\n"
-	    "\tzstream drop_record [-v] [OBJECT,OFFSET] ...\n"
+	    "\tzstream drop_record [-v] [-i INDEX] [OBJECT,OFFSET] ...\n"
 	    "\n"
-	    "\tzstream raw [-v] [-b blocks] [-g guid] IMAGE|DEVICE FILE\n"
+	    "\tzstream raw [-v] [-b blocks] [-g guid] [-i INDEX] "
+	    "IMAGE|DEVICE FILE\n"
 	    "\t... | zstream raw [-v] [-b blocks] [-g guid] IMAGE|DEVICE\n"
 	    "\n"
 	    "\tzstream recompress [-t num_threads] [-l level] TYPE\n"
 	    "\n"
+	    "\tzstream split [-v] [-r objects] -n parts PREFIX\n"
+	    "\n"
+	    "\tzstream merge [-v] PART ...\n"
+	    "\n"
+	    "\tzstream compress [-v] [-b frame_size] [-l level] "
+	    "[-t num_threads]\n"
+	    "\n"
+	    "\tzstream uncompress [-t num_threads]\n"
+	    "\n"
+	    "\tzstream index [-v] FILE [INDEX]\n"
+	    "\n"
 	    "\tzstream token resume_token\n"
 	    "\n"
-	    "\tzstream redup [-v] FILE | ...\n");
+	    "\tzstream redup [-v] [-d directory] FILE | ...\n");
 	exit(1);
 }
 
@@ -89,6 +101,16 @@ main(int argc, char *argv[])
 		return (zstream_do_raw(argc - 1, argv + 1));
 	} else if (strcmp(subcommand, "recompress") == 0) {
 		return (zstream_do_recompress(argc - 1, argv + 1));
+	} else if (strcmp(subcommand, "split") == 0) {
+		return (zstream_do_split(argc - 1, argv + 1));
+	} else if (strcmp(subcommand, "merge") == 0) {
+		return (zstream_do_merge(argc - 1, argv + 1));
+	} else if (strcmp(subcommand, "compress") == 0) {
+		return (zstream_do_compress(argc - 1, argv + 1));
+	} else if (strcmp(subcommand, "uncompress") == 0) {
+		return (zstream_do_uncompress(argc - 1, argv + 1));
+	} else if (strcmp(subcommand, "index") == 0) {
+		return (zstream_do_index(argc - 1, argv + 1));
 	} else if (strcmp(subcommand, "token") == 0) {
 		return (zstream_do_token(argc - 1, argv + 1));
 	} else if (strcmp(subcommand, "redup") == 0) {
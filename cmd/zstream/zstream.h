@@ -35,6 +35,11 @@ extern int zstream_do_dump(int, char *[]);
 extern int zstream_do_decompress(int argc, char *argv[]);
 extern int zstream_do_drop_record(int argc, char *argv[]);
 extern int zstream_do_recompress(int argc, char *argv[]);
+extern int zstream_do_split(int, char *[]);
+extern int zstream_do_merge(int, char *[]);
+extern int zstream_do_compress(int, char *[]);
+extern int zstream_do_uncompress(int, char *[]);
+extern int zstream_do_index(int, char *[]);
 extern int zstream_do_token(int, char *[]);
 extern int zstream_do_raw(int, char *[]);
 extern int zstream_do_selftest(int, char *[]);
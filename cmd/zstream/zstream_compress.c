@@ -0,0 +1,824 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * https://opensource.org/license/CDDL-1.0.
+ */
+
+#include <assert.h>
+#include <err.h>
+#include <libzfs.h>
+#include <libzutil.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/byteorder.h>
+#include <sys/stdtypes.h>
+#include <sys/zfs_ioctl.h>
+#include <sys/zio_compress.h>
+#include <unistd.h>
+#include <zfs_fletcher.h>
+
+#include "zstream.h"
+#include "zstream_compress.h"
+#include "zstream_modules.h"
+#include "zstream_queue.h"
+#include "zstream_util.h"
+
+#define	ZC_DEFAULT_FRAME_SIZE	(1U << 20)
+#define	ZC_MAX_FRAME_SIZE	SPA_MAXBLOCKSIZE
+
+/*
+ * Frames pass through the chains below with their headers in host order.
+ */
+typedef struct {
+	zc_frame_t	zi_frame;
+	uint8_t		*zi_data;
+} zc_item_t;
+
+typedef struct {
+	compression_spec_t cc_spec;
+	uint32_t	cc_frame_size;
+	uint64_t	cc_stream_offset;
+	uint8_t		*cc_record;	/* Read but not yet all in a frame */
+	size_t		cc_record_size;
+	size_t		cc_record_pos;
+	boolean_t	cc_eof;
+	boolean_t	cc_started;
+	uint64_t	cc_offset;	/* In the compressed stream */
+	zc_index_entry_t *cc_index;
+	uint64_t	cc_index_count;
+	uint64_t	cc_index_size;
+} compress_context_t;
+
+struct zc_reader {
+	FILE		*zr_fp;
+	uint64_t	zr_offset;	/* In the compressed stream */
+	uint64_t	zr_stream_offset;
+	uint64_t	zr_frames;
+	boolean_t	zr_done;
+	uint8_t		*zr_buf;	/* The current frame, decompressed */
+	size_t		zr_buf_size;
+	size_t		zr_buf_pos;
+	zc_index_entry_t *zr_index;	/* Loaded by the first seek */
+	uint64_t	zr_index_count;
+};
+
+boolean_t
+zc_is_header(const void *buf)
+{
+	return (LE_64(((const zc_header_t *)buf)->zh_magic) == ZC_MAGIC);
+}
+
+static void
+zc_reader_fread(zc_reader_t *reader, void *buf, size_t len)
+{
+	if (fread(buf, len, 1, reader->zr_fp) != 1) {
+		if (ferror(reader->zr_fp)) {
+			err(1, "error reading compressed stream at offset "
+			    "%llu", (u_longlong_t)reader->zr_offset);
+		}
+		errx(1, "compressed stream ends early at offset %llu",
+		    (u_longlong_t)reader->zr_offset);
+	}
+	reader->zr_offset += len;
+}
+
+zc_reader_t *
+zc_reader_create(FILE *fp, const void *header)
+{
+	const zc_header_t *zh = header;
+	zc_reader_t *reader;
+
+	if (LE_32(zh->zh_version) != ZC_VERSION) {
+		errx(1, "unsupported compressed stream version %u",
+		    LE_32(zh->zh_version));
+	}
+	reader = safe_calloc(sizeof (zc_reader_t));
+	reader->zr_fp = fp;
+	reader->zr_offset = sizeof (zc_header_t);
+	return (reader);
+}
+
+void
+zc_reader_destroy(zc_reader_t *reader)
+{
+	free(reader->zr_index);
+	free(reader->zr_buf);
+	free(reader);
+}
+
+/*
+ * Check the index against the frames that came before it, and that the
+ * stream ends with a trailer that locates the index.
+ */
+static void
+zc_reader_check_index(zc_reader_t *reader, zc_frame_t *frame)
+{
+	uint64_t index_offset = reader->zr_offset - sizeof (*frame);
+	uint64_t offset = sizeof (zc_header_t), stream_offset = 0;
+	zc_trailer_t trailer;
+
+	if (frame->zf_lsize != reader->zr_frames ||
+	    frame->zf_psize != frame->zf_lsize * sizeof (zc_index_entry_t)) {
+		errx(1, "compressed stream index at offset %llu does not "
+		    "match its %llu frames", (u_longlong_t)index_offset,
+		    (u_longlong_t)reader->zr_frames);
+	}
+	for (uint64_t i = 0; i < reader->zr_frames; i++) {
+		zc_index_entry_t entry;
+
+		zc_reader_fread(reader, &entry, sizeof (entry));
+		if (LE_64(entry.zi_offset) != offset ||
+		    LE_64(entry.zi_stream_offset) != stream_offset) {
+			errx(1, "compressed stream index entry %llu is wrong",
+			    (u_longlong_t)i);
+		}
+		offset += sizeof (zc_frame_t) + LE_32(entry.zi_psize);
+		stream_offset += LE_32(entry.zi_lsize);
+	}
+	if (offset != index_offset || stream_offset != reader->zr_stream_offset)
+		errx(1, "compressed stream index does not cover the stream");
+
+	zc_reader_fread(reader, &trailer, sizeof (trailer));
+	if (LE_64(trailer.zt_magic) != ZC_TRAILER_MAGIC ||
+	    LE_64(trailer.zt_index_offset) != index_offset ||
+	    fgetc(reader->zr_fp) != EOF) {
+		errx(1, "compressed stream does not end with its trailer at "
+		    "offset %llu", (u_longlong_t)reader->zr_offset -
+		    sizeof (trailer));
+	}
+}
+
+boolean_t
+zc_reader_next_frame(zc_reader_t *reader, zc_frame_t *frame,
+    uint8_t **payloadp)
+{
+	uint64_t offset = reader->zr_offset;
+	zio_cksum_t cksum;
+
+	if (reader->zr_done)
+		return (B_FALSE);
+
+	zc_reader_fread(reader, frame, sizeof (*frame));
+	frame->zf_magic = LE_32(frame->zf_magic);
+	frame->zf_compress = LE_16(frame->zf_compress);
+	frame->zf_flags = LE_16(frame->zf_flags);
+	frame->zf_psize = LE_32(frame->zf_psize);
+	frame->zf_lsize = LE_32(frame->zf_lsize);
+	frame->zf_stream_offset = LE_64(frame->zf_stream_offset);
+	for (int i = 0; i < 4; i++) {
+		frame->zf_checksum.zc_word[i] =
+		    LE_64(frame->zf_checksum.zc_word[i]);
+	}
+
+	if (frame->zf_magic == ZC_FRAME_INDEX) {
+		zc_reader_check_index(reader, frame);
+		reader->zr_done = B_TRUE;
+		return (B_FALSE);
+	}
+	if (frame->zf_magic != ZC_FRAME_DATA ||
+	    frame->zf_compress >= ZIO_COMPRESS_FUNCTIONS ||
+	    (frame->zf_flags & ~ZC_FRAME_CONTINUED) != 0 ||
+	    frame->zf_lsize == 0 || frame->zf_lsize > ZC_MAX_FRAME_SIZE ||
+	    frame->zf_psize == 0 || frame->zf_psize > frame->zf_lsize ||
+	    (ctype_is_uncompressed(frame->zf_compress) &&
+	    frame->zf_psize != frame->zf_lsize) ||
+	    frame->zf_stream_offset != reader->zr_stream_offset) {
+		errx(1, "invalid compressed stream frame at offset %llu",
+		    (u_longlong_t)offset);
+	}
+
+	*payloadp = safe_malloc(frame->zf_psize);
+	zc_reader_fread(reader, *payloadp, frame->zf_psize);
+	fletcher_4_native_varsize(*payloadp, frame->zf_psize, &cksum);
+	if (!ZIO_CHECKSUM_EQUAL(cksum, frame->zf_checksum)) {
+		errx(1, "checksum mismatch in compressed stream frame at "
+		    "offset %llu", (u_longlong_t)offset);
+	}
+	reader->zr_stream_offset += frame->zf_lsize;
+	reader->zr_frames++;
+	return (B_TRUE);
+}
+
+uint8_t *
+zc_decompress_frame(const zc_frame_t *frame, uint8_t *payload)
+{
+	uint8_t *buf = decompress_buffer(payload, frame->zf_psize,
+	    frame->zf_lsize, frame->zf_compress);
+
+	if (buf == NULL) {
+		errx(1, "compressed stream frame at stream offset %llu is "
+		    "corrupt", (u_longlong_t)frame->zf_stream_offset);
+	}
+	return (buf);
+}
+
+/*
+ * Replace the current frame with the next one, decompressed.
+ */
+static boolean_t
+zc_reader_load_frame(zc_reader_t *reader)
+{
+	zc_frame_t frame;
+	uint8_t *payload;
+
+	free(reader->zr_buf);
+	reader->zr_buf = NULL;
+	reader->zr_buf_size = reader->zr_buf_pos = 0;
+	if (!zc_reader_next_frame(reader, &frame, &payload))
+		return (B_FALSE);
+	if (ctype_is_uncompressed(frame.zf_compress)) {
+		reader->zr_buf = payload;
+	} else {
+		reader->zr_buf = zc_decompress_frame(&frame, payload);
+		free(payload);
+	}
+	reader->zr_buf_size = frame.zf_lsize;
+	return (B_TRUE);
+}
+
+size_t
+zc_reader_read(zc_reader_t *reader, void *buf, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		if (reader->zr_buf_pos == reader->zr_buf_size &&
+		    !zc_reader_load_frame(reader))
+			break;
+
+		size_t n = MIN(len - done,
+		    reader->zr_buf_size - reader->zr_buf_pos);
+		memcpy((uint8_t *)buf + done, reader->zr_buf +
+		    reader->zr_buf_pos, n);
+		reader->zr_buf_pos += n;
+		done += n;
+	}
+	return (done);
+}
+
+/*
+ * Read the frame index that the trailer locates. The index was checked
+ * against the frames when the stream was written, and is checked again if
+ * the stream is read to its end, so only its shape is checked here.
+ */
+static void
+zc_reader_load_index(zc_reader_t *reader)
+{
+	FILE *fp = reader->zr_fp;
+	zc_trailer_t trailer;
+	zc_frame_t frame;
+	uint64_t count;
+
+	if (fseeko(fp, -(off_t)sizeof (trailer), SEEK_END) != 0 ||
+	    fread(&trailer, sizeof (trailer), 1, fp) != 1)
+		err(1, "cannot read the index of the compressed stream");
+	if (LE_64(trailer.zt_magic) != ZC_TRAILER_MAGIC ||
+	    fseeko(fp, LE_64(trailer.zt_index_offset), SEEK_SET) != 0 ||
+	    fread(&frame, sizeof (frame), 1, fp) != 1 ||
+	    LE_32(frame.zf_magic) != ZC_FRAME_INDEX)
+		errx(1, "compressed stream has no valid index");
+
+	count = LE_32(frame.zf_lsize);
+	if (count == 0 || LE_32(frame.zf_psize) !=
+	    count * sizeof (zc_index_entry_t))
+		errx(1, "compressed stream has no valid index");
+	reader->zr_index = safe_malloc(count * sizeof (zc_index_entry_t));
+	if (fread(reader->zr_index, sizeof (zc_index_entry_t), count,
+	    fp) != count)
+		errx(1, "compressed stream has no valid index");
+	reader->zr_index_count = count;
+}
+
+void
+zc_reader_seek(zc_reader_t *reader, uint64_t stream_offset)
+{
+	uint64_t frame_start = reader->zr_stream_offset - reader->zr_buf_size;
+	uint64_t lo = 0, hi;
+
+	if (stream_offset >= frame_start &&
+	    stream_offset < reader->zr_stream_offset) {
+		reader->zr_buf_pos = stream_offset - frame_start;
+		return;
+	}
+
+	if (reader->zr_index == NULL)
+		zc_reader_load_index(reader);
+
+	/* Find the last frame that starts at or before the offset */
+	hi = reader->zr_index_count;
+	while (hi - lo > 1) {
+		uint64_t mid = lo + (hi - lo) / 2;
+
+		if (LE_64(reader->zr_index[mid].zi_stream_offset) <=
+		    stream_offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	zc_index_entry_t *entry = &reader->zr_index[lo];
+	uint64_t offset = LE_64(entry->zi_offset);
+
+	if (fseeko(reader->zr_fp, offset, SEEK_SET) != 0) {
+		err(1, "cannot seek to offset %llu of the compressed stream",
+		    (u_longlong_t)offset);
+	}
+	reader->zr_offset = offset;
+	reader->zr_stream_offset = LE_64(entry->zi_stream_offset);
+	reader->zr_frames = lo;
+	reader->zr_done = B_FALSE;
+	if (!zc_reader_load_frame(reader) ||
+	    stream_offset >= reader->zr_stream_offset) {
+		errx(1, "offset %llu is beyond the end of the compressed "
+		    "stream", (u_longlong_t)stream_offset);
+	}
+	reader->zr_buf_pos = stream_offset -
+	    (reader->zr_stream_offset - reader->zr_buf_size);
+}
+
+static void
+check_not_tty(int fd)
+{
+	if (isatty(fd)) {
+		errx(1, "stream cannot be %s a terminal. Use a file or a "
+		    "pipe.", fd == STDIN_FILENO ? "read from" : "written to");
+	}
+}
+
+static void
+compress_fwrite(compress_context_t *cc, const void *buf, size_t len)
+{
+	if (len != 0 && fwrite(buf, len, 1, stdout) != 1)
+		err(1, "error writing compressed stream");
+	cc->cc_offset += len;
+}
+
+/*
+ * Read the next record from standard input. The records are not otherwise
+ * examined; the stream is validated when it is uncompressed.
+ */
+static boolean_t
+compress_read_record(compress_context_t *cc, uint64_t offset)
+{
+	dmu_replay_record_t drr;
+	size_t payload_size;
+
+	if (fread(&drr, sizeof (drr), 1, stdin) != 1) {
+		if (ferror(stdin))
+			err(1, "error reading record header");
+		return (B_FALSE);
+	}
+
+	if (offset == 0) {
+		uint64_t magic = drr.drr_u.drr_begin.drr_magic;
+
+		if (zc_is_header(&drr)) {
+			errx(1, "stream is already compressed");
+		} else if (magic == BSWAP_64(DMU_BACKUP_MAGIC)) {
+			SET_ATTR(CA_BYTESWAPPED);
+		} else if (magic != DMU_BACKUP_MAGIC) {
+			errx(1, "invalid ZFS stream, bad magic number %llx",
+			    (u_longlong_t)magic);
+		}
+	}
+
+	payload_size = calc_payload_size(&drr);
+	if (payload_size > UINT32_MAX) {
+		errx(1, "stated packet size is greater than uint32_t at "
+		    "offset %llu", (u_longlong_t)offset);
+	}
+	cc->cc_record_size = sizeof (drr) + payload_size;
+	cc->cc_record_pos = 0;
+	cc->cc_record = safe_malloc(cc->cc_record_size);
+	memcpy(cc->cc_record, &drr, sizeof (drr));
+	if (payload_size != 0 && fread(cc->cc_record + sizeof (drr),
+	    payload_size, 1, stdin) != 1) {
+		if (ferror(stdin))
+			err(1, "error reading record payload");
+		errx(1, "input ends mid-record at offset %llu",
+		    (u_longlong_t)offset);
+	}
+	return (B_TRUE);
+}
+
+/*
+ * Fill a frame with records. A record that doesn't fit in what's left of
+ * the frame starts the next one, and one too large for any frame is
+ * continued over as many as it takes.
+ */
+static disposition_t
+chain_fill_frame(void *item_in, void *context_in)
+{
+	zc_item_t *item = (zc_item_t *)item_in;
+	compress_context_t *cc = (compress_context_t *)context_in;
+	uint16_t flags = cc->cc_record_pos != 0 ? ZC_FRAME_CONTINUED : 0;
+	size_t size = cc->cc_frame_size, used = 0;
+	uint8_t *buf;
+
+	if (item == NULL)
+		return (D_OK);
+
+	if (cc->cc_stream_offset == 0)
+		check_not_tty(STDIN_FILENO);
+
+	buf = safe_malloc(size);
+	while (used < cc->cc_frame_size) {
+		if (cc->cc_record == NULL && (cc->cc_eof ||
+		    !compress_read_record(cc, cc->cc_stream_offset + used))) {
+			cc->cc_eof = B_TRUE;
+			break;
+		}
+
+		size_t left = cc->cc_record_size - cc->cc_record_pos;
+		if (used != 0 && used + left > ZC_MAX_FRAME_SIZE)
+			break;
+		size_t n = MIN(left, ZC_MAX_FRAME_SIZE - used);
+		if (used + n > size) {
+			size = used + n;
+			if ((buf = realloc(buf, size)) == NULL)
+				err(1, "realloc");
+		}
+		memcpy(buf + used, cc->cc_record + cc->cc_record_pos, n);
+		used += n;
+		cc->cc_record_pos += n;
+		if (cc->cc_record_pos == cc->cc_record_size) {
+			free(cc->cc_record);
+			cc->cc_record = NULL;
+			cc->cc_record_size = cc->cc_record_pos = 0;
+		} else {
+			break;
+		}
+	}
+
+	if (used == 0) {
+		free(buf);
+		return (D_EOF);
+	}
+
+	item->zi_frame.zf_magic = ZC_FRAME_DATA;
+	item->zi_frame.zf_compress = ZIO_COMPRESS_OFF;
+	item->zi_frame.zf_flags = flags;
+	item->zi_frame.zf_psize = used;
+	item->zi_frame.zf_lsize = used;
+	item->zi_frame.zf_stream_offset = cc->cc_stream_offset;
+	item->zi_data = buf;
+	cc->cc_stream_offset += used;
+	return (D_OK);
+}
+
+/*
+ * Frames that don't compress are stored as they are.
+ */
+static void
+chain_compress_frame(queue_item_t *item_in, void *context_in)
+{
+	zc_item_t *item = (zc_item_t *)item_in;
+	compress_context_t *cc = (compress_context_t *)context_in;
+	uint8_t *cbuf;
+	size_t csize;
+
+	cbuf = compress_buffer(item->zi_data, item->zi_frame.zf_lsize,
+	    cc->cc_spec, &csize);
+	if (cbuf != NULL) {
+		free(item->zi_data);
+		item->zi_data = cbuf;
+		item->zi_frame.zf_psize = csize;
+		item->zi_frame.zf_compress = cc->cc_spec.cs_type;
+	}
+	fletcher_4_native_varsize(item->zi_data, item->zi_frame.zf_psize,
+	    &item->zi_frame.zf_checksum);
+}
+
+static size_t
+chain_compress_frame_cost(queue_item_t *item_in, void *context_in)
+{
+	(void) context_in;
+	zc_item_t *item = (zc_item_t *)item_in;
+
+	return (item->zi_frame.zf_lsize);
+}
+
+static void
+compress_write_header(compress_context_t *cc)
+{
+	zc_header_t header = {
+		.zh_magic = LE_64(ZC_MAGIC),
+		.zh_version = LE_32(ZC_VERSION),
+		.zh_frame_size = LE_32(cc->cc_frame_size)
+	};
+
+	check_not_tty(STDOUT_FILENO);
+	compress_fwrite(cc, &header, sizeof (header));
+	cc->cc_started = B_TRUE;
+}
+
+static void
+compress_write_index(compress_context_t *cc)
+{
+	zc_frame_t frame = {
+		.zf_magic = LE_32(ZC_FRAME_INDEX),
+		.zf_psize = LE_32(cc->cc_index_count *
+		    sizeof (zc_index_entry_t)),
+		.zf_lsize = LE_32(cc->cc_index_count)
+	};
+	zc_trailer_t trailer = {
+		.zt_index_offset = LE_64(cc->cc_offset),
+		.zt_magic = LE_64(ZC_TRAILER_MAGIC)
+	};
+
+	if (cc->cc_index_count > UINT32_MAX / sizeof (zc_index_entry_t))
+		errx(1, "stream has too many frames; use a larger frame size");
+	compress_fwrite(cc, &frame, sizeof (frame));
+	compress_fwrite(cc, cc->cc_index,
+	    cc->cc_index_count * sizeof (zc_index_entry_t));
+	compress_fwrite(cc, &trailer, sizeof (trailer));
+}
+
+static disposition_t
+chain_write_frame(void *item_in, void *context_in)
+{
+	zc_item_t *item = (zc_item_t *)item_in;
+	compress_context_t *cc = (compress_context_t *)context_in;
+
+	if (!cc->cc_started)
+		compress_write_header(cc);
+
+	if (item == NULL) {
+		compress_write_index(cc);
+		if (fflush(stdout) != 0)
+			err(1, "error writing compressed stream");
+		return (D_OK);
+	}
+
+	if (cc->cc_index_count == cc->cc_index_size) {
+		cc->cc_index_size = MAX(cc->cc_index_size * 2, 1024);
+		cc->cc_index = realloc(cc->cc_index,
+		    cc->cc_index_size * sizeof (zc_index_entry_t));
+		if (cc->cc_index == NULL)
+			err(1, "realloc");
+	}
+	zc_index_entry_t *entry = &cc->cc_index[cc->cc_index_count++];
+	entry->zi_offset = LE_64(cc->cc_offset);
+	entry->zi_stream_offset = LE_64(item->zi_frame.zf_stream_offset);
+	entry->zi_psize = LE_32(item->zi_frame.zf_psize);
+	entry->zi_lsize = LE_32(item->zi_frame.zf_lsize);
+
+	zc_frame_t frame = {
+		.zf_magic = LE_32(item->zi_frame.zf_magic),
+		.zf_compress = LE_16(item->zi_frame.zf_compress),
+		.zf_flags = LE_16(item->zi_frame.zf_flags),
+		.zf_psize = LE_32(item->zi_frame.zf_psize),
+		.zf_lsize = LE_32(item->zi_frame.zf_lsize),
+		.zf_stream_offset = LE_64(item->zi_frame.zf_stream_offset)
+	};
+	for (int i = 0; i < 4; i++) {
+		frame.zf_checksum.zc_word[i] =
+		    LE_64(item->zi_frame.zf_checksum.zc_word[i]);
+	}
+	compress_fwrite(cc, &frame, sizeof (frame));
+	compress_fwrite(cc, item->zi_data, item->zi_frame.zf_psize);
+	free(item->zi_data);
+	item->zi_data = NULL;
+	return (D_OK);
+}
+
+static disposition_t
+chain_read_frame(void *item_in, void *context_in)
+{
+	zc_item_t *item = (zc_item_t *)item_in;
+	zc_reader_t **readerp = (zc_reader_t **)context_in;
+	zc_header_t header;
+
+	if (item == NULL)
+		return (D_OK);
+
+	if (*readerp == NULL) {
+		check_not_tty(STDIN_FILENO);
+		if (fread(&header, sizeof (header), 1, stdin) != 1) {
+			if (ferror(stdin))
+				err(1, "error reading compressed stream");
+			errx(1, "compressed stream is empty");
+		}
+		if (!zc_is_header(&header))
+			errx(1, "input is not a compressed stream");
+		*readerp = zc_reader_create(stdin, &header);
+	}
+
+	if (!zc_reader_next_frame(*readerp, &item->zi_frame, &item->zi_data))
+		return (D_EOF);
+	return (D_OK);
+}
+
+static void
+chain_decompress_frame(queue_item_t *item_in, void *context_in)
+{
+	(void) context_in;
+	zc_item_t *item = (zc_item_t *)item_in;
+	uint8_t *buf = zc_decompress_frame(&item->zi_frame, item->zi_data);
+
+	free(item->zi_data);
+	item->zi_data = buf;
+	item->zi_frame.zf_psize = item->zi_frame.zf_lsize;
+	item->zi_frame.zf_compress = ZIO_COMPRESS_OFF;
+}
+
+static size_t
+chain_decompress_frame_cost(queue_item_t *item_in, void *context_in)
+{
+	(void) context_in;
+	zc_item_t *item = (zc_item_t *)item_in;
+
+	if (ctype_is_uncompressed(item->zi_frame.zf_compress))
+		return (0);
+	return (item->zi_frame.zf_lsize);
+}
+
+static disposition_t
+chain_write_data(void *item_in, void *context_in)
+{
+	zc_item_t *item = (zc_item_t *)item_in;
+	boolean_t *startedp = (boolean_t *)context_in;
+
+	if (!*startedp) {
+		check_not_tty(STDOUT_FILENO);
+		*startedp = B_TRUE;
+	}
+	if (item == NULL) {
+		if (fflush(stdout) != 0)
+			err(1, "error writing stream");
+		return (D_OK);
+	}
+	if (fwrite(item->zi_data, item->zi_frame.zf_lsize, 1, stdout) != 1)
+		err(1, "error writing stream");
+	free(item->zi_data);
+	item->zi_data = NULL;
+	return (D_OK);
+}
+
+int
+zstream_do_compress(int argc, char *argv[])
+{
+	chain_attrs_t attrs = {0};
+	compress_context_t context = {
+		.cc_spec = {
+			.cs_type = ZIO_COMPRESS_ZSTD,
+			.cs_level = ZIO_COMPLEVEL_DEFAULT
+		},
+		.cc_frame_size = ZC_DEFAULT_FRAME_SIZE
+	};
+	uint_t num_threads;
+	uint64_t frame_size;
+	int c;
+
+	while ((c = getopt(argc, argv, "b:l:t:v")) != -1) {
+		switch (c) {
+		case 'b':
+			if (zfs_nicestrtonum(NULL, optarg, &frame_size) != 0 ||
+			    frame_size < SPA_MINBLOCKSIZE ||
+			    frame_size > ZC_MAX_FRAME_SIZE) {
+				errx(2, "invalid frame size '%s'", optarg);
+			}
+			context.cc_frame_size = frame_size;
+			break;
+		case 'l':
+			if (sscanf(optarg, "%d", &context.cc_spec.cs_level) !=
+			    1 || context.cc_spec.cs_level < ZIO_ZSTD_LEVEL_1 ||
+			    context.cc_spec.cs_level > ZIO_ZSTD_LEVEL_19) {
+				errx(2, "invalid zstd level '%s'", optarg);
+			}
+			break;
+		case 't':
+			if (sscanf(optarg, "%u", &num_threads) != 1) {
+				warnx("failed to parse num_threads '%s'",
+				    optarg);
+				zstream_usage();
+			}
+			zstream_queue_set_num_threads(num_threads);
+			break;
+		case 'v':
+			ENABLE_OPTION(&attrs, CA_VERBOSE);
+			break;
+		case '?':
+			warnx("invalid option '%c'", optopt);
+			zstream_usage();
+		}
+	}
+
+	if (argc != optind)
+		zstream_usage();
+
+	zstream_chain_t compress_chain = {
+		{
+			.cs_type = CS_SERIAL,
+			.cs_in_size = 0,
+			.cs_out_size = sizeof (zc_item_t),
+			.cs_context = &context,
+			.cs_serial = { .process = chain_fill_frame }
+		},
+		{
+			.cs_type = CS_PARALLEL,
+			.cs_in_size = sizeof (zc_item_t),
+			.cs_out_size = sizeof (zc_item_t),
+			.cs_context = &context,
+			.cs_parallel = {
+				.queue_length = 64,
+				.batch_budget = 0,
+				.process = chain_compress_frame,
+				.cost = chain_compress_frame_cost
+			}
+		},
+		{
+			.cs_type = CS_SERIAL,
+			.cs_in_size = sizeof (zc_item_t),
+			.cs_out_size = 0,
+			.cs_context = &context,
+			.cs_serial = { .process = chain_write_frame }
+		},
+		chain_terminator()
+	};
+	zstream_chain_exec(compress_chain, &attrs);
+
+	if (OPTION_ENABLED(CA_VERBOSE)) {
+		char lsize[16], psize[16];
+
+		zfs_nicenum(context.cc_stream_offset, lsize, sizeof (lsize));
+		zfs_nicenum(context.cc_offset, psize, sizeof (psize));
+		(void) fprintf(stderr, "Compressed %sB into %sB in %llu "
+		    "frames.\n", lsize, psize,
+		    (u_longlong_t)context.cc_index_count);
+	}
+
+	free(context.cc_index);
+	return (0);
+}
+
+int
+zstream_do_uncompress(int argc, char *argv[])
+{
+	zc_reader_t *reader = NULL;
+	boolean_t started = B_FALSE;
+	uint_t num_threads;
+	int c;
+
+	while ((c = getopt(argc, argv, "t:")) != -1) {
+		switch (c) {
+		case 't':
+			if (sscanf(optarg, "%u", &num_threads) != 1) {
+				warnx("failed to parse num_threads '%s'",
+				    optarg);
+				zstream_usage();
+			}
+			zstream_queue_set_num_threads(num_threads);
+			break;
+		case '?':
+			warnx("invalid option '%c'", optopt);
+			zstream_usage();
+		}
+	}
+
+	if (argc != optind)
+		zstream_usage();
+
+	zstream_chain_t uncompress_chain = {
+		{
+			.cs_type = CS_SERIAL,
+			.cs_in_size = 0,
+			.cs_out_size = sizeof (zc_item_t),
+			.cs_context = &reader,
+			.cs_serial = { .process = chain_read_frame }
+		},
+		{
+			.cs_type = CS_PARALLEL,
+			.cs_in_size = sizeof (zc_item_t),
+			.cs_out_size = sizeof (zc_item_t),
+			.cs_context = NULL,
+			.cs_parallel = {
+				.queue_length = 64,
+				.batch_budget = 0,
+				.process = chain_decompress_frame,
+				.cost = chain_decompress_frame_cost
+			}
+		},
+		{
+			.cs_type = CS_SERIAL,
+			.cs_in_size = sizeof (zc_item_t),
+			.cs_out_size = 0,
+			.cs_context = &started,
+			.cs_serial = { .process = chain_write_data }
+		},
+		chain_terminator()
+	};
+	zstream_chain_exec(uncompress_chain, NULL);
+
+	if (reader != NULL)
+		zc_reader_destroy(reader);
+	return (0);
+}
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * https://opensource.org/license/CDDL-1.0.
+ */
+
+#ifndef _ZSTREAM_COMPRESS_H
+#define	_ZSTREAM_COMPRESS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/zfs_ioctl.h>
+
+/*
+ * A compressed stream, as written by zstream compress, is a header followed
+ * by frames, each holding whole records of the original stream, compressed
+ * independently of the others. A frame is at most SPA_MAXBLOCKSIZE bytes
+ * uncompressed, so a record too large for one is continued in the next.
+ * An index of the frames follows the last one, and a trailer that locates
+ * the index ends the stream, so a reader that can seek may go straight to
+ * the frame holding any stream offset.
+ *
+ * The header is the size of a replay record, so readers of send streams can
+ * tell a compressed stream from a plain one by reading the first record.
+ * All fields are little-endian.
+ */
+
+#define	ZC_MAGIC		0x31305a4d52545346ULL	/* "FSTRMZ01" */
+#define	ZC_TRAILER_MAGIC	0x31305849444e495aULL	/* "ZINDEX01" */
+#define	ZC_FRAME_DATA		0x41544144		/* "DATA" */
+#define	ZC_FRAME_INDEX		0x58444e49		/* "INDX" */
+#define	ZC_VERSION		1
+
+#define	ZC_FRAME_CONTINUED	(1U << 0)	/* Starts mid-record */
+
+typedef struct {
+	uint64_t	zh_magic;
+	uint32_t	zh_version;
+	uint32_t	zh_frame_size;	/* Target uncompressed frame size */
+	uint8_t		zh_pad[sizeof (dmu_replay_record_t) - 16];
+} zc_header_t;
+
+/*
+ * A ZC_FRAME_INDEX frame has zf_lsize index entries, in zf_psize bytes.
+ * zf_compress is ZIO_COMPRESS_OFF for a frame stored uncompressed. The
+ * checksum of a data frame covers its payload as stored.
+ */
+typedef struct {
+	uint32_t	zf_magic;
+	uint16_t	zf_compress;
+	uint16_t	zf_flags;
+	uint32_t	zf_psize;
+	uint32_t	zf_lsize;
+	uint64_t	zf_stream_offset;
+	zio_cksum_t	zf_checksum;	/* Fletcher-4 */
+} zc_frame_t;
+
+typedef struct {
+	uint64_t	zi_offset;	/* In the compressed stream */
+	uint64_t	zi_stream_offset;
+	uint32_t	zi_psize;
+	uint32_t	zi_lsize;
+} zc_index_entry_t;
+
+typedef struct {
+	uint64_t	zt_index_offset;
+	uint64_t	zt_magic;
+} zc_trailer_t;
+
+typedef struct zc_reader zc_reader_t;
+
+/*
+ * Whether the first record of a stream is a compressed stream header.
+ */
+boolean_t
+zc_is_header(const void *buf);
+
+/*
+ * Read a compressed stream from fp, whose header has already been read.
+ * The reader checks the frames, their offsets and the index as it reads
+ * them.
+ */
+zc_reader_t *
+zc_reader_create(FILE *fp, const void *header);
+
+void
+zc_reader_destroy(zc_reader_t *reader);
+
+/*
+ * Read the next frame, returning B_FALSE after the last one. The frame's
+ * header is in host order, and its payload, still compressed, is allocated
+ * for the caller.
+ */
+boolean_t
+zc_reader_next_frame(zc_reader_t *reader, zc_frame_t *frame,
+    uint8_t **payloadp);
+
+/*
+ * Read len bytes of the original stream, decompressing frames as needed.
+ * Returns the number of bytes read, which is less than len only at the end
+ * of the stream.
+ */
+size_t
+zc_reader_read(zc_reader_t *reader, void *buf, size_t len);
+
+/*
+ * Position the reader at an offset of the original stream, which is found
+ * with the index at the end of the compressed stream. The compressed
+ * stream must be seekable.
+ */
+void
+zc_reader_seek(zc_reader_t *reader, uint64_t stream_offset);
+
+/*
+ * Decompress the payload of a frame read by zc_reader_next_frame() into a
+ * buffer of zf_lsize bytes allocated for the caller.
+ */
+uint8_t *
+zc_decompress_frame(const zc_frame_t *frame, uint8_t *payload);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* _ZSTREAM_COMPRESS_H */
@@ -136,10 +136,16 @@ int
 zstream_do_decompress(int argc, char *argv[])
 {
 	chain_attrs_t attrs = {0};
+	zstream_index_t *index = NULL;
 	int c;
 
-	while ((c = getopt(argc, argv, "v")) != -1) {
+	while ((c = getopt(argc, argv, "i:v")) != -1) {
 		switch (c) {
+		case 'i':
+			if (index != NULL)
+				zsi_close(index);
+			index = zsi_open(optarg);
+			break;
 		case 'v':
 			ENABLE_OPTION(&attrs, CA_VERBOSE);
 			break;
@@ -196,6 +202,14 @@ zstream_do_decompress(int argc, char *argv[])
 			}
 		}
 
+		/* With an index, a write that isn't there is an error */
+		if (index != NULL && !zsi_find(index, DROP_WRITE,
+		    object, offset)) {
+			errx(1, "the stream has no record for object %llu "
+			    "offset %llu", (u_longlong_t)object,
+			    (u_longlong_t)offset);
+		}
+
 		int n_chars = asprintf(&key, "%llu,%llu", (u_longlong_t)object,
 		    (u_longlong_t)offset);
 		if (n_chars < 0)
@@ -211,12 +225,14 @@ zstream_do_decompress(int argc, char *argv[])
 	ENABLE_OPTION(&attrs, CA_FORBID_DEDUP);
 
 	zstream_chain_t decompress_chain = {
-		STANDARD_INPUT_STACK(NULL),
+		INDEXED_INPUT_STACK(NULL, index, zsi_select_all, NULL),
 		serial_decompress_named_writes(),
 		STANDARD_OUTPUT_STACK(NULL)
 	};
 	zstream_chain_exec(decompress_chain, &attrs);
 
 	hdestroy();
+	if (index != NULL)
+		zsi_close(index);
 	return (0);
 }
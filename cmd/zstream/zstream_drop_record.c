@@ -108,9 +108,15 @@ zstream_do_drop_record(int argc, char *argv[])
 {
 	int c;
 	chain_attrs_t attrs = {0};
+	zstream_index_t *index = NULL;
 
-	while ((c = getopt(argc, argv, "v")) != -1) {
+	while ((c = getopt(argc, argv, "i:v")) != -1) {
 		switch (c) {
+		case 'i':
+			if (index != NULL)
+				zsi_close(index);
+			index = zsi_open(optarg);
+			break;
 		case 'v':
 			ENABLE_OPTION(&attrs, CA_VERBOSE);
 			break;
@@ -148,6 +154,17 @@ zstream_do_drop_record(int argc, char *argv[])
 		if (errno || *end != '\0')
 			errx(1, "invalid value for offset");
 
+		/*
+		 * The whole stream is rewritten regardless, but an index can
+		 * tell up front whether the record is there at all.
+		 */
+		if (index != NULL && !zsi_find(index,
+		    DROP_WRITE | DROP_WRITE_EMBEDDED, object, offset)) {
+			errx(1, "the stream has no record for object %llu "
+			    "offset %llu", (u_longlong_t)object,
+			    (u_longlong_t)offset);
+		}
+
 		if (asprintf(&key, "%llu,%llu", (u_longlong_t)object,
 		    (u_longlong_t)offset) < 0) {
 			err(1, "asprintf");
@@ -163,12 +180,14 @@ zstream_do_drop_record(int argc, char *argv[])
 	ENABLE_OPTION(&attrs, CA_FORBID_DEDUP);
 
 	zstream_chain_t drop_chain = {
-		STANDARD_INPUT_STACK(NULL),
+		INDEXED_INPUT_STACK(NULL, index, zsi_select_all, NULL),
 		serial_drop_records(),
 		STANDARD_OUTPUT_STACK(NULL)
 	};
 	zstream_chain_exec(drop_chain, &attrs);
 
 	hdestroy();
+	if (index != NULL)
+		zsi_close(index);
 	return (0);
 }
@@ -21,9 +21,11 @@
 
 #include <ctype.h>
 #include <err.h>
+#include <errno.h>
 #include <libnvpair.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/nvpair.h>
 #include <sys/param.h>
@@ -494,17 +496,63 @@ serial_dump_records(void)
 	return (step);
 }
 
+/*
+ * The records that -o chooses
+ */
+typedef struct {
+	uint64_t	ds_object;
+	uint64_t	ds_offset;	/* UINT64_MAX for the whole object */
+} dump_selection_t;
+
+static boolean_t
+dump_select(const zsi_entry_t *entry, void *arg)
+{
+	dump_selection_t *sel = arg;
+
+	return (zsi_entry_matches(entry, sel->ds_object, sel->ds_offset));
+}
+
+static void
+parse_selection(char *arg, dump_selection_t *sel)
+{
+	char *obj_str = strsep(&arg, ",");
+	char *end;
+
+	errno = 0;
+	sel->ds_object = strtoull(obj_str, &end, 0);
+	if (errno || *end != '\0' || *obj_str == '\0')
+		errx(1, "invalid value for object");
+	sel->ds_offset = UINT64_MAX;
+	if (arg != NULL) {
+		sel->ds_offset = strtoull(arg, &end, 0);
+		if (errno || *end != '\0' || *arg == '\0')
+			errx(1, "invalid value for offset");
+	}
+}
+
 int
 zstream_do_dump(int argc, char *argv[])
 {
 	chain_attrs_t attrs = {0};
 	const char *input_file = NULL;
+	zstream_index_t *index = NULL;
+	dump_selection_t sel;
+	boolean_t selecting = B_FALSE;
 	int c;
 
 	ENABLE_OPTION(&attrs, CA_DUMP_BEGIN_AND_END);
 
-	while ((c = getopt(argc, argv, ":vCd")) != -1) {
+	while ((c = getopt(argc, argv, ":vCdi:o:")) != -1) {
 		switch (c) {
+		case 'i':
+			if (index != NULL)
+				zsi_close(index);
+			index = zsi_open(optarg);
+			break;
+		case 'o':
+			parse_selection(optarg, &sel);
+			selecting = B_TRUE;
+			break;
 		case 'C':
 			ENABLE_OPTION(&attrs, CA_IGNORE_CKSUMS);
 			break;
@@ -534,15 +582,40 @@ zstream_do_dump(int argc, char *argv[])
 	if (argc > optind) {
 		input_file = argv[optind];
 	}
-
-	zstream_chain_t dump_chain = {
-		STANDARD_INPUT_STACK(input_file),
-		serial_dump_records(),
-		NULL_OUTPUT_STACK()
-	};
+	if (index != NULL && !selecting) {
+		warnx("-i requires -o");
+		zstream_usage();
+	}
 
 	stream_error = 0;
-	zstream_chain_exec(dump_chain, &attrs);
+	if (selecting) {
+		zstream_chain_t dump_chain = {
+			INDEXED_INPUT_STACK(input_file, index, dump_select,
+			    &sel),
+			serial_select_records(dump_select, &sel),
+			serial_dump_records(),
+			NULL_OUTPUT_STACK()
+		};
+		zstream_chain_exec(dump_chain, &attrs);
+	} else {
+		zstream_chain_t dump_chain = {
+			STANDARD_INPUT_STACK(input_file),
+			serial_dump_records(),
+			NULL_OUTPUT_STACK()
+		};
+		zstream_chain_exec(dump_chain, &attrs);
+	}
+	if (index != NULL)
+		zsi_close(index);
+
+	/*
+	 * With -o, summarize only the records selected, which are the same
+	 * whether or not an index let the others go unread.
+	 */
+	record_stats_t *by_type = selecting ? attrs.ca_stats_out :
+	    attrs.ca_stats_in;
+	record_stats_t *totals = selecting ? &attrs.ca_totals_out :
+	    &attrs.ca_totals_in;
 
 	/*
 	 * Match previous zstream dump summary order
@@ -553,24 +626,22 @@ zstream_do_dump(int argc, char *argv[])
 		DRR_FREE, DRR_SPILL, DRR_OBJECT_RANGE, DRR_REDACT
 	};
 
-	printf("SUMMARY:\n");
+	printf(selecting ? "SUMMARY of selected records:\n" : "SUMMARY:\n");
 	for (int i = 0; i < DRR_NUMTYPES; i++) {
 		int type = print_order[i];
 		const record_dumper_t *rec = &record_dumpers[type];
-		record_stats_t *stats = &attrs.ca_stats_in[type];
+		record_stats_t *stats = &by_type[type];
 		printf("\tTotal %s records = %llu (%llu bytes)\n",
 		    rec->rt_typename,
 		    (u_longlong_t)stats->rs_num_records,
 		    (u_longlong_t)stats->rs_total_payload_bytes);
 	}
 
-	uint64_t total_payload =
-	    attrs.ca_totals_in.rs_total_payload_bytes;
-	uint64_t total_header =
-	    attrs.ca_totals_in.rs_total_header_bytes;
+	uint64_t total_payload = totals->rs_total_payload_bytes;
+	uint64_t total_header = totals->rs_total_header_bytes;
 
 	printf("\tTotal records = %llu\n",
-	    (u_longlong_t)attrs.ca_totals_in.rs_num_records);
+	    (u_longlong_t)totals->rs_num_records);
 	printf("\tTotal payload size = %llu (0x%llx)\n",
 	    (u_longlong_t)total_payload, (u_longlong_t)total_payload);
 	printf("\tTotal header overhead = %llu (0x%llx)\n",
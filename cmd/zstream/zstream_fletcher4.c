@@ -46,6 +46,7 @@ typedef enum { F4_SET, F4_VALIDATE } fletcher4_op_t;
 typedef struct {
 	zio_cksum_t	fc_stream_cksum;
 	fletcher4_op_t	fc_operation;
+	off_t		fc_next_offset;	/* Of the record expected next */
 } fletcher4_context_t;
 
 static fletcher4_context_t	fletcher4_contexts[MAX_FLETCHER_4];
@@ -235,6 +236,18 @@ chain_fletcher4(queue_item_t *item_in, void *context_in)
 		VERIFY3U(ck_offset, ==, sizeof (dmu_replay_record_t) -
 		    sizeof (zio_cksum_t));
 	}
+	if (context->fc_operation == F4_VALIDATE) {
+		/*
+		 * A reader that skips records with a stream index supplies
+		 * the stream checksum for the record it skipped to.
+		 */
+		if (item->dp_base.dp_stream_offset != context->fc_next_offset)
+			*stream_cksum = item->dp_base.dp_stream_cksum;
+		else
+			item->dp_base.dp_stream_cksum = *stream_cksum;
+		context->fc_next_offset = item->dp_base.dp_stream_offset +
+		    sizeof (*drr) + item->dp_base.dp_payload_size;
+	}
 	if (drr_type == DRR_BEGIN) {
 		ZIO_SET_CHECKSUM(stream_cksum, 0, 0, 0, 0);
 	} else if (drr_type == DRR_END) {
@@ -271,6 +284,15 @@ chain_fletcher4(queue_item_t *item_in, void *context_in)
 		    stream_cksum);
 		assemble_payload_cksum(item, stream_cksum);
 	}
+	/*
+	 * The reader may skip what follows, so check the payload against
+	 * the index before the stream checksum is replaced.
+	 */
+	if (context->fc_operation == F4_VALIDATE &&
+	    item->dp_base.dp_has_next_cksum) {
+		validate_or_exit(stream_cksum, &item->dp_base.dp_next_cksum,
+		    B_FALSE, "at DRR payload end", context->fc_next_offset);
+	}
 	return (D_OK);
 }
 
@@ -304,6 +326,7 @@ fletcher4_serial_step(fletcher4_op_t operation)
 	fletcher4_context_t *context = &fletcher4_contexts[context_ix];
 
 	context->fc_operation = operation;
+	context->fc_next_offset = 0;
 	ZIO_SET_CHECKSUM(&context->fc_stream_cksum, 0, 0, 0, 0);
 
 	chain_step_t step = {
@@ -0,0 +1,430 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * https://opensource.org/license/CDDL-1.0.
+ */
+
+#include <assert.h>
+#include <err.h>
+#include <fcntl.h>
+#include <libzutil.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/byteorder.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/stdtypes.h>
+#include <sys/zfs_ioctl.h>
+#include <unistd.h>
+
+#include "zstream.h"
+#include "zstream_index.h"
+#include "zstream_modules.h"
+#include "zstream_util.h"
+
+struct zstream_index {
+	zsi_header_t	zsi_header;	/* In host order */
+	const uint8_t	*zsi_map;
+	size_t		zsi_map_size;
+};
+
+typedef struct {
+	const char	*wc_filename;
+	FILE		*wc_fp;
+	uint64_t	wc_entries;
+	uint64_t	wc_stream_size;
+	uint64_t	wc_toguid;
+} index_writer_t;
+
+typedef struct {
+	zsi_select_f	*sc_select;
+	void		*sc_arg;
+} select_context_t;
+
+static index_writer_t index_writer;
+
+static select_context_t select_contexts[MAX_DROP_FILTERS];
+static int next_select_context = 0;
+
+void
+zsi_describe_record(const dmu_replay_record_t *drr, zsi_entry_t *entry)
+{
+	const struct drr_object *drro = &drr->drr_u.drr_object;
+	const struct drr_freeobjects *drrfo = &drr->drr_u.drr_freeobjects;
+	const struct drr_write *drrw = &drr->drr_u.drr_write;
+	const struct drr_write_byref *drrwb = &drr->drr_u.drr_write_byref;
+	const struct drr_free *drrf = &drr->drr_u.drr_free;
+	const struct drr_spill *drrs = &drr->drr_u.drr_spill;
+	const struct drr_write_embedded *drrwe =
+	    &drr->drr_u.drr_write_embedded;
+	const struct drr_object_range *drror = &drr->drr_u.drr_object_range;
+	const struct drr_redact *drrr = &drr->drr_u.drr_redact;
+
+	entry->ze_type = drr->drr_type;
+	entry->ze_object = entry->ze_offset = entry->ze_length = 0;
+
+	switch (drr->drr_type) {
+	case DRR_OBJECT:
+		entry->ze_object = drro->drr_object;
+		break;
+	case DRR_FREEOBJECTS:
+		entry->ze_object = drrfo->drr_firstobj;
+		entry->ze_length = drrfo->drr_numobjs;
+		break;
+	case DRR_WRITE:
+		entry->ze_object = drrw->drr_object;
+		entry->ze_offset = drrw->drr_offset;
+		entry->ze_length = drrw->drr_logical_size;
+		break;
+	case DRR_WRITE_BYREF:
+		entry->ze_object = drrwb->drr_object;
+		entry->ze_offset = drrwb->drr_offset;
+		entry->ze_length = drrwb->drr_length;
+		break;
+	case DRR_FREE:
+		entry->ze_object = drrf->drr_object;
+		entry->ze_offset = drrf->drr_offset;
+		entry->ze_length = drrf->drr_length;
+		break;
+	case DRR_SPILL:
+		entry->ze_object = drrs->drr_object;
+		entry->ze_length = drrs->drr_length;
+		break;
+	case DRR_WRITE_EMBEDDED:
+		entry->ze_object = drrwe->drr_object;
+		entry->ze_offset = drrwe->drr_offset;
+		entry->ze_length = drrwe->drr_length;
+		break;
+	case DRR_OBJECT_RANGE:
+		entry->ze_object = drror->drr_firstobj;
+		entry->ze_length = drror->drr_numslots;
+		break;
+	case DRR_REDACT:
+		entry->ze_object = drrr->drr_object;
+		entry->ze_offset = drrr->drr_offset;
+		entry->ze_length = drrr->drr_length;
+		break;
+	default:
+		break;
+	}
+}
+
+boolean_t
+zsi_entry_matches(const zsi_entry_t *entry, uint64_t object,
+    uint64_t offset)
+{
+	switch (entry->ze_type) {
+	case DRR_BEGIN:
+	case DRR_END:
+		return (B_FALSE);
+	case DRR_FREEOBJECTS:
+	case DRR_OBJECT_RANGE:
+		return (object >= entry->ze_object &&
+		    object - entry->ze_object < entry->ze_length);
+	case DRR_OBJECT:
+	case DRR_SPILL:
+		return (object == entry->ze_object);
+	default:
+		/* A DRR_FREE may run to the end of the object */
+		return (object == entry->ze_object && (offset == UINT64_MAX ||
+		    (offset >= entry->ze_offset &&
+		    offset - entry->ze_offset < entry->ze_length)));
+	}
+}
+
+zstream_index_t *
+zsi_open(const char *path)
+{
+	zstream_index_t *index = safe_calloc(sizeof (zstream_index_t));
+	zsi_header_t *zsh = &index->zsi_header;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+		err(1, "%s", path);
+	if (st.st_size < sizeof (zsi_header_t))
+		errx(1, "%s is not a stream index", path);
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		err(1, "%s: mmap", path);
+	(void) close(fd);
+	(void) madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	memcpy(zsh, map, sizeof (*zsh));
+	zsh->zsh_magic = LE_64(zsh->zsh_magic);
+	zsh->zsh_version = LE_32(zsh->zsh_version);
+	zsh->zsh_entry_size = LE_32(zsh->zsh_entry_size);
+	zsh->zsh_entries = LE_64(zsh->zsh_entries);
+	zsh->zsh_stream_size = LE_64(zsh->zsh_stream_size);
+	zsh->zsh_toguid = LE_64(zsh->zsh_toguid);
+
+	if (zsh->zsh_magic != ZSI_MAGIC)
+		errx(1, "%s is not a stream index", path);
+	if (zsh->zsh_version != ZSI_VERSION) {
+		errx(1, "%s: unsupported stream index version %u", path,
+		    zsh->zsh_version);
+	}
+	if (zsh->zsh_entry_size != sizeof (zsi_entry_t) ||
+	    zsh->zsh_entries == 0 || zsh->zsh_entries !=
+	    (st.st_size - sizeof (*zsh)) / sizeof (zsi_entry_t) ||
+	    (st.st_size - sizeof (*zsh)) % sizeof (zsi_entry_t) != 0) {
+		errx(1, "stream index %s is truncated or corrupt", path);
+	}
+
+	index->zsi_map = map;
+	index->zsi_map_size = st.st_size;
+	return (index);
+}
+
+void
+zsi_close(zstream_index_t *index)
+{
+	(void) munmap((void *)index->zsi_map, index->zsi_map_size);
+	free(index);
+}
+
+const zsi_header_t *
+zsi_header(const zstream_index_t *index)
+{
+	return (&index->zsi_header);
+}
+
+void
+zsi_entry(const zstream_index_t *index, uint64_t i, zsi_entry_t *entry)
+{
+	VERIFY3U(i, <, index->zsi_header.zsh_entries);
+	memcpy(entry, index->zsi_map + sizeof (zsi_header_t) +
+	    i * sizeof (zsi_entry_t), sizeof (*entry));
+
+	entry->ze_stream_offset = LE_64(entry->ze_stream_offset);
+	entry->ze_type = LE_32(entry->ze_type);
+	entry->ze_payload_size = LE_32(entry->ze_payload_size);
+	entry->ze_object = LE_64(entry->ze_object);
+	entry->ze_offset = LE_64(entry->ze_offset);
+	entry->ze_length = LE_64(entry->ze_length);
+	for (int w = 0; w < 4; w++)
+		entry->ze_cksum.zc_word[w] = LE_64(entry->ze_cksum.zc_word[w]);
+}
+
+boolean_t
+zsi_find(const zstream_index_t *index, uint32_t type_mask, uint64_t object,
+    uint64_t offset)
+{
+	zsi_entry_t entry;
+
+	for (uint64_t i = 0; i < index->zsi_header.zsh_entries; i++) {
+		zsi_entry(index, i, &entry);
+		if ((type_mask & (UINT32_C(1) << entry.ze_type)) != 0 &&
+		    entry.ze_object == object && entry.ze_offset == offset)
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+boolean_t
+zsi_select_all(const zsi_entry_t *entry, void *arg)
+{
+	(void) entry, (void) arg;
+	return (B_TRUE);
+}
+
+static disposition_t
+chain_select_records(void *item_in, void *context_in)
+{
+	drr_packet_t *item = (drr_packet_t *)item_in;
+	select_context_t *context = (select_context_t *)context_in;
+	zsi_entry_t entry;
+
+	if (item == NULL)
+		return (D_OK);
+
+	zsi_describe_record(&item->dp_drr, &entry);
+	entry.ze_stream_offset = item->dp_stream_offset;
+	entry.ze_payload_size = item->dp_payload_size;
+	entry.ze_cksum = item->dp_stream_cksum;
+
+	if (item->dp_stream_offset == 0 || entry.ze_type == DRR_BEGIN ||
+	    entry.ze_type == DRR_END ||
+	    context->sc_select(&entry, context->sc_arg))
+		return (D_OK);
+
+	if (item->dp_payload != NULL) {
+		free(item->dp_payload);
+		item->dp_payload = NULL;
+		item->dp_payload_size = 0;
+	}
+	return (D_DROP);
+}
+
+chain_step_t
+serial_select_records(zsi_select_f *select, void *arg)
+{
+	int context_no = next_select_context++ % MAX_DROP_FILTERS;
+	select_context_t *context = &select_contexts[context_no];
+
+	context->sc_select = select;
+	context->sc_arg = arg;
+
+	chain_step_t step = {
+		.cs_type = CS_SERIAL,
+		.cs_in_size = sizeof (drr_packet_t),
+		.cs_out_size = sizeof (drr_packet_t),
+		.cs_context = context,
+		.cs_serial = {
+			.process = chain_select_records
+		}
+	};
+	return (step);
+}
+
+static void
+index_fwrite(index_writer_t *writer, const void *buf, size_t len)
+{
+	if (fwrite(buf, len, 1, writer->wc_fp) != 1)
+		err(1, "error writing %s", writer->wc_filename);
+}
+
+/*
+ * The header goes first, but the entry count and stream size aren't known
+ * until the end, so it's written twice.
+ */
+static void
+index_write_header(index_writer_t *writer)
+{
+	zsi_header_t header = {
+		.zsh_magic = LE_64(ZSI_MAGIC),
+		.zsh_version = LE_32(ZSI_VERSION),
+		.zsh_entry_size = LE_32(sizeof (zsi_entry_t)),
+		.zsh_entries = LE_64(writer->wc_entries),
+		.zsh_stream_size = LE_64(writer->wc_stream_size),
+		.zsh_toguid = LE_64(writer->wc_toguid)
+	};
+
+	if (fseeko(writer->wc_fp, 0, SEEK_SET) != 0)
+		err(1, "error writing %s", writer->wc_filename);
+	index_fwrite(writer, &header, sizeof (header));
+}
+
+static disposition_t
+chain_write_index(void *item_in, void *context_in)
+{
+	drr_packet_t *item = (drr_packet_t *)item_in;
+	index_writer_t *writer = (index_writer_t *)context_in;
+	zsi_entry_t entry;
+
+	if (item == NULL) {
+		if (writer->wc_fp == NULL)
+			errx(1, "stream is empty");
+		index_write_header(writer);
+		if (fclose(writer->wc_fp) != 0)
+			err(1, "error writing %s", writer->wc_filename);
+		writer->wc_fp = NULL;
+		return (D_OK);
+	}
+
+	if (writer->wc_fp == NULL) {
+		writer->wc_fp = fopen(writer->wc_filename, "wb");
+		if (writer->wc_fp == NULL)
+			err(1, "%s", writer->wc_filename);
+		index_write_header(writer);
+	}
+
+	dmu_replay_record_t *drr = &item->dp_drr;
+
+	if (drr->drr_type == DRR_BEGIN && writer->wc_entries == 0)
+		writer->wc_toguid = drr->drr_u.drr_begin.drr_toguid;
+
+	zsi_describe_record(drr, &entry);
+	entry.ze_stream_offset = LE_64(item->dp_stream_offset);
+	entry.ze_type = LE_32(entry.ze_type);
+	entry.ze_payload_size = LE_32(item->dp_payload_size);
+	entry.ze_object = LE_64(entry.ze_object);
+	entry.ze_offset = LE_64(entry.ze_offset);
+	entry.ze_length = LE_64(entry.ze_length);
+	for (int w = 0; w < 4; w++) {
+		entry.ze_cksum.zc_word[w] =
+		    LE_64(item->dp_stream_cksum.zc_word[w]);
+	}
+	index_fwrite(writer, &entry, sizeof (entry));
+
+	writer->wc_entries++;
+	writer->wc_stream_size = item->dp_stream_offset +
+	    sizeof (dmu_replay_record_t) + item->dp_payload_size;
+	return (D_OK);
+}
+
+chain_step_t
+serial_write_index(const char *filename)
+{
+	index_writer_t writer = {
+		.wc_filename = filename
+	};
+	index_writer = writer;
+
+	chain_step_t step = {
+		.cs_type = CS_SERIAL,
+		.cs_in_size = sizeof (drr_packet_t),
+		.cs_out_size = sizeof (drr_packet_t),
+		.cs_context = &index_writer,
+		.cs_serial = {
+			.process = chain_write_index
+		}
+	};
+	return (step);
+}
+
+int
+zstream_do_index(int argc, char *argv[])
+{
+	chain_attrs_t attrs = {0};
+	char *index_file;
+	int c;
+
+	while ((c = getopt(argc, argv, "v")) != -1) {
+		switch (c) {
+		case 'v':
+			ENABLE_OPTION(&attrs, CA_VERBOSE);
+			break;
+		case '?':
+			warnx("invalid option '%c'", optopt);
+			zstream_usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 1 || argc > 2)
+		zstream_usage();
+	if (argc == 2) {
+		index_file = argv[1];
+	} else if (asprintf(&index_file, "%s.index", argv[0]) < 0) {
+		err(1, "asprintf");
+	}
+
+	zstream_chain_t index_chain = {
+		STANDARD_INPUT_STACK(argv[0]),
+		serial_write_index(index_file),
+		NULL_OUTPUT_STACK()
+	};
+	zstream_chain_exec(index_chain, &attrs);
+
+	if (OPTION_ENABLED(CA_VERBOSE)) {
+		char buf[32];
+
+		zfs_nicenum(index_writer.wc_stream_size, buf, sizeof (buf));
+		fprintf(stderr, "Indexed %llu records in %s of stream to %s\n",
+		    (u_longlong_t)index_writer.wc_entries, buf, index_file);
+	}
+	if (argc == 1)
+		free(index_file);
+	return (0);
+}
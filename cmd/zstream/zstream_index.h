@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * https://opensource.org/license/CDDL-1.0.
+ */
+
+#ifndef _ZSTREAM_INDEX_H
+#define	_ZSTREAM_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <sys/spa_checksum.h>
+#include <sys/types.h>
+#include <sys/zfs_ioctl.h>
+
+#include "zstream_chain.h"
+
+/*
+ * A stream index, as written by zstream index, is a sidecar file with an
+ * entry for every record of a send stream. Each entry locates its record
+ * in the stream and carries the stream checksum that precedes it, so a
+ * reader can seek straight to the records it wants and still validate
+ * them. Offsets are those of the original stream, even when the stream
+ * has been compressed by zstream compress.
+ *
+ * The header is followed by the entries, in stream order. All fields are
+ * little-endian.
+ */
+
+#define	ZSI_MAGIC	0x313058444e49535aULL	/* "ZSINDX01" */
+#define	ZSI_VERSION	1
+
+typedef struct {
+	uint64_t	zsh_magic;
+	uint32_t	zsh_version;
+	uint32_t	zsh_entry_size;
+	uint64_t	zsh_entries;
+	uint64_t	zsh_stream_size;
+	uint64_t	zsh_toguid;	/* Of the first DRR_BEGIN */
+} zsi_header_t;
+
+/*
+ * ze_object is the record's object, or the first of the objects it covers
+ * for DRR_FREEOBJECTS and DRR_OBJECT_RANGE, in which case ze_length is the
+ * number of objects. Otherwise ze_offset and ze_length give the range of
+ * the object the record applies to, if any.
+ */
+typedef struct {
+	uint64_t	ze_stream_offset;
+	uint32_t	ze_type;
+	uint32_t	ze_payload_size;
+	uint64_t	ze_object;
+	uint64_t	ze_offset;
+	uint64_t	ze_length;
+	zio_cksum_t	ze_cksum;	/* Stream checksum before the record */
+} zsi_entry_t;
+
+typedef struct zstream_index zstream_index_t;
+
+/*
+ * Chooses the records that a reader of an indexed stream needs. The first
+ * record and all DRR_BEGIN and DRR_END records are always read, so the
+ * function is not called for those.
+ */
+typedef boolean_t
+zsi_select_f(const zsi_entry_t *entry, void *arg);
+
+/*
+ * Fill in the type, object, offset and length of an entry from a record
+ * in host byte order.
+ */
+void
+zsi_describe_record(const dmu_replay_record_t *drr, zsi_entry_t *entry);
+
+/*
+ * Whether a record, as described above, applies to the given object and,
+ * unless offset is UINT64_MAX, to the given offset within it.
+ */
+boolean_t
+zsi_entry_matches(const zsi_entry_t *entry, uint64_t object,
+    uint64_t offset);
+
+/*
+ * Open an index written by serial_write_index(). Exits on failure.
+ */
+zstream_index_t *
+zsi_open(const char *path);
+
+void
+zsi_close(zstream_index_t *index);
+
+const zsi_header_t *
+zsi_header(const zstream_index_t *index);
+
+/*
+ * Copy entry i, in host byte order, to *entry.
+ */
+void
+zsi_entry(const zstream_index_t *index, uint64_t i, zsi_entry_t *entry);
+
+/*
+ * Look for a record of one of the types in type_mask (see the DROP_*
+ * masks in zstream_io.h) at the given object and offset.
+ */
+boolean_t
+zsi_find(const zstream_index_t *index, uint32_t type_mask, uint64_t object,
+    uint64_t offset);
+
+/*
+ * A zsi_select_f that chooses every record, for readers that use an index
+ * only to check that it matches the stream.
+ */
+boolean_t
+zsi_select_all(const zsi_entry_t *entry, void *arg);
+
+/*
+ * Drop the records that select doesn't choose. A reader with an index
+ * skips them anyway; this step does the same for streams read without
+ * one. It must follow byteswapping. The arg must remain valid while the
+ * chain executes.
+ */
+chain_step_t
+serial_select_records(zsi_select_f *select, void *arg);
+
+/*
+ * Write an entry for every record to the named file. The step must follow
+ * serial_validate_fletcher4() and byteswapping, which together leave the
+ * record in host order and its preceding stream checksum in the packet.
+ * The filename must remain valid while the chain executes.
+ */
+chain_step_t
+serial_write_index(const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* _ZSTREAM_INDEX_H */
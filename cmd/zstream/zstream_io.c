@@ -23,11 +23,13 @@
 #include <sys/byteorder.h>
 #include <sys/stdtypes.h>
 #include <sys/sysmacros.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/zfs_ioctl.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "zstream_compress.h"
 #include "zstream_modules.h"
 #include "zstream_util.h"
 
@@ -39,6 +41,12 @@ typedef struct {
 	FILE		*ic_fp;
 	boolean_t	ic_for_reading;
 	off_t		ic_offset;
+	zc_reader_t	*ic_zc;		/* If the input is compressed */
+	zstream_index_t	*ic_index;	/* If reading selected records */
+	zsi_select_f	*ic_select;
+	void		*ic_select_arg;
+	uint64_t	ic_next_entry;
+	zsi_entry_t	ic_entry;	/* Of the record being read */
 } io_context_t;
 
 typedef struct {
@@ -98,7 +106,7 @@ open_file(io_context_t *context)
  * 32-bit sizes. The drr_payloadlen field shared by all record types (but
  * used only by BEGIN records is also 32 bits.
  */
-static size_t
+size_t
 calc_payload_size(dmu_replay_record_t *drr)
 {
 	struct drr_object *drro		 = &drr->drr_u.drr_object;
@@ -210,6 +218,90 @@ set_stream_attributes(drr_packet_t *item)
 	}
 }
 
+/*
+ * Read from the input, uncompressing it if it was written by zstream
+ * compress. Returns the number of items read, as fread() does.
+ */
+static size_t
+read_input(io_context_t *context, void *buf, size_t len)
+{
+	if (context->ic_zc == NULL)
+		return (fread(buf, len, 1, context->ic_fp));
+	return (zc_reader_read(context->ic_zc, buf, len) == len);
+}
+
+/*
+ * Find the next record that the reader's selection function wants, and
+ * seek to it. Returns B_FALSE if there are no more.
+ */
+static boolean_t
+seek_selected(io_context_t *context)
+{
+	const zsi_header_t *zsh = zsi_header(context->ic_index);
+	zsi_entry_t *entry = &context->ic_entry;
+
+	for (;;) {
+		if (context->ic_next_entry == zsh->zsh_entries)
+			return (B_FALSE);
+		zsi_entry(context->ic_index, context->ic_next_entry++, entry);
+		if (entry->ze_stream_offset == 0 ||
+		    entry->ze_type == DRR_BEGIN || entry->ze_type == DRR_END ||
+		    context->ic_select(entry, context->ic_select_arg))
+			break;
+	}
+	if (entry->ze_stream_offset < context->ic_offset) {
+		errx(1, "stream index entry %llu is out of order",
+		    (u_longlong_t)context->ic_next_entry - 1);
+	}
+	if (entry->ze_stream_offset == context->ic_offset)
+		return (B_TRUE);
+
+	if (context->ic_zc != NULL) {
+		zc_reader_seek(context->ic_zc, entry->ze_stream_offset);
+	} else if (fseeko(context->ic_fp, entry->ze_stream_offset,
+	    SEEK_SET) != 0) {
+		err(1, "cannot seek to offset %llu of the stream",
+		    (u_longlong_t)entry->ze_stream_offset);
+	}
+	context->ic_offset = entry->ze_stream_offset;
+	return (B_TRUE);
+}
+
+/*
+ * Make sure that an index describes the stream being read, as far as can
+ * be told from its first record and its size.
+ */
+static void
+check_index(io_context_t *context, dmu_replay_record_t *drr)
+{
+	const zsi_header_t *zsh = zsi_header(context->ic_index);
+	uint64_t toguid = drr->drr_u.drr_begin.drr_toguid;
+	struct stat st;
+
+	if (ATTR_IS_SET(CA_BYTESWAPPED))
+		toguid = BSWAP_64(toguid);
+	if (toguid != zsh->zsh_toguid)
+		errx(1, "the stream index is for a different stream");
+	if (context->ic_zc == NULL &&
+	    fstat(fileno(context->ic_fp), &st) == 0 &&
+	    S_ISREG(st.st_mode) && st.st_size != zsh->zsh_stream_size) {
+		errx(1, "the stream index is for a stream of %llu bytes, "
+		    "but the stream has %llu",
+		    (u_longlong_t)zsh->zsh_stream_size,
+		    (u_longlong_t)st.st_size);
+	}
+}
+
+static void
+close_input(io_context_t *context)
+{
+	if (context->ic_zc != NULL) {
+		zc_reader_destroy(context->ic_zc);
+		context->ic_zc = NULL;
+	}
+	fclose(context->ic_fp);
+}
+
 static disposition_t
 chain_read(void *item_in, void *context_in)
 {
@@ -224,28 +316,64 @@ chain_read(void *item_in, void *context_in)
 	if (!context->ic_fp)
 		open_file(context);
 
-	if (fread(drr, sizeof (dmu_replay_record_t), 1, context->ic_fp) != 1) {
+	if (context->ic_index != NULL && !seek_selected(context)) {
+		close_input(context);
+		return (D_EOF);
+	}
+
+	size_t n_read = read_input(context, drr, sizeof (*drr));
+	if (n_read == 1 && context->ic_offset == 0 &&
+	    context->ic_zc == NULL && zc_is_header(drr)) {
+		context->ic_zc = zc_reader_create(context->ic_fp, drr);
+		n_read = read_input(context, drr, sizeof (*drr));
+	}
+	if (n_read != 1) {
 		if (ferror(context->ic_fp)) {
 			err(1, "error reading record header at offset %llu",
 			    (u_longlong_t)context->ic_offset);
 		}
-		fclose(context->ic_fp);
+		close_input(context);
 		return (D_EOF);
 	}
 
-	if (context->ic_offset == 0)
+	if (context->ic_offset == 0) {
 		set_stream_attributes(item);
+		if (context->ic_index != NULL)
+			check_index(context, drr);
+	}
 
 	size_t payload_size = calc_payload_size(&item->dp_drr);
 	if (payload_size > UINT32_MAX) {
 		errx(1, "stated packet size is greater than uint32_t"
 		    "at offset %llu", (u_longlong_t)context->ic_offset);
 	}
+	if (context->ic_index != NULL) {
+		uint32_t type = ATTR_IS_SET(CA_BYTESWAPPED) ?
+		    BSWAP_32(drr->drr_type) : drr->drr_type;
+
+		if (type != context->ic_entry.ze_type ||
+		    payload_size != context->ic_entry.ze_payload_size) {
+			errx(1, "the stream index does not match the record "
+			    "at offset %llu", (u_longlong_t)context->ic_offset);
+		}
+		item->dp_stream_cksum = context->ic_entry.ze_cksum;
+		item->dp_has_next_cksum = context->ic_next_entry <
+		    zsi_header(context->ic_index)->zsh_entries;
+		if (item->dp_has_next_cksum) {
+			zsi_entry_t next;
+
+			zsi_entry(context->ic_index, context->ic_next_entry,
+			    &next);
+			item->dp_next_cksum = next.ze_cksum;
+		}
+	} else {
+		item->dp_has_next_cksum = B_FALSE;
+	}
 	item->dp_payload_size = payload_size;
 	if (item->dp_payload_size > 0) {
 		item->dp_payload = safe_malloc(item->dp_payload_size);
-		size_t n_read = fread(item->dp_payload, item->dp_payload_size,
-		    1, context->ic_fp);
+		n_read = read_input(context, item->dp_payload,
+		    item->dp_payload_size);
 		if (n_read != 1) {
 			if (ferror(context->ic_fp)) {
 				err(1, "error reading record payload at "
@@ -260,7 +388,7 @@ chain_read(void *item_in, void *context_in)
 				warnx("input ends mid-record at offset %llu "
 				    "- stream is likely corrupt",
 				    (u_longlong_t)context->ic_offset);
-				fclose(context->ic_fp);
+				close_input(context);
 				free(item->dp_payload);
 				return (D_EOF);
 			}
@@ -293,6 +421,20 @@ chain_read(void *item_in, void *context_in)
 	return (D_OK);
 }
 
+static void
+count_output(uint32_t drr_type, uint32_t payload_size)
+{
+	record_stats_t *stats = &chain_attrs->ca_stats_out[drr_type];
+	stats->rs_num_records++;
+	stats->rs_total_header_bytes += sizeof (dmu_replay_record_t);
+	stats->rs_total_payload_bytes += payload_size;
+
+	stats = &chain_attrs->ca_totals_out;
+	stats->rs_num_records++;
+	stats->rs_total_header_bytes += sizeof (dmu_replay_record_t);
+	stats->rs_total_payload_bytes += payload_size;
+}
+
 static disposition_t
 chain_write(void *item_in, void *context_in)
 {
@@ -330,21 +472,14 @@ chain_write(void *item_in, void *context_in)
 	uint32_t drr_type = OPTION_ENABLED(CA_BYTESWAP_ON_OUTPUT) ?
 	    BSWAP_32(drr->drr_type) : drr->drr_type;
 
-	record_stats_t *stats = &chain_attrs->ca_stats_out[drr_type];
-	stats->rs_num_records++;
-	stats->rs_total_header_bytes += sizeof (dmu_replay_record_t);
-	stats->rs_total_payload_bytes += item->dp_payload_size;
-
-	stats = &chain_attrs->ca_totals_out;
-	stats->rs_num_records++;
-	stats->rs_total_header_bytes += sizeof (dmu_replay_record_t);
-	stats->rs_total_payload_bytes += item->dp_payload_size;
-
+	count_output(drr_type, item->dp_payload_size);
 	return (D_OK);
 }
 
 /*
  * Even if the chain doesn't write out a stream, payloads still need freed.
+ * The records are counted as output all the same, so that a chain that
+ * drops some of them can report on the rest.
  */
 static disposition_t
 chain_null_output(void *item_in, void *context)
@@ -352,6 +487,8 @@ chain_null_output(void *item_in, void *context)
 	(void) context;
 	drr_packet_t *item = (drr_packet_t *)item_in;
 
+	if (item != NULL && item->dp_drr.drr_type < DRR_NUMTYPES)
+		count_output(item->dp_drr.drr_type, item->dp_payload_size);
 	if (item && item->dp_payload != NULL && item->dp_payload_size > 0) {
 		free(item->dp_payload);
 		item->dp_payload = NULL;
@@ -392,6 +529,22 @@ serial_read_stream(const char *filename)
 	return (setup_io(filename, B_TRUE));
 }
 
+chain_step_t
+serial_read_stream_indexed(const char *filename, zstream_index_t *index,
+    zsi_select_f *select, void *arg)
+{
+	chain_step_t step = setup_io(filename, B_TRUE);
+	io_context_t *context = step.cs_context;
+
+	if (index == NULL)
+		return (step);
+
+	context->ic_index = index;
+	context->ic_select = select;
+	context->ic_select_arg = arg;
+	return (step);
+}
+
 chain_step_t
 serial_write_stream(const char *filename)
 {
@@ -27,6 +27,7 @@ extern "C" {
 #include <sys/zfs_ioctl.h>
 
 #include "zstream_chain.h"
+#include "zstream_index.h"
 
 #define	MAX_IO_STREAMS		4
 #define	MAX_DROP_FILTERS	4
@@ -52,22 +53,54 @@ extern "C" {
  * Changes to the stream (e.g., recompression) will necessarily change
  * offsets within the final stream. The original stream offset is raw data;
  * it should never be updated.
+ *
+ * The stream checksum is the Fletcher4 checksum of the stream up to the
+ * record. serial_validate_fletcher4() fills it in, except after a reader
+ * has skipped records, when it comes from the stream index and the
+ * validation resumes from it instead. A reader that uses an index also
+ * supplies the index's checksum of the stream up to the record after this
+ * one, so that the payload of a record followed by skipped ones is still
+ * validated.
  */
 typedef struct {
 	dmu_replay_record_t	dp_drr;
 	uint8_t			*dp_payload;
 	uint32_t		dp_payload_size;
 	off_t			dp_stream_offset;
+	zio_cksum_t		dp_stream_cksum;
+	zio_cksum_t		dp_next_cksum;
+	boolean_t		dp_has_next_cksum;
 } drr_packet_t;
 
+/*
+ * The size of the payload that follows a record, which may still be
+ * byteswapped if the stream is.
+ */
+size_t
+calc_payload_size(dmu_replay_record_t *drr);
+
 /*
  * In the following, the filename or checkpoint names must remain valid
  * as long as the chain is executing.
  */
 
+/*
+ * A stream written by zstream compress is uncompressed as it is read.
+ */
 chain_step_t
 serial_read_stream(const char *filename);
 
+/*
+ * Read only the records of a stream that select chooses, seeking past the
+ * others with the help of the stream's index. The stream must be a file,
+ * though it may be compressed, unless every record is chosen. The index and
+ * arg must remain valid as long as the chain is executing. With a NULL
+ * index, this is serial_read_stream().
+ */
+chain_step_t
+serial_read_stream_indexed(const char *filename, zstream_index_t *index,
+    zsi_select_f *select, void *arg);
+
 chain_step_t
 serial_write_stream(const char *filename);
 
@@ -30,18 +30,22 @@ extern "C" {
 #include "zstream_chain.h"
 #include "zstream_dump.h"
 #include "zstream_fletcher4.h"
+#include "zstream_index.h"
 #include "zstream_io.h"
 #include "zstream_recompress.h"
 #include "zstream_util.h"
 #include "zstream_validate.h"
 
-#define	STANDARD_INPUT_STACK_Q(infile, queue_size) 			\
-	serial_read_stream(infile),					\
+#define	INPUT_STACK_Q(reader, queue_size) 				\
+	reader,								\
 	parallel_calc_fletcher4(queue_size),				\
 	serial_validate_fletcher4(),					\
 	serial_byteswap(BS_INCOMING),					\
 	serial_validate_records()
 
+#define	STANDARD_INPUT_STACK_Q(infile, queue_size) 			\
+	INPUT_STACK_Q(serial_read_stream(infile), queue_size)
+
 #define	STANDARD_OUTPUT_STACK_Q(outfile, queue_size) 			\
 	serial_byteswap(BS_OUTGOING),					\
 	parallel_calc_fletcher4(queue_size),				\
@@ -50,6 +54,9 @@ extern "C" {
 	chain_terminator()
 
 #define	STANDARD_INPUT_STACK(infile)	STANDARD_INPUT_STACK_Q(infile, 1024)
+#define	INDEXED_INPUT_STACK(infile, index, select, arg)			\
+	INPUT_STACK_Q(serial_read_stream_indexed(infile, index, select,	\
+	    arg), 1024)
 #define	STANDARD_OUTPUT_STACK(outfile)	STANDARD_OUTPUT_STACK_Q(outfile, 512)
 
 #define	NULL_OUTPUT_STACK()						\
@@ -399,6 +399,17 @@ chain_replay_raw(void *item_in, void *context_in)
 	return (D_OK);
 }
 
+/*
+ * With an index, read only the records of the zvol's data and properties.
+ */
+static boolean_t
+raw_select(const zsi_entry_t *entry, void *arg)
+{
+	(void) arg;
+	return (zsi_entry_matches(entry, ZVOL_OBJ, UINT64_MAX) ||
+	    zsi_entry_matches(entry, ZVOL_ZAP_OBJ, UINT64_MAX));
+}
+
 /* Keep this small enough to not accidentally run systems out of memory. */
 #define	BUFFERS_MAX_DEFAULT 32
 
@@ -411,8 +422,9 @@ zstream_do_raw(int argc, char *argv[])
 	chain_attrs_t attrs = { 0 };
 	ENABLE_OPTION(&attrs, CA_FORBID_DEDUP);
 
+	zstream_index_t *index = NULL;
 	int c;
-	while ((c = getopt(argc, argv, ":b:g:v")) != -1) {
+	while ((c = getopt(argc, argv, ":b:g:i:v")) != -1) {
 		switch (c) {
 		case 'b':
 			context.limits.buffers_max = strtol(optarg, NULL, 0);
@@ -428,6 +440,11 @@ zstream_do_raw(int argc, char *argv[])
 				zstream_usage();
 			}
 			break;
+		case 'i':
+			if (index != NULL)
+				zsi_close(index);
+			index = zsi_open(optarg);
+			break;
 		case 'v':
 			ENABLE_OPTION(&attrs, CA_VERBOSE);
 			ENABLE_OPTION(&attrs, CA_DUMP_ALL_RECORDS);
@@ -492,7 +509,8 @@ zstream_do_raw(int argc, char *argv[])
 	uint32_t drop_mask = DROP_END | DROP_FREEOBJECTS | DROP_OBJECT_RANGE |
 	    DROP_REDACT | DROP_SPILL;
 	zstream_chain_t raw_chain = {
-		STANDARD_INPUT_STACK((argc > 1) ? argv[1] : NULL),
+		INDEXED_INPUT_STACK((argc > 1) ? argv[1] : NULL, index,
+		    raw_select, NULL),
 		serial_dump_records(),
 		serial_drop_record_types(drop_mask),
 		parallel_decompress_writes(NULL),
@@ -508,6 +526,8 @@ zstream_do_raw(int argc, char *argv[])
 	zstream_chain_exec(raw_chain, &attrs);
 
 	buffer_finish(&context);
+	if (index != NULL)
+		zsi_close(index);
 	free(zero_page);
 	free(context.zeros.iov);
 	free(context.buffer.iov);
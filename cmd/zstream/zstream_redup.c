@@ -18,28 +18,46 @@
 #include <cityhash.h>
 #include <err.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <libzutil.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/bitops.h>
+#include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/stdtypes.h>
 #include <sys/sysmacros.h>
 #include <sys/zfs_ioctl.h>
-#include <umem.h>
 #include <unistd.h>
 
 #include "zstream.h"
+#include "zstream_compress.h"
 #include "zstream_modules.h"
+#include "zstream_queue.h"
 #include "zstream_util.h"
 
 #define	MAX_RDT_PHYSMEM_PERCENT		20
 #define	SMALLEST_POSSIBLE_MAX_RDT_MB	128
+#define	RDT_MIN_HASHBITS		16
 
+/*
+ * Referenced WRITE records are read back from the input through a small
+ * cache of read-ahead buffers, since the records a deduplicated copy of a
+ * file refers to are usually next to each other in the stream.
+ */
+#define	REDUP_CACHE_SLOTS		16
+#define	REDUP_READAHEAD			(1ULL << 20)
+
+/*
+ * The redup table is an open-addressed hash table of the WRITE records seen
+ * so far, kept either in memory or in a memory-mapped file, so that its
+ * size is not bounded by memory. No WRITE record starts at stream offset 0,
+ * so zeroed entries are free.
+ */
 typedef struct redup_entry {
-	struct redup_entry	*rde_next;
 	uint64_t		rde_guid;
 	uint64_t		rde_object;
 	uint64_t		rde_offset;
@@ -47,34 +65,172 @@ typedef struct redup_entry {
 } redup_entry_t;
 
 typedef struct redup_table {
-	redup_entry_t	**redup_hash_array;
-	umem_cache_t	*ddecache;
+	redup_entry_t	*redup_hash_array;
+	pthread_rwlock_t rdt_lock;
+	const char	*rdt_dir;	/* Directory of the table file */
+	uint64_t	rdt_max_mem;
 	uint64_t	ddt_count;
 	int		numhashbits;
 } redup_table_t;
 
+typedef struct {
+	uint64_t	rcs_offset;
+	size_t		rcs_size;
+	uint8_t		*rcs_buf;
+} redup_cache_slot_t;
+
 typedef struct {
 	redup_table_t	rc_rdt;
-	FILE		*rc_fp;
+	int		rc_fd;
+	pthread_mutex_t	rc_cache_lock;
+	redup_cache_slot_t rc_cache[REDUP_CACHE_SLOTS];
+	uint_t		rc_cache_next;
+	uint64_t	rc_cache_hits;
+	uint64_t	rc_cache_misses;
 } redup_context_t;
 
+static size_t
+rdt_size(int numhashbits)
+{
+	return ((1ULL << numhashbits) * sizeof (redup_entry_t));
+}
+
+/*
+ * Allocate a zeroed hash array. On disk, the file is unlinked as soon as it
+ * is created, and its pages are left to the kernel to write back and evict.
+ */
+static redup_entry_t *
+rdt_alloc(redup_table_t *rdt, int numhashbits)
+{
+	size_t size = rdt_size(numhashbits);
+	redup_entry_t *array;
+
+	if (rdt->rdt_dir == NULL) {
+		if (size > rdt->rdt_max_mem && rdt_size(rdt->numhashbits) <=
+		    rdt->rdt_max_mem) {
+			warnx("redup table is larger than %d%% of physical "
+			    "memory; use -d to keep it on disk",
+			    MAX_RDT_PHYSMEM_PERCENT);
+		}
+		return (safe_calloc(size));
+	}
+
+	size_t len = strlen(rdt->rdt_dir) + sizeof ("/zstream-redup.XXXXXX");
+	char *path = safe_malloc(len);
+	int fd;
+
+	(void) snprintf(path, len, "%s/zstream-redup.XXXXXX", rdt->rdt_dir);
+	if ((fd = mkstemp(path)) == -1)
+		err(1, "unable to create redup table in %s", rdt->rdt_dir);
+	(void) unlink(path);
+	free(path);
+	if (ftruncate(fd, size) != 0)
+		err(1, "unable to size redup table");
+	array = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (array == MAP_FAILED)
+		err(1, "unable to map redup table");
+	(void) madvise(array, size, MADV_RANDOM);
+	(void) close(fd);
+	return (array);
+}
+
 static void
-rdt_insert(redup_table_t *rdt,
-    uint64_t guid, uint64_t object, uint64_t offset, uint64_t stream_offset)
+rdt_free(redup_table_t *rdt, redup_entry_t *array, int numhashbits)
+{
+	if (rdt->rdt_dir == NULL)
+		free(array);
+	else
+		VERIFY0(munmap(array, rdt_size(numhashbits)));
+}
+
+static redup_entry_t *
+rdt_slot(redup_entry_t *array, int numhashbits,
+    uint64_t guid, uint64_t object, uint64_t offset)
 {
 	uint64_t ch = cityhash3(guid, object, offset);
-	uint64_t hashcode = BF64_GET(ch, 0, rdt->numhashbits);
-	redup_entry_t **rdepp;
+	uint64_t mask = (1ULL << numhashbits) - 1;
+	uint64_t hashcode = BF64_GET(ch, 0, numhashbits);
+	redup_entry_t *rde;
+
+	for (rde = &array[hashcode]; rde->rde_stream_offset != 0;
+	    rde = &array[hashcode]) {
+		if (rde->rde_guid == guid &&
+		    rde->rde_object == object &&
+		    rde->rde_offset == offset)
+			break;
+		hashcode = (hashcode + 1) & mask;
+	}
+	return (rde);
+}
 
-	rdepp = &(rdt->redup_hash_array[hashcode]);
-	redup_entry_t *rde = umem_cache_alloc(rdt->ddecache, UMEM_NOFAIL);
-	rde->rde_next = *rdepp;
+/*
+ * Double the size of the table once it is half full.
+ */
+static void
+rdt_grow(redup_table_t *rdt)
+{
+	redup_entry_t *old = rdt->redup_hash_array;
+	int bits = rdt->numhashbits + 1;
+	redup_entry_t *array = rdt_alloc(rdt, bits);
+
+	for (uint64_t i = 0; i < 1ULL << rdt->numhashbits; i++) {
+		redup_entry_t *rde = &old[i];
+
+		if (rde->rde_stream_offset != 0) {
+			*rdt_slot(array, bits, rde->rde_guid, rde->rde_object,
+			    rde->rde_offset) = *rde;
+		}
+	}
+	rdt_free(rdt, old, rdt->numhashbits);
+	rdt->redup_hash_array = array;
+	rdt->numhashbits = bits;
+}
+
+static void
+rdt_init(redup_table_t *rdt, const char *dir)
+{
+#ifdef _ILP32
+	uint64_t max_rde_size = SMALLEST_POSSIBLE_MAX_RDT_MB << 20;
+#else
+	uint64_t physbytes = sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+	uint64_t max_rde_size = MAX((physbytes * MAX_RDT_PHYSMEM_PERCENT) / 100,
+	    SMALLEST_POSSIBLE_MAX_RDT_MB << 20);
+#endif
+
+	VERIFY0(pthread_rwlock_init(&rdt->rdt_lock, NULL));
+	rdt->rdt_dir = dir;
+	rdt->rdt_max_mem = max_rde_size;
+	rdt->numhashbits = RDT_MIN_HASHBITS;
+	rdt->redup_hash_array = rdt_alloc(rdt, rdt->numhashbits);
+	rdt->ddt_count = 0;
+}
+
+static void
+rdt_fini(redup_table_t *rdt)
+{
+	rdt_free(rdt, rdt->redup_hash_array, rdt->numhashbits);
+	VERIFY0(pthread_rwlock_destroy(&rdt->rdt_lock));
+}
+
+static void
+rdt_insert(redup_table_t *rdt,
+    uint64_t guid, uint64_t object, uint64_t offset, uint64_t stream_offset)
+{
+	redup_entry_t *rde;
+
+	VERIFY3U(stream_offset, !=, 0);
+	VERIFY0(pthread_rwlock_wrlock(&rdt->rdt_lock));
+	if (rdt->ddt_count >= 1ULL << (rdt->numhashbits - 1))
+		rdt_grow(rdt);
+	rde = rdt_slot(rdt->redup_hash_array, rdt->numhashbits,
+	    guid, object, offset);
+	if (rde->rde_stream_offset == 0)
+		rdt->ddt_count++;
 	rde->rde_guid = guid;
 	rde->rde_object = object;
 	rde->rde_offset = offset;
 	rde->rde_stream_offset = stream_offset;
-	*rdepp = rde;
-	rdt->ddt_count++;
+	VERIFY0(pthread_rwlock_unlock(&rdt->rdt_lock));
 }
 
 static void
@@ -82,21 +238,87 @@ rdt_lookup(redup_table_t *rdt,
     uint64_t guid, uint64_t object, uint64_t offset,
     uint64_t *stream_offsetp)
 {
-	uint64_t ch = cityhash3(guid, object, offset);
-	uint64_t hashcode = BF64_GET(ch, 0, rdt->numhashbits);
+	VERIFY0(pthread_rwlock_rdlock(&rdt->rdt_lock));
+	*stream_offsetp = rdt_slot(rdt->redup_hash_array, rdt->numhashbits,
+	    guid, object, offset)->rde_stream_offset;
+	VERIFY0(pthread_rwlock_unlock(&rdt->rdt_lock));
+	assert(*stream_offsetp != 0 &&
+	    "could not find expected redup table entry");
+}
 
-	for (redup_entry_t *rde = rdt->redup_hash_array[hashcode];
-	    rde != NULL; rde = rde->rde_next) {
-		if (rde->rde_guid == guid &&
-		    rde->rde_object == object &&
-		    rde->rde_offset == offset) {
-			*stream_offsetp = rde->rde_stream_offset;
+static size_t
+redup_pread(int fd, void *buf, size_t len, uint64_t offset)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = pread(fd, (uint8_t *)buf + done, len - done,
+		    offset + done);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			err(1, "read of source file failed, offset %llu",
+			    (u_longlong_t)(offset + done));
+		}
+		if (n == 0)
+			break;
+		done += n;
+	}
+	return (done);
+}
+
+/*
+ * Read part of a prior WRITE record from the input, through the read-ahead
+ * cache. The cache lock is not held while reading from the input.
+ */
+static void
+redup_read(redup_context_t *context, void *buf, size_t len, uint64_t offset)
+{
+	redup_cache_slot_t *slot;
+	uint8_t *readahead;
+	size_t n;
+
+	if (len > REDUP_READAHEAD) {
+		if (redup_pread(context->rc_fd, buf, len, offset) != len)
+			errx(1, "read of prior write failed");
+		return;
+	}
+
+	VERIFY0(pthread_mutex_lock(&context->rc_cache_lock));
+	for (int i = 0; i < REDUP_CACHE_SLOTS; i++) {
+		slot = &context->rc_cache[i];
+		if (slot->rcs_buf != NULL && offset >= slot->rcs_offset &&
+		    offset + len <= slot->rcs_offset + slot->rcs_size) {
+			memcpy(buf, slot->rcs_buf + offset - slot->rcs_offset,
+			    len);
+			context->rc_cache_hits++;
+			VERIFY0(pthread_mutex_unlock(&context->rc_cache_lock));
 			return;
 		}
 	}
-	assert(!"could not find expected redup table entry");
+	VERIFY0(pthread_mutex_unlock(&context->rc_cache_lock));
+
+	readahead = safe_malloc(REDUP_READAHEAD);
+	n = redup_pread(context->rc_fd, readahead, REDUP_READAHEAD, offset);
+	if (n < len)
+		errx(1, "read of prior write failed");
+	memcpy(buf, readahead, len);
+
+	VERIFY0(pthread_mutex_lock(&context->rc_cache_lock));
+	slot = &context->rc_cache[context->rc_cache_next++ %
+	    REDUP_CACHE_SLOTS];
+	free(slot->rcs_buf);
+	slot->rcs_offset = offset;
+	slot->rcs_size = n;
+	slot->rcs_buf = readahead;
+	context->rc_cache_misses++;
+	VERIFY0(pthread_mutex_unlock(&context->rc_cache_lock));
 }
 
+/*
+ * Record every WRITE in the redup table, in stream order, so that each one
+ * is in the table before any record that refers to it is looked up.
+ */
 static disposition_t
 chain_redup_writes(void *item_in, void *context_in)
 {
@@ -122,51 +344,6 @@ chain_redup_writes(void *item_in, void *context_in)
 		break;
 	}
 
-	case DRR_WRITE_BYREF:
-	{
-		struct drr_write_byref drrwb = drr->drr_u.drr_write_byref;
-
-		/*
-		 * Look up in hash table by drrwb->drr_refguid,
-		 * drr_refobject, drr_refoffset.  Replace this
-		 * record with the found WRITE record, but with
-		 * drr_object,drr_offset,drr_toguid replaced with ours.
-		 */
-		uint64_t stream_offset = 0;
-		rdt_lookup(&context->rc_rdt, drrwb.drr_refguid,
-		    drrwb.drr_refobject, drrwb.drr_refoffset,
-		    &stream_offset);
-
-		if (fseeko(context->rc_fp, stream_offset, SEEK_SET) != 0) {
-			err(1, "seek into source file failed, offset %llu",
-			    (u_longlong_t)stream_offset);
-		}
-		if (fread(drr, sizeof (*drr), 1, context->rc_fp) != 1) {
-			err(1, "read of prior write failed");
-		}
-		if (ATTR_IS_SET(CA_BYTESWAPPED)) {
-			byteswap_record(drr, BSWAP_32(drr->drr_type));
-		}
-
-		VERIFY3U(drr->drr_type,    ==, DRR_WRITE);
-		VERIFY3U(drrw->drr_toguid, ==, drrwb.drr_refguid);
-		VERIFY3U(drrw->drr_object, ==, drrwb.drr_refobject);
-		VERIFY3U(drrw->drr_offset, ==, drrwb.drr_refoffset);
-
-		item->dp_payload_size = DRR_WRITE_PAYLOAD_SIZE(drrw);
-		item->dp_payload = safe_malloc(item->dp_payload_size);
-
-		size_t n_read = fread(item->dp_payload, item->dp_payload_size,
-		    1, context->rc_fp);
-		if (n_read != 1)
-			err(1, "read of prior payload failed");
-
-		drrw->drr_toguid = drrwb.drr_toguid;
-		drrw->drr_object = drrwb.drr_object;
-		drrw->drr_offset = drrwb.drr_offset;
-		break;
-	}
-
 	case DRR_WRITE:
 		rdt_insert(&context->rc_rdt, drrw->drr_toguid, drrw->drr_object,
 		    drrw->drr_offset, item->dp_stream_offset);
@@ -178,6 +355,64 @@ chain_redup_writes(void *item_in, void *context_in)
 	return (D_OK);
 }
 
+static void
+chain_redup_byref(queue_item_t *item_in, void *context_in)
+{
+	drr_packet_t *item = (drr_packet_t *)item_in;
+	redup_context_t *context = (redup_context_t *)context_in;
+
+	dmu_replay_record_t *drr = &item->dp_drr;
+	struct drr_write *drrw	 = &drr->drr_u.drr_write;
+	struct drr_write_byref drrwb = drr->drr_u.drr_write_byref;
+
+	VERIFY3U(drr->drr_type, ==, DRR_WRITE_BYREF);
+
+	/*
+	 * Look up in hash table by drrwb->drr_refguid,
+	 * drr_refobject, drr_refoffset.  Replace this
+	 * record with the found WRITE record, but with
+	 * drr_object,drr_offset,drr_toguid replaced with ours.
+	 */
+	uint64_t stream_offset = 0;
+	rdt_lookup(&context->rc_rdt, drrwb.drr_refguid,
+	    drrwb.drr_refobject, drrwb.drr_refoffset,
+	    &stream_offset);
+
+	redup_read(context, drr, sizeof (*drr), stream_offset);
+	if (ATTR_IS_SET(CA_BYTESWAPPED)) {
+		byteswap_record(drr, BSWAP_32(drr->drr_type));
+	}
+
+	VERIFY3U(drr->drr_type,    ==, DRR_WRITE);
+	VERIFY3U(drrw->drr_toguid, ==, drrwb.drr_refguid);
+	VERIFY3U(drrw->drr_object, ==, drrwb.drr_refobject);
+	VERIFY3U(drrw->drr_offset, ==, drrwb.drr_refoffset);
+
+	item->dp_payload_size = DRR_WRITE_PAYLOAD_SIZE(drrw);
+	item->dp_payload = safe_malloc(item->dp_payload_size);
+	redup_read(context, item->dp_payload, item->dp_payload_size,
+	    stream_offset + sizeof (*drr));
+
+	drrw->drr_toguid = drrwb.drr_toguid;
+	drrw->drr_object = drrwb.drr_object;
+	drrw->drr_offset = drrwb.drr_offset;
+}
+
+/*
+ * Only WRITE_BYREF records need work. Their size isn't known until the
+ * record they refer to is read, so they are all assumed to be the size of
+ * a typical block.
+ */
+static size_t
+chain_redup_byref_cost(queue_item_t *item_in, void *context_in)
+{
+	(void) context_in;
+	drr_packet_t *item = (drr_packet_t *)item_in;
+
+	return (item->dp_drr.drr_type == DRR_WRITE_BYREF ?
+	    SPA_OLD_MAXBLOCKSIZE : 0);
+}
+
 static chain_step_t
 serial_redup_writes(redup_context_t *context)
 {
@@ -193,16 +428,37 @@ serial_redup_writes(redup_context_t *context)
 	return (step);
 }
 
+static chain_step_t
+parallel_redup_byref(redup_context_t *context)
+{
+	chain_step_t step = {
+	    .cs_type = CS_PARALLEL,
+	    .cs_in_size = sizeof (drr_packet_t),
+	    .cs_out_size = sizeof (drr_packet_t),
+	    .cs_context = context,
+	    .cs_parallel = {
+		.queue_length = 1024,
+		.batch_budget = 1024 * 1024,
+		.process = chain_redup_byref,
+		.cost = chain_redup_byref_cost
+	    }
+	};
+	return (step);
+}
+
 int
 zstream_do_redup(int argc, char *argv[])
 {
 	int c;
 	chain_attrs_t attrs = {0};
 	redup_context_t context = {0};
-	uint64_t numbuckets;
+	const char *dir = NULL;
 
-	while ((c = getopt(argc, argv, "v")) != -1) {
+	while ((c = getopt(argc, argv, "d:v")) != -1) {
 		switch (c) {
+		case 'd':
+			dir = optarg;
+			break;
 		case 'v':
 			ENABLE_OPTION(&attrs, CA_VERBOSE);
 			break;
@@ -218,33 +474,29 @@ zstream_do_redup(int argc, char *argv[])
 	if (argc != 1)
 		zstream_usage();
 
-	context.rc_fp = fopen(argv[0], "rb");
-	if (context.rc_fp == NULL) {
+	context.rc_fd = open(argv[0], O_RDONLY | O_CLOEXEC);
+	if (context.rc_fd == -1) {
 		err(1, "unable to open %s", argv[0]);
 	}
 
-#ifdef _ILP32
-	uint64_t max_rde_size = SMALLEST_POSSIBLE_MAX_RDT_MB << 20;
-#else
-	uint64_t physbytes = sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
-	uint64_t max_rde_size = MAX((physbytes * MAX_RDT_PHYSMEM_PERCENT) / 100,
-	    SMALLEST_POSSIBLE_MAX_RDT_MB << 20);
-#endif
-
-	numbuckets = max_rde_size / (sizeof (redup_entry_t));
-	if (!ISP2(numbuckets))
-		numbuckets = 1ULL << highbit64(numbuckets);
+	/*
+	 * Prior writes are read back by their offsets in the stream, so it
+	 * can't be compressed.
+	 */
+	dmu_replay_record_t first;
+	if (redup_pread(context.rc_fd, &first, sizeof (first), 0) ==
+	    sizeof (first) && zc_is_header(&first)) {
+		errx(1, "%s is compressed; use 'zstream uncompress' first",
+		    argv[0]);
+	}
 
-	context.rc_rdt.redup_hash_array =
-	    safe_calloc(numbuckets * sizeof (redup_entry_t *));
-	context.rc_rdt.ddecache = umem_cache_create("rde",
-	    sizeof (redup_entry_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
-	context.rc_rdt.numhashbits = highbit64(numbuckets) - 1;
-	context.rc_rdt.ddt_count = 0;
+	rdt_init(&context.rc_rdt, dir);
+	VERIFY0(pthread_mutex_init(&context.rc_cache_lock, NULL));
 
 	zstream_chain_t redup_chain = {
 		STANDARD_INPUT_STACK(argv[0]),
 		serial_redup_writes(&context),
+		parallel_redup_byref(&context),
 		STANDARD_OUTPUT_STACK(NULL)
 	};
 	zstream_chain_exec(redup_chain, &attrs);
@@ -252,17 +504,22 @@ zstream_do_redup(int argc, char *argv[])
 	if (attrs.ca_command_opts & CA_VERBOSE) {
 		char mem_str[16];
 		record_stats_t *acsi = attrs.ca_stats_in;
-		zfs_nicenum(context.rc_rdt.ddt_count * sizeof (redup_entry_t),
+		zfs_nicenum(rdt_size(context.rc_rdt.numhashbits),
 		    mem_str, sizeof (mem_str));
 		fprintf(stderr, "Converted stream with %llu total records, "
-		    "including %llu dedup records, using %sB memory.\n",
+		    "including %llu dedup records, using %sB %s.\n",
 		    (u_longlong_t)attrs.ca_totals_in.rs_num_records,
 		    (u_longlong_t)acsi[DRR_WRITE_BYREF].rs_num_records,
-		    mem_str);
+		    mem_str, dir == NULL ? "memory" : "of disk");
+		fprintf(stderr, "Read-ahead cache: %llu hits, %llu misses.\n",
+		    (u_longlong_t)context.rc_cache_hits,
+		    (u_longlong_t)context.rc_cache_misses);
 	}
 
-	fclose(context.rc_fp);
-	umem_cache_destroy(context.rc_rdt.ddecache);
-	free(context.rc_rdt.redup_hash_array);
+	for (int i = 0; i < REDUP_CACHE_SLOTS; i++)
+		free(context.rc_cache[i].rcs_buf);
+	VERIFY0(pthread_mutex_destroy(&context.rc_cache_lock));
+	rdt_fini(&context.rc_rdt);
+	(void) close(context.rc_fd);
 	return (0);
 }
@@ -0,0 +1,600 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * https://opensource.org/license/CDDL-1.0.
+ */
+
+#include <assert.h>
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/byteorder.h>
+#include <sys/random.h>
+#include <sys/stdtypes.h>
+#include <sys/zfs_ioctl.h>
+#include <unistd.h>
+
+#include "zstream.h"
+#include "zstream_modules.h"
+
+/*
+ * zstream split divides a send stream into parts that can be carried
+ * separately, e.g. over several network connections, and zstream merge
+ * puts the parts back together into the original stream, byte for byte.
+ *
+ * Each part starts with a split_header_t and is followed by frames. A
+ * record frame holds one record of the stream exactly as it was read,
+ * header and payload, along with its sequence number in the stream and the
+ * part that holds the record after it. zstream merge follows that chain
+ * from part 0 and never reads ahead in any part, so the parts can be
+ * pipes that zstream split writes while zstream merge reads them.
+ *
+ * Records are assigned to parts by object range, and the data of large
+ * objects by offset range, so that consecutive records mostly go to the
+ * same part. Records that do not belong to an object go with the record
+ * before them.
+ *
+ * Every SPLIT_SYNC_INTERVAL bytes, a part has a resync marker that holds
+ * its own offset in the part and the sequence number of the record after
+ * it. A reader that has lost its place in a part can find the next marker
+ * and check it is one, and zstream merge checks every marker it passes.
+ * Parts end with a frame that holds the number of records in the stream.
+ *
+ * Headers and frames are little-endian. Records are never byteswapped, and
+ * the checksums of the stream are validated both as it is split and as it
+ * is merged.
+ */
+
+#define	SPLIT_MAGIC		0x31305053545a5346ULL	/* "FSZTSP01" */
+#define	SPLIT_FRAME_RECORD	0x44434552		/* "RECD" */
+#define	SPLIT_FRAME_SYNC	0x434e5953		/* "SYNC" */
+#define	SPLIT_FRAME_END		0x20444e45		/* "END " */
+#define	SPLIT_NO_PART		UINT32_MAX
+#define	SPLIT_MAX_PARTS		256
+#define	SPLIT_SYNC_INTERVAL	(1ULL << 20)
+#define	SPLIT_DATA_RANGE	(16ULL << 20)
+#define	SPLIT_DEFAULT_RANGE	256
+
+typedef struct {
+	uint64_t	sh_magic;
+	uint64_t	sh_guid;	/* Shared by all parts of a stream */
+	uint32_t	sh_part;
+	uint32_t	sh_nparts;
+} split_header_t;
+
+/*
+ * For a SPLIT_FRAME_SYNC frame, sf_next_part is the part itself and
+ * sf_length is the offset of the frame in it.
+ */
+typedef struct {
+	uint32_t	sf_magic;
+	uint32_t	sf_next_part;
+	uint64_t	sf_seq;
+	uint64_t	sf_length;
+} split_frame_t;
+
+typedef struct {
+	const char	*sp_prefix;
+	uint_t		sp_nparts;
+	uint64_t	sp_range;	/* Objects per range */
+	FILE		**sp_fp;
+	uint64_t	*sp_offset;
+	uint64_t	*sp_next_sync;
+	uint64_t	*sp_records;
+	uint64_t	sp_guid;
+	uint64_t	sp_seq;
+	boolean_t	sp_held;
+	uint_t		sp_held_part;
+	drr_packet_t	sp_held_packet;
+} split_context_t;
+
+typedef struct {
+	char		**mc_names;
+	uint_t		mc_nparts;
+	FILE		**mc_fp;
+	uint64_t	*mc_offset;
+	boolean_t	mc_started;
+	uint_t		mc_part;	/* Part holding the next record */
+	uint64_t	mc_seq;
+	off_t		mc_stream_offset;
+} merge_context_t;
+
+static void
+split_usage(void)
+{
+	(void) fprintf(stderr,
+	    "usage: zstream split [-v] [-r objects] -n parts PREFIX\n"
+	    "       zstream merge [-v] PART ...\n");
+	exit(2);
+}
+
+static void
+split_write(split_context_t *sp, uint_t part, const void *buf, size_t len)
+{
+	if (len != 0 && fwrite(buf, len, 1, sp->sp_fp[part]) != 1)
+		err(1, "error writing %s.%u", sp->sp_prefix, part);
+	sp->sp_offset[part] += len;
+}
+
+static void
+split_write_frame(split_context_t *sp, uint_t part, uint32_t magic,
+    uint32_t next_part, uint64_t seq, uint64_t length)
+{
+	split_frame_t frame = {
+		.sf_magic = LE_32(magic),
+		.sf_next_part = LE_32(next_part),
+		.sf_seq = LE_64(seq),
+		.sf_length = LE_64(length)
+	};
+
+	split_write(sp, part, &frame, sizeof (frame));
+}
+
+static void
+split_open(split_context_t *sp)
+{
+	size_t len = strlen(sp->sp_prefix) + 16;
+	char *name = safe_malloc(len);
+
+	random_get_pseudo_bytes((uint8_t *)&sp->sp_guid,
+	    sizeof (sp->sp_guid));
+	for (uint_t part = 0; part < sp->sp_nparts; part++) {
+		split_header_t header = {
+			.sh_magic = LE_64(SPLIT_MAGIC),
+			.sh_guid = LE_64(sp->sp_guid),
+			.sh_part = LE_32(part),
+			.sh_nparts = LE_32(sp->sp_nparts)
+		};
+
+		(void) snprintf(name, len, "%s.%u", sp->sp_prefix, part);
+		if ((sp->sp_fp[part] = fopen(name, "wb")) == NULL)
+			err(1, "%s", name);
+		split_write(sp, part, &header, sizeof (header));
+		if (fflush(sp->sp_fp[part]) != 0)
+			err(1, "error writing %s", name);
+		sp->sp_next_sync[part] = SPLIT_SYNC_INTERVAL;
+	}
+	free(name);
+}
+
+/*
+ * Choose the part of a record. The record has not been byteswapped yet,
+ * but the object and offset are the first fields of every record type
+ * that has them.
+ */
+static uint_t
+split_part_of(split_context_t *sp, dmu_replay_record_t *drr, uint_t prev)
+{
+	boolean_t swap = ATTR_IS_SET(CA_BYTESWAPPED);
+	uint32_t type = swap ? BSWAP_32(drr->drr_type) : drr->drr_type;
+	uint64_t object, offset = 0;
+
+	switch (type) {
+	case DRR_WRITE:
+		offset = drr->drr_u.drr_write.drr_offset;
+		break;
+	case DRR_WRITE_BYREF:
+		offset = drr->drr_u.drr_write_byref.drr_offset;
+		break;
+	case DRR_WRITE_EMBEDDED:
+		offset = drr->drr_u.drr_write_embedded.drr_offset;
+		break;
+	case DRR_OBJECT:
+	case DRR_FREEOBJECTS:
+	case DRR_FREE:
+	case DRR_SPILL:
+	case DRR_OBJECT_RANGE:
+	case DRR_REDACT:
+		break;
+	default:
+		return (prev);
+	}
+
+	object = drr->drr_u.drr_object.drr_object;
+	if (swap) {
+		object = BSWAP_64(object);
+		offset = BSWAP_64(offset);
+	}
+	return ((object / sp->sp_range + offset / SPLIT_DATA_RANGE) %
+	    sp->sp_nparts);
+}
+
+/*
+ * Write the record held back until the part of the record after it was
+ * known. If that is in another part, flush this one, so a reader of the
+ * parts never waits for a record still buffered here.
+ */
+static void
+split_flush_held(split_context_t *sp, uint32_t next_part)
+{
+	drr_packet_t *pkt = &sp->sp_held_packet;
+	uint_t part = sp->sp_held_part;
+
+	if (sp->sp_offset[part] >= sp->sp_next_sync[part]) {
+		split_write_frame(sp, part, SPLIT_FRAME_SYNC, part,
+		    sp->sp_seq, sp->sp_offset[part]);
+		sp->sp_next_sync[part] += SPLIT_SYNC_INTERVAL;
+	}
+	split_write_frame(sp, part, SPLIT_FRAME_RECORD, next_part,
+	    sp->sp_seq, sizeof (pkt->dp_drr) + pkt->dp_payload_size);
+	split_write(sp, part, &pkt->dp_drr, sizeof (pkt->dp_drr));
+	split_write(sp, part, pkt->dp_payload, pkt->dp_payload_size);
+	free(pkt->dp_payload);
+	pkt->dp_payload = NULL;
+
+	if (next_part != part && fflush(sp->sp_fp[part]) != 0)
+		err(1, "error writing %s.%u", sp->sp_prefix, part);
+	sp->sp_records[part]++;
+	sp->sp_seq++;
+	sp->sp_held = B_FALSE;
+}
+
+static disposition_t
+chain_split(void *item_in, void *context_in)
+{
+	drr_packet_t *item = (drr_packet_t *)item_in;
+	split_context_t *sp = (split_context_t *)context_in;
+	uint_t part;
+
+	if (item == NULL) {
+		if (sp->sp_fp[0] == NULL)
+			split_open(sp);
+		if (sp->sp_held)
+			split_flush_held(sp, SPLIT_NO_PART);
+		for (part = 0; part < sp->sp_nparts; part++) {
+			split_write_frame(sp, part, SPLIT_FRAME_END,
+			    SPLIT_NO_PART, sp->sp_seq, 0);
+			if (fclose(sp->sp_fp[part]) != 0)
+				err(1, "error closing %s.%u", sp->sp_prefix,
+				    part);
+			if (OPTION_ENABLED(CA_VERBOSE)) {
+				(void) fprintf(stderr, "%s.%u: %llu records, "
+				    "%llu bytes\n", sp->sp_prefix, part,
+				    (u_longlong_t)sp->sp_records[part],
+				    (u_longlong_t)sp->sp_offset[part]);
+			}
+		}
+		return (D_OK);
+	}
+
+	if (sp->sp_fp[0] == NULL)
+		split_open(sp);
+
+	part = split_part_of(sp, &item->dp_drr,
+	    sp->sp_held ? sp->sp_held_part : 0);
+	if (sp->sp_held)
+		split_flush_held(sp, part);
+	sp->sp_held_packet = *item;
+	sp->sp_held_part = part;
+	sp->sp_held = B_TRUE;
+	item->dp_payload = NULL;
+
+	return (D_OK);
+}
+
+static void
+merge_read(merge_context_t *mc, uint_t part, void *buf, size_t len)
+{
+	if (len != 0 && fread(buf, len, 1, mc->mc_fp[part]) != 1) {
+		if (ferror(mc->mc_fp[part]))
+			err(1, "error reading %s", mc->mc_names[part]);
+		errx(1, "%s ends early at offset %llu", mc->mc_names[part],
+		    (u_longlong_t)mc->mc_offset[part]);
+	}
+	mc->mc_offset[part] += len;
+}
+
+/*
+ * Open the parts and put them in order. Files can be named in any order,
+ * but all of them must be named. Named pipes must be named in order, as
+ * zstream split opens them in order.
+ */
+static void
+merge_open(merge_context_t *mc)
+{
+	FILE **fp = safe_calloc(mc->mc_nparts * sizeof (FILE *));
+	char **names = safe_calloc(mc->mc_nparts * sizeof (char *));
+	uint64_t guid = 0;
+
+	for (uint_t i = 0; i < mc->mc_nparts; i++) {
+		split_header_t header;
+		uint32_t part;
+		FILE *f;
+
+		if ((f = fopen(mc->mc_names[i], "rb")) == NULL)
+			err(1, "%s", mc->mc_names[i]);
+		if (fread(&header, sizeof (header), 1, f) != 1 ||
+		    LE_64(header.sh_magic) != SPLIT_MAGIC) {
+			errx(1, "%s is not a part of a split stream",
+			    mc->mc_names[i]);
+		}
+		part = LE_32(header.sh_part);
+		if (i == 0)
+			guid = LE_64(header.sh_guid);
+		if (LE_32(header.sh_nparts) != mc->mc_nparts) {
+			errx(1, "%s is one of %u parts, not one of %u",
+			    mc->mc_names[i], LE_32(header.sh_nparts),
+			    mc->mc_nparts);
+		}
+		if (LE_64(header.sh_guid) != guid || part >= mc->mc_nparts) {
+			errx(1, "%s is not a part of the same stream as %s",
+			    mc->mc_names[i], mc->mc_names[0]);
+		}
+		if (fp[part] != NULL) {
+			errx(1, "%s and %s are the same part",
+			    names[part], mc->mc_names[i]);
+		}
+		fp[part] = f;
+		names[part] = mc->mc_names[i];
+	}
+
+	mc->mc_fp = fp;
+	mc->mc_names = names;
+	for (uint_t part = 0; part < mc->mc_nparts; part++)
+		mc->mc_offset[part] = sizeof (split_header_t);
+	mc->mc_part = 0;
+	mc->mc_started = B_TRUE;
+}
+
+/*
+ * Read the next frame of a part, checking the resync markers before it.
+ */
+static void
+merge_read_frame(merge_context_t *mc, uint_t part, split_frame_t *frame)
+{
+	for (;;) {
+		uint64_t offset = mc->mc_offset[part];
+
+		merge_read(mc, part, frame, sizeof (*frame));
+		frame->sf_magic = LE_32(frame->sf_magic);
+		frame->sf_next_part = LE_32(frame->sf_next_part);
+		frame->sf_seq = LE_64(frame->sf_seq);
+		frame->sf_length = LE_64(frame->sf_length);
+		if (frame->sf_magic != SPLIT_FRAME_SYNC)
+			return;
+		if (frame->sf_next_part != part ||
+		    frame->sf_length != offset || frame->sf_seq != mc->mc_seq) {
+			errx(1, "%s has a bad resync marker at offset %llu",
+			    mc->mc_names[part], (u_longlong_t)offset);
+		}
+	}
+}
+
+/*
+ * Check a part ends where the last record of the stream says it does.
+ */
+static void
+merge_check_end(merge_context_t *mc, uint_t part, split_frame_t *frame)
+{
+	if (frame->sf_magic != SPLIT_FRAME_END || frame->sf_seq != mc->mc_seq ||
+	    fgetc(mc->mc_fp[part]) != EOF) {
+		errx(1, "%s does not end at offset %llu with record %llu",
+		    mc->mc_names[part], (u_longlong_t)mc->mc_offset[part],
+		    (u_longlong_t)mc->mc_seq);
+	}
+	(void) fclose(mc->mc_fp[part]);
+}
+
+static void
+merge_close(merge_context_t *mc, uint_t first)
+{
+	for (uint_t part = first; part < mc->mc_nparts; part++) {
+		split_frame_t frame;
+
+		merge_read_frame(mc, part, &frame);
+		merge_check_end(mc, part, &frame);
+	}
+}
+
+static disposition_t
+chain_merge(void *item_in, void *context_in)
+{
+	drr_packet_t *item = (drr_packet_t *)item_in;
+	merge_context_t *mc = (merge_context_t *)context_in;
+	dmu_replay_record_t *drr;
+	split_frame_t frame;
+	uint_t part;
+
+	if (item == NULL)
+		return (D_OK);
+
+	if (!mc->mc_started)
+		merge_open(mc);
+	if ((part = mc->mc_part) == SPLIT_NO_PART) {
+		merge_close(mc, 0);
+		return (D_EOF);
+	}
+
+	merge_read_frame(mc, part, &frame);
+	if (frame.sf_magic == SPLIT_FRAME_END && mc->mc_seq == 0) {
+		/* The stream was empty */
+		merge_check_end(mc, part, &frame);
+		merge_close(mc, 1);
+		return (D_EOF);
+	}
+	if (frame.sf_magic != SPLIT_FRAME_RECORD ||
+	    frame.sf_seq != mc->mc_seq ||
+	    frame.sf_length < sizeof (dmu_replay_record_t) ||
+	    frame.sf_length - sizeof (dmu_replay_record_t) > UINT32_MAX ||
+	    (frame.sf_next_part >= mc->mc_nparts &&
+	    frame.sf_next_part != SPLIT_NO_PART)) {
+		errx(1, "%s has no record %llu at offset %llu",
+		    mc->mc_names[part], (u_longlong_t)mc->mc_seq,
+		    (u_longlong_t)(mc->mc_offset[part] - sizeof (frame)));
+	}
+
+	drr = &item->dp_drr;
+	merge_read(mc, part, drr, sizeof (*drr));
+	item->dp_payload_size = frame.sf_length - sizeof (*drr);
+	item->dp_payload = NULL;
+	if (item->dp_payload_size != 0) {
+		item->dp_payload = safe_malloc(item->dp_payload_size);
+		merge_read(mc, part, item->dp_payload, item->dp_payload_size);
+	}
+	item->dp_stream_offset = mc->mc_stream_offset;
+	item->dp_has_next_cksum = B_FALSE;
+
+	/*
+	 * Records are passed through as they are, so an opposite-endian
+	 * stream is also written out that way.
+	 */
+	if (mc->mc_seq == 0) {
+		uint64_t magic = drr->drr_u.drr_begin.drr_magic;
+
+		if (magic == BSWAP_64(DMU_BACKUP_MAGIC)) {
+			SET_ATTR(CA_BYTESWAPPED);
+			ENABLE_OPTION(chain_attrs, CA_BYTESWAP_ON_OUTPUT);
+		} else if (magic != DMU_BACKUP_MAGIC) {
+			errx(1, "invalid ZFS stream, bad magic number %llx",
+			    (u_longlong_t)magic);
+		}
+	}
+
+	mc->mc_stream_offset += frame.sf_length;
+	mc->mc_part = frame.sf_next_part;
+	mc->mc_seq++;
+	return (D_OK);
+}
+
+int
+zstream_do_split(int argc, char *argv[])
+{
+	chain_attrs_t attrs = {0};
+	split_context_t context = { .sp_range = SPLIT_DEFAULT_RANGE };
+	char *end;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:r:v")) != -1) {
+		switch (c) {
+		case 'n':
+			context.sp_nparts = strtoul(optarg, &end, 0);
+			if (*end != '\0' || context.sp_nparts == 0 ||
+			    context.sp_nparts > SPLIT_MAX_PARTS) {
+				errx(2, "number of parts must be 1 to %d",
+				    SPLIT_MAX_PARTS);
+			}
+			break;
+		case 'r':
+			context.sp_range = strtoull(optarg, &end, 0);
+			if (*end != '\0' || context.sp_range == 0)
+				errx(2, "invalid number of objects '%s'",
+				    optarg);
+			break;
+		case 'v':
+			ENABLE_OPTION(&attrs, CA_VERBOSE);
+			break;
+		case '?':
+			warnx("invalid option '%c'", optopt);
+			split_usage();
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc != 1 || context.sp_nparts == 0)
+		split_usage();
+
+	context.sp_prefix = argv[0];
+	context.sp_fp = safe_calloc(context.sp_nparts * sizeof (FILE *));
+	context.sp_offset = safe_calloc(context.sp_nparts * sizeof (uint64_t));
+	context.sp_next_sync =
+	    safe_calloc(context.sp_nparts * sizeof (uint64_t));
+	context.sp_records =
+	    safe_calloc(context.sp_nparts * sizeof (uint64_t));
+
+	chain_step_t split_step = {
+		.cs_type = CS_SERIAL,
+		.cs_in_size = sizeof (drr_packet_t),
+		.cs_out_size = 0,
+		.cs_context = &context,
+		.cs_serial = {
+			.process = chain_split
+		}
+	};
+
+	/*
+	 * The records are split before they are byteswapped, so they are
+	 * written to the parts exactly as they were read.
+	 */
+	zstream_chain_t split_chain = {
+		serial_read_stream(NULL),
+		parallel_calc_fletcher4(1024),
+		serial_validate_fletcher4(),
+		split_step,
+		chain_terminator()
+	};
+	zstream_chain_exec(split_chain, &attrs);
+
+	free(context.sp_records);
+	free(context.sp_next_sync);
+	free(context.sp_offset);
+	free(context.sp_fp);
+	return (0);
+}
+
+int
+zstream_do_merge(int argc, char *argv[])
+{
+	chain_attrs_t attrs = {0};
+	merge_context_t context = {0};
+	int c;
+
+	while ((c = getopt(argc, argv, "v")) != -1) {
+		switch (c) {
+		case 'v':
+			ENABLE_OPTION(&attrs, CA_VERBOSE);
+			break;
+		case '?':
+			warnx("invalid option '%c'", optopt);
+			split_usage();
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 1 || argc > SPLIT_MAX_PARTS)
+		split_usage();
+
+	context.mc_names = argv;
+	context.mc_nparts = argc;
+	context.mc_offset = safe_calloc(argc * sizeof (uint64_t));
+
+	chain_step_t merge_step = {
+		.cs_type = CS_SERIAL,
+		.cs_in_size = 0,
+		.cs_out_size = sizeof (drr_packet_t),
+		.cs_context = &context,
+		.cs_serial = {
+			.process = chain_merge
+		}
+	};
+
+	zstream_chain_t merge_chain = {
+		merge_step,
+		parallel_calc_fletcher4(1024),
+		serial_validate_fletcher4(),
+		serial_write_stream(NULL),
+		chain_terminator()
+	};
+	zstream_chain_exec(merge_chain, &attrs);
+
+	if (OPTION_ENABLED(CA_VERBOSE)) {
+		(void) fprintf(stderr, "merged %llu records from %d parts\n",
+		    (u_longlong_t)context.mc_seq, argc);
+	}
+
+	free(context.mc_offset);
+	free(context.mc_fp);
+	free(context.mc_names);
+	return (0);
+}
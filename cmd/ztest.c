@@ -4990,6 +4990,73 @@ ztest_dmu_object_next_chunk(ztest_ds_t *zd, uint64_t id)
 	mutex_exit(&os->os_obj_lock);
 }
 
+typedef struct ztest_read_async {
+	kmutex_t	zra_lock;
+	kcondvar_t	zra_cv;
+	boolean_t	zra_done;
+	int		zra_err;
+	uint64_t	zra_offset;
+	uint64_t	zra_size;
+	char		*zra_buf;
+} ztest_read_async_t;
+
+static void
+ztest_read_async_done(void *arg, dmu_buf_t **dbp, int numbufs, int err)
+{
+	ztest_read_async_t *zra = arg;
+
+	for (int i = 0; i < numbufs; i++) {
+		dmu_buf_t *db = dbp[i];
+		uint64_t start = MAX(db->db_offset, zra->zra_offset);
+		uint64_t end = MIN(db->db_offset + db->db_size,
+		    zra->zra_offset + zra->zra_size);
+
+		memcpy(zra->zra_buf + start - zra->zra_offset,
+		    (char *)db->db_data + start - db->db_offset, end - start);
+	}
+	if (err == 0)
+		dmu_buf_rele_array(dbp, numbufs, zra);
+
+	mutex_enter(&zra->zra_lock);
+	zra->zra_err = err;
+	zra->zra_done = B_TRUE;
+	cv_signal(&zra->zra_cv);
+	mutex_exit(&zra->zra_lock);
+}
+
+/*
+ * dmu_read() through dmu_buf_hold_array_by_dnode_async().
+ */
+static int
+ztest_dmu_read_async(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t size, void *buf, dmu_flags_t flags)
+{
+	ztest_read_async_t zra = {
+		.zra_offset = offset,
+		.zra_size = size,
+		.zra_buf = buf,
+	};
+	dnode_t *dn;
+
+	VERIFY0(dnode_hold(os, object, FTAG, &dn));
+	mutex_init(&zra.zra_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zra.zra_cv, NULL, CV_DEFAULT, NULL);
+
+	dmu_buf_hold_array_by_dnode_async(dn, offset, size, &zra, flags,
+	    ztest_read_async_done, &zra);
+
+	mutex_enter(&zra.zra_lock);
+	while (!zra.zra_done)
+		cv_wait(&zra.zra_cv, &zra.zra_lock);
+	mutex_exit(&zra.zra_lock);
+
+	cv_destroy(&zra.zra_cv);
+	mutex_destroy(&zra.zra_lock);
+	dnode_rele(dn, FTAG);
+
+	return (zra.zra_err);
+}
+
 #undef OD_ARRAY_SIZE
 #define	OD_ARRAY_SIZE	2
 
@@ -5102,8 +5169,13 @@ ztest_dmu_read_write(ztest_ds_t *zd, uint64_t id)
 	error = dmu_read(os, packobj, packoff, packsize, packbuf,
 	    dmu_read_flags);
 	ASSERT0(error);
-	error = dmu_read(os, bigobj, bigoff, bigsize, bigbuf,
-	    dmu_read_flags);
+	if (bigsize <= DMU_MAX_ACCESS / 2 && ztest_random(2) == 0) {
+		error = ztest_dmu_read_async(os, bigobj, bigoff, bigsize,
+		    bigbuf, dmu_read_flags);
+	} else {
+		error = dmu_read(os, bigobj, bigoff, bigsize, bigbuf,
+		    dmu_read_flags);
+	}
 	ASSERT0(error);
 
 	/*
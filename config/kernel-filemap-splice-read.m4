@@ -24,3 +24,37 @@ AC_DEFUN([ZFS_AC_KERNEL_COPY_SPLICE_READ], [
 		AC_MSG_RESULT(no)
 	])
 ])
+
+AC_DEFUN([ZFS_AC_KERNEL_SRC_SPLICE_ADD_TO_PIPE], [
+	dnl #
+	dnl # Kernel 5.8 - pipe_buf_operations .confirm became optional and
+	dnl # .steal was renamed .try_steal, which lets a filesystem add its
+	dnl # own pages to a pipe with add_to_pipe().
+	dnl #
+	ZFS_LINUX_TEST_SRC([splice_add_to_pipe], [
+		#include <linux/pipe_fs_i.h>
+		#include <linux/splice.h>
+
+		static const struct pipe_buf_operations
+		    ops __attribute__((unused)) = {
+			.release = generic_pipe_buf_release,
+			.try_steal = NULL,
+			.get = generic_pipe_buf_get,
+		};
+	],[
+		struct pipe_inode_info *pipe __attribute__((unused)) = NULL;
+		struct pipe_buffer buf = { .ops = &ops };
+		ssize_t ret __attribute__((unused)) = add_to_pipe(pipe, &buf);
+	])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_SPLICE_ADD_TO_PIPE], [
+	AC_MSG_CHECKING([whether add_to_pipe() can add borrowed pages])
+	ZFS_LINUX_TEST_RESULT([splice_add_to_pipe], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_SPLICE_ADD_TO_PIPE, 1,
+		    [add_to_pipe() can add borrowed pages])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
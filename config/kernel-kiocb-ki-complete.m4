@@ -0,0 +1,25 @@
+dnl # SPDX-License-Identifier: CDDL-1.0
+dnl #
+dnl # 5.16 API change,
+dnl # Unused 'long res2' removed from kiocb->ki_complete() prototype.
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_SRC_KIOCB_KI_COMPLETE], [
+	ZFS_LINUX_TEST_SRC([kiocb_ki_complete_2args], [
+		#include <linux/fs.h>
+	],[
+		struct kiocb kiocb __attribute__ ((unused)) = { 0 };
+
+		kiocb.ki_complete(&kiocb, 0);
+	])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_KIOCB_KI_COMPLETE], [
+	AC_MSG_CHECKING([whether kiocb->ki_complete() wants 2 args])
+	ZFS_LINUX_TEST_RESULT([kiocb_ki_complete_2args], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_KIOCB_KI_COMPLETE_2ARGS, 1,
+		    [kiocb->ki_complete() wants 2 args])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
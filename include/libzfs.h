@@ -928,6 +928,9 @@ typedef struct recvflags {
 
 	/* use this recv to check (and heal if needed) an existing snapshot */
 	boolean_t heal;
+
+	/* keep the received data out of the ARC (ie, -U) */
+	boolean_t uncached;
 } recvflags_t;
 
 _LIBZFS_H int zfs_receive(libzfs_handle_t *, const char *, nvlist_t *,
@@ -937,7 +940,8 @@ typedef enum diff_flags {
 	ZFS_DIFF_PARSEABLE = 1 << 0,
 	ZFS_DIFF_TIMESTAMP = 1 << 1,
 	ZFS_DIFF_CLASSIFY = 1 << 2,
-	ZFS_DIFF_NO_MANGLE = 1 << 3
+	ZFS_DIFF_NO_MANGLE = 1 << 3,
+	ZFS_DIFF_MACHINE = 1 << 4
 } diff_flags_t;
 
 _LIBZFS_H int zfs_show_diffs(zfs_handle_t *, int, const char *, const char *,
@@ -1099,6 +1103,13 @@ _LIBZFS_H int zpool_nextboot(libzfs_handle_t *, uint64_t, uint64_t,
  */
 _LIBZFS_H int zfs_userns(zfs_handle_t *zhp, const char *nspath, int attach);
 
+/*
+ * Read the entries of the directory open as dirfd, with their attributes,
+ * into buf as zfs_direntplus_t records.  Returns 0 or -1 with errno set.
+ */
+_LIBZFS_H int zfs_readdirplus(int dirfd, uint64_t *cookie, void *buf,
+    size_t bufsize, uint32_t *count, boolean_t *eof);
+
 #endif
 
 #ifdef	__cplusplus
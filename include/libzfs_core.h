@@ -110,6 +110,10 @@ _LIBZFS_CORE_H int lzc_receive_with_heal(const char *, nvlist_t *, nvlist_t *,
     uint8_t *, uint_t, const char *, boolean_t, boolean_t, boolean_t, boolean_t,
     int, const struct dmu_replay_record *, int, uint64_t *, uint64_t *,
     uint64_t *, nvlist_t **);
+_LIBZFS_CORE_H int lzc_receive_with_uncached(const char *, nvlist_t *,
+    nvlist_t *, uint8_t *, uint_t, const char *, boolean_t, boolean_t,
+    boolean_t, boolean_t, boolean_t, int, const struct dmu_replay_record *, int,
+    uint64_t *, uint64_t *, uint64_t *, uint64_t *, nvlist_t **);
 _LIBZFS_CORE_H int lzc_send_space(const char *, const char *,
     enum lzc_send_flags, uint64_t *);
 _LIBZFS_CORE_H int lzc_send_space_resume_redacted(const char *, const char *,
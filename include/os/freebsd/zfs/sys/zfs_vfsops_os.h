@@ -66,6 +66,9 @@ struct zfsvfs {
 	boolean_t	z_use_hold;	/* held via dmu_objset_hold */
 	zfs_teardown_lock_t z_teardown_lock;
 	zfs_teardown_inactive_lock_t z_teardown_inactive_lock;
+	kmutex_t	z_async_lock;	/* protects z_async_reads */
+	kcondvar_t	z_async_cv;	/* signaled when z_async_reads is 0 */
+	uint64_t	z_async_reads;	/* zfs_read_async() reads in flight */
 	list_t		z_all_znodes;	/* all vnodes in the fs */
 	kmutex_t	z_znodes_lock;	/* lock for z_all_znodes */
 	struct zfsctl_root	*z_ctldir;	/* .zfs directory pointer */
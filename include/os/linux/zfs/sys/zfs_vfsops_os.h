@@ -93,6 +93,9 @@ struct zfsvfs {
 	boolean_t	z_use_hold;	/* held via dmu_objset_hold */
 	rrmlock_t	z_teardown_lock;
 	krwlock_t	z_teardown_inactive_lock;
+	kmutex_t	z_async_lock;	/* protects z_async_reads */
+	kcondvar_t	z_async_cv;	/* signaled when z_async_reads is 0 */
+	uint64_t	z_async_reads;	/* zfs_read_async() reads in flight */
 	list_t		z_all_znodes;	/* all znodes in the fs */
 	unsigned long	z_rollback_time; /* last online rollback time */
 	uint64_t	z_snap_atime;	/* last snapshot access time */
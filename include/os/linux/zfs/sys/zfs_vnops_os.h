@@ -47,6 +47,8 @@ extern int zfs_mkdir(znode_t *dzp, char *dirname, vattr_t *vap,
 extern int zfs_rmdir(znode_t *dzp, char *name, znode_t *cwd,
     cred_t *cr, int flags);
 extern int zfs_readdir(struct inode *ip, struct dir_context *ctx, cred_t *cr);
+extern int zfs_readdirplus(struct inode *ip, char *buf, uint32_t bufsize,
+    uint64_t *cookiep, uint32_t *countp, boolean_t *eofp, cred_t *cr);
 extern int zfs_getattr_fast(zidmap_t *, u32 request_mask, struct inode *ip,
     struct kstat *sp);
 extern int zfs_setattr(znode_t *zp, vattr_t *vap, int flag, cred_t *cr);
@@ -68,6 +70,11 @@ extern int zfs_dirty_inode(struct inode *ip, int flags);
 extern int zfs_map(struct inode *ip, offset_t off, caddr_t *addrp,
     size_t len, unsigned long vm_flags);
 extern void zfs_zrele_async(znode_t *zp);
+#ifdef HAVE_SPLICE_ADD_TO_PIPE
+struct pipe_inode_info;
+extern int zfs_splice_read(znode_t *zp, loff_t pos,
+    struct pipe_inode_info *pipe, size_t len, int ioflag, size_t *splicedp);
+#endif
 
 extern int zfs_create_idmap(znode_t *dzp, char *name, vattr_t *vap, int excl,
     int mode, znode_t **zpp, cred_t *cr, int flag, vsecattr_t *vsecp,
@@ -160,6 +160,10 @@ extern int zpl_clone_file_range(struct file *src_file, loff_t src_off,
 extern int zpl_dedupe_file_range(struct file *src_file, loff_t src_off,
     struct file *dst_file, loff_t dst_off, uint64_t len);
 
+extern long zpl_ioctl_clone_ranges(struct file *filp, void __user *arg);
+extern void zpl_clone_ranges_init(void);
+extern void zpl_clone_ranges_fini(void);
+
 
 #if defined(HAVE_INODE_TIMESTAMP_TRUNCATE)
 #define	zpl_inode_timestamp_truncate(ts, ip)	timestamp_truncate(ts, ip)
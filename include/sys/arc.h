@@ -292,6 +292,7 @@ void arc_buf_destroy(arc_buf_t *buf, const void *tag);
 void arc_buf_info(arc_buf_t *buf, arc_buf_info_t *abi, int state_index);
 uint64_t arc_buf_size(arc_buf_t *buf);
 uint64_t arc_buf_lsize(arc_buf_t *buf);
+struct abd *arc_buf_hdr_abd(arc_buf_t *buf);
 void arc_buf_access(arc_buf_t *buf);
 void arc_release(arc_buf_t *buf, const void *tag);
 int arc_released(arc_buf_t *buf);
@@ -327,6 +328,7 @@ boolean_t arc_async_flush_guid_inuse(uint64_t load_guid);
 uint64_t arc_all_memory(void);
 uint64_t arc_default_max(uint64_t min, uint64_t allmem);
 uint64_t arc_target_bytes(void);
+void arc_mapped_uncached(uint64_t size);
 uint64_t arc_boot_target_bytes(void);
 void arc_set_limits(uint64_t);
 void arc_init(void);
@@ -955,6 +955,12 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_raw_size;
 	kstat_named_t arcstat_cached_only_in_progress;
 	kstat_named_t arcstat_abd_chunk_waste_size;
+	/*
+	 * Number of page cache fills and writebacks of memory mapped files,
+	 * and their bytes, done without keeping the data in the ARC.
+	 */
+	kstat_named_t arcstat_mapped_uncached_ios;
+	kstat_named_t arcstat_mapped_uncached_bytes;
 } arc_stats_t;
 
 typedef struct arc_sums {
@@ -1056,6 +1062,8 @@ typedef struct arc_sums {
 	wmsum_t arcstat_raw_size;
 	wmsum_t arcstat_cached_only_in_progress;
 	wmsum_t arcstat_abd_chunk_waste_size;
+	wmsum_t arcstat_mapped_uncached_ios;
+	wmsum_t arcstat_mapped_uncached_bytes;
 } arc_sums_t;
 
 typedef struct arc_evict_waiter {
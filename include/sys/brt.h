@@ -40,6 +40,8 @@ extern void brt_init(void);
 extern void brt_fini(void);
 
 extern void brt_pending_add(spa_t *spa, const blkptr_t *bp, dmu_tx_t *tx);
+extern void brt_pending_add_many(spa_t *spa, const blkptr_t *bps, size_t nbps,
+    dmu_tx_t *tx);
 extern void brt_pending_remove(spa_t *spa, const blkptr_t *bp, dmu_tx_t *tx);
 extern void brt_pending_apply(spa_t *spa, uint64_t txg);
 
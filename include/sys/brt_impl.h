@@ -54,8 +54,9 @@ _Static_assert(BRT_RANGESIZE / SPA_MINBLOCKSIZE <= UINT16_MAX,
  * that reside on a 32kB disk block (32kB / sizeof (uint16_t)).
  */
 #define	BRT_BLOCKSIZE	(32 * 1024)
+#define	BRT_BLOCK_NENTCOUNT	(BRT_BLOCKSIZE / sizeof (uint16_t))
 #define	BRT_RANGESIZE_TO_NBLOCKS(size)					\
-	(((size) - 1) / (BRT_BLOCKSIZE / sizeof (uint16_t)) + 1)
+	(((size) - 1) / BRT_BLOCK_NENTCOUNT + 1)
 
 #define	BRT_LITTLE_ENDIAN	0
 #define	BRT_BIG_ENDIAN		1
@@ -110,31 +111,43 @@ struct brt_vdev {
 	 */
 	boolean_t	bv_initiated;
 	/*
-	 * Does the bv_entcount[] array needs byte swapping?
+	 * Does the entcount array needs byte swapping?
 	 */
 	boolean_t	bv_need_byteswap;
 	/*
-	 * Number of entries in the bv_entcount[] array.
+	 * Number of entries in the entcount array.
 	 */
 	uint64_t	bv_size;
 	/*
 	 * This is the array with BRT entry count per BRT_RANGESIZE.
+	 * On disk it is a flat array, but in memory it is kept as a
+	 * two-level table: bv_entcount[] holds a pointer per BRT_BLOCKSIZE
+	 * block of entcounts (BRT_BLOCK_NENTCOUNT entries), which is NULL
+	 * until any entcount in that block becomes non-zero.  Pools that
+	 * clone blocks only in a few regions of large vdevs this way keep
+	 * only the touched blocks in memory, while lookups stay O(1).
+	 * Allocated blocks are kept until the whole table is freed, so
+	 * lockless readers never see them go away.
 	 */
-	uint16_t	*bv_entcount;
+	uint16_t	**bv_entcount;
 	/*
-	 * bv_entcount[] potentially can be a bit too big to sychronize it all
-	 * when we just changed few entcounts. The fields below allow us to
-	 * track updates to bv_entcount[] array since the last sync.
+	 * Number of allocated bv_entcount[] blocks.
+	 */
+	uint64_t	bv_entcount_nblocks;
+	/*
+	 * The entcount array potentially can be a bit too big to sychronize
+	 * it all when we just changed few entcounts. The fields below allow
+	 * us to track updates to the entcount array since the last sync.
 	 * A single bit in the bv_bitmap represents as many entcounts as can
 	 * fit into a single BRT_BLOCKSIZE.
-	 * For example we have 65536 entcounts in the bv_entcount array
-	 * (so the whole array is 128kB). We updated bv_entcount[2] and
-	 * bv_entcount[5]. In that case only first bit in the bv_bitmap will
+	 * For example we have 65536 entcounts in the entcount array
+	 * (so the whole array is 128kB). We updated entcount 2 and
+	 * entcount 5. In that case only first bit in the bv_bitmap will
 	 * be set and we will write only first BRT_BLOCKSIZE out of 128kB.
 	 */
 	ulong_t		*bv_bitmap;
 	/*
-	 * bv_entcount[] needs updating on disk.
+	 * The entcount array needs updating on disk.
 	 */
 	boolean_t	bv_entcount_dirty;
 	/*
@@ -142,7 +155,7 @@ struct brt_vdev {
 	 */
 	boolean_t	bv_meta_dirty;
 	/*
-	 * Sum of all bv_entcount[]s.
+	 * Sum of all entcounts.
 	 */
 	uint64_t	bv_totalcount;
 	/*
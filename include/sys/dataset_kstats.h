@@ -30,6 +30,7 @@ typedef struct dataset_sum_stats_t {
 	wmsum_t dss_nread;
 	wmsum_t dss_nunlinks;
 	wmsum_t dss_nunlinked;
+	wmsum_t dss_nlent;
 } dataset_sum_stats_t;
 
 typedef struct dataset_kstat_values {
@@ -48,6 +49,11 @@ typedef struct dataset_kstat_values {
 	 * entry is removed from the unlinked set
 	 */
 	kstat_named_t dkv_nunlinked;
+	/*
+	 * nlent counts the bytes read by lending ARC pages to a pipe
+	 * rather than copying them (see zfs_splice_read_zerocopy)
+	 */
+	kstat_named_t dkv_nlent;
 	/*
 	 * Per dataset zil kstats
 	 */
@@ -69,5 +75,6 @@ void dataset_kstats_update_read_kstats(dataset_kstats_t *, int64_t);
 
 void dataset_kstats_update_nunlinks_kstat(dataset_kstats_t *, int64_t);
 void dataset_kstats_update_nunlinked_kstat(dataset_kstats_t *, int64_t);
+void dataset_kstats_update_nlent_kstat(dataset_kstats_t *, int64_t);
 
 #endif /* _SYS_DATASET_KSTATS_H */
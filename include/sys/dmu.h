@@ -63,6 +63,7 @@ struct zbookmark_phys;
 struct spa;
 struct nvlist;
 struct arc_buf;
+struct abd;
 struct zio_prop;
 struct sa_handle;
 struct dsl_crypto_params;
@@ -564,6 +565,7 @@ typedef enum dmu_flags {
 	DMU_PARTIAL_MORE	= 1 << 8, /* Following partial access. */
 	DMU_KEEP_CACHING	= 1 << 9, /* Don't affect caching. */
 	DMU_IS_PREFETCH		= 1 << 10, /* This read is a prefetch. */
+	DMU_NOWAIT		= 1 << 11, /* EAGAIN rather than block. */
 } dmu_flags_t;
 
 /*
@@ -627,6 +629,21 @@ int dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset,
 int dmu_buf_hold_noread_by_dnode(dnode_t *dn, uint64_t offset, const void *tag,
     dmu_buf_t **dbp);
 
+/*
+ * Asynchronous dmu_buf_hold_array_by_dnode() for reads.  The thread issuing
+ * the reads may still wait for indirect blocks, but not for the data, and
+ * done() is called exactly once when all of it is cached, possibly before
+ * dmu_buf_hold_array_by_dnode_async() returns, or else from zio completion
+ * context, where it must not block.  On success done() gets the held
+ * buffers, which it must release with dmu_buf_rele_array(); on error they
+ * have already been released.
+ */
+typedef void (dmu_read_done_t)(void *arg, dmu_buf_t **dbp, int numbufs,
+    int err);
+void dmu_buf_hold_array_by_dnode_async(dnode_t *dn, uint64_t offset,
+    uint64_t length, const void *tag, dmu_flags_t flags,
+    dmu_read_done_t *done, void *arg);
+
 /*
  * Add a reference to a dmu buffer that has already been held via
  * dmu_buf_hold() in the current context.
@@ -927,6 +944,11 @@ int dmu_read_uio_dbuf(dmu_buf_t *zdb, zfs_uio_t *uio, uint64_t size,
     dmu_flags_t flags);
 int dmu_read_uio_dnode(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
     dmu_flags_t flags);
+typedef void (dmu_read_uio_done_t)(void *arg, int err);
+void dmu_read_uio_dbuf_async(dmu_buf_t *zdb, zfs_uio_t *uio, uint64_t size,
+    dmu_flags_t flags, dmu_read_uio_done_t *done, void *arg);
+void dmu_read_uio_dnode_async(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
+    dmu_flags_t flags, dmu_read_uio_done_t *done, void *arg);
 int dmu_write_uio(objset_t *os, uint64_t object, zfs_uio_t *uio, uint64_t size,
 	dmu_tx_t *tx, dmu_flags_t flags);
 int dmu_write_uio_dbuf(dmu_buf_t *zdb, zfs_uio_t *uio, uint64_t size,
@@ -934,6 +956,11 @@ int dmu_write_uio_dbuf(dmu_buf_t *zdb, zfs_uio_t *uio, uint64_t size,
 int dmu_write_uio_dnode(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
 	dmu_tx_t *tx, dmu_flags_t flags);
 #endif
+boolean_t dmu_write_is_cached(dmu_buf_t *zdb, uint64_t offset, uint64_t size);
+typedef int (dmu_buf_lend_func_t)(struct abd *abd, size_t off, size_t size,
+    void *arg);
+int dmu_buf_lend(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    dmu_buf_lend_func_t *func, void *arg);
 struct arc_buf *dmu_request_arcbuf(dmu_buf_t *handle, int size);
 void dmu_return_arcbuf(struct arc_buf *buf);
 int dmu_assign_arcbuf_by_dnode(dnode_t *dn, uint64_t offset,
@@ -942,6 +969,7 @@ int dmu_assign_arcbuf_by_dbuf(dmu_buf_t *handle, uint64_t offset,
     struct arc_buf *buf, dmu_tx_t *tx, dmu_flags_t flags);
 #define	dmu_assign_arcbuf	dmu_assign_arcbuf_by_dbuf
 extern uint_t zfs_max_recordsize;
+extern int zfs_dio_write_rmw;
 
 /*
  * Asynchronously try to read in the data.
@@ -1151,6 +1179,8 @@ int dmu_read_l0_bps(objset_t *os, uint64_t object, uint64_t offset,
     uint64_t length, struct blkptr *bps, size_t *nbpsp);
 int dmu_brt_clone(objset_t *os, uint64_t object, uint64_t offset,
     uint64_t length, dmu_tx_t *tx, const struct blkptr *bps, size_t nbps);
+int dmu_brt_clone_nopending(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t length, dmu_tx_t *tx, const struct blkptr *bps, size_t nbps);
 
 /*
  * Initial setup and final teardown.
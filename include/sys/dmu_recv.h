@@ -42,6 +42,7 @@ typedef struct dmu_recv_cookie {
 	uint64_t drc_featureflags;
 	boolean_t drc_force;
 	boolean_t drc_heal;
+	boolean_t drc_uncached;
 	boolean_t drc_resumable;
 	boolean_t drc_should_save;
 	boolean_t drc_raw;
@@ -61,6 +62,7 @@ typedef struct dmu_recv_cookie {
 	zfs_file_t *drc_fp; /* The file to read the stream from */
 	uint64_t drc_voff; /* The current offset in the stream */
 	uint64_t drc_bytes_read;
+	uint64_t drc_uncached_bytes; /* Data written without the ARC */
 	/*
 	 * A record that has had its payload read in, but hasn't yet been handed
 	 * off to the worker thread.
@@ -75,8 +77,8 @@ typedef struct dmu_recv_cookie {
 } dmu_recv_cookie_t;
 
 int dmu_recv_begin(const char *, const char *, dmu_replay_record_t *,
-    boolean_t, boolean_t, boolean_t, nvlist_t *, nvlist_t *, const char *,
-    dmu_recv_cookie_t *, zfs_file_t *, offset_t *);
+    boolean_t, boolean_t, boolean_t, boolean_t, nvlist_t *, nvlist_t *,
+    const char *, dmu_recv_cookie_t *, zfs_file_t *, offset_t *);
 int dmu_recv_stream(dmu_recv_cookie_t *, offset_t *);
 int dmu_recv_end(dmu_recv_cookie_t *, void *);
 boolean_t dmu_objset_is_receiving(objset_t *);
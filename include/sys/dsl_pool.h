@@ -38,7 +38,7 @@
 extern "C" {
 #endif
 
-extern int zfs_txg_synctime_ms;
+extern uint_t zfs_txg_synctime_ms;
 
 struct objset;
 struct dsl_dir;
@@ -58,6 +58,7 @@ extern uint_t zfs_delay_min_dirty_percent;
 extern uint_t zfs_vdev_async_write_active_min_dirty_percent;
 extern uint_t zfs_vdev_async_write_active_max_dirty_percent;
 extern uint64_t zfs_delay_scale;
+extern int zfs_delay_adaptive;
 
 /* These macros are for indexing into the zfs_all_blkstats_t. */
 #define	DMU_OT_DEFERRED	DMU_OT_NONE
@@ -125,6 +126,16 @@ typedef struct dsl_pool {
 	 */
 	hrtime_t dp_last_wakeup;
 
+	/*
+	 * Adaptive throttle state: the sync bandwidth (bytes/sec) measured
+	 * over recent txgs, the dirty data limit derived from it, and the
+	 * number and total time of transaction delays per open txg.
+	 */
+	uint64_t dp_sync_bw;
+	uint64_t dp_dirty_target;
+	uint64_t dp_delays_pertxg[TXG_SIZE];
+	hrtime_t dp_delay_time_pertxg[TXG_SIZE];
+
 	/* Has its own locking */
 	tx_state_t dp_tx;
 	txg_list_t dp_dirty_datasets;
@@ -177,6 +188,10 @@ void dsl_pool_mos_diduse_space(dsl_pool_t *dp,
 void dsl_pool_ckpoint_diduse_space(dsl_pool_t *dp,
     int64_t used, int64_t comp, int64_t uncomp);
 boolean_t dsl_pool_need_dirty_delay(dsl_pool_t *dp);
+uint64_t dsl_pool_dirty_max(dsl_pool_t *dp);
+void dsl_pool_delay_count(dsl_pool_t *dp, hrtime_t delay);
+void dsl_pool_sync_throttle(dsl_pool_t *dp, uint64_t txg, uint64_t dirty,
+    hrtime_t synctime, txg_stat_t *ts);
 void dsl_pool_config_enter(dsl_pool_t *dp, const void *tag);
 void dsl_pool_config_enter_prio(dsl_pool_t *dp, const void *tag);
 void dsl_pool_config_exit(dsl_pool_t *dp, const void *tag);
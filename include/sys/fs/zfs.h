@@ -1777,6 +1777,76 @@ typedef struct zfs_rewrite_args {
 
 #define	ZFS_IOC_REWRITE		_IOW(0x83, 3, zfs_rewrite_args_t)
 
+/*
+ * Clone many ranges with one call.  Each entry is processed like FICLONERANGE
+ * (a zero len clones up to the source EOF), but entries into the same dataset
+ * share transactions, and the ZIL commit required by sync=always.  On return
+ * len holds the number of bytes cloned and error the entry's errno.
+ */
+typedef struct zfs_clone_range_entry {
+	int32_t		src_fd;
+	int32_t		dst_fd;
+	uint64_t	src_off;
+	uint64_t	dst_off;
+	uint64_t	len;
+	int32_t		error;
+	uint32_t	pad;
+} zfs_clone_range_entry_t;
+
+typedef struct zfs_clone_ranges_args {
+	uint64_t	entries;	/* user pointer to the entries array */
+	uint32_t	count;
+	uint32_t	flags;		/* reserved, must be zero */
+} zfs_clone_ranges_args_t;
+
+#define	ZFS_CLONE_RANGES_MAX	1024
+
+#define	ZFS_IOC_CLONE_RANGES	_IOW(0x83, 4, zfs_clone_ranges_args_t)
+
+/*
+ * Read the entries of a directory together with their attributes.  Starting
+ * at cookie (zero for the first call), as many entries as fit are packed into
+ * buf as zfs_direntplus_t records, each reclen bytes long.  On return count
+ * holds the number of records, cookie the position to continue from, and
+ * ZFS_READDIRPLUS_EOF is set in flags once the end of the directory was
+ * reached.  The '.', '..' and '.zfs' entries are not returned.  An entry
+ * whose attributes could not be read has error set and its attributes zero.
+ */
+typedef struct zfs_direntplus {
+	uint64_t	ino;
+	uint64_t	gen;
+	uint64_t	size;
+	uint64_t	mode;
+	uint64_t	links;
+	uint64_t	uid;
+	uint64_t	gid;
+	uint64_t	mtime[2];
+	uint64_t	ctime[2];
+	int32_t		error;
+	uint16_t	reclen;
+	uint16_t	namelen;	/* excluding the terminating NUL */
+	char		name[];
+} zfs_direntplus_t;
+
+#define	ZFS_DIRENTPLUS_RECLEN(namelen)	\
+	((offsetof(zfs_direntplus_t, name) + (namelen) + 1 + 7) & ~7)
+
+typedef struct zfs_readdirplus_args {
+	uint64_t	buf;		/* user pointer to the record buffer */
+	uint64_t	cookie;
+	uint32_t	bufsize;
+	uint32_t	count;
+	uint32_t	flags;
+	uint32_t	pad;
+} zfs_readdirplus_args_t;
+
+/* zfs_readdirplus_args flags, set on return */
+#define	ZFS_READDIRPLUS_EOF	0x1
+
+#define	ZFS_READDIRPLUS_BUFSIZE_MAX	(1024 * 1024)
+
+#define	ZFS_IOC_READDIRPLUS	_IOWR(0x83, 5, zfs_readdirplus_args_t)
+
 /*
  * ZFS-specific error codes used for returning descriptive errors
  * to the userland through zfs ioctls.
@@ -2000,6 +2070,11 @@ typedef enum {
 #define	ZFS_IMPORT_LOAD_KEYS	0x40
 #define	ZFS_IMPORT_CHECKPOINT	0x80
 
+/*
+ * Flags for ZFS_IOC_OBJ_TO_STATS
+ */
+#define	ZFS_OBJ_STATS_NAME	0x1	/* Name in parent, not whole path */
+
 /*
  * Channel program argument/return nvlist keys and defaults.
  */
@@ -954,6 +954,10 @@ typedef struct txg_stat {
 	vdev_stat_t		vs2;
 	uint64_t		txg;
 	uint64_t		ndirty;
+	uint64_t		dirty_max;
+	uint64_t		sync_bw;
+	uint64_t		delays;
+	uint64_t		delay_time;
 } txg_stat_t;
 
 /* Assorted pool IO kstats */
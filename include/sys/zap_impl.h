@@ -150,6 +150,12 @@ typedef struct zap {
 			 * zap_num_entries
 			 */
 			kmutex_t zap_num_entries_mtx;
+			/*
+			 * zap_split_mtx protects zap_freeblk and
+			 * zap_num_leafs when leaves are split with
+			 * zap_rwlock held as reader
+			 */
+			kmutex_t zap_split_mtx;
 			int zap_block_shift;
 		} zap_fat;
 		struct {
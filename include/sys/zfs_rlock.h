@@ -36,16 +36,27 @@ struct zfs_locked_range;
 
 typedef void (zfs_rangelock_cb_t)(struct zfs_locked_range *, void *);
 
+typedef struct zfs_rangelock_shard {
+	avl_tree_t rls_tree;	/* contains locked_range_t */
+	kmutex_t rls_lock;
+} ____cacheline_aligned zfs_rangelock_shard_t;
+
 typedef struct zfs_rangelock {
 	avl_tree_t rl_tree; /* contains locked_range_t */
 	kmutex_t rl_lock;
 	zfs_rangelock_cb_t *rl_cb;
 	void *rl_arg;
+	zfs_rangelock_shard_t *rl_shards; /* set once rl_lock is contended */
+	zfs_rangelock_shard_t *rl_shards_pending; /* until rl_tree empties */
+	uint_t rl_nshards;	/* number of rl_shards */
+	uint_t rl_shard_shift;	/* log2 of the stripe size of each shard */
 } zfs_rangelock_t;
 
 typedef struct zfs_locked_range {
 	zfs_rangelock_t *lr_rangelock; /* rangelock that this lock applies to */
 	avl_node_t lr_node;	/* avl node link */
+	zfs_rangelock_shard_t *lr_shard; /* shard linked in, or NULL */
+	struct zfs_locked_range *lr_next; /* same range in next shard */
 	uint64_t lr_offset;	/* file range offset */
 	uint64_t lr_length;	/* file range length */
 	uint_t lr_count;	/* range reference count in tree */
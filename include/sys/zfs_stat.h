@@ -38,7 +38,7 @@ typedef struct zfs_stat {
 } zfs_stat_t;
 
 extern int zfs_obj_to_stats(objset_t *osp, uint64_t obj, zfs_stat_t *sb,
-    char *buf, int len);
+    char *buf, int len, uint64_t *pobjp);
 
 #ifdef	__cplusplus
 }
@@ -20,14 +20,39 @@
 #include <sys/zfs_vnops_os.h>
 
 extern int zfs_bclone_enabled;
+extern int zfs_mmap_uncached;
+
+/*
+ * zfs_read() and zfs_write() ioflag, next to the O_* flags: fail with EAGAIN
+ * rather than wait for I/O, a txg or a contended range lock (IOCB_NOWAIT).
+ */
+#define	ZFS_IO_NOWAIT	0x40000000
+
+/*
+ * One clone of a zfs_clone_ranges() batch.  zcr_len holds the length to clone
+ * on entry, and the length cloned on return, with zcr_error the result.
+ */
+typedef struct zfs_clone_range {
+	znode_t		*zcr_inzp;
+	znode_t		*zcr_outzp;
+	uint64_t	zcr_inoff;
+	uint64_t	zcr_outoff;
+	uint64_t	zcr_len;
+	int		zcr_error;
+} zfs_clone_range_t;
 
 extern int zfs_fsync(znode_t *, int, cred_t *);
 extern int zfs_read(znode_t *, zfs_uio_t *, int, cred_t *);
+typedef void (zfs_read_done_t)(void *arg, int error);
+extern int zfs_read_async(znode_t *, zfs_uio_t *, int, cred_t *,
+    zfs_read_done_t *, void *);
+extern void zfs_read_async_wait(zfsvfs_t *);
 extern int zfs_write(znode_t *, zfs_uio_t *, int, cred_t *);
 extern int zfs_holey(znode_t *, ulong_t, loff_t *);
 extern int zfs_access(znode_t *, int, int, cred_t *);
 extern int zfs_clone_range(znode_t *, uint64_t *, znode_t *, uint64_t *,
     uint64_t *, cred_t *);
+extern void zfs_clone_ranges(zfs_clone_range_t *, uint_t, cred_t *);
 extern int zfs_clone_range_replay(znode_t *, uint64_t, uint64_t, uint64_t,
     const blkptr_t *, size_t);
 extern int zfs_dedupe_range(znode_t *, uint64_t, znode_t *, uint64_t,
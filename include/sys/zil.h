@@ -496,6 +496,15 @@ typedef struct zil_stats {
 	kstat_named_t zil_commit_suspend_count;
 	kstat_named_t zil_commit_crash_count;
 
+	/*
+	 * Number of ZIL commits that only gathered the records of the
+	 * requested object and its dependencies (see zil_commit_per_object),
+	 * and the number of unrelated records that were left on the sync
+	 * lists by them.
+	 */
+	kstat_named_t zil_commit_object_count;
+	kstat_named_t zil_commit_deferred_count;
+
 	/*
 	 * Number of transactions (reads, writes, renames, etc.)
 	 * that have been committed.
@@ -543,6 +552,8 @@ typedef struct zil_sums {
 	wmsum_t zil_commit_stall_count;
 	wmsum_t zil_commit_suspend_count;
 	wmsum_t zil_commit_crash_count;
+	wmsum_t zil_commit_object_count;
+	wmsum_t zil_commit_deferred_count;
 	wmsum_t zil_itx_count;
 	wmsum_t zil_itx_indirect_count;
 	wmsum_t zil_itx_indirect_bytes;
@@ -154,6 +154,11 @@ typedef struct zil_commit_waiter {
 typedef struct itxs {
 	list_t		i_sync_list;	/* list of synchronous itxs */
 	avl_tree_t	i_async_tree;	/* tree of foids for async itxs */
+	avl_tree_t	i_dep_tree;	/* last namespace itx of each object */
+	itx_t		*i_dep_all;	/* last namespace itx of all objects */
+	uint64_t	i_dep_all_seq;	/* sequence number of i_dep_all */
+	uint64_t	i_dep_seq;	/* namespace itxs put on i_sync_list */
+	uint64_t	i_dep_done;	/* ... of which these left it */
 } itxs_t;
 
 typedef struct itxg {
@@ -169,6 +174,20 @@ typedef struct itx_async_node {
 	avl_node_t	ia_node;	/* AVL tree linkage */
 } itx_async_node_t;
 
+/*
+ * Namespace itxs on a sync list are numbered in order, and indexed by the
+ * objects they involve (see zil_itx_dep_objects()), so that a commit of a
+ * single object can find the last one it depends on.  They only ever leave
+ * the sync list in order, so a node is stale once its sequence number is
+ * not above i_dep_done.
+ */
+typedef struct itx_dep_node {
+	uint64_t	id_oid;		/* object id */
+	itx_t		*id_itx;	/* last namespace itx involving it */
+	uint64_t	id_seq;		/* sequence number of id_itx */
+	avl_node_t	id_node;	/* AVL tree linkage */
+} itx_dep_node_t;
+
 /*
  * Vdev flushing: during a zil_commit(), we build up an AVL tree of the vdevs
  * we've touched so we know which ones need a write cache flush at the end.
@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <sys/avl.h>
 #include <sys/zfs_ioctl.h>
 #include <libzfs.h>
 #include <libzutil.h>
@@ -52,50 +53,320 @@
 #define	ZDIFF_RENAMED_COLOR  ANSI_BOLD_BLUE
 
 /*
- * Given a {dsname, object id}, get the object path
+ * Upper bound of the threads resolving the paths of changed objects, and the
+ * number of objects resolved at a time.
+ */
+#define	ZDIFF_PARALLEL_MAX	64
+#define	ZDIFF_BATCH		256
+
+/* Directories whose paths are cached per snapshot */
+#define	ZDIFF_DIRCACHE_MAX	(1 << 18)
+
+/*
+ * The paths of the directories of a snapshot, by object number.  The kernel
+ * returns the name of an object in its parent directory, and the path of the
+ * parent comes from here, so the kernel walks up to the root of the dataset
+ * once per directory rather than once per changed object.  Snapshots don't
+ * change, so a cached path never goes stale.
+ */
+typedef struct differ_dircache {
+	pthread_mutex_t	dc_lock;
+	avl_tree_t	dc_tree;
+	uint64_t	dc_count;
+} differ_dircache_t;
+
+typedef struct differ_dir {
+	avl_node_t	dd_node;
+	uint64_t	dd_obj;
+	char		*dd_path;
+} differ_dir_t;
+
+/*
+ * A changed object, and what the from and to snapshots have of it.  Objects
+ * of DDR_FREE records are only looked up in the from snapshot.
+ */
+typedef struct differ_obj {
+	uint64_t	do_obj;
+	boolean_t	do_free;
+	int		do_ferr;
+	int		do_terr;
+	zfs_stat_t	do_fsb;
+	zfs_stat_t	do_tsb;
+	char		do_fname[MAXPATHLEN];
+	char		do_tname[MAXPATHLEN];
+} differ_obj_t;
+
+/*
+ * Threads that resolve a batch of changed objects together with the thread
+ * reading the diff records, which then writes them out in order.
+ */
+typedef struct differ_pool {
+	pthread_mutex_t	dp_lock;
+	pthread_cond_t	dp_cv;
+	pthread_cond_t	dp_done_cv;
+	differ_info_t	*dp_di;
+	differ_obj_t	*dp_objs;
+	uint_t		dp_count;
+	uint_t		dp_next;	/* Next object to resolve */
+	uint_t		dp_done;
+	boolean_t	dp_exit;
+	pthread_t	*dp_tids;
+	uint_t		dp_nthreads;
+} differ_pool_t;
+
+static int
+dircache_compare(const void *a, const void *b)
+{
+	const differ_dir_t *da = a;
+	const differ_dir_t *db = b;
+
+	return (TREE_CMP(da->dd_obj, db->dd_obj));
+}
+
+static differ_dircache_t *
+dircache_create(void)
+{
+	differ_dircache_t *dc = calloc(1, sizeof (*dc));
+
+	if (dc == NULL)
+		return (NULL);
+	(void) pthread_mutex_init(&dc->dc_lock, NULL);
+	avl_create(&dc->dc_tree, dircache_compare, sizeof (differ_dir_t),
+	    offsetof(differ_dir_t, dd_node));
+	return (dc);
+}
+
+static void
+dircache_clear(differ_dircache_t *dc)
+{
+	differ_dir_t *dd;
+	void *cookie = NULL;
+
+	while ((dd = avl_destroy_nodes(&dc->dc_tree, &cookie)) != NULL) {
+		free(dd->dd_path);
+		free(dd);
+	}
+	dc->dc_count = 0;
+}
+
+static void
+dircache_destroy(differ_dircache_t *dc)
+{
+	if (dc == NULL)
+		return;
+	dircache_clear(dc);
+	avl_destroy(&dc->dc_tree);
+	(void) pthread_mutex_destroy(&dc->dc_lock);
+	free(dc);
+}
+
+static boolean_t
+dircache_lookup(differ_dircache_t *dc, uint64_t obj, char *path, size_t len)
+{
+	differ_dir_t search = { .dd_obj = obj };
+	differ_dir_t *dd;
+
+	(void) pthread_mutex_lock(&dc->dc_lock);
+	if ((dd = avl_find(&dc->dc_tree, &search, NULL)) != NULL)
+		(void) strlcpy(path, dd->dd_path, len);
+	(void) pthread_mutex_unlock(&dc->dc_lock);
+	return (dd != NULL);
+}
+
+/*
+ * Cache the path of a directory.  The cache is emptied once it is full,
+ * which costs the walks to the root of the directories used after that.
+ */
+static void
+dircache_insert(differ_dircache_t *dc, uint64_t obj, const char *path)
+{
+	differ_dir_t *dd;
+	avl_index_t where;
+
+	if ((dd = malloc(sizeof (*dd))) == NULL)
+		return;
+	dd->dd_obj = obj;
+	if ((dd->dd_path = strdup(path)) == NULL) {
+		free(dd);
+		return;
+	}
+
+	(void) pthread_mutex_lock(&dc->dc_lock);
+	if (avl_find(&dc->dc_tree, dd, &where) != NULL) {
+		/* Another thread resolved it at the same time */
+		(void) pthread_mutex_unlock(&dc->dc_lock);
+		free(dd->dd_path);
+		free(dd);
+		return;
+	}
+	if (dc->dc_count >= ZDIFF_DIRCACHE_MAX) {
+		dircache_clear(dc);
+		(void) avl_find(&dc->dc_tree, dd, &where);
+	}
+	avl_insert(&dc->dc_tree, dd, where);
+	dc->dc_count++;
+	(void) pthread_mutex_unlock(&dc->dc_lock);
+}
+
+/*
+ * Given a {dsname, object id}, get the object's stats and its name in its
+ * parent directory, whose object id is returned in *pobjp.  A kernel that
+ * doesn't know ZFS_OBJ_STATS_NAME returns the whole path instead, which is
+ * flagged by a *pobjp of UINT64_MAX.  Returns 0 or an errno.
  */
 static int
-get_stats_for_obj(differ_info_t *di, const char *dsname, uint64_t obj,
-    char *pn, int maxlen, zfs_stat_t *sb)
+get_name_for_obj(differ_info_t *di, const char *dsname, uint64_t obj,
+    char *pn, size_t maxlen, zfs_stat_t *sb, uint64_t *pobjp)
 {
 	zfs_cmd_t zc = {"\0"};
 	int error;
 
 	(void) strlcpy(zc.zc_name, dsname, sizeof (zc.zc_name));
 	zc.zc_obj = obj;
+	zc.zc_flags = ZFS_OBJ_STATS_NAME;
 
 	errno = 0;
 	error = zfs_ioctl(di->zhp->zfs_hdl, ZFS_IOC_OBJ_TO_STATS, &zc);
-	di->zerr = errno;
 
 	/* we can get stats even if we failed to get a path */
 	(void) memcpy(sb, &zc.zc_stat, sizeof (zfs_stat_t));
+	if (error != 0)
+		return (errno);
+
+	(void) strlcpy(pn, zc.zc_value, maxlen);
+	*pobjp = (zc.zc_value[0] == '/') ? UINT64_MAX : zc.zc_cookie;
+	return (0);
+}
+
+static void
+join_path(char *pn, size_t maxlen, const char *dir, const char *name)
+{
+	(void) snprintf(pn, maxlen, "%s/%s",
+	    strcmp(dir, "/") == 0 ? "" : dir, name);
+}
+
+/*
+ * Get the path of a directory, from the cache or by looking up its name and
+ * those of the directories above it up to one that is cached, and caching
+ * the paths of all of them.
+ */
+static int
+get_path_for_dir(differ_info_t *di, const char *dsname,
+    differ_dircache_t *dc, uint64_t dobj, char *pn, size_t maxlen)
+{
+	struct {
+		uint64_t	obj;
+		char		*name;
+	} *walk = NULL;
+	uint_t depth = 0;
+	char name[MAXPATHLEN];
+	zfs_stat_t sb;
+	uint64_t pobj;
+	int error = 0;
+
+	while (!dircache_lookup(dc, dobj, pn, maxlen)) {
+		if ((error = get_name_for_obj(di, dsname, dobj, name,
+		    sizeof (name), &sb, &pobj)) != 0)
+			goto out;
+		if (pobj == UINT64_MAX) {
+			(void) strlcpy(pn, name, maxlen);
+			break;
+		}
+		if (pobj == dobj) {
+			(void) strlcpy(pn, "/", maxlen);
+			dircache_insert(dc, dobj, pn);
+			break;
+		}
+		/* Each level adds at least two characters to the path */
+		if (depth >= MAXPATHLEN / 2) {
+			error = ENAMETOOLONG;
+			goto out;
+		}
+		if ((depth & (depth - 1)) == 0) {
+			void *p = realloc(walk, MAX(2 * depth, 8) *
+			    sizeof (*walk));
+			if (p == NULL) {
+				error = ENOMEM;
+				goto out;
+			}
+			walk = p;
+		}
+		walk[depth].obj = dobj;
+		if ((walk[depth].name = strdup(name)) == NULL) {
+			error = ENOMEM;
+			goto out;
+		}
+		depth++;
+		dobj = pobj;
+	}
+
+	while (depth > 0) {
+		depth--;
+		(void) strlcpy(name, pn, sizeof (name));
+		join_path(pn, maxlen, name, walk[depth].name);
+		dircache_insert(dc, walk[depth].obj, pn);
+		free(walk[depth].name);
+	}
+out:
+	while (depth > 0)
+		free(walk[--depth].name);
+	free(walk);
+	return (error);
+}
+
+/*
+ * Given a {dsname, object id}, get the object path.  Returns 0 or an errno;
+ * for an object on the delete queue, ESTALE with a placeholder path.
+ */
+static int
+get_stats_for_obj(differ_info_t *di, const char *dsname,
+    differ_dircache_t *dc, uint64_t obj, char *pn, int maxlen,
+    zfs_stat_t *sb)
+{
+	char name[MAXPATHLEN], dir[MAXPATHLEN];
+	uint64_t pobj;
+	int error;
+
+	error = get_name_for_obj(di, dsname, obj, name, sizeof (name), sb,
+	    &pobj);
 	if (error == 0) {
-		ASSERT0(di->zerr);
-		(void) strlcpy(pn, zc.zc_value, maxlen);
-		return (0);
+		if (pobj == UINT64_MAX) {
+			(void) strlcpy(pn, name, maxlen);
+		} else if (pobj == obj) {
+			(void) strlcpy(pn, "/", maxlen);
+		} else if ((error = get_path_for_dir(di, dsname, dc, pobj,
+		    dir, sizeof (dir))) == 0) {
+			join_path(pn, maxlen, dir, name);
+			if (S_ISDIR(sb->zs_mode))
+				dircache_insert(dc, obj, pn);
+		}
 	}
 
-	if (di->zerr == ESTALE) {
+	if (error == ESTALE)
 		(void) snprintf(pn, maxlen, "(on_delete_queue)");
-		return (0);
-	} else if (di->zerr == EPERM) {
+	return (error);
+}
+
+/*
+ * Describe an error of get_stats_for_obj() in di->errbuf.
+ */
+static void
+stats_error(differ_info_t *di, int zerr, const char *dsname, uint64_t obj)
+{
+	if (zerr == EPERM) {
 		(void) snprintf(di->errbuf, sizeof (di->errbuf),
 		    dgettext(TEXT_DOMAIN,
 		    "The sys_config privilege or diff delegated permission "
 		    "is needed\nto discover path names"));
-		return (-1);
-	} else if (di->zerr == EACCES) {
+	} else if (zerr == EACCES) {
 		(void) snprintf(di->errbuf, sizeof (di->errbuf),
 		    dgettext(TEXT_DOMAIN,
 		    "Key must be loaded to discover path names"));
-		return (-1);
 	} else {
 		(void) snprintf(di->errbuf, sizeof (di->errbuf),
 		    dgettext(TEXT_DOMAIN,
 		    "Unable to determine path or stats for "
 		    "object %lld in %s"), (longlong_t)obj, dsname);
-		return (-1);
 	}
 }
 
@@ -186,11 +457,38 @@ print_cmn(FILE *fp, differ_info_t *di, const char *file)
 	}
 }
 
+/*
+ * In machine-readable output, every change is six fields, each ended by a
+ * NUL: the type of change, the type of file, the ctime, the change in link
+ * count, the path and the new path of a rename.  Paths are written as they
+ * are, so nothing needs escaping or formatting per character.
+ */
+static void
+print_machine(FILE *fp, differ_info_t *di, char type, const char *file,
+    const char *newfile, int delta, zfs_stat_t *isb)
+{
+	(void) fprintf(fp, "%c%c%c%c%lld.%09lld%c%d%c", type, '\0',
+	    get_what(isb->zs_mode), '\0', (longlong_t)isb->zs_ctime[0],
+	    (longlong_t)isb->zs_ctime[1], '\0', delta, '\0');
+	(void) fputs(di->dsmnt, fp);
+	(void) fputs(file, fp);
+	(void) fputc('\0', fp);
+	if (newfile != NULL) {
+		(void) fputs(di->dsmnt, fp);
+		(void) fputs(newfile, fp);
+	}
+	(void) fputc('\0', fp);
+}
+
 static void
 print_rename(FILE *fp, differ_info_t *di, const char *old, const char *new,
     zfs_stat_t *isb)
 {
-	if (isatty(fileno(fp)))
+	if (di->machine) {
+		print_machine(fp, di, *ZDIFF_RENAMED, old, new, 0, isb);
+		return;
+	}
+	if (di->colorize)
 		color_start(ZDIFF_RENAMED_COLOR);
 	if (di->timestamped)
 		(void) fprintf(fp, "%10lld.%09lld\t",
@@ -204,7 +502,7 @@ print_rename(FILE *fp, differ_info_t *di, const char *old, const char *new,
 	print_cmn(fp, di, new);
 	(void) fputc('\n', fp);
 
-	if (isatty(fileno(fp)))
+	if (di->colorize)
 		color_end();
 }
 
@@ -212,7 +510,11 @@ static void
 print_link_change(FILE *fp, differ_info_t *di, int delta, const char *file,
     zfs_stat_t *isb)
 {
-	if (isatty(fileno(fp)))
+	if (di->machine) {
+		print_machine(fp, di, *ZDIFF_MODIFIED, file, NULL, delta, isb);
+		return;
+	}
+	if (di->colorize)
 		color_start(ZDIFF_MODIFIED_COLOR);
 
 	if (di->timestamped)
@@ -224,7 +526,7 @@ print_link_change(FILE *fp, differ_info_t *di, int delta, const char *file,
 		(void) fprintf(fp, "%c\t", get_what(isb->zs_mode));
 	print_cmn(fp, di, file);
 	(void) fprintf(fp, "\t(%+d)\n", delta);
-	if (isatty(fileno(fp)))
+	if (di->colorize)
 		color_end();
 }
 
@@ -232,7 +534,11 @@ static void
 print_file(FILE *fp, differ_info_t *di, char type, const char *file,
     zfs_stat_t *isb)
 {
-	if (isatty(fileno(fp)))
+	if (di->machine) {
+		print_machine(fp, di, type, file, NULL, 0, isb);
+		return;
+	}
+	if (di->colorize)
 		color_start(type_to_color(type));
 
 	if (di->timestamped)
@@ -245,23 +551,20 @@ print_file(FILE *fp, differ_info_t *di, char type, const char *file,
 	print_cmn(fp, di, file);
 	(void) fputc('\n', fp);
 
-	if (isatty(fileno(fp)))
+	if (di->colorize)
 		color_end();
 }
 
 static int
-write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
+write_inuse_diffs_one(FILE *fp, differ_info_t *di, differ_obj_t *dobj)
 {
-	struct zfs_stat fsb, tsb;
+	zfs_stat_t *fsb = &dobj->do_fsb, *tsb = &dobj->do_tsb;
+	const char *fobjname = dobj->do_fname, *tobjname = dobj->do_tname;
 	mode_t fmode, tmode;
-	char fobjname[MAXPATHLEN], tobjname[MAXPATHLEN];
 	boolean_t already_logged = B_FALSE;
-	int fobjerr, tobjerr;
+	boolean_t fobjerr, tobjerr;
 	int change;
 
-	if (dobj == di->shares)
-		return (0);
-
 	/*
 	 * Check the from and to snapshots for info on the object. If
 	 * we get ENOENT, then the object just didn't exist in that
@@ -271,11 +574,12 @@ write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
 	 * errno and continue.
 	 */
 
-	fobjerr = get_stats_for_obj(di, di->fromsnap, dobj, fobjname,
-	    MAXPATHLEN, &fsb);
-	if (fobjerr && di->zerr != ENOTSUP && di->zerr != ENOENT) {
-		zfs_error_aux(di->zhp->zfs_hdl, "%s", zfs_strerror(di->zerr));
-		zfs_error(di->zhp->zfs_hdl, di->zerr, di->errbuf);
+	fobjerr = (dobj->do_ferr != 0 && dobj->do_ferr != ESTALE);
+	if (fobjerr && dobj->do_ferr != ENOTSUP && dobj->do_ferr != ENOENT) {
+		stats_error(di, dobj->do_ferr, di->fromsnap, dobj->do_obj);
+		zfs_error_aux(di->zhp->zfs_hdl, "%s",
+		    zfs_strerror(dobj->do_ferr));
+		zfs_error(di->zhp->zfs_hdl, dobj->do_ferr, di->errbuf);
 		/*
 		 * Let's not print an error for the same object more than
 		 * once if it happens in both snapshots
@@ -283,113 +587,211 @@ write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
 		already_logged = B_TRUE;
 	}
 
-	tobjerr = get_stats_for_obj(di, di->tosnap, dobj, tobjname,
-	    MAXPATHLEN, &tsb);
-
-	if (tobjerr && di->zerr != ENOTSUP && di->zerr != ENOENT) {
+	tobjerr = (dobj->do_terr != 0 && dobj->do_terr != ESTALE);
+	if (tobjerr && dobj->do_terr != ENOTSUP && dobj->do_terr != ENOENT) {
 		if (!already_logged) {
+			stats_error(di, dobj->do_terr, di->tosnap,
+			    dobj->do_obj);
 			zfs_error_aux(di->zhp->zfs_hdl,
-			    "%s", zfs_strerror(di->zerr));
-			zfs_error(di->zhp->zfs_hdl, di->zerr, di->errbuf);
+			    "%s", zfs_strerror(dobj->do_terr));
+			zfs_error(di->zhp->zfs_hdl, dobj->do_terr,
+			    di->errbuf);
 		}
 	}
 	/*
 	 * Unallocated object sharing the same meta dnode block
 	 */
-	if (fobjerr && tobjerr) {
-		di->zerr = 0;
+	if (fobjerr && tobjerr)
 		return (0);
-	}
 
-	di->zerr = 0; /* negate get_stats_for_obj() from side that failed */
-	fmode = fsb.zs_mode & S_IFMT;
-	tmode = tsb.zs_mode & S_IFMT;
-	if (fmode == S_IFDIR || tmode == S_IFDIR || fsb.zs_links == 0 ||
-	    tsb.zs_links == 0)
+	fmode = fsb->zs_mode & S_IFMT;
+	tmode = tsb->zs_mode & S_IFMT;
+	if (fmode == S_IFDIR || tmode == S_IFDIR || fsb->zs_links == 0 ||
+	    tsb->zs_links == 0)
 		change = 0;
 	else
-		change = tsb.zs_links - fsb.zs_links;
+		change = tsb->zs_links - fsb->zs_links;
 
 	if (fobjerr) {
 		if (change) {
-			print_link_change(fp, di, change, tobjname, &tsb);
+			print_link_change(fp, di, change, tobjname, tsb);
 			return (0);
 		}
-		print_file(fp, di, ZDIFF_ADDED, tobjname, &tsb);
+		print_file(fp, di, ZDIFF_ADDED, tobjname, tsb);
 		return (0);
 	} else if (tobjerr) {
 		if (change) {
-			print_link_change(fp, di, change, fobjname, &fsb);
+			print_link_change(fp, di, change, fobjname, fsb);
 			return (0);
 		}
-		print_file(fp, di, ZDIFF_REMOVED, fobjname, &fsb);
+		print_file(fp, di, ZDIFF_REMOVED, fobjname, fsb);
 		return (0);
 	}
 
-	if (fmode != tmode && fsb.zs_gen == tsb.zs_gen)
-		tsb.zs_gen++;	/* Force a generational difference */
+	if (fmode != tmode && fsb->zs_gen == tsb->zs_gen)
+		tsb->zs_gen++;	/* Force a generational difference */
 
 	/* Simple modification or no change */
-	if (fsb.zs_gen == tsb.zs_gen) {
+	if (fsb->zs_gen == tsb->zs_gen) {
 		/* No apparent changes.  Could we assert !this?  */
-		if (fsb.zs_ctime[0] == tsb.zs_ctime[0] &&
-		    fsb.zs_ctime[1] == tsb.zs_ctime[1])
+		if (fsb->zs_ctime[0] == tsb->zs_ctime[0] &&
+		    fsb->zs_ctime[1] == tsb->zs_ctime[1])
 			return (0);
 		if (change) {
 			print_link_change(fp, di, change,
-			    change > 0 ? fobjname : tobjname, &tsb);
+			    change > 0 ? fobjname : tobjname, tsb);
 		} else if (strcmp(fobjname, tobjname) == 0) {
-			print_file(fp, di, *ZDIFF_MODIFIED, fobjname, &tsb);
+			print_file(fp, di, *ZDIFF_MODIFIED, fobjname, tsb);
 		} else {
-			print_rename(fp, di, fobjname, tobjname, &tsb);
+			print_rename(fp, di, fobjname, tobjname, tsb);
 		}
 		return (0);
 	} else {
 		/* file re-created or object re-used */
-		print_file(fp, di, ZDIFF_REMOVED, fobjname, &fsb);
-		print_file(fp, di, ZDIFF_ADDED, tobjname, &tsb);
+		print_file(fp, di, ZDIFF_REMOVED, fobjname, fsb);
+		print_file(fp, di, ZDIFF_ADDED, tobjname, tsb);
 		return (0);
 	}
 }
 
 static int
-write_inuse_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
+describe_free(FILE *fp, differ_info_t *di, differ_obj_t *dobj)
 {
-	uint64_t o;
-	int err;
+	/* Don't print if in the delete queue on from side */
+	if (dobj->do_ferr == ESTALE || dobj->do_ferr == ENOENT)
+		return (0);
 
-	for (o = dr->ddr_first; o <= dr->ddr_last; o++) {
-		if ((err = write_inuse_diffs_one(fp, di, o)) != 0)
-			return (err);
+	if (dobj->do_ferr != 0) {
+		stats_error(di, dobj->do_ferr, di->fromsnap, dobj->do_obj);
+		di->zerr = dobj->do_ferr;
+		return (-1);
 	}
+
+	print_file(fp, di, ZDIFF_REMOVED, dobj->do_fname, &dobj->do_fsb);
 	return (0);
 }
 
-static int
-describe_free(FILE *fp, differ_info_t *di, uint64_t object, char *namebuf,
-    int maxlen)
+static void
+resolve_obj(differ_info_t *di, differ_obj_t *dobj)
+{
+	dobj->do_fname[0] = dobj->do_tname[0] = '\0';
+	dobj->do_ferr = get_stats_for_obj(di, di->fromsnap, di->fromdirs,
+	    dobj->do_obj, dobj->do_fname, MAXPATHLEN, &dobj->do_fsb);
+	if (!dobj->do_free) {
+		dobj->do_terr = get_stats_for_obj(di, di->tosnap, di->todirs,
+		    dobj->do_obj, dobj->do_tname, MAXPATHLEN, &dobj->do_tsb);
+	}
+}
+
+/*
+ * Resolve the objects of the current batch.  Called with dp_lock held; the
+ * thread that reads the diff records resolves them too until none are left.
+ */
+static void
+resolve_batch_locked(differ_pool_t *dp)
+{
+	while (dp->dp_next < dp->dp_count) {
+		differ_obj_t *dobj = &dp->dp_objs[dp->dp_next++];
+
+		(void) pthread_mutex_unlock(&dp->dp_lock);
+		resolve_obj(dp->dp_di, dobj);
+		(void) pthread_mutex_lock(&dp->dp_lock);
+		if (++dp->dp_done == dp->dp_count)
+			(void) pthread_cond_broadcast(&dp->dp_done_cv);
+	}
+}
+
+static void *
+resolve_thread(void *arg)
 {
-	struct zfs_stat sb;
+	differ_pool_t *dp = arg;
 
-	(void) get_stats_for_obj(di, di->fromsnap, object, namebuf,
-	    maxlen, &sb);
+	(void) pthread_mutex_lock(&dp->dp_lock);
+	while (!dp->dp_exit) {
+		if (dp->dp_next < dp->dp_count)
+			resolve_batch_locked(dp);
+		else
+			(void) pthread_cond_wait(&dp->dp_cv, &dp->dp_lock);
+	}
+	(void) pthread_mutex_unlock(&dp->dp_lock);
+	return (NULL);
+}
 
-	/* Don't print if in the delete queue on from side */
-	if (di->zerr == ESTALE || di->zerr == ENOENT) {
-		di->zerr = 0;
+/*
+ * Resolve the paths of a batch of changed objects, on di->nthreads threads,
+ * and write out their changes in order.
+ */
+static int
+write_batch(FILE *fp, differ_pool_t *dp)
+{
+	differ_info_t *di = dp->dp_di;
+	int oldstate;
+	int err = 0;
+
+	if (dp->dp_count == 0)
 		return (0);
+
+	/* The resolving threads use the batch, so don't leave them to it */
+	(void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate);
+
+	(void) pthread_mutex_lock(&dp->dp_lock);
+	dp->dp_next = dp->dp_done = 0;
+	(void) pthread_cond_broadcast(&dp->dp_cv);
+	resolve_batch_locked(dp);
+	while (dp->dp_done < dp->dp_count)
+		(void) pthread_cond_wait(&dp->dp_done_cv, &dp->dp_lock);
+	(void) pthread_mutex_unlock(&dp->dp_lock);
+
+	for (uint_t i = 0; i < dp->dp_count && err == 0; i++) {
+		differ_obj_t *dobj = &dp->dp_objs[i];
+
+		if (dobj->do_free)
+			err = describe_free(fp, di, dobj);
+		else
+			err = write_inuse_diffs_one(fp, di, dobj);
 	}
+	dp->dp_count = 0;
+
+	(void) pthread_setcancelstate(oldstate, NULL);
+	return (err);
+}
 
-	print_file(fp, di, ZDIFF_REMOVED, namebuf, &sb);
+/*
+ * Add a changed object to the batch, writing out the batch once it is full.
+ */
+static int
+add_obj(FILE *fp, differ_pool_t *dp, uint64_t obj, boolean_t freed)
+{
+	differ_obj_t *dobj = &dp->dp_objs[dp->dp_count++];
+
+	dobj->do_obj = obj;
+	dobj->do_free = freed;
+	if (dp->dp_count == ZDIFF_BATCH)
+		return (write_batch(fp, dp));
+	return (0);
+}
+
+static int
+write_inuse_diffs(FILE *fp, differ_pool_t *dp, dmu_diff_record_t *dr)
+{
+	uint64_t o;
+	int err;
+
+	for (o = dr->ddr_first; o <= dr->ddr_last; o++) {
+		if (o == dp->dp_di->shares)
+			continue;
+		if ((err = add_obj(fp, dp, o, B_FALSE)) != 0)
+			return (err);
+	}
 	return (0);
 }
 
 static int
-write_free_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
+write_free_diffs(FILE *fp, differ_pool_t *dp, dmu_diff_record_t *dr)
 {
+	differ_info_t *di = dp->dp_di;
 	zfs_cmd_t zc = {"\0"};
 	libzfs_handle_t *lhdl = di->zhp->zfs_hdl;
-	char fobjname[MAXPATHLEN];
 
 	(void) strlcpy(zc.zc_name, di->fromsnap, sizeof (zc.zc_name));
 	zc.zc_obj = dr->ddr_first - 1;
@@ -408,16 +810,21 @@ write_free_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
 			if (zc.zc_obj > dr->ddr_last) {
 				break;
 			}
-			(void) describe_free(fp, di, zc.zc_obj, fobjname,
-			    MAXPATHLEN);
+			if ((err = add_obj(fp, dp, zc.zc_obj, B_TRUE)) != 0)
+				return (err);
 		} else if (errno == ESRCH) {
 			break;
 		} else {
+			/* Write out the changes before this one first */
+			int zerr = errno;
+
+			if (write_batch(fp, dp) != 0)
+				return (-1);
 			(void) snprintf(di->errbuf, sizeof (di->errbuf),
 			    dgettext(TEXT_DOMAIN,
 			    "next allocated object (> %lld) find failure"),
 			    (longlong_t)zc.zc_obj);
-			di->zerr = errno;
+			di->zerr = zerr;
 			break;
 		}
 	}
@@ -426,14 +833,81 @@ write_free_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
 	return (0);
 }
 
+/*
+ * Returns the number of threads resolving the paths of changed objects, as
+ * given by the ZFS_DIFF_PARALLEL environment variable.
+ */
+static uint_t
+differ_parallelism(void)
+{
+	const char *env = getenv("ZFS_DIFF_PARALLEL");
+	unsigned long n;
+
+	if (env == NULL)
+		return (1);
+	n = strtoul(env, NULL, 0);
+	return (MAX(1, MIN(n, ZDIFF_PARALLEL_MAX)));
+}
+
+static void
+differ_pool_fini(void *arg)
+{
+	differ_pool_t *dp = arg;
+
+	(void) pthread_mutex_lock(&dp->dp_lock);
+	dp->dp_exit = B_TRUE;
+	(void) pthread_cond_broadcast(&dp->dp_cv);
+	(void) pthread_mutex_unlock(&dp->dp_lock);
+	for (uint_t i = 0; i < dp->dp_nthreads; i++)
+		(void) pthread_join(dp->dp_tids[i], NULL);
+
+	(void) pthread_cond_destroy(&dp->dp_done_cv);
+	(void) pthread_cond_destroy(&dp->dp_cv);
+	(void) pthread_mutex_destroy(&dp->dp_lock);
+	free(dp->dp_tids);
+	free(dp->dp_objs);
+}
+
+/*
+ * Set up the batch of changed objects, and start the threads resolving them
+ * besides the calling one.  If fewer threads than asked for can be started,
+ * the ones that were do the work.
+ */
+static int
+differ_pool_init(differ_pool_t *dp, differ_info_t *di)
+{
+	(void) memset(dp, 0, sizeof (*dp));
+	dp->dp_di = di;
+	(void) pthread_mutex_init(&dp->dp_lock, NULL);
+	(void) pthread_cond_init(&dp->dp_cv, NULL);
+	(void) pthread_cond_init(&dp->dp_done_cv, NULL);
+
+	dp->dp_objs = calloc(ZDIFF_BATCH, sizeof (differ_obj_t));
+	dp->dp_tids = calloc(di->nthreads, sizeof (pthread_t));
+	if (dp->dp_objs == NULL || dp->dp_tids == NULL) {
+		differ_pool_fini(dp);
+		return (ENOMEM);
+	}
+
+	for (uint_t i = 1; i < di->nthreads; i++) {
+		if (pthread_create(&dp->dp_tids[dp->dp_nthreads], NULL,
+		    resolve_thread, dp) != 0)
+			break;
+		dp->dp_nthreads++;
+	}
+	return (0);
+}
+
 static void *
 differ(void *arg)
 {
 	differ_info_t *di = arg;
 	dmu_diff_record_t dr;
+	differ_pool_t dp;
 	FILE *ofp;
 	int err = 0;
 
+	di->colorize = !di->machine && isatty(di->outputfd);
 	if ((ofp = fdopen(di->outputfd, "w")) == NULL) {
 		di->zerr = errno;
 		strlcpy(di->errbuf, zfs_strerror(errno), sizeof (di->errbuf));
@@ -441,6 +915,15 @@ differ(void *arg)
 		return ((void *)-1);
 	}
 
+	if ((err = differ_pool_init(&dp, di)) != 0) {
+		di->zerr = err;
+		strlcpy(di->errbuf, zfs_strerror(err), sizeof (di->errbuf));
+		(void) fclose(ofp);
+		(void) close(di->datafd);
+		return ((void *)-1);
+	}
+	pthread_cleanup_push(differ_pool_fini, &dp);
+
 	for (;;) {
 		char *cp = (char *)&dr;
 		int len = sizeof (dr);
@@ -457,15 +940,16 @@ differ(void *arg)
 			break;
 		} else if (rv == 0) {
 			/* end of file at a natural breaking point */
+			err = write_batch(ofp, &dp);
 			break;
 		}
 
 		switch (dr.ddr_type) {
 		case DDR_FREE:
-			err = write_free_diffs(ofp, di, &dr);
+			err = write_free_diffs(ofp, &dp, &dr);
 			break;
 		case DDR_INUSE:
-			err = write_inuse_diffs(ofp, di, &dr);
+			err = write_inuse_diffs(ofp, &dp, &dr);
 			break;
 		default:
 			di->zerr = EPIPE;
@@ -476,6 +960,7 @@ differ(void *arg)
 			break;
 	}
 
+	pthread_cleanup_pop(1);
 	(void) fclose(ofp);
 	(void) close(di->datafd);
 	if (err)
@@ -532,6 +1017,8 @@ teardown_differ_info(differ_info_t *di)
 	free(di->tosnap);
 	free(di->tmpsnap);
 	free(di->tomnt);
+	dircache_destroy(di->fromdirs);
+	dircache_destroy(di->todirs);
 	(void) close(di->cleanupfd);
 }
 
@@ -762,6 +1249,16 @@ zfs_show_diffs(zfs_handle_t *zhp, int outfd, const char *fromsnap,
 	di.classify = (flags & ZFS_DIFF_CLASSIFY);
 	di.timestamped = (flags & ZFS_DIFF_TIMESTAMP);
 	di.no_mangle = (flags & ZFS_DIFF_NO_MANGLE);
+	di.machine = (flags & ZFS_DIFF_MACHINE);
+	di.nthreads = differ_parallelism();
+
+	if ((di.fromdirs = dircache_create()) == NULL ||
+	    (di.todirs = dircache_create()) == NULL) {
+		(void) close(pipefd[0]);
+		(void) close(pipefd[1]);
+		teardown_differ_info(&di);
+		return (no_memory(zhp->zfs_hdl));
+	}
 
 	di.outputfd = outfd;
 	di.datafd = pipefd[0];
@@ -226,6 +226,11 @@ typedef struct differ_info {
 	int cleanupfd;
 	int outputfd;
 	int datafd;
+	boolean_t machine;
+	boolean_t colorize;
+	uint_t nthreads;
+	struct differ_dircache *fromdirs;	/* Directory paths by object */
+	struct differ_dircache *todirs;
 } differ_info_t;
 
 extern int do_mount(zfs_handle_t *zhp, const char *mntpt, const char *opts,
@@ -739,6 +739,79 @@ gather_nvlist(libzfs_handle_t *hdl, const char *fsname, const char *fromsnap,
 	return (0);
 }
 
+/*
+ * Upper bound of the datasets of a replication stream sent or received
+ * concurrently.
+ */
+#define	SENDRECV_PARALLEL_MAX	64
+
+/*
+ * Returns the number of datasets of a replication stream to send or receive
+ * concurrently, as given by the environment variable envvar.
+ */
+static uint_t
+sendrecv_parallelism(const char *envvar)
+{
+	const char *env = getenv(envvar);
+	unsigned long n;
+
+	if (env == NULL)
+		return (1);
+	n = strtoul(env, NULL, 0);
+	return (MAX(1, MIN(n, SENDRECV_PARALLEL_MAX)));
+}
+
+/*
+ * Creates a pipe for one dataset of a replication stream sent or received
+ * concurrently, large enough to keep its sender busy while the other end
+ * is handling another dataset.
+ */
+static int
+sendrecv_pipe(int fds[2])
+{
+	if (pipe2(fds, O_CLOEXEC) != 0)
+		return (errno);
+#ifdef F_SETPIPE_SZ
+	/* The pipe is empty, so resizing it cannot deadlock. */
+	(void) fcntl(fds[1], F_SETPIPE_SZ, 1024 * 1024);
+#endif
+	return (0);
+}
+
+/*
+ * Opens a handle for a thread sending or receiving datasets concurrently.
+ * The error buffers of a handle are not locked, so each thread reports its
+ * errors through a handle of its own.  These are opened before any of the
+ * threads start, since libzfs_init() sets up the property tables they use.
+ */
+static libzfs_handle_t *
+sendrecv_hdl_open(libzfs_handle_t *hdl)
+{
+	libzfs_handle_t *thdl;
+
+	if ((thdl = libzfs_init()) == NULL)
+		return (NULL);
+	libzfs_print_on_error(thdl, hdl->libzfs_printerr);
+	libzfs_mnttab_cache(thdl, hdl->zh_mnttab_cache_enabled);
+	return (thdl);
+}
+
+/*
+ * Passes the error a thread reported through its handle, if any, on to the
+ * handle of the caller.
+ */
+static void
+sendrecv_hdl_error(libzfs_handle_t *hdl, const libzfs_handle_t *thdl)
+{
+	if (thdl->libzfs_error == EZFS_SUCCESS)
+		return;
+	hdl->libzfs_error = thdl->libzfs_error;
+	(void) strlcpy(hdl->libzfs_action, thdl->libzfs_action,
+	    sizeof (hdl->libzfs_action));
+	(void) strlcpy(hdl->libzfs_desc, thdl->libzfs_desc,
+	    sizeof (hdl->libzfs_desc));
+}
+
 /*
  * Routines specific to "zfs send"
  */
@@ -1415,6 +1488,236 @@ dump_filesystem(zfs_handle_t *zhp, send_dump_data_t *sdd)
 	return (rv);
 }
 
+/*
+ * The filesystems of a replication stream sent concurrently.  Each one is
+ * dumped by one of several threads into a pipe of its own, and the pipes
+ * are copied to the output in the order the filesystems would have been
+ * sent in one by one, so the stream is the same either way.
+ */
+typedef struct send_parallel_fs {
+	const char *spf_name;
+	libzfs_handle_t *spf_hdl;	/* of the thread dumping it */
+	int spf_fd;		/* read end of the pipe, -1 once drained */
+	boolean_t spf_started;
+	boolean_t spf_done;
+	boolean_t spf_err;	/* sdd->err of the filesystem */
+	int spf_rv;
+} send_parallel_fs_t;
+
+typedef struct send_parallel {
+	pthread_mutex_t sp_lock;
+	pthread_cond_t sp_cv;
+	libzfs_handle_t **sp_hdls;	/* one for each thread */
+	uint_t sp_nhdls;	/* handles taken by the threads */
+	send_dump_data_t *sp_sdd;
+	send_parallel_fs_t *sp_fs;
+	uint_t sp_nfs;
+	uint_t sp_next;		/* next filesystem to dump */
+	uint_t sp_drained;	/* filesystems copied to the output */
+	uint_t sp_window;	/* filesystems dumped ahead of the output */
+	boolean_t sp_stop;
+} send_parallel_t;
+
+static void *
+send_parallel_thread(void *arg)
+{
+	send_parallel_t *sp = arg;
+	libzfs_handle_t *hdl;
+
+	(void) pthread_mutex_lock(&sp->sp_lock);
+	hdl = sp->sp_hdls[sp->sp_nhdls++];
+	(void) pthread_mutex_unlock(&sp->sp_lock);
+
+	/*
+	 * A thread stops after a filesystem fails, so that its handle keeps
+	 * the error until the filesystem is drained.
+	 */
+	for (;;) {
+		send_parallel_fs_t *spf;
+		send_dump_data_t sdd;
+		zfs_handle_t *zhp;
+		int fds[2], rv;
+
+		(void) pthread_mutex_lock(&sp->sp_lock);
+		while (!sp->sp_stop && sp->sp_next < sp->sp_nfs &&
+		    sp->sp_next >= sp->sp_drained + sp->sp_window)
+			(void) pthread_cond_wait(&sp->sp_cv, &sp->sp_lock);
+		if (sp->sp_stop || sp->sp_next == sp->sp_nfs) {
+			(void) pthread_mutex_unlock(&sp->sp_lock);
+			break;
+		}
+		spf = &sp->sp_fs[sp->sp_next++];
+		spf->spf_hdl = hdl;
+		hdl->libzfs_error = EZFS_SUCCESS;
+		if ((rv = sendrecv_pipe(fds)) != 0) {
+			spf->spf_rv = rv;
+			spf->spf_started = spf->spf_done = B_TRUE;
+			sp->sp_stop = B_TRUE;
+			(void) pthread_cond_broadcast(&sp->sp_cv);
+			(void) pthread_mutex_unlock(&sp->sp_lock);
+			break;
+		}
+		spf->spf_fd = fds[0];
+		spf->spf_started = B_TRUE;
+		(void) pthread_cond_broadcast(&sp->sp_cv);
+		(void) pthread_mutex_unlock(&sp->sp_lock);
+
+		sdd = *sp->sp_sdd;
+		sdd.outfd = fds[1];
+		sdd.err = B_FALSE;
+		zhp = zfs_open(hdl, spf->spf_name, ZFS_TYPE_DATASET);
+		if (zhp != NULL) {
+			rv = dump_filesystem(zhp, &sdd);
+			zfs_close(zhp);
+		} else {
+			rv = -1;
+		}
+		(void) close(fds[1]);
+
+		(void) pthread_mutex_lock(&sp->sp_lock);
+		spf->spf_rv = rv;
+		spf->spf_err = sdd.err;
+		spf->spf_done = B_TRUE;
+		if (rv != 0)
+			sp->sp_stop = B_TRUE;
+		(void) pthread_cond_broadcast(&sp->sp_cv);
+		(void) pthread_mutex_unlock(&sp->sp_lock);
+		if (rv != 0)
+			break;
+	}
+
+	return (NULL);
+}
+
+/*
+ * Copies the pipe of a filesystem to the output, returning the first error
+ * writing it.  The pipe is read to its end even after that, so the thread
+ * dumping into it can finish.
+ */
+static int
+send_parallel_copy(int fd, int outfd, char *buf, size_t bufsize)
+{
+	ssize_t rd, wr;
+	int error = 0;
+
+	while ((rd = read(fd, buf, bufsize)) != 0) {
+		if (rd < 0) {
+			if (errno == EINTR)
+				continue;
+			if (error == 0)
+				error = errno;
+			break;
+		}
+		for (ssize_t off = 0; error == 0 && off < rd; off += wr) {
+			wr = write(outfd, buf + off, rd - off);
+			if (wr < 0 && errno == EINTR) {
+				wr = 0;
+			} else if (wr < 0) {
+				error = errno;
+			}
+		}
+	}
+
+	return (error);
+}
+
+/*
+ * Sends the filesystems named in names, in that order, using nthreads
+ * threads.
+ */
+static int
+dump_filesystems_parallel(libzfs_handle_t *hdl, send_dump_data_t *sdd,
+    const char **names, uint_t nfs, uint_t nthreads)
+{
+	send_parallel_t sp = { 0 };
+	pthread_t *tids;
+	size_t bufsize = 1024 * 1024;
+	char *buf;
+	uint_t i, nhdls, nstarted = 0;
+	int rv = 0, error = 0;
+
+	buf = zfs_alloc(hdl, bufsize);
+	sp.sp_fs = zfs_alloc(hdl, nfs * sizeof (send_parallel_fs_t));
+	sp.sp_hdls = zfs_alloc(hdl, nthreads * sizeof (libzfs_handle_t *));
+	tids = zfs_alloc(hdl, nthreads * sizeof (pthread_t));
+	(void) pthread_mutex_init(&sp.sp_lock, NULL);
+	(void) pthread_cond_init(&sp.sp_cv, NULL);
+	sp.sp_sdd = sdd;
+	sp.sp_nfs = nfs;
+	sp.sp_window = 2 * nthreads;
+	for (i = 0; i < nfs; i++) {
+		sp.sp_fs[i].spf_name = names[i];
+		sp.sp_fs[i].spf_fd = -1;
+	}
+	for (nhdls = 0; nhdls < nthreads; nhdls++) {
+		if ((sp.sp_hdls[nhdls] = sendrecv_hdl_open(hdl)) == NULL) {
+			rv = (errno != 0) ? errno : ENOMEM;
+			break;
+		}
+	}
+
+	for (; rv == 0 && nstarted < nthreads; nstarted++) {
+		if ((error = pthread_create(&tids[nstarted], NULL,
+		    send_parallel_thread, &sp)) != 0) {
+			(void) pthread_mutex_lock(&sp.sp_lock);
+			sp.sp_stop = B_TRUE;
+			(void) pthread_cond_broadcast(&sp.sp_cv);
+			(void) pthread_mutex_unlock(&sp.sp_lock);
+			rv = error;
+			break;
+		}
+	}
+
+	for (i = 0; nstarted != 0 && i < nfs; i++) {
+		send_parallel_fs_t *spf = &sp.sp_fs[i];
+
+		(void) pthread_mutex_lock(&sp.sp_lock);
+		while (!spf->spf_started && !(sp.sp_stop && i >= sp.sp_next))
+			(void) pthread_cond_wait(&sp.sp_cv, &sp.sp_lock);
+		(void) pthread_mutex_unlock(&sp.sp_lock);
+		if (!spf->spf_started)
+			break;
+
+		if (spf->spf_fd != -1) {
+			int err = send_parallel_copy(spf->spf_fd, sdd->outfd,
+			    buf, bufsize);
+			if (err != 0 && error == 0)
+				error = err;
+			(void) close(spf->spf_fd);
+			spf->spf_fd = -1;
+		}
+
+		(void) pthread_mutex_lock(&sp.sp_lock);
+		while (!spf->spf_done)
+			(void) pthread_cond_wait(&sp.sp_cv, &sp.sp_lock);
+		if (spf->spf_err)
+			sdd->err = B_TRUE;
+		if (rv == 0 && (rv = spf->spf_rv) != 0)
+			sendrecv_hdl_error(hdl, spf->spf_hdl);
+		if (rv == 0)
+			rv = error;
+		sp.sp_drained++;
+		if (rv != 0)
+			sp.sp_stop = B_TRUE;
+		(void) pthread_cond_broadcast(&sp.sp_cv);
+		(void) pthread_mutex_unlock(&sp.sp_lock);
+	}
+
+	for (i = 0; i < nstarted; i++)
+		(void) pthread_join(tids[i], NULL);
+	for (i = 0; i < nhdls; i++)
+		libzfs_fini(sp.sp_hdls[i]);
+
+	(void) pthread_cond_destroy(&sp.sp_cv);
+	(void) pthread_mutex_destroy(&sp.sp_lock);
+	free(tids);
+	free(sp.sp_hdls);
+	free(sp.sp_fs);
+	free(buf);
+
+	return (rv);
+}
+
 /*
  * Send all snapshots for all filesystems in sdd.
  */
@@ -1423,10 +1726,31 @@ dump_filesystems(zfs_handle_t *rzhp, send_dump_data_t *sdd)
 {
 	nvpair_t *fspair;
 	boolean_t needagain, progress;
+	const char **names = NULL;
+	uint_t nfs = 0, nthreads;
+	int rv = 0;
 
 	if (!sdd->replicate)
 		return (dump_filesystem(rzhp, sdd));
 
+	/*
+	 * With ZFS_SEND_PARALLEL set, the order the filesystems are sent in
+	 * is worked out first, and they are then dumped concurrently.  Only
+	 * the stream itself is produced that way; dry runs, progress
+	 * reports and holds still go one filesystem at a time.
+	 */
+	nthreads = sendrecv_parallelism("ZFS_SEND_PARALLEL");
+	if (nthreads > 1 && !sdd->dryrun && !sdd->progress &&
+	    sdd->verbosity == 0 && sdd->snapholds == NULL &&
+	    sdd->debugnv == NULL) {
+		uint_t n = 0;
+
+		for (fspair = nvlist_next_nvpair(sdd->fss, NULL); fspair;
+		    fspair = nvlist_next_nvpair(sdd->fss, fspair))
+			n++;
+		names = zfs_alloc(rzhp->zfs_hdl, MAX(n, 1) * sizeof (char *));
+	}
+
 	/* Mark the clone origin snapshots. */
 	for (fspair = nvlist_next_nvpair(sdd->fss, NULL); fspair;
 	    fspair = nvlist_next_nvpair(sdd->fss, fspair)) {
@@ -1493,6 +1817,13 @@ again:
 			}
 		}
 
+		if (names != NULL) {
+			names[nfs++] = fsname;
+			fnvlist_add_boolean(fslist, "sent");
+			progress = B_TRUE;
+			continue;
+		}
+
 		zhp = zfs_open(rzhp->zfs_hdl, fsname, ZFS_TYPE_DATASET);
 		if (zhp == NULL)
 			return (-1);
@@ -1508,6 +1839,12 @@ again:
 		goto again;
 	}
 
+	if (names != NULL) {
+		rv = dump_filesystems_parallel(rzhp->zfs_hdl, sdd, names, nfs,
+		    nthreads);
+		free(names);
+	}
+
 	/* Clean out the sent flags in case we reuse this fss. */
 	for (fspair = nvlist_next_nvpair(sdd->fss, NULL); fspair;
 	    fspair = nvlist_next_nvpair(sdd->fss, fspair)) {
@@ -1517,7 +1854,7 @@ again:
 		(void) nvlist_remove_all(fslist, "sent");
 	}
 
-	return (0);
+	return (rv);
 }
 
 nvlist_t *
@@ -3847,6 +4184,421 @@ doagain:
 	return (needagain || error != 0);
 }
 
+/*
+ * The substreams of a replication stream received concurrently.  The
+ * stream is read by one thread, which hands each substream to a thread of
+ * its own through a pipe, once the substreams it depends on are received.
+ */
+typedef struct recv_parallel_job {
+	struct recv_parallel *rpj_rp;
+	libzfs_handle_t *rpj_hdl;
+	pthread_t rpj_tid;
+	boolean_t rpj_busy;
+	boolean_t rpj_done;
+	int rpj_fd;		/* read end of the pipe */
+	char rpj_fs[ZFS_MAX_DATASET_NAME_LEN];
+	char rpj_origin[ZFS_MAX_DATASET_NAME_LEN];
+	recvflags_t rpj_flags;
+	int rpj_error;
+} recv_parallel_job_t;
+
+typedef struct recv_parallel {
+	pthread_mutex_t rp_lock;
+	pthread_cond_t rp_cv;
+	const char *rp_destname;
+	const char *rp_sendfs;
+	const char *rp_sendsnap;
+	nvlist_t *rp_stream_nv;
+	avl_tree_t *rp_stream_avl;
+	nvlist_t *rp_cmdprops;
+	char **rp_top_zfs;
+	recv_parallel_job_t *rp_jobs;
+	uint_t rp_njobs;
+	uint_t rp_nbusy;
+	uint_t rp_ndone;
+} recv_parallel_t;
+
+static void *
+recv_parallel_thread(void *arg)
+{
+	recv_parallel_job_t *rpj = arg;
+	recv_parallel_t *rp = rpj->rpj_rp;
+	char buf[4096];
+
+	rpj->rpj_error = zfs_receive_impl(rpj->rpj_hdl, rp->rp_destname, NULL,
+	    &rpj->rpj_flags, rpj->rpj_fd, rp->rp_sendfs, rp->rp_stream_nv,
+	    rp->rp_stream_avl, rp->rp_top_zfs, rp->rp_sendsnap,
+	    rp->rp_cmdprops);
+
+	/* Consume whatever was not received, so the reader never blocks. */
+	while (read(rpj->rpj_fd, buf, sizeof (buf)) > 0)
+		;
+	(void) close(rpj->rpj_fd);
+
+	(void) pthread_mutex_lock(&rp->rp_lock);
+	rpj->rpj_done = B_TRUE;
+	(void) pthread_cond_broadcast(&rp->rp_cv);
+	(void) pthread_mutex_unlock(&rp->rp_lock);
+
+	return (NULL);
+}
+
+/*
+ * Returns B_TRUE if a and b are the same dataset or one contains the other.
+ */
+static boolean_t
+recv_parallel_nested(const char *a, const char *b)
+{
+	size_t alen = strlen(a), blen = strlen(b);
+
+	if (alen > blen)
+		return (recv_parallel_nested(b, a));
+	return (strncmp(a, b, alen) == 0 && (b[alen] == '\0' ||
+	    b[alen] == '/'));
+}
+
+/*
+ * Returns B_TRUE if the substream of fs, a clone of origin if that is not
+ * empty, has to wait for the one rpj is receiving: one of them creates or
+ * changes a dataset the other one is received into or cloned from.
+ */
+static boolean_t
+recv_parallel_depends(const recv_parallel_job_t *rpj, const char *fs,
+    const char *origin)
+{
+	return (recv_parallel_nested(rpj->rpj_fs, fs) ||
+	    strcmp(rpj->rpj_fs, origin) == 0 ||
+	    strcmp(rpj->rpj_origin, fs) == 0);
+}
+
+/*
+ * Reaps the substreams that have finished being received, without waiting
+ * for any, and returns the first error of those, which is passed on to hdl.
+ * Sets *reaped if there were any.  Called with rp_lock held.
+ */
+static int
+recv_parallel_reap_done(recv_parallel_t *rp, libzfs_handle_t *hdl,
+    recvflags_t *flags, boolean_t *reaped)
+{
+	int error = 0;
+
+	for (uint_t i = 0; i < rp->rp_njobs; i++) {
+		recv_parallel_job_t *rpj = &rp->rp_jobs[i];
+
+		if (!rpj->rpj_busy || !rpj->rpj_done)
+			continue;
+		(void) pthread_join(rpj->rpj_tid, NULL);
+		if (rpj->rpj_flags.domount)
+			flags->domount = B_TRUE;
+		if (error == 0 && (error = rpj->rpj_error) != 0)
+			sendrecv_hdl_error(hdl, rpj->rpj_hdl);
+		rpj->rpj_busy = B_FALSE;
+		rp->rp_nbusy--;
+		rp->rp_ndone++;
+		*reaped = B_TRUE;
+	}
+
+	return (error);
+}
+
+/*
+ * Waits for the substreams being received to finish, all of them if all is
+ * set or else any one of them, and returns the first error of those.
+ * Called with rp_lock held.
+ */
+static int
+recv_parallel_reap(recv_parallel_t *rp, libzfs_handle_t *hdl,
+    recvflags_t *flags, boolean_t all)
+{
+	boolean_t reaped = B_FALSE;
+	int error = 0, err;
+
+	while (rp->rp_nbusy != 0) {
+		err = recv_parallel_reap_done(rp, hdl, flags, &reaped);
+		if (error == 0)
+			error = err;
+		if (reaped && !all)
+			break;
+		if (rp->rp_nbusy != 0)
+			(void) pthread_cond_wait(&rp->rp_cv, &rp->rp_lock);
+	}
+
+	return (error);
+}
+
+/*
+ * Copies the substream whose BEGIN record drr was read from infd, as it
+ * is in the stream, to outfd, through its END record.
+ */
+static int
+recv_parallel_copy(libzfs_handle_t *hdl, int infd, int outfd,
+    dmu_replay_record_t *drr, boolean_t byteswap, void *buf, size_t bufsize)
+{
+	dmu_replay_record_t rec;
+	uint64_t payload_size;
+	char errbuf[ERRBUFLEN];
+	int error;
+
+	(void) snprintf(errbuf, sizeof (errbuf), dgettext(TEXT_DOMAIN,
+	    "cannot receive"));
+
+	for (;;) {
+		rec = *drr;
+		if (byteswap)
+			rec.drr_type = BSWAP_32(rec.drr_type);
+
+		switch (rec.drr_type) {
+		case DRR_BEGIN:
+			payload_size = byteswap ?
+			    BSWAP_32(rec.drr_payloadlen) : rec.drr_payloadlen;
+			break;
+		case DRR_OBJECT:
+			if (byteswap) {
+				rec.drr_u.drr_object.drr_bonuslen =
+				    BSWAP_32(rec.drr_u.drr_object.drr_bonuslen);
+				rec.drr_u.drr_object.drr_raw_bonuslen =
+				    BSWAP_32(rec.drr_u.drr_object.
+				    drr_raw_bonuslen);
+			}
+			payload_size =
+			    DRR_OBJECT_PAYLOAD_SIZE(&rec.drr_u.drr_object);
+			break;
+		case DRR_WRITE:
+			if (byteswap) {
+				rec.drr_u.drr_write.drr_logical_size =
+				    BSWAP_64(rec.drr_u.drr_write.
+				    drr_logical_size);
+				rec.drr_u.drr_write.drr_compressed_size =
+				    BSWAP_64(rec.drr_u.drr_write.
+				    drr_compressed_size);
+			}
+			payload_size =
+			    DRR_WRITE_PAYLOAD_SIZE(&rec.drr_u.drr_write);
+			break;
+		case DRR_SPILL:
+			if (byteswap) {
+				rec.drr_u.drr_spill.drr_length =
+				    BSWAP_64(rec.drr_u.drr_spill.drr_length);
+				rec.drr_u.drr_spill.drr_compressed_size =
+				    BSWAP_64(rec.drr_u.drr_spill.
+				    drr_compressed_size);
+			}
+			payload_size =
+			    DRR_SPILL_PAYLOAD_SIZE(&rec.drr_u.drr_spill);
+			break;
+		case DRR_WRITE_EMBEDDED:
+			if (byteswap) {
+				rec.drr_u.drr_write_embedded.drr_psize =
+				    BSWAP_32(rec.drr_u.drr_write_embedded.
+				    drr_psize);
+			}
+			payload_size = P2ROUNDUP(
+			    rec.drr_u.drr_write_embedded.drr_psize, 8);
+			break;
+		case DRR_END:
+		case DRR_OBJECT_RANGE:
+		case DRR_WRITE_BYREF:
+		case DRR_FREEOBJECTS:
+		case DRR_FREE:
+		case DRR_REDACT:
+			payload_size = 0;
+			break;
+		default:
+			zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
+			    "invalid record type"));
+			return (zfs_error(hdl, EZFS_BADSTREAM, errbuf));
+		}
+		if (payload_size > bufsize) {
+			zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
+			    "invalid record size"));
+			return (zfs_error(hdl, EZFS_BADSTREAM, errbuf));
+		}
+
+		if (write(outfd, drr, sizeof (*drr)) != sizeof (*drr))
+			return (zfs_standard_error(hdl, errno, errbuf));
+		if (payload_size != 0) {
+			if ((error = recv_read(hdl, infd, buf, payload_size,
+			    B_FALSE, NULL)) != 0)
+				return (error);
+			if (write(outfd, buf, payload_size) != payload_size)
+				return (zfs_standard_error(hdl, errno, errbuf));
+		}
+		if (rec.drr_type == DRR_END)
+			return (0);
+
+		if ((error = recv_read(hdl, infd, drr, sizeof (*drr),
+		    B_FALSE, NULL)) != 0)
+			return (error);
+	}
+}
+
+/*
+ * Receives the substreams of a replication stream from fd on nthreads
+ * threads, in place of calling zfs_receive_impl() for each one in turn.
+ * A substream waits for the ones before it that create or change its
+ * filesystem, one of the filesystem's ancestors or descendants, or its
+ * origin.  Until the first substream is received, which sets top_zfs, the
+ * others wait for it too.
+ */
+static int
+recv_parallel_package(libzfs_handle_t *hdl, int fd, const char *destname,
+    recvflags_t *flags, const char *sendfs, nvlist_t *stream_nv,
+    avl_tree_t *stream_avl, char **top_zfs, const char *sendsnap,
+    nvlist_t *cmdprops, uint_t nthreads)
+{
+	recv_parallel_t rp = { 0 };
+	dmu_replay_record_t drr;
+	size_t bufsize = SPA_MAXBLOCKSIZE;
+	void *buf;
+	char errbuf[ERRBUFLEN];
+	boolean_t reaped;
+	int error = 0, err;
+
+	(void) snprintf(errbuf, sizeof (errbuf), dgettext(TEXT_DOMAIN,
+	    "cannot receive"));
+
+	buf = zfs_alloc(hdl, bufsize);
+	rp.rp_jobs = zfs_alloc(hdl, nthreads * sizeof (recv_parallel_job_t));
+	(void) pthread_mutex_init(&rp.rp_lock, NULL);
+	(void) pthread_cond_init(&rp.rp_cv, NULL);
+	rp.rp_destname = destname;
+	rp.rp_sendfs = sendfs;
+	rp.rp_sendsnap = sendsnap;
+	rp.rp_stream_nv = stream_nv;
+	rp.rp_stream_avl = stream_avl;
+	rp.rp_cmdprops = cmdprops;
+	rp.rp_top_zfs = top_zfs;
+	for (; rp.rp_njobs < nthreads; rp.rp_njobs++) {
+		recv_parallel_job_t *rpj = &rp.rp_jobs[rp.rp_njobs];
+
+		if ((rpj->rpj_hdl = sendrecv_hdl_open(hdl)) == NULL) {
+			error = zfs_standard_error(hdl, errno, errbuf);
+			break;
+		}
+	}
+
+	while (error == 0) {
+		struct drr_begin *drrb = &drr.drr_u.drr_begin;
+		recv_parallel_job_t *rpj = NULL;
+		char fs[ZFS_MAX_DATASET_NAME_LEN];
+		char origin[ZFS_MAX_DATASET_NAME_LEN] = "";
+		boolean_t byteswap;
+		uint64_t fromguid;
+		nvlist_t *nvfs;
+		int fds[2];
+		char *cp;
+
+		/*
+		 * Like a serial receive, stop at the first substream that
+		 * fails rather than start on any more.
+		 */
+		(void) pthread_mutex_lock(&rp.rp_lock);
+		error = recv_parallel_reap_done(&rp, hdl, flags, &reaped);
+		(void) pthread_mutex_unlock(&rp.rp_lock);
+		if (error != 0)
+			break;
+
+		if ((error = recv_read(hdl, fd, &drr, sizeof (drr), B_FALSE,
+		    NULL)) != 0)
+			break;
+		/* It's the double end record at the end of a package */
+		if (drr.drr_type == DRR_END ||
+		    drr.drr_type == BSWAP_32(DRR_END))
+			break;
+
+		byteswap = (drrb->drr_magic == BSWAP_64(DMU_BACKUP_MAGIC));
+		if ((byteswap ? BSWAP_32(drr.drr_type) : drr.drr_type) !=
+		    DRR_BEGIN || (!byteswap &&
+		    drrb->drr_magic != DMU_BACKUP_MAGIC)) {
+			zfs_error_aux(hdl, dgettext(TEXT_DOMAIN, "invalid "
+			    "stream (bad magic number)"));
+			error = zfs_error(hdl, EZFS_BADSTREAM, errbuf);
+			break;
+		}
+
+		(void) strlcpy(fs, drrb->drr_toname, sizeof (fs));
+		if ((cp = strchr(fs, '@')) != NULL)
+			*cp = '\0';
+		fromguid = byteswap ? BSWAP_64(drrb->drr_fromguid) :
+		    drrb->drr_fromguid;
+		if (fromguid != 0 &&
+		    (nvfs = fsavl_find(stream_avl, fromguid, NULL)) != NULL &&
+		    strcmp(fnvlist_lookup_string(nvfs, "name"), fs) != 0) {
+			(void) strlcpy(origin,
+			    fnvlist_lookup_string(nvfs, "name"),
+			    sizeof (origin));
+		}
+
+		(void) pthread_mutex_lock(&rp.rp_lock);
+		for (;;) {
+			boolean_t blocked = (rp.rp_ndone == 0 &&
+			    rp.rp_nbusy != 0);
+
+			for (uint_t i = 0; i < rp.rp_njobs; i++) {
+				recv_parallel_job_t *j = &rp.rp_jobs[i];
+
+				if (!j->rpj_busy)
+					rpj = j;
+				else if (recv_parallel_depends(j, fs, origin))
+					blocked = B_TRUE;
+			}
+			if (!blocked && rpj != NULL)
+				break;
+			rpj = NULL;
+			if ((error = recv_parallel_reap(&rp, hdl, flags,
+			    B_FALSE)) != 0)
+				break;
+		}
+		(void) pthread_mutex_unlock(&rp.rp_lock);
+		if (error != 0)
+			break;
+
+		if ((err = sendrecv_pipe(fds)) != 0) {
+			error = zfs_standard_error(hdl, err, errbuf);
+			break;
+		}
+		rpj->rpj_rp = &rp;
+		rpj->rpj_done = B_FALSE;
+		rpj->rpj_fd = fds[0];
+		(void) strlcpy(rpj->rpj_fs, fs, sizeof (rpj->rpj_fs));
+		(void) strlcpy(rpj->rpj_origin, origin,
+		    sizeof (rpj->rpj_origin));
+		rpj->rpj_flags = *flags;
+		rpj->rpj_error = 0;
+		rpj->rpj_hdl->libzfs_error = EZFS_SUCCESS;
+		if ((err = pthread_create(&rpj->rpj_tid, NULL,
+		    recv_parallel_thread, rpj)) != 0) {
+			(void) close(fds[0]);
+			(void) close(fds[1]);
+			error = zfs_standard_error(hdl, err, errbuf);
+			break;
+		}
+		(void) pthread_mutex_lock(&rp.rp_lock);
+		rpj->rpj_busy = B_TRUE;
+		rp.rp_nbusy++;
+		(void) pthread_mutex_unlock(&rp.rp_lock);
+
+		error = recv_parallel_copy(hdl, fd, fds[1], &drr, byteswap,
+		    buf, bufsize);
+		(void) close(fds[1]);
+	}
+
+	(void) pthread_mutex_lock(&rp.rp_lock);
+	err = recv_parallel_reap(&rp, hdl, flags, B_TRUE);
+	(void) pthread_mutex_unlock(&rp.rp_lock);
+	if (error == 0)
+		error = err;
+	for (uint_t i = 0; i < rp.rp_njobs; i++)
+		libzfs_fini(rp.rp_jobs[i].rpj_hdl);
+
+	(void) pthread_cond_destroy(&rp.rp_cv);
+	(void) pthread_mutex_destroy(&rp.rp_lock);
+	free(rp.rp_jobs);
+	free(buf);
+
+	return (error);
+}
+
 static int
 zfs_receive_package(libzfs_handle_t *hdl, int fd, const char *destname,
     recvflags_t *flags, dmu_replay_record_t *drr, zio_cksum_t *zc,
@@ -3865,6 +4617,7 @@ zfs_receive_package(libzfs_handle_t *hdl, int fd, const char *destname,
 	boolean_t anyerr = B_FALSE;
 	boolean_t softerr = B_FALSE;
 	boolean_t recursive, raw;
+	uint_t nthreads;
 
 	(void) snprintf(errbuf, sizeof (errbuf), dgettext(TEXT_DOMAIN,
 	    "cannot receive"));
@@ -4015,23 +4768,38 @@ zfs_receive_package(libzfs_handle_t *hdl, int fd, const char *destname,
 		sendsnap = (cp + 1);
 	}
 
-	/* Finally, receive each contained stream */
-	do {
-		/*
-		 * we should figure out if it has a recoverable
-		 * error, in which case do a recv_skip() and drive on.
-		 * Note, if we fail due to already having this guid,
-		 * zfs_receive_one() will take care of it (ie,
-		 * recv_skip() and return 0).
-		 */
-		error = zfs_receive_impl(hdl, destname, NULL, flags, fd,
-		    sendfs, stream_nv, stream_avl, top_zfs, sendsnap, cmdprops);
-		if (error == ENODATA) {
-			error = 0;
-			break;
-		}
-		anyerr |= error;
-	} while (error == 0);
+	/*
+	 * Finally, receive each contained stream, several at a time with
+	 * ZFS_RECV_PARALLEL set.  Verbose and dry-run receives print per
+	 * stream, which would interleave, so they stay serial.
+	 */
+	nthreads = sendrecv_parallelism("ZFS_RECV_PARALLEL");
+	if (nthreads > 1 && stream_avl != NULL && !flags->verbose &&
+	    !flags->dryrun) {
+		error = recv_parallel_package(hdl, fd, destname, flags,
+		    sendfs, stream_nv, stream_avl, top_zfs, sendsnap,
+		    cmdprops, nthreads);
+		if (error != 0)
+			anyerr = B_TRUE;
+	} else {
+		do {
+			/*
+			 * we should figure out if it has a recoverable
+			 * error, in which case do a recv_skip() and drive on.
+			 * Note, if we fail due to already having this guid,
+			 * zfs_receive_one() will take care of it (ie,
+			 * recv_skip() and return 0).
+			 */
+			error = zfs_receive_impl(hdl, destname, NULL, flags,
+			    fd, sendfs, stream_nv, stream_avl, top_zfs,
+			    sendsnap, cmdprops);
+			if (error == ENODATA) {
+				error = 0;
+				break;
+			}
+			anyerr |= error;
+		} while (error == 0);
+	}
 
 	if (drr->drr_payloadlen != 0 && recursive && fromsnap != NULL) {
 		/*
@@ -4460,6 +5228,7 @@ zfs_receive_one(libzfs_handle_t *hdl, int infd, const char *tosnap,
 	boolean_t stream_wantsnewfs, stream_resumingnewfs;
 	boolean_t newprops = B_FALSE;
 	uint64_t read_bytes = 0;
+	uint64_t uncached_bytes = 0;
 	uint64_t errflags = 0;
 	uint64_t parent_snapguid = 0;
 	prop_changelist_t *clp = NULL;
@@ -5071,7 +5840,13 @@ zfs_receive_one(libzfs_handle_t *hdl, int infd, const char *tosnap,
 		goto out;
 	}
 
-	if (flags->heal) {
+	if (flags->uncached) {
+		err = ioctl_err = lzc_receive_with_uncached(destsnap, rcvprops,
+		    oxprops, wkeydata, wkeylen, origin, flags->force,
+		    flags->heal, flags->uncached, flags->resumable, raw, infd,
+		    drr_noswap, -1, &read_bytes, &uncached_bytes, &errflags,
+		    NULL, &prop_errors);
+	} else if (flags->heal) {
 		err = ioctl_err = lzc_receive_with_heal(destsnap, rcvprops,
 		    oxprops, wkeydata, wkeylen, origin, flags->force,
 		    flags->heal, flags->resumable, raw, infd, drr_noswap, -1,
@@ -5432,6 +6207,11 @@ zfs_receive_one(libzfs_handle_t *hdl, int infd, const char *tosnap,
 
 		(void) printf("received %s stream in %.2f seconds (%s/sec)\n",
 		    buf1, delta_f, buf2);
+		if (flags->uncached) {
+			zfs_nicebytes(uncached_bytes, buf1, sizeof (buf1));
+			(void) printf("wrote %s of data without caching it in "
+			    "the ARC\n", buf1);
+		}
 	}
 
 	err = 0;
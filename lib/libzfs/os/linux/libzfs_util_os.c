@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <strings.h>
 #include <sys/inotify.h>
+#include <sys/ioctl.h>
 #include <sys/mntent.h>
 #include <sys/mnttab.h>
 #include <sys/stat.h>
@@ -300,3 +301,31 @@ zfs_userns(zfs_handle_t *zhp, const char *nspath, int attach)
 
 	return (ret);
 }
+
+/*
+ * Read as many entries of the directory open as dirfd as fit into buf,
+ * starting at *cookie (zero for the first call), together with their
+ * attributes.  On success *count holds the number of zfs_direntplus_t
+ * records packed into buf, *cookie the position to continue from, and *eof
+ * whether the end of the directory was reached.  The directory is read
+ * without instantiating an inode for every entry, so this is considerably
+ * cheaper than readdir(3) and a stat(2) of each entry.
+ */
+int
+zfs_readdirplus(int dirfd, uint64_t *cookie, void *buf, size_t bufsize,
+    uint32_t *count, boolean_t *eof)
+{
+	zfs_readdirplus_args_t args = {
+		.buf = (uintptr_t)buf,
+		.cookie = *cookie,
+		.bufsize = MIN(bufsize, ZFS_READDIRPLUS_BUFSIZE_MAX),
+	};
+
+	if (ioctl(dirfd, ZFS_IOC_READDIRPLUS, &args) != 0)
+		return (-1);
+
+	*cookie = args.cookie;
+	*count = args.count;
+	*eof = !!(args.flags & ZFS_READDIRPLUS_EOF);
+	return (0);
+}
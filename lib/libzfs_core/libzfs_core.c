@@ -1087,9 +1087,10 @@ recv_read(int fd, void *buf, int ilen)
 static int
 recv_impl(const char *snapname, nvlist_t *recvdprops, nvlist_t *localprops,
     uint8_t *wkeydata, uint_t wkeylen, const char *origin, boolean_t force,
-    boolean_t heal, boolean_t resumable, boolean_t raw, int input_fd,
-    const dmu_replay_record_t *begin_record, uint64_t *read_bytes,
-    uint64_t *errflags, nvlist_t **errors)
+    boolean_t heal, boolean_t uncached, boolean_t resumable, boolean_t raw,
+    int input_fd, const dmu_replay_record_t *begin_record,
+    uint64_t *read_bytes, uint64_t *uncached_bytes, uint64_t *errflags,
+    nvlist_t **errors)
 {
 	dmu_replay_record_t drr;
 	char fsname[MAXPATHLEN];
@@ -1142,7 +1143,8 @@ recv_impl(const char *snapname, nvlist_t *recvdprops, nvlist_t *localprops,
 	/*
 	 * All receives with a payload should use the new interface.
 	 */
-	if (resumable || heal || raw || wkeydata != NULL || payload) {
+	if (resumable || heal || uncached || raw || wkeydata != NULL ||
+	    payload) {
 		nvlist_t *outnvl = NULL;
 		nvlist_t *innvl = fnvlist_alloc();
 
@@ -1185,12 +1187,19 @@ recv_impl(const char *snapname, nvlist_t *recvdprops, nvlist_t *localprops,
 		if (heal)
 			fnvlist_add_boolean(innvl, "heal");
 
+		if (uncached)
+			fnvlist_add_boolean(innvl, "uncached");
+
 		error = lzc_ioctl(ZFS_IOC_RECV_NEW, fsname, innvl, &outnvl);
 
 		if (error == 0 && read_bytes != NULL)
 			error = nvlist_lookup_uint64(outnvl, "read_bytes",
 			    read_bytes);
 
+		if (error == 0 && uncached && uncached_bytes != NULL)
+			error = nvlist_lookup_uint64(outnvl, "uncached_bytes",
+			    uncached_bytes);
+
 		if (error == 0 && errflags != NULL)
 			error = nvlist_lookup_uint64(outnvl, "error_flags",
 			    errflags);
@@ -1305,7 +1314,7 @@ lzc_receive(const char *snapname, nvlist_t *props, const char *origin,
     boolean_t force, boolean_t raw, int fd)
 {
 	return (recv_impl(snapname, props, NULL, NULL, 0, origin, force,
-	    B_FALSE, B_FALSE, raw, fd, NULL, NULL, NULL, NULL));
+	    B_FALSE, B_FALSE, B_FALSE, raw, fd, NULL, NULL, NULL, NULL, NULL));
 }
 
 /*
@@ -1319,7 +1328,7 @@ lzc_receive_resumable(const char *snapname, nvlist_t *props, const char *origin,
     boolean_t force, boolean_t raw, int fd)
 {
 	return (recv_impl(snapname, props, NULL, NULL, 0, origin, force,
-	    B_FALSE, B_TRUE, raw, fd, NULL, NULL, NULL, NULL));
+	    B_FALSE, B_FALSE, B_TRUE, raw, fd, NULL, NULL, NULL, NULL, NULL));
 }
 
 /*
@@ -1342,7 +1351,8 @@ lzc_receive_with_header(const char *snapname, nvlist_t *props,
 		return (EINVAL);
 
 	return (recv_impl(snapname, props, NULL, NULL, 0, origin, force,
-	    B_FALSE, resumable, raw, fd, begin_record, NULL, NULL, NULL));
+	    B_FALSE, B_FALSE, resumable, raw, fd, begin_record, NULL, NULL,
+	    NULL, NULL));
 }
 
 /*
@@ -1381,8 +1391,8 @@ lzc_receive_one(const char *snapname, nvlist_t *props,
 {
 	(void) action_handle, (void) cleanup_fd;
 	return (recv_impl(snapname, props, NULL, NULL, 0, origin, force,
-	    B_FALSE, resumable, raw, input_fd, begin_record,
-	    read_bytes, errflags, errors));
+	    B_FALSE, B_FALSE, resumable, raw, input_fd, begin_record,
+	    read_bytes, NULL, errflags, errors));
 }
 
 /*
@@ -1403,8 +1413,8 @@ lzc_receive_with_cmdprops(const char *snapname, nvlist_t *props,
 {
 	(void) action_handle, (void) cleanup_fd;
 	return (recv_impl(snapname, props, cmdprops, wkeydata, wkeylen, origin,
-	    force, B_FALSE, resumable, raw, input_fd, begin_record,
-	    read_bytes, errflags, errors));
+	    force, B_FALSE, B_FALSE, resumable, raw, input_fd, begin_record,
+	    read_bytes, NULL, errflags, errors));
 }
 
 /*
@@ -1423,8 +1433,31 @@ int lzc_receive_with_heal(const char *snapname, nvlist_t *props,
 {
 	(void) action_handle, (void) cleanup_fd;
 	return (recv_impl(snapname, props, cmdprops, wkeydata, wkeylen, origin,
-	    force, heal, resumable, raw, input_fd, begin_record,
-	    read_bytes, errflags, errors));
+	    force, heal, B_FALSE, resumable, raw, input_fd, begin_record,
+	    read_bytes, NULL, errflags, errors));
+}
+
+/*
+ * Like lzc_receive_with_heal, but allows the caller to pass an additional
+ * 'uncached' argument.
+ *
+ * The uncached argument tells the kernel to keep the received data out of
+ * the ARC, writing records that cover whole blocks with Direct I/O.  The
+ * 'uncached_bytes' value will be set to the number of bytes of data that
+ * were written without going through the ARC.
+ */
+int
+lzc_receive_with_uncached(const char *snapname, nvlist_t *props,
+    nvlist_t *cmdprops, uint8_t *wkeydata, uint_t wkeylen, const char *origin,
+    boolean_t force, boolean_t heal, boolean_t uncached, boolean_t resumable,
+    boolean_t raw, int input_fd, const dmu_replay_record_t *begin_record,
+    int cleanup_fd, uint64_t *read_bytes, uint64_t *uncached_bytes,
+    uint64_t *errflags, uint64_t *action_handle, nvlist_t **errors)
+{
+	(void) action_handle, (void) cleanup_fd;
+	return (recv_impl(snapname, props, cmdprops, wkeydata, wkeylen, origin,
+	    force, heal, uncached, resumable, raw, input_fd, begin_record,
+	    read_bytes, uncached_bytes, errflags, errors));
 }
 
 /*
@@ -46,6 +46,7 @@
 #include <sys/spa.h>
 #include <sys/txg.h>
 #include <sys/dbuf.h>
+#include <sys/abd.h>
 #include <sys/zap.h>
 #include <sys/sa.h>
 #include <sys/policy.h>
@@ -62,6 +63,8 @@
 #include <sys/zil.h>
 #include <sys/sa_impl.h>
 #include <linux/mm_compat.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
 
 /*
  * Programming rules.
@@ -225,6 +228,15 @@ zfs_close(struct inode *ip, int flag, cred_t *cr)
 
 static int zfs_fillpage(struct inode *ip, struct page *pp);
 
+/*
+ * DMU flags for I/O between the DMU and the page cache of a mapped file.
+ */
+static inline dmu_flags_t
+zfs_mapped_dmu_flags(void)
+{
+	return (DMU_READ_PREFETCH | (zfs_mmap_uncached ? DMU_UNCACHEDIO : 0));
+}
+
 /*
  * When a file is memory mapped, we must keep the IO data synchronized
  * between the DMU cache and the memory mapped pages.  Update all mapped
@@ -235,6 +247,7 @@ update_pages(znode_t *zp, int64_t start, int len, objset_t *os)
 {
 	struct address_space *mp = ZTOI(zp)->i_mapping;
 	int64_t off = start & (PAGE_SIZE - 1);
+	dmu_flags_t flags = zfs_mapped_dmu_flags();
 
 	for (start &= PAGE_MASK; len > 0; start += PAGE_SIZE) {
 		uint64_t nbytes = MIN(PAGE_SIZE - off, len);
@@ -246,9 +259,12 @@ update_pages(znode_t *zp, int64_t start, int len, objset_t *os)
 
 			void *pb = kmap(pp);
 			int error = dmu_read(os, zp->z_id, start + off,
-			    nbytes, pb + off, DMU_READ_PREFETCH);
+			    nbytes, pb + off, flags);
 			kunmap(pp);
 
+			if (error == 0 && (flags & DMU_UNCACHEDIO))
+				arc_mapped_uncached(nbytes);
+
 			if (error) {
 				SetPageError(pp);
 				ClearPageUptodate(pp);
@@ -1726,6 +1742,225 @@ out:
 	return (error);
 }
 
+/*
+ * Number of directory entries ahead of the one being read whose dnodes
+ * ZFS_IOC_READDIRPLUS prefetches.
+ */
+static uint_t zfs_readdirplus_prefetch = 256;
+
+/*
+ * Look up the attributes ZFS_IOC_READDIRPLUS reports for an object, without
+ * instantiating an inode for it.  If the object has a znode, the lookup uses
+ * its SA handle, which serializes it against updates.  Otherwise a private
+ * handle is used, and the znode hold keeps a znode from being created and
+ * changing the object meanwhile.
+ */
+static int
+zfs_readdirplus_attrs(zfsvfs_t *zfsvfs, uint64_t obj, zfs_direntplus_t *de)
+{
+	dmu_object_info_t doi;
+	sa_bulk_attr_t bulk[8];
+	sa_handle_t *hdl;
+	dmu_buf_t *db;
+	int count = 0;
+	int error;
+
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_GEN(zfsvfs), NULL,
+	    &de->gen, sizeof (de->gen));
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_SIZE(zfsvfs), NULL,
+	    &de->size, sizeof (de->size));
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_MODE(zfsvfs), NULL,
+	    &de->mode, sizeof (de->mode));
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_LINKS(zfsvfs), NULL,
+	    &de->links, sizeof (de->links));
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_UID(zfsvfs), NULL,
+	    &de->uid, sizeof (de->uid));
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_GID(zfsvfs), NULL,
+	    &de->gid, sizeof (de->gid));
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_MTIME(zfsvfs), NULL,
+	    &de->mtime, sizeof (de->mtime));
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_CTIME(zfsvfs), NULL,
+	    &de->ctime, sizeof (de->ctime));
+
+	znode_hold_t *zh = zfs_znode_hold_enter(zfsvfs, obj);
+	error = sa_buf_hold(zfsvfs->z_os, obj, NULL, &db);
+	if (error != 0) {
+		zfs_znode_hold_exit(zfsvfs, zh);
+		return (error);
+	}
+
+	dmu_object_info_from_db(db, &doi);
+	if (doi.doi_bonus_type != DMU_OT_SA &&
+	    (doi.doi_bonus_type != DMU_OT_ZNODE ||
+	    doi.doi_bonus_size < sizeof (znode_phys_t))) {
+		sa_buf_rele(db, NULL);
+		error = SET_ERROR(EINVAL);
+	} else if ((hdl = dmu_buf_get_user(db)) != NULL) {
+		error = sa_bulk_lookup(hdl, bulk, count);
+		sa_buf_rele(db, NULL);
+	} else {
+		/* The private handle takes over the hold on db. */
+		error = sa_handle_get_from_db(zfsvfs->z_os, db, NULL,
+		    SA_HDL_PRIVATE, &hdl);
+		if (error == 0)
+			error = sa_bulk_lookup(hdl, bulk, count);
+		sa_handle_destroy(hdl);
+	}
+	zfs_znode_hold_exit(zfsvfs, zh);
+
+	if (error == 0) {
+		de->uid = from_kuid_munged(current_user_ns(),
+		    make_kuid(kcred->user_ns, (uid_t)de->uid));
+		de->gid = from_kgid_munged(current_user_ns(),
+		    make_kgid(kcred->user_ns, (gid_t)de->gid));
+	}
+	return (error);
+}
+
+/*
+ * Read directory entries along with their attributes for
+ * ZFS_IOC_READDIRPLUS, replacing a getdents() followed by a statx() of
+ * every entry.  The dnodes of the entries are prefetched in batches of
+ * zfs_readdirplus_prefetch ahead of the entries being read, and their
+ * attributes are read from the SA without instantiating inodes.
+ *
+ *	IN:	ip	- inode of directory to read.
+ *		buf	- buffer for the zfs_direntplus_t records.
+ *		bufsize	- size of buf.
+ *		cookiep	- position to start reading at, 0 for the start.
+ *		cr	- credentials of caller.
+ *
+ *	OUT:	cookiep	- position to continue reading at.
+ *		countp	- number of records in buf.
+ *		eofp	- set if the end of the directory was reached.
+ *
+ *	RETURN:	0 if success
+ *		EOVERFLOW if the next entry does not fit in an empty buffer
+ *		error code if failure
+ */
+int
+zfs_readdirplus(struct inode *ip, char *buf, uint32_t bufsize,
+    uint64_t *cookiep, uint32_t *countp, boolean_t *eofp, cred_t *cr)
+{
+	znode_t		*zp = ITOZ(ip);
+	zfsvfs_t	*zfsvfs = ITOZSB(ip);
+	objset_t	*os;
+	zap_cursor_t	zc, pzc;
+	zap_attribute_t	*zap, *pzap;
+	uint32_t	off = 0;
+	uint_t		batch = MAX(zfs_readdirplus_prefetch, 1);
+	uint_t		ahead = 0;
+	boolean_t	pf_done = B_FALSE;
+	int		error;
+
+	*countp = 0;
+	*eofp = B_FALSE;
+
+	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
+		return (error);
+
+	if (!S_ISDIR(ip->i_mode)) {
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(ENOTDIR));
+	}
+
+	/*
+	 * The attributes of the entries are only visible to callers who can
+	 * search the directory.
+	 */
+	if ((error = zfs_zaccess(zp, ACE_EXECUTE, 0, B_FALSE, cr)) != 0) {
+		zfs_exit(zfsvfs, FTAG);
+		return (error);
+	}
+
+	if (zp->z_unlinked) {
+		*eofp = B_TRUE;
+		zfs_exit(zfsvfs, FTAG);
+		return (0);
+	}
+
+	os = zfsvfs->z_os;
+	zap = zap_attribute_long_alloc();
+	pzap = zap_attribute_long_alloc();
+	zap_cursor_init_serialized(&zc, os, zp->z_id, *cookiep);
+	zap_cursor_init_serialized(&pzc, os, zp->z_id, *cookiep);
+
+	for (;;) {
+		/*
+		 * Keep the prefetch cursor between half a batch and a batch
+		 * of entries ahead of the one being read.
+		 */
+		if (!pf_done && ahead <= batch / 2) {
+			for (; ahead < batch; ahead++) {
+				if (zap_cursor_retrieve(&pzc, pzap) != 0) {
+					pf_done = B_TRUE;
+					break;
+				}
+				if (pzap->za_integer_length == 8 &&
+				    pzap->za_num_integers != 0) {
+					dmu_prefetch_dnode(os, ZFS_DIRENT_OBJ(
+					    pzap->za_first_integer),
+					    ZIO_PRIORITY_SYNC_READ);
+				}
+				zap_cursor_advance(&pzc);
+			}
+		}
+
+		if ((error = zap_cursor_retrieve(&zc, zap)) != 0) {
+			if (error == ENOENT) {
+				*eofp = B_TRUE;
+				error = 0;
+			}
+			break;
+		}
+
+		if (zap->za_integer_length != 8 || zap->za_num_integers == 0) {
+			error = SET_ERROR(ENXIO);
+			break;
+		}
+
+		size_t namelen = strlen(zap->za_name);
+		size_t reclen = ZFS_DIRENTPLUS_RECLEN(namelen);
+		if (off + reclen > bufsize) {
+			if (*countp == 0)
+				error = SET_ERROR(EOVERFLOW);
+			break;
+		}
+
+		zfs_direntplus_t *de = (zfs_direntplus_t *)(buf + off);
+		memset(de, 0, reclen);
+		de->ino = ZFS_DIRENT_OBJ(zap->za_first_integer);
+		de->reclen = reclen;
+		de->namelen = namelen;
+		memcpy(de->name, zap->za_name, namelen);
+		de->error = zfs_readdirplus_attrs(zfsvfs, de->ino, de);
+		if (de->error != 0) {
+			uint64_t ino = de->ino;
+			int32_t err = de->error;
+			memset(de, 0, offsetof(zfs_direntplus_t, reclen));
+			de->ino = ino;
+			de->error = err;
+		}
+
+		off += reclen;
+		(*countp)++;
+		if (ahead > 0)
+			ahead--;
+		zap_cursor_advance(&zc);
+	}
+
+	if (*countp > 0 || *eofp)
+		*cookiep = zap_cursor_serialize(&zc);
+
+	zap_cursor_fini(&pzc);
+	zap_cursor_fini(&zc);
+	zap_attribute_free(pzap);
+	zap_attribute_free(zap);
+
+	zfs_exit(zfsvfs, FTAG);
+	return (error);
+}
+
 /*
  * Get the basic file attributes and place them in the provided kstat
  * structure.  The inode is assumed to be the authoritative source
@@ -3957,11 +4192,13 @@ zfs_putpage(struct inode *ip, struct page *pp, struct writeback_control *wbc,
 		return (for_sync ? err : 0);
 	}
 
+	dmu_flags_t flags = zfs_mapped_dmu_flags();
 	va = kmap(pp);
 	ASSERT3U(pglen, <=, PAGE_SIZE);
-	dmu_write(zfsvfs->z_os, zp->z_id, pgoff, pglen, va, tx,
-	    DMU_READ_PREFETCH);
+	dmu_write(zfsvfs->z_os, zp->z_id, pgoff, pglen, va, tx, flags);
 	kunmap(pp);
+	if (flags & DMU_UNCACHEDIO)
+		arc_mapped_uncached(pglen);
 
 	/* Preserve the mtime and ctime provided by the inode */
 	tmp_ts = zpl_inode_get_mtime(ip);
@@ -4220,9 +4457,10 @@ zfs_fillpage(struct inode *ip, struct page *pp)
 	if (io_off + io_len > i_size)
 		io_len = i_size - io_off;
 
+	dmu_flags_t flags = zfs_mapped_dmu_flags();
 	void *va = kmap(pp);
 	int error = dmu_read(zfsvfs->z_os, zp->z_id, io_off,
-	    io_len, va, DMU_READ_PREFETCH);
+	    io_len, va, flags);
 	if (io_len != PAGE_SIZE)
 		memset((char *)va + io_len, 0, PAGE_SIZE - io_len);
 	kunmap(pp);
@@ -4237,6 +4475,8 @@ zfs_fillpage(struct inode *ip, struct page *pp)
 	} else {
 		ClearPageError(pp);
 		SetPageUptodate(pp);
+		if (flags & DMU_UNCACHEDIO)
+			arc_mapped_uncached(io_len);
 	}
 
 	return (error);
@@ -4360,6 +4600,148 @@ zfs_map(struct inode *ip, offset_t off, caddr_t *addrp, size_t len,
 	return (0);
 }
 
+#ifdef HAVE_SPLICE_ADD_TO_PIPE
+/*
+ * ARC pages lent to a pipe are only referenced, never stolen: the ARC does
+ * not modify them, and frees them once the last reference is dropped.
+ */
+static const struct pipe_buf_operations zfs_splice_buf_ops = {
+	.release = generic_pipe_buf_release,
+	.get = generic_pipe_buf_get,
+};
+
+typedef struct zfs_splice {
+	struct pipe_inode_info	*zs_pipe;
+	size_t			zs_bytes;
+} zfs_splice_t;
+
+static int
+zfs_splice_page(struct page *page, size_t off, size_t len, void *arg)
+{
+	zfs_splice_t *zs = arg;
+
+	while (len > 0) {
+		struct pipe_buffer buf = {
+			.page = nth_page(page, off >> PAGE_SHIFT),
+			.offset = off & (PAGE_SIZE - 1),
+			.ops = &zfs_splice_buf_ops,
+		};
+		buf.len = MIN(len, PAGE_SIZE - buf.offset);
+
+		/* add_to_pipe() drops the reference if the pipe is full. */
+		get_page(buf.page);
+		ssize_t ret = add_to_pipe(zs->zs_pipe, &buf);
+		if (ret < 0)
+			return (-ret);
+
+		zs->zs_bytes += buf.len;
+		off += buf.len;
+		len -= buf.len;
+	}
+
+	return (0);
+}
+
+static int
+zfs_splice_lend(abd_t *abd, size_t off, size_t size, void *arg)
+{
+	return (abd_iterate_page_func(abd, off, size, zfs_splice_page, arg));
+}
+
+/*
+ * Splice up to len bytes of a file at pos into a pipe by lending it the
+ * ARC's pages holding the data, rather than copying them.
+ *
+ *	IN:	zp	- znode of file to be read from.
+ *		pos	- file offset to start reading at.
+ *		pipe	- pipe to add the pages to, locked by the caller.
+ *		len	- maximum number of bytes to splice.
+ *		ioflag	- O_DIRECT flag.
+ *
+ *	OUT:	splicedp - number of bytes spliced.
+ *
+ *	RETURN:	0 on success (or at end of file), error code on failure.
+ *		ENOTSUP, having spliced nothing, if the data at pos can not
+ *		be lent, so the caller must fall back to copying it.
+ *
+ * Timestamps:
+ *	zp - atime updated on success
+ */
+int
+zfs_splice_read(znode_t *zp, loff_t pos, struct pipe_inode_info *pipe,
+    size_t len, int ioflag, size_t *splicedp)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	zfs_splice_t zs = { .zs_pipe = pipe };
+	dmu_buf_t **dbp;
+	uint64_t n;
+	int numbufs, error;
+
+	*splicedp = 0;
+	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
+		return (error);
+
+	/*
+	 * Leave Direct I/O, and anything needing more than a read of the
+	 * cached data, to the copying path.
+	 */
+	if ((zp->z_pflags & ZFS_AV_QUARANTINED) || (ioflag & O_DIRECT) ||
+	    zfsvfs->z_os->os_direct == ZFS_DIRECT_ALWAYS ||
+	    (zfsvfs->z_log && zfsvfs->z_os->os_sync == ZFS_SYNC_ALWAYS)) {
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(ENOTSUP));
+	}
+
+	zfs_locked_range_t *lr = zfs_rangelock_enter(&zp->z_rangelock,
+	    pos, len, RL_READER);
+	if (pos >= zp->z_size || len == 0)
+		goto out;
+
+	/*
+	 * Pages of a mapped file may be newer than the ARC.
+	 */
+	n = MIN(MIN(len, zp->z_size - pos), DMU_MAX_ACCESS >> 1);
+	if (zn_has_cached_data(zp, pos, pos + n - 1)) {
+		error = SET_ERROR(ENOTSUP);
+		goto out;
+	}
+
+	error = dmu_buf_hold_array_by_bonus(sa_get_db(zp->z_sa_hdl), pos, n,
+	    B_TRUE, FTAG, &numbufs, &dbp);
+	if (error == 0) {
+		for (int i = 0; i < numbufs && error == 0; i++) {
+			dmu_buf_t *db = dbp[i];
+			uint64_t bufoff = pos + zs.zs_bytes - db->db_offset;
+			uint64_t tolend = MIN(db->db_size - bufoff,
+			    n - zs.zs_bytes);
+
+			error = dmu_buf_lend(db, bufoff, tolend,
+			    zfs_splice_lend, &zs);
+		}
+		dmu_buf_rele_array(dbp, numbufs, FTAG);
+	}
+
+	/* A short splice is a success, the caller will come back for more. */
+	if (zs.zs_bytes > 0) {
+		error = 0;
+		*splicedp = zs.zs_bytes;
+		dataset_kstats_update_read_kstats(&zfsvfs->z_kstat,
+		    zs.zs_bytes);
+		dataset_kstats_update_nlent_kstat(&zfsvfs->z_kstat,
+		    zs.zs_bytes);
+	} else if (error == ECKSUM) {
+		error = SET_ERROR(EIO);
+	}
+out:
+	zfs_rangelock_exit(lr);
+	/* The copying path stamps it otherwise. */
+	if (error == 0)
+		ZFS_ACCESSTIME_STAMP(zfsvfs, zp);
+	zfs_exit(zfsvfs, FTAG);
+	return (error);
+}
+#endif /* HAVE_SPLICE_ADD_TO_PIPE */
+
 /*
  * Free or allocate space in a file.  Currently, this function only
  * supports the `F_FREESP' command.  However, this command is somewhat
@@ -4491,6 +4873,7 @@ EXPORT_SYMBOL(zfs_remove);
 EXPORT_SYMBOL(zfs_mkdir);
 EXPORT_SYMBOL(zfs_rmdir);
 EXPORT_SYMBOL(zfs_readdir);
+EXPORT_SYMBOL(zfs_readdirplus);
 EXPORT_SYMBOL(zfs_getattr_fast);
 EXPORT_SYMBOL(zfs_setattr);
 EXPORT_SYMBOL(zfs_rename);
@@ -4504,7 +4887,14 @@ EXPORT_SYMBOL(zfs_getpage);
 EXPORT_SYMBOL(zfs_putpage);
 EXPORT_SYMBOL(zfs_dirty_inode);
 EXPORT_SYMBOL(zfs_map);
+#ifdef HAVE_SPLICE_ADD_TO_PIPE
+EXPORT_SYMBOL(zfs_splice_read);
+#endif
 
 module_param(zfs_delete_blocks, ulong, 0644);
 MODULE_PARM_DESC(zfs_delete_blocks, "Delete files larger than N blocks async");
+
+module_param(zfs_readdirplus_prefetch, uint, 0644);
+MODULE_PARM_DESC(zfs_readdirplus_prefetch,
+	"Number of dnodes ZFS_IOC_READDIRPLUS prefetches ahead");
 #endif
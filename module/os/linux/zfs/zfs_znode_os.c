@@ -71,7 +71,8 @@ static int zfs_unlink_suspend_progress = 0;
  * This callback is invoked when acquiring a RL_WRITER or RL_APPEND lock on
  * z_rangelock. It will modify the offset and length of the lock to reflect
  * znode-specific information, and convert RL_APPEND to RL_WRITER.  This is
- * called with the rangelock_t's rl_lock held, which avoids races.
+ * called with the rangelock_t's rl_lock held, which avoids races, or once
+ * the range is locked again to check it, if the rangelock is sharded.
  */
 static void
 zfs_rangelock_cb(zfs_locked_range_t *new, void *arg)
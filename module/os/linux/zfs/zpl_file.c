@@ -43,6 +43,18 @@
  */
 static unsigned int zfs_fallocate_reserve_percent = 110;
 
+/*
+ * Complete AIO reads into kernel pages from the read's completion callback
+ * (see zpl_iter_read_async()).
+ */
+static unsigned int zfs_aio_read_async = 1;
+
+/*
+ * Splice reads by lending the ARC's pages to the pipe rather than copying
+ * them (see zfs_splice_read()).
+ */
+static unsigned int zfs_splice_read_zerocopy = 1;
+
 static int
 zpl_open(struct inode *ip, struct file *filp)
 {
@@ -54,6 +66,17 @@ zpl_open(struct inode *ip, struct file *filp)
 	if (error)
 		return (error);
 
+	/*
+	 * zfs_read() and zfs_write() honor IOCB_NOWAIT, which lets io_uring
+	 * and RWF_NOWAIT complete ARC hits inline rather than in a worker.
+	 */
+#if defined(FMODE_NOWAIT)
+	filp->f_mode |= FMODE_NOWAIT;
+#endif
+#if defined(FMODE_BUF_WASYNC)
+	filp->f_mode |= FMODE_BUF_WASYNC;
+#endif
+
 	crhold(cr);
 	cookie = spl_fstrans_mark();
 	error = -zfs_open(ip, filp->f_mode, filp->f_flags, cr);
@@ -177,6 +200,10 @@ zfs_io_flags(struct kiocb *kiocb)
 #if defined(IOCB_DIRECT)
 	if (kiocb->ki_flags & IOCB_DIRECT)
 		flags |= O_DIRECT;
+#endif
+#if defined(IOCB_NOWAIT)
+	if (kiocb->ki_flags & IOCB_NOWAIT)
+		flags |= ZFS_IO_NOWAIT;
 #endif
 	return (flags);
 }
@@ -201,6 +228,88 @@ zpl_file_accessed(struct file *filp)
 	}
 }
 
+/*
+ * State of an AIO read, from zpl_iter_read_async() to zpl_aio_read_done().
+ */
+typedef struct zpl_aio_read {
+	struct kiocb	*zar_kiocb;
+	struct iov_iter	zar_iter;
+	zfs_uio_t	zar_uio;
+	ssize_t		zar_count;
+} zpl_aio_read_t;
+
+static void
+zpl_aio_read_done(void *arg, int error)
+{
+	zpl_aio_read_t *zar = arg;
+	struct kiocb *kiocb = zar->zar_kiocb;
+	ssize_t ret;
+
+	if (error != 0) {
+		ret = -error;
+	} else {
+		ret = zar->zar_count - zar->zar_uio.uio_resid;
+		kiocb->ki_pos += ret;
+	}
+	kmem_free(zar, sizeof (*zar));
+
+#ifdef HAVE_KIOCB_KI_COMPLETE_2ARGS
+	kiocb->ki_complete(kiocb, ret);
+#else
+	kiocb->ki_complete(kiocb, ret, 0);
+#endif
+}
+
+/*
+ * Read into kernel pages, like those of a loop device request or of an
+ * io_uring registered buffer, without tying up the submitting thread while
+ * the data is read from disk.  The iterator is copied, as the caller's may
+ * not outlive this call, but the pages it points to do.  Returns
+ * -EOPNOTSUPP for reads which must go through zpl_iter_read() instead,
+ * with *accessed set if the access time was already updated.
+ */
+static ssize_t
+zpl_iter_read_async(struct kiocb *kiocb, struct iov_iter *to,
+    boolean_t *accessed)
+{
+	cred_t *cr = CRED();
+	fstrans_cookie_t cookie;
+	struct file *filp = kiocb->ki_filp;
+	zpl_aio_read_t *zar;
+	int error;
+
+	if (is_sync_kiocb(kiocb) || zfs_uio_iov_iter_type(to) != ITER_BVEC ||
+	    kiocb->ki_complete == NULL)
+		return (-EOPNOTSUPP);
+
+	zar = kmem_alloc(sizeof (*zar), KM_SLEEP);
+	zar->zar_kiocb = kiocb;
+	zar->zar_iter = *to;
+	zar->zar_count = iov_iter_count(to);
+	zfs_uio_iov_iter_init(&zar->zar_uio, &zar->zar_iter, kiocb->ki_pos,
+	    zar->zar_count);
+
+	/* The file may be released as soon as the read completes. */
+	zpl_file_accessed(filp);
+	*accessed = B_TRUE;
+
+	crhold(cr);
+	cookie = spl_fstrans_mark();
+
+	error = zfs_read_async(ITOZ(filp->f_mapping->host), &zar->zar_uio,
+	    filp->f_flags | zfs_io_flags(kiocb), cr, zpl_aio_read_done, zar);
+
+	spl_fstrans_unmark(cookie);
+	crfree(cr);
+
+	if (error != 0) {
+		kmem_free(zar, sizeof (*zar));
+		return (-error);
+	}
+
+	return (-EIOCBQUEUED);
+}
+
 static ssize_t
 zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 {
@@ -209,6 +318,13 @@ zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 	struct file *filp = kiocb->ki_filp;
 	ssize_t count = iov_iter_count(to);
 	zfs_uio_t uio;
+	boolean_t accessed = B_FALSE;
+
+	if (zfs_aio_read_async) {
+		ssize_t ret = zpl_iter_read_async(kiocb, to, &accessed);
+		if (ret != -EOPNOTSUPP)
+			return (ret);
+	}
 
 	zfs_uio_iov_iter_init(&uio, to, kiocb->ki_pos, count);
 
@@ -227,11 +343,41 @@ zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 	ssize_t read = count - uio.uio_resid;
 	kiocb->ki_pos += read;
 
-	zpl_file_accessed(filp);
+	if (!accessed)
+		zpl_file_accessed(filp);
 
 	return (read);
 }
 
+#ifdef HAVE_SPLICE_ADD_TO_PIPE
+static ssize_t
+zpl_splice_read(struct file *filp, loff_t *ppos, struct pipe_inode_info *pipe,
+    size_t len, unsigned int flags)
+{
+	if (zfs_splice_read_zerocopy) {
+		fstrans_cookie_t cookie = spl_fstrans_mark();
+		size_t spliced = 0;
+		int error = zfs_splice_read(ITOZ(filp->f_mapping->host),
+		    *ppos, pipe, len, filp->f_flags, &spliced);
+		spl_fstrans_unmark(cookie);
+
+		if (error == 0) {
+			*ppos += spliced;
+			zpl_file_accessed(filp);
+			return (spliced);
+		}
+		if (error != ENOTSUP)
+			return (-error);
+	}
+
+#ifdef HAVE_COPY_SPLICE_READ
+	return (copy_splice_read(filp, ppos, pipe, len, flags));
+#else
+	return (generic_file_splice_read(filp, ppos, pipe, len, flags));
+#endif
+}
+#endif /* HAVE_SPLICE_ADD_TO_PIPE */
+
 static inline ssize_t
 zpl_generic_write_checks(struct kiocb *kiocb, struct iov_iter *from,
     size_t *countp)
@@ -1173,6 +1319,53 @@ zpl_ioctl_rewrite(struct file *filp, void __user *arg)
 	return (err);
 }
 
+/*
+ * ZFS_IOC_READDIRPLUS: read directory entries with their attributes.  The
+ * records are built in a kernel buffer of at most
+ * ZFS_READDIRPLUS_BUFSIZE_MAX bytes and copied out once.
+ */
+static int
+zpl_ioctl_readdirplus(struct file *filp, void __user *arg)
+{
+	struct inode *ip = file_inode(filp);
+	zfs_readdirplus_args_t args;
+	fstrans_cookie_t cookie;
+	boolean_t eof;
+	cred_t *cr = CRED();
+	char *buf;
+	int err;
+
+	if (copy_from_user(&args, arg, sizeof (args)))
+		return (-EFAULT);
+	if (args.flags != 0 || args.pad != 0 || args.bufsize == 0)
+		return (-EINVAL);
+
+	args.bufsize = MIN(args.bufsize, ZFS_READDIRPLUS_BUFSIZE_MAX);
+	buf = vmem_alloc(args.bufsize, KM_SLEEP);
+
+	crhold(cr);
+	cookie = spl_fstrans_mark();
+	err = -zfs_readdirplus(ip, buf, args.bufsize, &args.cookie,
+	    &args.count, &eof, cr);
+	spl_fstrans_unmark(cookie);
+	crfree(cr);
+
+	if (err == 0) {
+		uint32_t size = 0;
+		for (uint32_t i = 0; i < args.count; i++)
+			size += ((zfs_direntplus_t *)(buf + size))->reclen;
+
+		if (eof)
+			args.flags |= ZFS_READDIRPLUS_EOF;
+		if (copy_to_user((void __user *)(uintptr_t)args.buf, buf,
+		    size) || copy_to_user(arg, &args, sizeof (args)))
+			err = -EFAULT;
+	}
+	vmem_free(buf, args.bufsize);
+
+	return (err);
+}
+
 static long
 zpl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
@@ -1193,6 +1386,10 @@ zpl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		return (zpl_ioctl_setdosflags(filp, (void *)arg));
 	case ZFS_IOC_REWRITE:
 		return (zpl_ioctl_rewrite(filp, (void *)arg));
+	case ZFS_IOC_CLONE_RANGES:
+		return (zpl_ioctl_clone_ranges(filp, (void *)arg));
+	case ZFS_IOC_READDIRPLUS:
+		return (zpl_ioctl_readdirplus(filp, (void *)arg));
 	default:
 		return (-ENOTTY);
 	}
@@ -1254,7 +1451,12 @@ const struct file_operations zpl_file_operations = {
 	.llseek		= zpl_llseek,
 	.read_iter	= zpl_iter_read,
 	.write_iter	= zpl_iter_write,
-#ifdef HAVE_COPY_SPLICE_READ
+#if defined(FOP_BUFFER_WASYNC)
+	.fop_flags	= FOP_BUFFER_WASYNC,
+#endif
+#if defined(HAVE_SPLICE_ADD_TO_PIPE)
+	.splice_read	= zpl_splice_read,
+#elif defined(HAVE_COPY_SPLICE_READ)
 	.splice_read	= copy_splice_read,
 #else
 	.splice_read	= generic_file_splice_read,
@@ -1296,3 +1498,11 @@ const struct file_operations zpl_dir_file_operations = {
 module_param(zfs_fallocate_reserve_percent, uint, 0644);
 MODULE_PARM_DESC(zfs_fallocate_reserve_percent,
 	"Percentage of length to use for the available capacity check");
+
+module_param(zfs_aio_read_async, uint, 0644);
+MODULE_PARM_DESC(zfs_aio_read_async,
+	"Complete AIO reads into kernel pages asynchronously");
+
+module_param(zfs_splice_read_zerocopy, uint, 0644);
+MODULE_PARM_DESC(zfs_splice_read_zerocopy,
+	"Splice reads by lending ARC pages to the pipe");
@@ -25,6 +25,12 @@
 #include <sys/zfs_vnops.h>
 #include <sys/zfeature.h>
 
+/*
+ * While ZFS_IOC_CLONE_RANGES passes an entry through the VFS, points to the
+ * zfs_clone_range_t the clone should be queued in, instead of being done.
+ */
+static uint_t zpl_clone_ranges_key;
+
 /*
  * Take the source and destination inode locks for a remap (clone or dedupe).
  *
@@ -85,6 +91,17 @@ zpl_clone_file_range_impl(struct file *src_file, loff_t src_off,
 	    dmu_objset_spa(ITOZSB(dst_i)->z_os), SPA_FEATURE_BLOCK_CLONING))
 		return (-EOPNOTSUPP);
 
+	zfs_clone_range_t *zcr = tsd_get(zpl_clone_ranges_key);
+	if (zcr != NULL) {
+		zcr->zcr_inzp = ITOZ(src_i);
+		zcr->zcr_outzp = ITOZ(dst_i);
+		zcr->zcr_inoff = src_off_o;
+		zcr->zcr_outoff = dst_off_o;
+		zcr->zcr_len = len_o;
+		/* Past the source EOF, len is what is left of a negative. */
+		return ((ssize_t)MIN(len_o, INT64_MAX));
+	}
+
 	zpl_remap_lock_two(src_i, dst_i);
 
 	crhold(cr);
@@ -104,6 +121,174 @@ zpl_clone_file_range_impl(struct file *src_file, loff_t src_off,
 	return ((ssize_t)len_o);
 }
 
+/*
+ * Pass one ZFS_IOC_CLONE_RANGES entry through vfs_clone_file_range(), as
+ * FICLONERANGE does, so that the usual checks and LSM hooks apply, and queue
+ * it in zcr rather than clone it there.  The VFS reports the fsnotify events
+ * then, before the data is cloned, but within the same ioctl.
+ */
+static int
+zpl_clone_ranges_queue(zfs_clone_range_entry_t *ent, struct file *src_file,
+    struct file *dst_file, zfs_clone_range_t *zcr)
+{
+	struct inode *src_i = file_inode(src_file);
+	struct inode *dst_i = file_inode(dst_file);
+	loff_t ret;
+
+	if (src_file->f_op != &zpl_file_operations ||
+	    dst_file->f_op != &zpl_file_operations)
+		return (EXDEV);
+	if ((loff_t)ent->src_off < 0 || (loff_t)ent->dst_off < 0 ||
+	    (loff_t)ent->len < 0)
+		return (EINVAL);
+
+	/*
+	 * ->remap_file_range() implementations are left to check these
+	 * through generic_remap_file_range_prep(), which ZFS doesn't use.
+	 */
+	if (IS_IMMUTABLE(dst_i) || IS_APPEND(dst_i))
+		return (EPERM);
+	if (IS_SWAPFILE(src_i) || IS_SWAPFILE(dst_i))
+		return (ETXTBSY);
+
+	tsd_set(zpl_clone_ranges_key, zcr);
+#ifdef HAVE_VFS_REMAP_FILE_RANGE
+	ret = vfs_clone_file_range(src_file, ent->src_off, dst_file,
+	    ent->dst_off, ent->len, REMAP_FILE_CAN_SHORTEN);
+#else
+	ret = vfs_clone_file_range(src_file, ent->src_off, dst_file,
+	    ent->dst_off, ent->len);
+#endif
+	tsd_set(zpl_clone_ranges_key, NULL);
+
+	if (ret < 0)
+		return (-ret);
+	ASSERT3P(zcr->zcr_inzp, !=, NULL);
+
+	return (0);
+}
+
+/*
+ * ZFS_IOC_CLONE_RANGES: clone a batch of ranges, possibly between many
+ * different files, in one call.  Entries are independent: each gets its own
+ * error and the number of bytes cloned, and a failing entry does not stop the
+ * batch.  The ioctl itself only fails if the arguments cannot be read or
+ * written back.
+ *
+ * Each entry is first checked by the VFS as for FICLONERANGE, and the entries
+ * that pass are then cloned together by zfs_clone_ranges(), which shares
+ * transactions and ZIL commits between them.
+ */
+long
+zpl_ioctl_clone_ranges(struct file *filp, void __user *arg)
+{
+	zfs_clone_ranges_args_t args;
+	zfs_clone_range_entry_t *ents;
+	zfs_clone_range_t *zcrs;
+	struct file **files;
+	uint32_t *queued;
+	uint32_t nqueued = 0;
+	fstrans_cookie_t cookie;
+	cred_t *cr = CRED();
+	size_t size;
+	long err = 0;
+
+	(void) filp;
+
+	if (copy_from_user(&args, arg, sizeof (args)))
+		return (-EFAULT);
+	if (args.flags != 0 || args.count > ZFS_CLONE_RANGES_MAX)
+		return (-EINVAL);
+	if (args.count == 0)
+		return (0);
+	if (!zfs_bclone_enabled)
+		return (-EOPNOTSUPP);
+
+	size = args.count * sizeof (zfs_clone_range_entry_t);
+	ents = vmem_alloc(size, KM_SLEEP);
+	if (copy_from_user(ents, (void __user *)(uintptr_t)args.entries,
+	    size)) {
+		vmem_free(ents, size);
+		return (-EFAULT);
+	}
+
+	zcrs = vmem_zalloc(args.count * sizeof (zfs_clone_range_t), KM_SLEEP);
+	files = vmem_zalloc(2 * args.count * sizeof (struct file *), KM_SLEEP);
+	queued = vmem_alloc(args.count * sizeof (uint32_t), KM_SLEEP);
+
+	/*
+	 * The files stay held until the clones are done, which keeps their
+	 * znodes alive.
+	 */
+	for (uint32_t i = 0; i < args.count; i++) {
+		zfs_clone_range_entry_t *ent = &ents[i];
+		struct file *src_file = fget(ent->src_fd);
+		struct file *dst_file = fget(ent->dst_fd);
+
+		files[2 * i] = src_file;
+		files[2 * i + 1] = dst_file;
+		if (src_file == NULL || dst_file == NULL) {
+			ent->error = EBADF;
+		} else {
+			ent->error = zpl_clone_ranges_queue(ent, src_file,
+			    dst_file, &zcrs[nqueued]);
+		}
+
+		/* Keep the length queued, with a zero len resolved. */
+		if (ent->error == 0) {
+			ent->len = zcrs[nqueued].zcr_len;
+			queued[nqueued++] = i;
+		} else {
+			ent->len = 0;
+		}
+	}
+
+	crhold(cr);
+	cookie = spl_fstrans_mark();
+	zfs_clone_ranges(zcrs, nqueued, cr);
+	spl_fstrans_unmark(cookie);
+	crfree(cr);
+
+	for (uint32_t i = 0; i < nqueued; i++) {
+		zfs_clone_range_entry_t *ent = &ents[queued[i]];
+		zfs_clone_range_t *zcr = &zcrs[i];
+
+		ent->error = zcr->zcr_error;
+#ifndef HAVE_VFS_REMAP_FILE_RANGE
+		/* Before Linux 4.20, the whole range must be cloned. */
+		if (ent->error == 0 && zcr->zcr_len != ent->len)
+			ent->error = EINVAL;
+#endif
+		ent->len = ent->error == 0 ? zcr->zcr_len : 0;
+	}
+
+	for (uint32_t i = 0; i < 2 * args.count; i++) {
+		if (files[i] != NULL)
+			fput(files[i]);
+	}
+	vmem_free(queued, args.count * sizeof (uint32_t));
+	vmem_free(files, 2 * args.count * sizeof (struct file *));
+	vmem_free(zcrs, args.count * sizeof (zfs_clone_range_t));
+
+	if (copy_to_user((void __user *)(uintptr_t)args.entries, ents, size))
+		err = -EFAULT;
+	vmem_free(ents, size);
+
+	return (err);
+}
+
+void
+zpl_clone_ranges_init(void)
+{
+	tsd_create(&zpl_clone_ranges_key, NULL);
+}
+
+void
+zpl_clone_ranges_fini(void)
+{
+	tsd_destroy(&zpl_clone_ranges_key);
+}
+
 #if defined(HAVE_VFS_REMAP_FILE_RANGE) || \
 	defined(HAVE_VFS_DEDUPE_FILE_RANGE)
 /*
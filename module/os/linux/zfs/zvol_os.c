@@ -63,6 +63,12 @@ static boolean_t zvol_use_blk_mq = B_FALSE;
  */
 static unsigned int zvol_blk_mq_blocks_per_thread = 8;
 
+/*
+ * Issue zvol reads with dmu_read_uio_dnode_async() and complete them from
+ * the zio completion callback, rather than wait for them in a zvol thread.
+ */
+static unsigned int zvol_read_async = 1;
+
 #ifndef	BLKDEV_DEFAULT_RQ
 /* BLKDEV_MAX_RQ was renamed to BLKDEV_DEFAULT_RQ in the 5.16 kernel */
 #define	BLKDEV_DEFAULT_RQ BLKDEV_MAX_RQ
@@ -377,74 +383,116 @@ zvol_discard_task(void *arg)
 	zv_request_task_free(task);
 }
 
+/*
+ * State of a read, which outlives zvol_read() when it is asynchronous.
+ */
+typedef struct zvol_read_state {
+	zv_request_t		zrs_zvr;
+	zfs_uio_t		zrs_uio;
+	zfs_locked_range_t	*zrs_lr;
+	ssize_t			zrs_start_resid;
+	unsigned long		zrs_start_time;
+	boolean_t		zrs_acct;
+} zvol_read_state_t;
+
+static void
+zvol_read_done(void *arg, int error)
+{
+	zvol_read_state_t *zrs = arg;
+	zvol_state_t *zv = zrs->zrs_zvr.zv;
+	struct bio *bio = zrs->zrs_zvr.bio;
+	struct request *rq = zrs->zrs_zvr.rq;
+
+	/* convert checksum errors into IO errors */
+	if (error == ECKSUM)
+		error = SET_ERROR(EIO);
+
+	zfs_rangelock_exit(zrs->zrs_lr);
+
+	int64_t nread = zrs->zrs_start_resid - zrs->zrs_uio.uio_resid;
+	dataset_kstats_update_read_kstats(&zv->zv_kstat, nread);
+
+	rw_exit(&zv->zv_suspend_lock);
+
+	if (bio && zrs->zrs_acct) {
+		blk_generic_end_io_acct(zv->zv_zso->zvo_queue,
+		    zv->zv_zso->zvo_disk, READ, bio, zrs->zrs_start_time);
+	}
+
+	kmem_free(zrs, sizeof (*zrs));
+	zvol_end_io(bio, rq, error);
+}
+
 static void
 zvol_read(zv_request_t *zvr)
 {
 	struct bio *bio = zvr->bio;
 	struct request *rq = zvr->rq;
 	int error = 0;
-	zfs_uio_t uio;
-	boolean_t acct = B_FALSE;
 	zvol_state_t *zv = zvr->zv;
 	struct request_queue *q;
 	struct gendisk *disk;
-	unsigned long start_time = 0;
 
 	ASSERT3P(zv, !=, NULL);
 	ASSERT3U(zv->zv_open_count, >, 0);
 
-	zfs_uio_bvec_init(&uio, bio, rq);
+	zvol_read_state_t *zrs = kmem_zalloc(sizeof (*zrs), KM_SLEEP);
+	zrs->zrs_zvr = *zvr;
+	zfs_uio_t *uio = &zrs->zrs_uio;
+	zfs_uio_bvec_init(uio, bio, rq);
 
 	q = zv->zv_zso->zvo_queue;
 	disk = zv->zv_zso->zvo_disk;
 
-	ssize_t start_resid = uio.uio_resid;
+	zrs->zrs_start_resid = uio->uio_resid;
 
 	/*
 	 * When blk-mq is being used, accounting is done by
 	 * blk_mq_start_request() and blk_mq_end_request().
 	 */
 	if (bio) {
-		acct = blk_queue_io_stat(q);
-		if (acct)
-			start_time = blk_generic_start_io_acct(q, disk, READ,
-			    bio);
+		zrs->zrs_acct = blk_queue_io_stat(q);
+		if (zrs->zrs_acct)
+			zrs->zrs_start_time = blk_generic_start_io_acct(q,
+			    disk, READ, bio);
 	}
 
-	zfs_locked_range_t *lr = zfs_rangelock_enter(&zv->zv_rangelock,
-	    uio.uio_loffset, uio.uio_resid, RL_READER);
+	zrs->zrs_lr = zfs_rangelock_enter(&zv->zv_rangelock,
+	    uio->uio_loffset, uio->uio_resid, RL_READER);
 
 	uint64_t volsize = zv->zv_volsize;
 
-	while (uio.uio_resid > 0 && uio.uio_loffset < volsize) {
-		uint64_t bytes = MIN(uio.uio_resid, DMU_MAX_ACCESS >> 1);
+	/*
+	 * Requests which fit in a single DMU read are issued asynchronously
+	 * and completed from zvol_read_done(), so that this thread does not
+	 * wait for the data and can go on to issue more requests.
+	 */
+	if (zvol_read_async && uio->uio_resid <= DMU_MAX_ACCESS >> 1 &&
+	    uio->uio_loffset < volsize) {
+		uint64_t bytes = MIN(uio->uio_resid,
+		    volsize - uio->uio_loffset);
+
+		task_io_account_read(bytes);
+		dmu_read_uio_dnode_async(zv->zv_dn, uio, bytes,
+		    DMU_READ_PREFETCH, zvol_read_done, zrs);
+		return;
+	}
+
+	while (uio->uio_resid > 0 && uio->uio_loffset < volsize) {
+		uint64_t bytes = MIN(uio->uio_resid, DMU_MAX_ACCESS >> 1);
 
 		/* don't read past the end */
-		if (bytes > volsize - uio.uio_loffset)
-			bytes = volsize - uio.uio_loffset;
+		if (bytes > volsize - uio->uio_loffset)
+			bytes = volsize - uio->uio_loffset;
 
-		error = dmu_read_uio_dnode(zv->zv_dn, &uio, bytes,
+		error = dmu_read_uio_dnode(zv->zv_dn, uio, bytes,
 		    DMU_READ_PREFETCH);
-		if (error) {
-			/* convert checksum errors into IO errors */
-			if (error == ECKSUM)
-				error = SET_ERROR(EIO);
+		if (error)
 			break;
-		}
-	}
-	zfs_rangelock_exit(lr);
-
-	int64_t nread = start_resid - uio.uio_resid;
-	dataset_kstats_update_read_kstats(&zv->zv_kstat, nread);
-	task_io_account_read(nread);
-
-	rw_exit(&zv->zv_suspend_lock);
-
-	if (bio && acct) {
-		blk_generic_end_io_acct(q, disk, READ, bio, start_time);
 	}
+	task_io_account_read(zrs->zrs_start_resid - uio->uio_resid);
 
-	zvol_end_io(bio, rq, error);
+	zvol_read_done(zrs, error);
 }
 
 static void
@@ -617,7 +665,8 @@ zvol_request_impl(zvol_state_t *zv, struct bio *bio, struct request *rq,
 		 * of one i/o at a time per zvol.  However, an even better
 		 * design would be for zvol_request() to initiate the zio
 		 * directly, and then be notified by the zio_done callback,
-		 * which would call END_IO().  Unfortunately, the DMU/ZIL
+		 * which would call END_IO().  Reads do so when
+		 * zvol_read_async is set, but the DMU write and ZIL
 		 * interfaces lack this functionality (they block waiting for
 		 * the i/o to complete).
 		 */
@@ -1887,6 +1936,9 @@ module_param(zvol_blk_mq_blocks_per_thread, uint, 0644);
 MODULE_PARM_DESC(zvol_blk_mq_blocks_per_thread,
 	"Process volblocksize blocks per thread");
 
+module_param(zvol_read_async, uint, 0644);
+MODULE_PARM_DESC(zvol_read_async, "Complete zvol reads asynchronously");
+
 #ifndef HAVE_BLKDEV_GET_ERESTARTSYS
 module_param(zvol_open_timeout_ms, uint, 0644);
 MODULE_PARM_DESC(zvol_open_timeout_ms, "Timeout for ZVOL open retries");
@@ -642,6 +642,8 @@ arc_stats_t arc_stats = {
 	{ "arc_raw_size",		KSTAT_DATA_UINT64 },
 	{ "cached_only_in_progress",	KSTAT_DATA_UINT64 },
 	{ "abd_chunk_waste_size",	KSTAT_DATA_UINT64 },
+	{ "mapped_uncached_ios",	KSTAT_DATA_UINT64 },
+	{ "mapped_uncached_bytes",	KSTAT_DATA_UINT64 },
 };
 
 arc_sums_t arc_sums;
@@ -1407,6 +1409,28 @@ arc_get_complevel(arc_buf_t *buf)
 	return (buf->b_hdr->b_complevel);
 }
 
+/*
+ * Return the ARC's own copy of the data of buf, if it is held uncompressed,
+ * decrypted and in host byte order, so it is identical to buf's contents
+ * for as long as buf is not released.  The ARC never modifies this data once
+ * the header is filled, so a consumer may take references on its pages and
+ * lend them out rather than copy them.  Returns NULL otherwise.
+ */
+abd_t *
+arc_buf_hdr_abd(arc_buf_t *buf)
+{
+	arc_buf_hdr_t *hdr = buf->b_hdr;
+
+	if (!HDR_HAS_L1HDR(hdr) || hdr->b_l1hdr.b_state == arc_anon ||
+	    HDR_IO_IN_PROGRESS(hdr) || ARC_BUF_COMPRESSED(buf) ||
+	    ARC_BUF_ENCRYPTED(buf) ||
+	    arc_hdr_get_compress(hdr) != ZIO_COMPRESS_OFF ||
+	    hdr->b_l1hdr.b_byteswap != DMU_BSWAP_NUMFUNCS)
+		return (NULL);
+
+	return (hdr->b_l1hdr.b_pabd);
+}
+
 __maybe_unused
 static inline boolean_t
 arc_buf_is_shared(arc_buf_t *buf)
@@ -7558,6 +7582,10 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_cached_only_in_progress);
 	as->arcstat_abd_chunk_waste_size.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_abd_chunk_waste_size);
+	as->arcstat_mapped_uncached_ios.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_mapped_uncached_ios);
+	as->arcstat_mapped_uncached_bytes.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_mapped_uncached_bytes);
 
 	return (0);
 }
@@ -7866,6 +7894,8 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_raw_size, 0);
 	wmsum_init(&arc_sums.arcstat_cached_only_in_progress, 0);
 	wmsum_init(&arc_sums.arcstat_abd_chunk_waste_size, 0);
+	wmsum_init(&arc_sums.arcstat_mapped_uncached_ios, 0);
+	wmsum_init(&arc_sums.arcstat_mapped_uncached_bytes, 0);
 
 	arc_anon->arcs_state = ARC_STATE_ANON;
 	arc_mru->arcs_state = ARC_STATE_MRU;
@@ -8025,6 +8055,19 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_raw_size);
 	wmsum_fini(&arc_sums.arcstat_cached_only_in_progress);
 	wmsum_fini(&arc_sums.arcstat_abd_chunk_waste_size);
+	wmsum_fini(&arc_sums.arcstat_mapped_uncached_ios);
+	wmsum_fini(&arc_sums.arcstat_mapped_uncached_bytes);
+}
+
+/*
+ * Account for a page cache fill or writeback of a memory mapped file done
+ * without keeping the data in the ARC (see zfs_mmap_uncached).
+ */
+void
+arc_mapped_uncached(uint64_t size)
+{
+	ARCSTAT_BUMP(arcstat_mapped_uncached_ios);
+	ARCSTAT_INCR(arcstat_mapped_uncached_bytes, size);
 }
 
 uint64_t
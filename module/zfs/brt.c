@@ -269,6 +269,8 @@ typedef struct brt_stats {
 	kstat_named_t brt_decref_free_data_later;
 	kstat_named_t brt_decref_free_data_now;
 	kstat_named_t brt_decref_no_entry;
+	kstat_named_t brt_entcount_blocks;
+	kstat_named_t brt_entcount_bytes;
 } brt_stats_t;
 
 static brt_stats_t brt_stats = {
@@ -281,7 +283,9 @@ static brt_stats_t brt_stats = {
 	{ "decref_entry_still_referenced",	KSTAT_DATA_UINT64 },
 	{ "decref_free_data_later",		KSTAT_DATA_UINT64 },
 	{ "decref_free_data_now",		KSTAT_DATA_UINT64 },
-	{ "decref_no_entry",			KSTAT_DATA_UINT64 }
+	{ "decref_no_entry",			KSTAT_DATA_UINT64 },
+	{ "entcount_blocks",			KSTAT_DATA_UINT64 },
+	{ "entcount_bytes",			KSTAT_DATA_UINT64 }
 };
 
 struct {
@@ -295,9 +299,12 @@ struct {
 	wmsum_t brt_decref_free_data_later;
 	wmsum_t brt_decref_free_data_now;
 	wmsum_t brt_decref_no_entry;
+	wmsum_t brt_entcount_blocks;
+	wmsum_t brt_entcount_bytes;
 } brt_sums;
 
 #define	BRTSTAT_BUMP(stat)	wmsum_add(&brt_sums.stat, 1)
+#define	BRTSTAT_INCR(stat, val)	wmsum_add(&brt_sums.stat, (val))
 
 static int brt_entry_compare(const void *x1, const void *x2);
 static void brt_vdevs_expand(spa_t *spa, uint64_t nvdevs);
@@ -323,26 +330,63 @@ brt_unlock(spa_t *spa)
 static uint16_t
 brt_vdev_entcount_get(const brt_vdev_t *brtvd, uint64_t idx)
 {
+	const uint16_t *entcount;
 
 	ASSERT3U(idx, <, brtvd->bv_size);
 
+	entcount = brtvd->bv_entcount[idx / BRT_BLOCK_NENTCOUNT];
+	if (entcount == NULL)
+		return (0);
+	idx %= BRT_BLOCK_NENTCOUNT;
+
 	if (unlikely(brtvd->bv_need_byteswap)) {
-		return (BSWAP_16(brtvd->bv_entcount[idx]));
+		return (BSWAP_16(entcount[idx]));
 	} else {
-		return (brtvd->bv_entcount[idx]);
+		return (entcount[idx]);
 	}
 }
 
+/*
+ * Publish a zeroed block of entcounts.  It is done only from syncing
+ * context, but brt_maybe_exists() may look at the block without locks.
+ */
+static uint16_t *
+brt_vdev_entcount_block_alloc(brt_vdev_t *brtvd, uint64_t blk)
+{
+	uint16_t *entcount;
+
+	ASSERT0P(brtvd->bv_entcount[blk]);
+
+	entcount = kmem_zalloc(BRT_BLOCKSIZE, KM_SLEEP);
+	membar_producer();
+	brtvd->bv_entcount[blk] = entcount;
+	brtvd->bv_entcount_nblocks++;
+	BRTSTAT_BUMP(brt_entcount_blocks);
+	BRTSTAT_INCR(brt_entcount_bytes, BRT_BLOCKSIZE);
+
+	return (entcount);
+}
+
 static void
 brt_vdev_entcount_set(brt_vdev_t *brtvd, uint64_t idx, uint16_t entcnt)
 {
+	uint16_t *entcount;
 
 	ASSERT3U(idx, <, brtvd->bv_size);
 
+	entcount = brtvd->bv_entcount[idx / BRT_BLOCK_NENTCOUNT];
+	if (entcount == NULL) {
+		if (entcnt == 0)
+			return;
+		entcount = brt_vdev_entcount_block_alloc(brtvd,
+		    idx / BRT_BLOCK_NENTCOUNT);
+	}
+	idx %= BRT_BLOCK_NENTCOUNT;
+
 	if (unlikely(brtvd->bv_need_byteswap)) {
-		brtvd->bv_entcount[idx] = BSWAP_16(entcnt);
+		entcount[idx] = BSWAP_16(entcnt);
 	} else {
-		brtvd->bv_entcount[idx] = entcnt;
+		entcount[idx] = entcnt;
 	}
 }
 
@@ -380,16 +424,25 @@ brt_vdev_dump(brt_vdev_t *brtvd)
 
 	uint64_t nblocks = BRT_RANGESIZE_TO_NBLOCKS(brtvd->bv_size);
 	zfs_dbgmsg("  BRT vdevid=%llu meta_dirty=%d entcount_dirty=%d "
-	    "size=%llu totalcount=%llu nblocks=%llu bitmapsize=%zu",
+	    "size=%llu totalcount=%llu nblocks=%llu allocated=%llu "
+	    "bitmapsize=%zu",
 	    (u_longlong_t)brtvd->bv_vdevid,
 	    brtvd->bv_meta_dirty, brtvd->bv_entcount_dirty,
 	    (u_longlong_t)brtvd->bv_size,
 	    (u_longlong_t)brtvd->bv_totalcount,
 	    (u_longlong_t)nblocks,
+	    (u_longlong_t)brtvd->bv_entcount_nblocks,
 	    (size_t)BT_SIZEOFMAP(nblocks));
 	if (brtvd->bv_totalcount > 0) {
 		zfs_dbgmsg("    entcounts:");
 		for (idx = 0; idx < brtvd->bv_size; idx++) {
+			/* Skip blocks which were never allocated. */
+			if (idx % BRT_BLOCK_NENTCOUNT == 0 &&
+			    brtvd->bv_entcount[idx / BRT_BLOCK_NENTCOUNT] ==
+			    NULL) {
+				idx += BRT_BLOCK_NENTCOUNT - 1;
+				continue;
+			}
 			uint16_t entcnt = brt_vdev_entcount_get(brtvd, idx);
 			if (entcnt > 0) {
 				zfs_dbgmsg("      [%04llu] %hu",
@@ -455,9 +508,9 @@ brt_vdev_create(spa_t *spa, brt_vdev_t *brtvd, dmu_tx_t *tx)
 	    (u_longlong_t)brtvd->bv_mos_entries);
 
 	/*
-	 * We allocate DMU buffer to store the bv_entcount[] array.
+	 * We allocate DMU buffer to store the entcount array.
 	 * We will keep array size (bv_size) and cummulative count for all
-	 * bv_entcount[]s (bv_totalcount) in the bonus buffer.
+	 * entcounts (bv_totalcount) in the bonus buffer.
 	 */
 	brtvd->bv_mos_brtvdev = dmu_object_alloc(spa->spa_meta_objset,
 	    DMU_OTN_UINT64_METADATA, BRT_BLOCKSIZE,
@@ -491,7 +544,7 @@ static void
 brt_vdev_realloc(spa_t *spa, brt_vdev_t *brtvd)
 {
 	vdev_t *vd;
-	uint16_t *entcount;
+	uint16_t **entcount;
 	ulong_t *bitmap;
 	uint64_t nblocks, onblocks, size;
 
@@ -503,8 +556,10 @@ brt_vdev_realloc(spa_t *spa, brt_vdev_t *brtvd)
 	spa_config_exit(spa, SCL_VDEV, FTAG);
 
 	nblocks = BRT_RANGESIZE_TO_NBLOCKS(size);
-	entcount = vmem_zalloc(nblocks * BRT_BLOCKSIZE, KM_SLEEP);
+	entcount = vmem_zalloc(nblocks * sizeof (entcount[0]), KM_SLEEP);
 	bitmap = kmem_zalloc(BT_SIZEOFMAP(nblocks), KM_SLEEP);
+	BRTSTAT_INCR(brt_entcount_bytes,
+	    nblocks * sizeof (entcount[0]) + BT_SIZEOFMAP(nblocks));
 
 	if (!brtvd->bv_initiated) {
 		ASSERT0(brtvd->bv_size);
@@ -522,13 +577,20 @@ brt_vdev_realloc(spa_t *spa, brt_vdev_t *brtvd)
 		 */
 		ASSERT3U(brtvd->bv_size, <=, size);
 
-		memcpy(entcount, brtvd->bv_entcount,
-		    sizeof (entcount[0]) * MIN(size, brtvd->bv_size));
+		/*
+		 * Only the block pointers need copying, the allocated
+		 * blocks of entcounts are simply carried over.
+		 */
 		onblocks = BRT_RANGESIZE_TO_NBLOCKS(brtvd->bv_size);
-		vmem_free(brtvd->bv_entcount, onblocks * BRT_BLOCKSIZE);
+		memcpy(entcount, brtvd->bv_entcount,
+		    sizeof (entcount[0]) * MIN(nblocks, onblocks));
+		vmem_free(brtvd->bv_entcount, onblocks * sizeof (entcount[0]));
 		memcpy(bitmap, brtvd->bv_bitmap, MIN(BT_SIZEOFMAP(nblocks),
 		    BT_SIZEOFMAP(onblocks)));
 		kmem_free(brtvd->bv_bitmap, BT_SIZEOFMAP(onblocks));
+		BRTSTAT_INCR(brt_entcount_bytes,
+		    -(int64_t)(onblocks * sizeof (entcount[0]) +
+		    BT_SIZEOFMAP(onblocks)));
 	}
 
 	brtvd->bv_size = size;
@@ -547,6 +609,8 @@ brt_vdev_load(spa_t *spa, brt_vdev_t *brtvd)
 {
 	dmu_buf_t *db;
 	brt_vdev_phys_t *bvphys;
+	uint16_t *entcount;
+	uint64_t size;
 	int error;
 
 	ASSERT(!brtvd->bv_initiated);
@@ -570,15 +634,40 @@ brt_vdev_load(spa_t *spa, brt_vdev_t *brtvd)
 	ASSERT3U(bvphys->bvp_size, <=, brtvd->bv_size);
 
 	/*
-	 * If VDEV grew, we will leave new bv_entcount[] entries zeroed out.
+	 * Read the entcount array one block at a time and keep only the
+	 * blocks with any non-zero entcount.  Never written parts of the
+	 * array are holes, so skipping over them is cheap.
+	 * If VDEV grew, we will leave new entcounts zeroed out.
 	 */
-	error = dmu_read(spa->spa_meta_objset, brtvd->bv_mos_brtvdev, 0,
-	    MIN(brtvd->bv_size, bvphys->bvp_size) * sizeof (uint16_t),
-	    brtvd->bv_entcount, DMU_READ_NO_PREFETCH | DMU_UNCACHEDIO);
-	if (error != 0) {
-		dmu_buf_rele(db, FTAG);
-		return (error);
+	size = MIN(brtvd->bv_size, bvphys->bvp_size);
+	entcount = NULL;
+	for (uint64_t idx = 0; idx < size; idx += BRT_BLOCK_NENTCOUNT) {
+		uint64_t blk = idx / BRT_BLOCK_NENTCOUNT;
+		uint64_t n = MIN(size - idx, BRT_BLOCK_NENTCOUNT);
+
+		if (entcount == NULL)
+			entcount = kmem_zalloc(BRT_BLOCKSIZE, KM_SLEEP);
+		error = dmu_read(spa->spa_meta_objset, brtvd->bv_mos_brtvdev,
+		    blk * BRT_BLOCKSIZE, n * sizeof (uint16_t), entcount,
+		    DMU_READ_NO_PREFETCH | DMU_UNCACHEDIO);
+		if (error != 0) {
+			kmem_free(entcount, BRT_BLOCKSIZE);
+			dmu_buf_rele(db, FTAG);
+			return (error);
+		}
+		uint64_t i;
+		for (i = 0; i < n && entcount[i] == 0; i++)
+			;
+		if (i == n)
+			continue;
+		brtvd->bv_entcount[blk] = entcount;
+		brtvd->bv_entcount_nblocks++;
+		BRTSTAT_BUMP(brt_entcount_blocks);
+		BRTSTAT_INCR(brt_entcount_bytes, BRT_BLOCKSIZE);
+		entcount = NULL;
 	}
+	if (entcount != NULL)
+		kmem_free(entcount, BRT_BLOCKSIZE);
 
 	ASSERT(bvphys->bvp_mos_entries != 0);
 	VERIFY0(dnode_hold(spa->spa_meta_objset, bvphys->bvp_mos_entries, brtvd,
@@ -610,7 +699,17 @@ brt_vdev_dealloc(brt_vdev_t *brtvd)
 	ASSERT0(avl_numnodes(&brtvd->bv_tree));
 
 	uint64_t nblocks = BRT_RANGESIZE_TO_NBLOCKS(brtvd->bv_size);
-	vmem_free(brtvd->bv_entcount, nblocks * BRT_BLOCKSIZE);
+	for (uint64_t blk = 0; blk < nblocks; blk++) {
+		if (brtvd->bv_entcount[blk] != NULL)
+			kmem_free(brtvd->bv_entcount[blk], BRT_BLOCKSIZE);
+	}
+	BRTSTAT_INCR(brt_entcount_blocks,
+	    -(int64_t)brtvd->bv_entcount_nblocks);
+	BRTSTAT_INCR(brt_entcount_bytes,
+	    -(int64_t)(brtvd->bv_entcount_nblocks * BRT_BLOCKSIZE +
+	    nblocks * sizeof (brtvd->bv_entcount[0]) + BT_SIZEOFMAP(nblocks)));
+	brtvd->bv_entcount_nblocks = 0;
+	vmem_free(brtvd->bv_entcount, nblocks * sizeof (brtvd->bv_entcount[0]));
 	brtvd->bv_entcount = NULL;
 	kmem_free(brtvd->bv_bitmap, BT_SIZEOFMAP(nblocks));
 	brtvd->bv_bitmap = NULL;
@@ -754,7 +853,7 @@ brt_vdev_addref(spa_t *spa, brt_vdev_t *brtvd, const brt_entry_t *bre,
 	brtvd->bv_totalcount++;
 	brt_vdev_entcount_inc(brtvd, idx);
 	brtvd->bv_entcount_dirty = TRUE;
-	BT_SET(brtvd->bv_bitmap, idx / (BRT_BLOCKSIZE / sizeof (uint16_t)));
+	BT_SET(brtvd->bv_bitmap, idx / BRT_BLOCK_NENTCOUNT);
 }
 
 static void
@@ -781,7 +880,7 @@ brt_vdev_decref(spa_t *spa, brt_vdev_t *brtvd, const brt_entry_t *bre,
 	brtvd->bv_totalcount--;
 	brt_vdev_entcount_dec(brtvd, idx);
 	brtvd->bv_entcount_dirty = TRUE;
-	BT_SET(brtvd->bv_bitmap, idx / (BRT_BLOCKSIZE / sizeof (uint16_t)));
+	BT_SET(brtvd->bv_bitmap, idx / BRT_BLOCK_NENTCOUNT);
 }
 
 static void
@@ -802,16 +901,12 @@ brt_vdev_sync(spa_t *spa, brt_vdev_t *brtvd, dmu_tx_t *tx)
 		for (uint64_t i = 0; i < nblocks; i++) {
 			if (!BT_TEST(brtvd->bv_bitmap, i))
 				continue;
-			uint64_t end = i + 1;
-			uint64_t maxend = MIN(i + DMU_MAX_ACCESS / 2 /
-			    BRT_BLOCKSIZE, nblocks);
-			while (end < maxend && BT_TEST(brtvd->bv_bitmap, end))
-				end++;
+			/* Only modified entcounts make the block dirty. */
+			ASSERT(brtvd->bv_entcount[i] != NULL);
 			dmu_write(spa->spa_meta_objset, brtvd->bv_mos_brtvdev,
-			    i * BRT_BLOCKSIZE, (end - i) * BRT_BLOCKSIZE,
-			    (char *)brtvd->bv_entcount + i * BRT_BLOCKSIZE,
-			    tx, DMU_READ_NO_PREFETCH | DMU_UNCACHEDIO);
-			i = end - 1;
+			    i * BRT_BLOCKSIZE, BRT_BLOCKSIZE,
+			    brtvd->bv_entcount[i], tx,
+			    DMU_READ_NO_PREFETCH | DMU_UNCACHEDIO);
 		}
 		memset(brtvd->bv_bitmap, 0, BT_SIZEOFMAP(nblocks));
 		brtvd->bv_entcount_dirty = FALSE;
@@ -914,7 +1009,7 @@ brt_maybe_exists(spa_t *spa, const blkptr_t *bp)
 		return (FALSE);
 
 	/*
-	 * We don't need locks here, since bv_entcount pointer must be
+	 * We don't need locks here, since bv_entcount pointers must be
 	 * stable at this point, and we don't care about false positive
 	 * races here, while false negative should be impossible, since
 	 * all brt_vdev_addref() have already completed by this point.
@@ -1007,6 +1102,10 @@ brt_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&brt_sums.brt_decref_free_data_now);
 	bs->brt_decref_no_entry.value.ui64 =
 	    wmsum_value(&brt_sums.brt_decref_no_entry);
+	bs->brt_entcount_blocks.value.ui64 =
+	    wmsum_value(&brt_sums.brt_entcount_blocks);
+	bs->brt_entcount_bytes.value.ui64 =
+	    wmsum_value(&brt_sums.brt_entcount_bytes);
 
 	return (0);
 }
@@ -1025,6 +1124,8 @@ brt_stat_init(void)
 	wmsum_init(&brt_sums.brt_decref_free_data_later, 0);
 	wmsum_init(&brt_sums.brt_decref_free_data_now, 0);
 	wmsum_init(&brt_sums.brt_decref_no_entry, 0);
+	wmsum_init(&brt_sums.brt_entcount_blocks, 0);
+	wmsum_init(&brt_sums.brt_entcount_bytes, 0);
 
 	brt_ksp = kstat_create("zfs", 0, "brtstats", "misc", KSTAT_TYPE_NAMED,
 	    sizeof (brt_stats) / sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
@@ -1053,6 +1154,8 @@ brt_stat_fini(void)
 	wmsum_fini(&brt_sums.brt_decref_free_data_later);
 	wmsum_fini(&brt_sums.brt_decref_free_data_now);
 	wmsum_fini(&brt_sums.brt_decref_no_entry);
+	wmsum_fini(&brt_sums.brt_entcount_blocks);
+	wmsum_fini(&brt_sums.brt_entcount_bytes);
 }
 
 void
@@ -1297,6 +1400,113 @@ brt_pending_add(spa_t *spa, const blkptr_t *bp, dmu_tx_t *tx)
 	}
 }
 
+/*
+ * Where brt_pending_add_many() puts one block pointer.
+ */
+typedef struct brt_pending_slot {
+	brt_entry_t	*bps_bre;
+	kmutex_t	*bps_lock;
+	avl_tree_t	*bps_tree;
+	brt_vdev_t	*bps_brtvd;
+} brt_pending_slot_t;
+
+/*
+ * Same as brt_pending_add() for each of the nbps block pointers in bps, except
+ * that holes and embedded blocks, which reference no data block, are skipped.
+ * Runs of blocks going to the same pending tree, usually those of one vdev,
+ * are added under a single acquisition of its lock, so that cloning many
+ * blocks at once does not take and drop the lock for each of them.
+ */
+void
+brt_pending_add_many(spa_t *spa, const blkptr_t *bps, size_t nbps,
+    dmu_tx_t *tx)
+{
+	brt_pending_slot_t *slots;
+	kmutex_t *held = NULL;
+	brt_entry_t *bre;
+	avl_index_t where;
+	uint64_t txg;
+
+	txg = dmu_tx_get_txg(tx);
+	ASSERT3U(txg, !=, 0);
+
+	if (nbps == 0)
+		return;
+
+	/*
+	 * Allocate the entries and look up the vdevs first: brt_vdev() may
+	 * have to take the BRT lock as a writer, which we must not do while
+	 * holding a pending lock.
+	 */
+	slots = kmem_zalloc(nbps * sizeof (brt_pending_slot_t), KM_SLEEP);
+	for (size_t i = 0; i < nbps; i++) {
+		const blkptr_t *bp = &bps[i];
+		brt_pending_slot_t *slot = &slots[i];
+
+		if (BP_IS_HOLE(bp) || BP_IS_EMBEDDED(bp))
+			continue;
+
+		slot->bps_bre = kmem_cache_alloc(brt_entry_cache, KM_SLEEP);
+		slot->bps_bre->bre_bp = *bp;
+		slot->bps_bre->bre_count = 0;
+		slot->bps_bre->bre_pcount = 1;
+
+		if (BP_GET_DEDUP(bp)) {
+			brt_dedup_shard_t *bds =
+			    &spa->spa_brt_dedup[BRT_DEDUP_SHARD(bp)];
+			slot->bps_lock = &bds->bds_lock;
+			slot->bps_tree = &bds->bds_tree[txg & TXG_MASK];
+		} else {
+			brt_vdev_t *brtvd = brt_vdev(spa,
+			    DVA_GET_VDEV(&bp->blk_dva[0]), B_TRUE);
+			slot->bps_lock = &brtvd->bv_pending_lock;
+			slot->bps_tree =
+			    &brtvd->bv_pending_tree[txg & TXG_MASK];
+			slot->bps_brtvd = brtvd;
+		}
+	}
+
+	for (size_t i = 0; i < nbps; i++) {
+		brt_pending_slot_t *slot = &slots[i];
+
+		if (slot->bps_bre == NULL)
+			continue;
+
+		if (slot->bps_lock != held) {
+			if (held != NULL)
+				mutex_exit(held);
+			held = slot->bps_lock;
+			mutex_enter(held);
+		}
+
+		bre = avl_find(slot->bps_tree, slot->bps_bre, &where);
+		if (bre == NULL) {
+			avl_insert(slot->bps_tree, slot->bps_bre, where);
+			slot->bps_bre = NULL;
+		} else {
+			bre->bre_pcount++;
+		}
+	}
+	if (held != NULL)
+		mutex_exit(held);
+
+	/* Prefetch the entries new to the txg for the syncing context. */
+	for (size_t i = 0; i < nbps; i++) {
+		brt_pending_slot_t *slot = &slots[i];
+
+		if (slot->bps_lock == NULL)
+			continue;
+
+		if (slot->bps_bre != NULL)
+			kmem_cache_free(brt_entry_cache, slot->bps_bre);
+		else if (slot->bps_brtvd != NULL)
+			brt_prefetch(slot->bps_brtvd, &bps[i]);
+		else
+			ddt_prefetch(spa, &bps[i]);
+	}
+	kmem_free(slots, nbps * sizeof (brt_pending_slot_t));
+}
+
 void
 brt_pending_remove(spa_t *spa, const blkptr_t *bp, dmu_tx_t *tx)
 {
@@ -28,6 +28,7 @@ static dataset_kstat_values_t empty_dataset_kstats = {
 	{ "nread",	KSTAT_DATA_UINT64 },
 	{ "nunlinks",	KSTAT_DATA_UINT64 },
 	{ "nunlinked",	KSTAT_DATA_UINT64 },
+	{ "nlent",	KSTAT_DATA_UINT64 },
 	{
 	{ "zil_commit_count",			KSTAT_DATA_UINT64 },
 	{ "zil_commit_writer_count",		KSTAT_DATA_UINT64 },
@@ -35,6 +36,8 @@ static dataset_kstat_values_t empty_dataset_kstats = {
 	{ "zil_commit_stall_count",		KSTAT_DATA_UINT64 },
 	{ "zil_commit_suspend_count",		KSTAT_DATA_UINT64 },
 	{ "zil_commit_crash_count",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_object_count",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_deferred_count",		KSTAT_DATA_UINT64 },
 	{ "zil_itx_count",			KSTAT_DATA_UINT64 },
 	{ "zil_itx_indirect_count",		KSTAT_DATA_UINT64 },
 	{ "zil_itx_indirect_bytes",		KSTAT_DATA_UINT64 },
@@ -75,6 +78,8 @@ dataset_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&dk->dk_sums.dss_nunlinks);
 	dkv->dkv_nunlinked.value.ui64 =
 	    wmsum_value(&dk->dk_sums.dss_nunlinked);
+	dkv->dkv_nlent.value.ui64 =
+	    wmsum_value(&dk->dk_sums.dss_nlent);
 
 	zil_kstat_values_update(&dkv->dkv_zil_stats, &dk->dk_zil_sums);
 
@@ -164,6 +169,7 @@ dataset_kstats_create(dataset_kstats_t *dk, objset_t *objset)
 	wmsum_init(&dk->dk_sums.dss_nread, 0);
 	wmsum_init(&dk->dk_sums.dss_nunlinks, 0);
 	wmsum_init(&dk->dk_sums.dss_nunlinked, 0);
+	wmsum_init(&dk->dk_sums.dss_nlent, 0);
 	zil_sums_init(&dk->dk_zil_sums);
 
 	dk->dk_kstats = kstat;
@@ -190,6 +196,7 @@ dataset_kstats_destroy(dataset_kstats_t *dk)
 	wmsum_fini(&dk->dk_sums.dss_nread);
 	wmsum_fini(&dk->dk_sums.dss_nunlinks);
 	wmsum_fini(&dk->dk_sums.dss_nunlinked);
+	wmsum_fini(&dk->dk_sums.dss_nlent);
 	zil_sums_fini(&dk->dk_zil_sums);
 }
 
@@ -249,3 +256,14 @@ dataset_kstats_update_nunlinked_kstat(dataset_kstats_t *dk, int64_t delta)
 
 	wmsum_add(&dk->dk_sums.dss_nunlinked, delta);
 }
+
+void
+dataset_kstats_update_nlent_kstat(dataset_kstats_t *dk, int64_t nlent)
+{
+	ASSERT3S(nlent, >=, 0);
+
+	if (dk->dk_kstats == NULL)
+		return;
+
+	wmsum_add(&dk->dk_sums.dss_nlent, nlent);
+}
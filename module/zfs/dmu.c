@@ -31,6 +31,7 @@
 #include <sys/zfs_context.h>
 #include <sys/dmu_objset.h>
 #include <sys/dmu_traverse.h>
+#include <sys/dmu_recv.h>
 #include <sys/dsl_dataset.h>
 #include <sys/dsl_dir.h>
 #include <sys/dsl_pool.h>
@@ -68,14 +69,21 @@ static int zfs_nopwrite_enabled = 1;
 static uint_t zfs_per_txg_dirty_frees_percent = 30;
 
 /*
- * Enable/disable forcing txg sync when dirty checking for holes with lseek().
- * By default this is enabled to ensure accurate hole reporting, it can result
- * in a significant performance penalty for lseek(SEEK_HOLE) heavy workloads.
- * Disabling this option will result in holes never being reported in dirty
- * files which is always safe.
+ * Enable/disable accurate hole reporting for dirty files with lseek().
+ * By default this is enabled, and the unsynced changes of a file are merged
+ * with its blocks on disk.  This only waits for a txg sync when the file is
+ * part of the txg being synced at the time.  Disabling this option will
+ * result in holes never being reported in dirty files which is always safe.
  */
 static int zfs_dmu_offset_next_sync = 1;
 
+/*
+ * Write the parts of Direct I/O writes which do not cover whole blocks
+ * directly as well, by merging them into the block read from disk, rather
+ * than through the ARC.
+ */
+int zfs_dio_write_rmw = 0;
+
 /*
  * Limit the amount we can prefetch with one call to this amount.  This
  * helps to limit the amount of memory that can be used by prefetching.
@@ -476,26 +484,93 @@ dmu_spill_hold_by_bonus(dmu_buf_t *bonus, dmu_flags_t flags, const void *tag,
 }
 
 /*
- * Note: longer-term, we should modify all of the dmu_buf_*() interfaces
- * to take a held dnode rather than <os, object> -- the lookup is wasteful,
- * and can induce severe lock contention when writing to several files
- * whose dnodes are in the same block.
+ * Hold the dbufs of a read from dmu_buf_hold_array_by_dnode() with
+ * DMU_NOWAIT, only if they are all cached already.  Fails with EAGAIN
+ * rather than wait for a read or a contended dn_struct_rwlock.
  */
-int
-dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
+static int
+dmu_buf_hold_array_nowait(dnode_t *dn, uint64_t offset, uint64_t length,
+    const void *tag, int *numbufsp, dmu_buf_t ***dbpp, dmu_flags_t flags)
+{
+	dmu_buf_t **dbp;
+	zstream_t *zs = NULL;
+	uint64_t blkid, nblks, i;
+	dmu_flags_t dbuf_flags;
+
+	dbuf_flags = (flags & ~(DMU_READ_PREFETCH | DMU_NOWAIT)) |
+	    DMU_READ_NO_PREFETCH | DB_RF_CANFAIL | DB_RF_NEVERWAIT |
+	    DB_RF_HAVESTRUCT;
+
+	if (!rw_tryenter(&dn->dn_struct_rwlock, RW_READER))
+		return (SET_ERROR(EAGAIN));
+	if (dn->dn_datablkshift) {
+		int blkshift = dn->dn_datablkshift;
+		nblks = (P2ROUNDUP(offset + length, 1ULL << blkshift) -
+		    P2ALIGN_TYPED(offset, 1ULL << blkshift, uint64_t))
+		    >> blkshift;
+	} else {
+		/* Let the blocking path report accesses past the end. */
+		if (offset + length > dn->dn_datablksz) {
+			rw_exit(&dn->dn_struct_rwlock);
+			return (SET_ERROR(EAGAIN));
+		}
+		nblks = 1;
+	}
+	dbp = kmem_zalloc(sizeof (dmu_buf_t *) * nblks, KM_SLEEP);
+
+	blkid = dbuf_whichblock(dn, 0, offset);
+	for (i = 0; i < nblks; i++) {
+		dmu_buf_impl_t *db;
+
+		if (dbuf_hold_impl(dn, 0, blkid + i, FALSE, TRUE, tag,
+		    &db) != 0)
+			break;
+		dbp[i] = &db->db;
+		if (dbuf_read(db, NULL, dbuf_flags) != 0 ||
+		    db->db_state != DB_CACHED)
+			break;
+	}
+	if (i < nblks) {
+		rw_exit(&dn->dn_struct_rwlock);
+		dmu_buf_rele_array(dbp, nblks, tag);
+		return (SET_ERROR(EAGAIN));
+	}
+
+	/*
+	 * Only let the prefetcher see the access once it is known to be
+	 * satisfied here, as it would otherwise see it twice.
+	 */
+	if ((flags & DMU_READ_NO_PREFETCH) == 0) {
+		zs = dmu_zfetch_prepare(&dn->dn_zfetch, blkid, nblks,
+		    B_TRUE, B_TRUE);
+		if (zs != NULL) {
+			dmu_zfetch_run(&dn->dn_zfetch, zs, B_FALSE, B_TRUE,
+			    (flags & DMU_UNCACHEDIO));
+		}
+	}
+	rw_exit(&dn->dn_struct_rwlock);
+
+	*numbufsp = nblks;
+	*dbpp = dbp;
+	return (0);
+}
+
+/*
+ * Hold the buffers of a range of an object and, for a read, issue the reads
+ * of those not cached as children of "zio".  On error, the buffers have
+ * been released, but "zio" may still have children and must be issued.
+ */
+static int
+dmu_buf_hold_array_issue(dnode_t *dn, uint64_t offset, uint64_t length,
     boolean_t read, const void *tag, int *numbufsp, dmu_buf_t ***dbpp,
-    dmu_flags_t flags)
+    dmu_flags_t flags, zio_t *zio)
 {
 	dmu_buf_t **dbp;
 	zstream_t *zs = NULL;
 	uint64_t blkid, nblks, i;
 	dmu_flags_t dbuf_flags;
-	int err;
-	zio_t *zio = NULL;
 	boolean_t missed = B_FALSE;
 
-	ASSERT(!read || length <= DMU_MAX_ACCESS);
-
 	/*
 	 * Note: We directly notify the prefetch code of this read, so that
 	 * we can tell it about the multi-block read.  dbuf_read() only knows
@@ -525,9 +600,6 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 	}
 	dbp = kmem_zalloc(sizeof (dmu_buf_t *) * nblks, KM_SLEEP);
 
-	if (read)
-		zio = zio_root(dn->dn_objset->os_spa, NULL, NULL,
-		    ZIO_FLAG_CANFAIL);
 	blkid = dbuf_whichblock(dn, 0, offset);
 	if ((flags & DMU_READ_NO_PREFETCH) == 0) {
 		/*
@@ -547,8 +619,6 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 			}
 			rw_exit(&dn->dn_struct_rwlock);
 			dmu_buf_rele_array(dbp, nblks, tag);
-			if (read)
-				zio_nowait(zio);
 			return (SET_ERROR(EIO));
 		}
 
@@ -593,29 +663,77 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 	}
 	rw_exit(&dn->dn_struct_rwlock);
 
+	*numbufsp = nblks;
+	*dbpp = dbp;
+	return (0);
+}
+
+/*
+ * Wait for reads of held buffers issued by other threads to complete.
+ */
+static int
+dmu_buf_wait_array(dmu_buf_t **dbp, int numbufs)
+{
+	int err = 0;
+
+	for (int i = 0; i < numbufs && err == 0; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		mutex_enter(&db->db_mtx);
+		while (db->db_state == DB_READ ||
+		    db->db_state == DB_FILL)
+			cv_wait(&db->db_changed, &db->db_mtx);
+		if (db->db_state == DB_UNCACHED)
+			err = SET_ERROR(EIO);
+		mutex_exit(&db->db_mtx);
+	}
+	return (err);
+}
+
+/*
+ * Note: longer-term, we should modify all of the dmu_buf_*() interfaces
+ * to take a held dnode rather than <os, object> -- the lookup is wasteful,
+ * and can induce severe lock contention when writing to several files
+ * whose dnodes are in the same block.
+ */
+int
+dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
+    boolean_t read, const void *tag, int *numbufsp, dmu_buf_t ***dbpp,
+    dmu_flags_t flags)
+{
+	dmu_buf_t **dbp;
+	int nblks, err;
+	zio_t *zio = NULL;
+
+	ASSERT(!read || length <= DMU_MAX_ACCESS);
+
+	if (read && (flags & DMU_NOWAIT)) {
+		return (dmu_buf_hold_array_nowait(dn, offset, length, tag,
+		    numbufsp, dbpp, flags));
+	}
+	flags &= ~DMU_NOWAIT;
+
+	if (read)
+		zio = zio_root(dn->dn_objset->os_spa, NULL, NULL,
+		    ZIO_FLAG_CANFAIL);
+	err = dmu_buf_hold_array_issue(dn, offset, length, read, tag,
+	    &nblks, &dbp, flags, zio);
+	if (err) {
+		if (read)
+			zio_nowait(zio);
+		return (err);
+	}
+
 	if (read) {
 		/* wait for async read i/o */
 		err = zio_wait(zio);
+
+		/* wait for other io to complete */
+		if (err == 0)
+			err = dmu_buf_wait_array(dbp, nblks);
 		if (err) {
 			dmu_buf_rele_array(dbp, nblks, tag);
 			return (err);
 		}
-
-		/* wait for other io to complete */
-		for (i = 0; i < nblks; i++) {
-			dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
-			mutex_enter(&db->db_mtx);
-			while (db->db_state == DB_READ ||
-			    db->db_state == DB_FILL)
-				cv_wait(&db->db_changed, &db->db_mtx);
-			if (db->db_state == DB_UNCACHED)
-				err = SET_ERROR(EIO);
-			mutex_exit(&db->db_mtx);
-			if (err) {
-				dmu_buf_rele_array(dbp, nblks, tag);
-				return (err);
-			}
-		}
 	}
 
 	*numbufsp = nblks;
@@ -623,6 +741,97 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 	return (0);
 }
 
+typedef struct dmu_read_async {
+	dmu_buf_t	**dra_dbp;
+	int		dra_numbufs;
+	int		dra_err;
+	const void	*dra_tag;
+	dmu_read_done_t	*dra_done;
+	void		*dra_arg;
+	taskq_ent_t	dra_tqent;
+} dmu_read_async_t;
+
+static void
+dmu_read_async_finish(dmu_read_async_t *dra)
+{
+	if (dra->dra_err != 0 && dra->dra_dbp != NULL) {
+		dmu_buf_rele_array(dra->dra_dbp, dra->dra_numbufs,
+		    dra->dra_tag);
+		dra->dra_dbp = NULL;
+		dra->dra_numbufs = 0;
+	}
+	dra->dra_done(dra->dra_arg, dra->dra_dbp, dra->dra_numbufs,
+	    dra->dra_err);
+	kmem_free(dra, sizeof (*dra));
+}
+
+static void
+dmu_read_async_wait(void *arg)
+{
+	dmu_read_async_t *dra = arg;
+
+	dra->dra_err = dmu_buf_wait_array(dra->dra_dbp, dra->dra_numbufs);
+	dmu_read_async_finish(dra);
+}
+
+/*
+ * All reads issued for the request are done.  Buffers which were being
+ * read or filled by other threads are waited for from a taskq rather than
+ * in zio completion context.
+ */
+static void
+dmu_read_async_done(zio_t *zio)
+{
+	dmu_read_async_t *dra = zio->io_private;
+
+	if (dra->dra_err == 0)
+		dra->dra_err = zio->io_error;
+	for (int i = 0; dra->dra_err == 0 && i < dra->dra_numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dra->dra_dbp[i];
+		boolean_t cached;
+
+		mutex_enter(&db->db_mtx);
+		cached = (db->db_state == DB_CACHED);
+		mutex_exit(&db->db_mtx);
+		if (!cached) {
+			taskq_dispatch_ent(system_taskq, dmu_read_async_wait,
+			    dra, 0, &dra->dra_tqent);
+			return;
+		}
+	}
+	dmu_read_async_finish(dra);
+}
+
+void
+dmu_buf_hold_array_by_dnode_async(dnode_t *dn, uint64_t offset,
+    uint64_t length, const void *tag, dmu_flags_t flags,
+    dmu_read_done_t *done, void *arg)
+{
+	dmu_read_async_t *dra;
+	zio_t *zio;
+
+	ASSERT(length <= DMU_MAX_ACCESS);
+
+	/* Direct I/O reads are not asynchronous, read through the ARC. */
+	flags &= ~(DMU_DIRECTIO | DMU_NOWAIT);
+
+	dra = kmem_zalloc(sizeof (*dra), KM_SLEEP);
+	dra->dra_tag = tag;
+	dra->dra_done = done;
+	dra->dra_arg = arg;
+	taskq_init_ent(&dra->dra_tqent);
+
+	zio = zio_root(dn->dn_objset->os_spa, dmu_read_async_done, dra,
+	    ZIO_FLAG_CANFAIL);
+	dra->dra_err = dmu_buf_hold_array_issue(dn, offset, length, B_TRUE,
+	    tag, &dra->dra_numbufs, &dra->dra_dbp, flags, zio);
+	if (dra->dra_err != 0) {
+		dra->dra_dbp = NULL;
+		dra->dra_numbufs = 0;
+	}
+	zio_nowait(zio);
+}
+
 int
 dmu_buf_hold_array(objset_t *os, uint64_t object, uint64_t offset,
     uint64_t length, int read, const void *tag, int *numbufsp,
@@ -1588,12 +1797,40 @@ dmu_redact(objset_t *os, uint64_t object, uint64_t offset, uint64_t size,
 }
 
 #ifdef _KERNEL
+static int
+dmu_read_uio_bufs(dmu_buf_t **dbp, int numbufs, zfs_uio_t *uio, uint64_t size)
+{
+	int err = 0;
+
+	for (int i = 0; i < numbufs; i++) {
+		uint64_t tocpy;
+		int64_t bufoff;
+		dmu_buf_t *db = dbp[i];
+
+		ASSERT(size > 0);
+
+		bufoff = zfs_uio_offset(uio) - db->db_offset;
+		tocpy = MIN(db->db_size - bufoff, size);
+
+		ASSERT(db->db_data != NULL);
+		err = zfs_uio_fault_move((char *)db->db_data + bufoff, tocpy,
+		    UIO_READ, uio);
+
+		if (err)
+			break;
+
+		size -= tocpy;
+	}
+
+	return (err);
+}
+
 int
 dmu_read_uio_dnode(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
     dmu_flags_t flags)
 {
 	dmu_buf_t **dbp;
-	int numbufs, i, err;
+	int numbufs, err;
 
 	if ((flags & DMU_DIRECTIO) && (uio->uio_extflg & UIO_DIRECT))
 		return (dmu_read_uio_direct(dn, uio, size, flags));
@@ -1608,28 +1845,55 @@ dmu_read_uio_dnode(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
 	if (err)
 		return (err);
 
-	for (i = 0; i < numbufs; i++) {
-		uint64_t tocpy;
-		int64_t bufoff;
-		dmu_buf_t *db = dbp[i];
-
-		ASSERT(size > 0);
+	err = dmu_read_uio_bufs(dbp, numbufs, uio, size);
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
 
-		bufoff = zfs_uio_offset(uio) - db->db_offset;
-		tocpy = MIN(db->db_size - bufoff, size);
+	return (err);
+}
 
-		ASSERT(db->db_data != NULL);
-		err = zfs_uio_fault_move((char *)db->db_data + bufoff, tocpy,
-		    UIO_READ, uio);
+typedef struct dmu_read_uio_async {
+	zfs_uio_t		*drua_uio;
+	uint64_t		drua_size;
+	dmu_read_uio_done_t	*drua_done;
+	void			*drua_arg;
+} dmu_read_uio_async_t;
 
-		if (err)
-			break;
+static void
+dmu_read_uio_async_done(void *arg, dmu_buf_t **dbp, int numbufs, int err)
+{
+	dmu_read_uio_async_t *drua = arg;
+	dmu_read_uio_done_t *done = drua->drua_done;
+	void *done_arg = drua->drua_arg;
 
-		size -= tocpy;
+	if (err == 0) {
+		err = dmu_read_uio_bufs(dbp, numbufs, drua->drua_uio,
+		    drua->drua_size);
+		dmu_buf_rele_array(dbp, numbufs, drua);
 	}
-	dmu_buf_rele_array(dbp, numbufs, FTAG);
+	kmem_free(drua, sizeof (*drua));
+	done(done_arg, err);
+}
 
-	return (err);
+/*
+ * Asynchronous dmu_read_uio_dnode(), built on
+ * dmu_buf_hold_array_by_dnode_async().  The data is copied from the
+ * completion callback, so the uio must describe kernel memory, like the
+ * pages of a bio, and stay valid until done() is called.
+ */
+void
+dmu_read_uio_dnode_async(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
+    dmu_flags_t flags, dmu_read_uio_done_t *done, void *arg)
+{
+	dmu_read_uio_async_t *drua;
+
+	drua = kmem_alloc(sizeof (*drua), KM_SLEEP);
+	drua->drua_uio = uio;
+	drua->drua_size = size;
+	drua->drua_done = done;
+	drua->drua_arg = arg;
+
+	dmu_buf_hold_array_by_dnode_async(dn, zfs_uio_offset(uio), size,
+	    drua, flags, dmu_read_uio_async_done, drua);
 }
 
 /*
@@ -1658,6 +1922,17 @@ dmu_read_uio_dbuf(dmu_buf_t *zdb, zfs_uio_t *uio, uint64_t size,
 	return (err);
 }
 
+void
+dmu_read_uio_dbuf_async(dmu_buf_t *zdb, zfs_uio_t *uio, uint64_t size,
+    dmu_flags_t flags, dmu_read_uio_done_t *done, void *arg)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+
+	DB_DNODE_ENTER(db);
+	dmu_read_uio_dnode_async(DB_DNODE(db), uio, size, flags, done, arg);
+	DB_DNODE_EXIT(db);
+}
+
 /*
  * Read 'size' bytes into the uio buffer.
  * From the specified object
@@ -1697,6 +1972,26 @@ dmu_write_uio_dnode(dnode_t *dn, zfs_uio_t *uio, uint64_t size, dmu_tx_t *tx,
 top:
 	write_size = size;
 
+	/*
+	 * With zfs_dio_write_rmw, a Direct I/O write of part of a block is
+	 * merged into the block read from disk, and the whole block written
+	 * directly.  The caller holds the range lock over the whole block.
+	 */
+	if ((flags & DMU_DIRECTIO) && (uio->uio_extflg & UIO_DIRECT) &&
+	    zfs_dio_write_rmw) {
+		uint64_t blkoff = zfs_uio_offset(uio) % dn->dn_datablksz;
+
+		if (blkoff != 0 || size < dn->dn_datablksz) {
+			write_size = MIN(size, dn->dn_datablksz - blkoff);
+			err = dmu_write_uio_direct_rmw(dn, uio, write_size,
+			    flags, tx);
+			if (err != 0 || write_size == size)
+				return (err);
+			size -= write_size;
+			goto top;
+		}
+	}
+
 	/*
 	 * We only allow Direct I/O writes to happen if we are block
 	 * sized aligned. Otherwise, we pass the write off to the ARC.
@@ -1839,6 +2134,117 @@ dmu_write_uio(objset_t *os, uint64_t object, zfs_uio_t *uio, uint64_t size,
 }
 #endif /* _KERNEL */
 
+/*
+ * Check whether a block can be dirtied without reading it from disk: it is
+ * cached, or past the end of the object, or a hole according to a block
+ * pointer in memory.  Called with dn_struct_rwlock held.
+ */
+static boolean_t
+dmu_block_is_cached(dnode_t *dn, int level, uint64_t blkid)
+{
+	int epbs = dn->dn_indblkshift - SPA_BLKPTRSHIFT;
+	dmu_buf_impl_t *db;
+	boolean_t cached;
+
+	if (level >= dn->dn_nlevels ||
+	    blkid > (dn->dn_maxblkid >> (level * epbs)))
+		return (B_TRUE);
+
+	db = dbuf_find(dn->dn_objset, dn->dn_object, level, blkid, NULL);
+	if (db != NULL) {
+		cached = (db->db_state == DB_CACHED);
+		mutex_exit(&db->db_mtx);
+		return (cached);
+	}
+
+	if (level + 1 == dn->dn_nlevels) {
+		return (blkid < dn->dn_nblkptr &&
+		    BP_IS_HOLE(&dn->dn_phys->dn_blkptr[blkid]));
+	}
+	db = dbuf_find(dn->dn_objset, dn->dn_object, level + 1, blkid >> epbs,
+	    NULL);
+	if (db == NULL)
+		return (B_FALSE);
+	cached = (db->db_state == DB_CACHED && BP_IS_HOLE(
+	    &((blkptr_t *)db->db.db_data)[blkid & ((1ULL << epbs) - 1)]));
+	mutex_exit(&db->db_mtx);
+	return (cached);
+}
+
+/*
+ * Check whether writing a range of an object can proceed without reading any
+ * block from disk, neither from dmu_tx_hold_write() nor to dirty the blocks:
+ * the level-1 blocks covering the range, and the first and last level-0
+ * blocks if partially written, must not need a read.  Nothing is held, so
+ * this is only a hint for callers which would rather fail than block.
+ */
+boolean_t
+dmu_write_is_cached(dmu_buf_t *zdb, uint64_t offset, uint64_t size)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	boolean_t cached = B_TRUE;
+	dnode_t *dn;
+
+	if (size == 0)
+		return (B_TRUE);
+
+	DB_DNODE_ENTER(db);
+	dn = DB_DNODE(db);
+	if (!rw_tryenter(&dn->dn_struct_rwlock, RW_READER)) {
+		DB_DNODE_EXIT(db);
+		return (B_FALSE);
+	}
+
+	uint64_t blksz = dn->dn_datablksz;
+	uint64_t start = dbuf_whichblock(dn, 0, offset);
+	uint64_t end = dbuf_whichblock(dn, 0, offset + size - 1);
+	if (offset != start * blksz || offset + size < (start + 1) * blksz)
+		cached = dmu_block_is_cached(dn, 0, start);
+	if (cached && end != start && offset + size < (end + 1) * blksz)
+		cached = dmu_block_is_cached(dn, 0, end);
+	if (dn->dn_nlevels > 1) {
+		int epbs = dn->dn_indblkshift - SPA_BLKPTRSHIFT;
+		for (uint64_t i = start >> epbs; cached && i <= end >> epbs;
+		    i++)
+			cached = dmu_block_is_cached(dn, 1, i);
+	}
+
+	rw_exit(&dn->dn_struct_rwlock);
+	DB_DNODE_EXIT(db);
+	return (cached);
+}
+
+/*
+ * Pass the ARC's copy of a range of a clean, cached dbuf to func, so that the
+ * caller can take references on its pages rather than copy the data.  The
+ * ABD is only valid for the duration of the call, which is made with the
+ * dbuf's mutex held so the buffer can not be dirtied meanwhile.  Returns
+ * ENOTSUP if the data is dirty, or not kept scattered and uncompressed in
+ * the ARC; otherwise the result of func.
+ */
+int
+dmu_buf_lend(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    dmu_buf_lend_func_t *func, void *arg)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	abd_t *abd = NULL;
+	int err;
+
+	ASSERT3U(offset + size, <=, db->db.db_size);
+
+	mutex_enter(&db->db_mtx);
+	if (db->db_state == DB_CACHED && db->db_dirtycnt == 0 &&
+	    db->db_buf != NULL)
+		abd = arc_buf_hdr_abd(db->db_buf);
+	if (abd == NULL || abd_is_linear(abd))
+		err = SET_ERROR(ENOTSUP);
+	else
+		err = func(abd, offset, size, arg);
+	mutex_exit(&db->db_mtx);
+
+	return (err);
+}
+
 static void
 dmu_cached_bps(spa_t *spa, blkptr_t *bps, uint_t nbps,
     uint64_t *l1sz, uint64_t *l2sz)
@@ -2743,8 +3149,11 @@ restart:
 	if (dnode_is_dirty(dn)) {
 		/*
 		 * If the zfs_dmu_offset_next_sync module option is enabled
-		 * then hole reporting has been requested.  Dirty dnodes
-		 * must be synced to disk to accurately report holes.
+		 * then hole reporting has been requested.  The changes of
+		 * a dirty dnode which are not synced yet are merged with
+		 * its block tree on disk, which is only unreliable while
+		 * a txg the dnode is dirty in is being synced.  We wait for
+		 * that txg and try again then.
 		 *
 		 * Provided a RL_READER rangelock spanning 0-UINT64_MAX is
 		 * held by the caller only limited restarts will be required.
@@ -2753,20 +3162,28 @@ restart:
 		 * TXG_CONCURRENT_STATES (3) restarts.
 		 */
 		if (zfs_dmu_offset_next_sync) {
-			rw_exit(&dn->dn_struct_rwlock);
-			dnode_rele(dn, FTAG);
-
 			if (maxtxg == 0) {
 				txg = spa_last_synced_txg(dmu_objset_spa(os));
 				maxtxg = txg + TXG_CONCURRENT_STATES;
-			} else if (txg >= maxtxg)
-				return (SET_ERROR(EBUSY));
+			}
 
-			txg_wait_synced(dmu_objset_pool(os), ++txg);
-			goto restart;
-		}
+			if (!dmu_objset_is_receiving(os))
+				err = dnode_next_offset_dirty(dn, hole, off);
+			else
+				err = SET_ERROR(EAGAIN);
+			if (err == EAGAIN) {
+				rw_exit(&dn->dn_struct_rwlock);
+				dnode_rele(dn, FTAG);
+
+				if (txg >= maxtxg)
+					return (SET_ERROR(EBUSY));
 
-		err = SET_ERROR(EBUSY);
+				txg_wait_synced(dmu_objset_pool(os), ++txg);
+				goto restart;
+			}
+		} else {
+			err = SET_ERROR(EBUSY);
+		}
 	} else {
 		err = dnode_next_offset(dn, DNODE_FIND_HAVELOCK |
 		    (hole ? DNODE_FIND_HOLE : 0), off, 1, 1, 0);
@@ -2874,9 +3291,10 @@ out:
 	return (error);
 }
 
-int
-dmu_brt_clone(objset_t *os, uint64_t object, uint64_t offset, uint64_t length,
-    dmu_tx_t *tx, const blkptr_t *bps, size_t nbps)
+static int
+dmu_brt_clone_impl(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t length, dmu_tx_t *tx, const blkptr_t *bps, size_t nbps,
+    boolean_t pending)
 {
 	spa_t *spa;
 	dmu_buf_t **dbp, *dbuf;
@@ -2942,22 +3360,43 @@ dmu_brt_clone(objset_t *os, uint64_t object, uint64_t offset, uint64_t length,
 		dl->dr_override_state = DR_OVERRIDDEN;
 
 		mutex_exit(&db->db_mtx);
-
-		/*
-		 * When data in embedded into BP there is no need to create
-		 * BRT entry as there is no data block. Just copy the BP as
-		 * it contains the data.
-		 */
-		if (!BP_IS_HOLE(bp) && !BP_IS_EMBEDDED(bp)) {
-			brt_pending_add(spa, bp, tx);
-		}
 	}
+
+	/*
+	 * When data in embedded into BP there is no need to create
+	 * BRT entry as there is no data block. Just copy the BP as
+	 * it contains the data.  brt_pending_add_many() skips those.
+	 */
+	if (pending)
+		brt_pending_add_many(spa, bps, nbps, tx);
 out:
 	dmu_buf_rele_array(dbp, numbufs, FTAG);
 
 	return (error);
 }
 
+int
+dmu_brt_clone(objset_t *os, uint64_t object, uint64_t offset, uint64_t length,
+    dmu_tx_t *tx, const blkptr_t *bps, size_t nbps)
+{
+	return (dmu_brt_clone_impl(os, object, offset, length, tx, bps, nbps,
+	    B_TRUE));
+}
+
+/*
+ * Same as dmu_brt_clone(), but the cloned blocks are not added to the BRT.
+ * The caller must pass the same bps to brt_pending_add_many() in the same tx,
+ * while still holding the range locked against writers, so that the clones
+ * of many files can add their blocks at once.
+ */
+int
+dmu_brt_clone_nopending(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t length, dmu_tx_t *tx, const blkptr_t *bps, size_t nbps)
+{
+	return (dmu_brt_clone_impl(os, object, offset, length, tx, bps, nbps,
+	    B_FALSE));
+}
+
 void
 __dmu_object_info_from_dnode(dnode_t *dn, dmu_object_info_t *doi)
 {
@@ -3151,6 +3590,7 @@ dmu_fini(void)
 EXPORT_SYMBOL(dmu_bonus_hold);
 EXPORT_SYMBOL(dmu_bonus_hold_by_dnode);
 EXPORT_SYMBOL(dmu_buf_hold_array_by_bonus);
+EXPORT_SYMBOL(dmu_buf_hold_array_by_dnode_async);
 EXPORT_SYMBOL(dmu_buf_rele_array);
 EXPORT_SYMBOL(dmu_prefetch);
 EXPORT_SYMBOL(dmu_prefetch_by_dnode);
@@ -3165,6 +3605,8 @@ EXPORT_SYMBOL(dmu_read_by_dnode);
 EXPORT_SYMBOL(dmu_read_uio);
 EXPORT_SYMBOL(dmu_read_uio_dbuf);
 EXPORT_SYMBOL(dmu_read_uio_dnode);
+EXPORT_SYMBOL(dmu_read_uio_dbuf_async);
+EXPORT_SYMBOL(dmu_read_uio_dnode_async);
 EXPORT_SYMBOL(dmu_write);
 EXPORT_SYMBOL(dmu_write_by_dnode);
 EXPORT_SYMBOL(dmu_write_uio);
@@ -3184,6 +3626,7 @@ EXPORT_SYMBOL(dmu_object_set_compress);
 EXPORT_SYMBOL(dmu_offset_next);
 EXPORT_SYMBOL(dmu_write_policy);
 EXPORT_SYMBOL(dmu_sync);
+EXPORT_SYMBOL(dmu_buf_lend);
 EXPORT_SYMBOL(dmu_request_arcbuf);
 EXPORT_SYMBOL(dmu_return_arcbuf);
 EXPORT_SYMBOL(dmu_assign_arcbuf_by_dnode);
@@ -3198,7 +3641,10 @@ ZFS_MODULE_PARAM(zfs, zfs_, per_txg_dirty_frees_percent, UINT, ZMOD_RW,
 	"Percentage of dirtied blocks from frees in one TXG");
 
 ZFS_MODULE_PARAM(zfs, zfs_, dmu_offset_next_sync, INT, ZMOD_RW,
-	"Enable forcing txg sync to find holes");
+	"Enable reporting holes in dirty files");
+
+ZFS_MODULE_PARAM(zfs, zfs_, dio_write_rmw, INT, ZMOD_RW,
+	"Write partial blocks of Direct I/O writes directly");
 
 ZFS_MODULE_PARAM(zfs, , dmu_prefetch_max, UINT, ZMOD_RW,
 	"Limit one prefetch call to this size");
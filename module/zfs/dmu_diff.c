@@ -32,15 +32,68 @@
 #include <sys/zio_checksum.h>
 #include <sys/zfs_znode.h>
 #include <sys/zfs_file.h>
+#include <sys/bqueue.h>
 
+/*
+ * The number of threads that traverse the meta-dnode for one diff.  With more
+ * than one, the objects are split into ranges that are traversed concurrently,
+ * and their records are written in object order.  See dmu_diff_ranges().
+ */
+static uint_t zfs_diff_traverse_threads = 1;
+
+/* Number of object ranges to split a diff into per traversal thread */
+#define	DIFF_RANGES_PER_THREAD	16
+
+/* Bytes of records queued by each traversal thread */
+#define	DIFF_QUEUE_LENGTH	(1024 * 1024)
 
 typedef struct dmu_diffarg {
 	zfs_file_t *da_fp;		/* file to which we are reporting */
 	offset_t *da_offp;
 	int da_err;			/* error that stopped diff search */
 	dmu_diff_record_t da_ddr;
+
+	/*
+	 * On a range thread: the thread writing its records, the queue they
+	 * are passed on in, and the object range being traversed.
+	 */
+	struct dmu_diffarg *da_parent;
+	bqueue_t da_q;
+	dsl_dataset_t *da_ds;
+	uint64_t da_fromtxg;
+	uint64_t da_range_idx;
+	uint64_t da_start_object;
+	uint64_t da_end_object;		/* 0 for the last range */
+	boolean_t da_cancel;
+
+	/* When the traversal is split into object ranges */
+	struct dmu_diffarg *da_range_args;
+	uint_t da_nrange_args;
+	uint64_t da_range_objects;	/* Objects per range */
+	uint64_t da_nranges;
 } dmu_diffarg_t;
 
+typedef struct diff_range_record {
+	bqueue_node_t drr_ln;
+	dmu_diff_record_t drr_ddr;
+	boolean_t drr_eos;		/* End of a range */
+} diff_range_record_t;
+
+static void
+enqueue_record(dmu_diffarg_t *da, const dmu_diff_record_t *ddr,
+    boolean_t eos)
+{
+	diff_range_record_t *rec = kmem_zalloc(sizeof (*rec), KM_SLEEP);
+
+	if (ddr != NULL)
+		rec->drr_ddr = *ddr;
+	rec->drr_eos = eos;
+	if (eos)
+		bqueue_enqueue_flush(&da->da_q, rec, sizeof (*rec));
+	else
+		bqueue_enqueue(&da->da_q, rec, sizeof (*rec));
+}
+
 static int
 write_record(dmu_diffarg_t *da)
 {
@@ -52,6 +105,13 @@ write_record(dmu_diffarg_t *da)
 		return (0);
 	}
 
+	/* A range thread passes its records on to be written in order */
+	if (da->da_parent != NULL) {
+		enqueue_record(da, &da->da_ddr, B_FALSE);
+		da->da_err = 0;
+		return (0);
+	}
+
 	fp = da->da_fp;
 	da->da_err = zfs_file_write(fp, (caddr_t)&da->da_ddr,
 	    sizeof (da->da_ddr), &resid);
@@ -107,7 +167,7 @@ diff_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	dmu_diffarg_t *da = arg;
 	int err = 0;
 
-	if (issig())
+	if (da->da_parent != NULL ? da->da_cancel : issig())
 		return (SET_ERROR(EINTR));
 
 	if (zb->zb_level == ZB_DNODE_LEVEL ||
@@ -117,9 +177,24 @@ diff_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	if (BP_IS_HOLE(bp)) {
 		uint64_t span = DBP_SPAN(dnp, zb->zb_level);
 		uint64_t dnobj = (zb->zb_blkid * span) >> DNODE_SHIFT;
+		uint64_t last = dnobj + (span >> DNODE_SHIFT) - 1;
 
-		err = report_free_dnode_range(da, dnobj,
-		    dnobj + (span >> DNODE_SHIFT) - 1);
+		/*
+		 * Holes can extend past either end of the object range of a
+		 * range thread.  Clip them to it, so that the records of
+		 * consecutive ranges follow each other in order.  A range
+		 * thread stops at the first object past its range.
+		 */
+		if (da->da_parent != NULL) {
+			if (da->da_end_object != 0) {
+				if (dnobj >= da->da_end_object)
+					return (SET_ERROR(EINTR));
+				last = MIN(last, da->da_end_object - 1);
+			}
+			dnobj = MAX(dnobj, da->da_start_object);
+		}
+
+		err = report_free_dnode_range(da, dnobj, last);
 		if (err)
 			return (err);
 	} else if (zb->zb_level == 0) {
@@ -130,6 +205,10 @@ diff_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 		int zio_flags = ZIO_FLAG_CANFAIL;
 		int i;
 
+		if (da->da_end_object != 0 &&
+		    zb->zb_blkid * DNODES_PER_BLOCK >= da->da_end_object)
+			return (SET_ERROR(EINTR));
+
 		if (BP_IS_PROTECTED(bp))
 			zio_flags |= ZIO_FLAG_RAW;
 
@@ -154,6 +233,158 @@ diff_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	return (0);
 }
 
+#define	DIFF_TRAVERSE_FLAGS	(TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA | \
+	TRAVERSE_NO_DECRYPT | TRAVERSE_LOGICAL)
+
+/*
+ * A range thread traverses every da_nrange_args'th object range, starting
+ * with its own index, and ends each range with an end marker.  Once the diff
+ * is cancelled or the traversal fails, it only ends the remaining ranges, so
+ * that dmu_diff_ranges() can still drain them in order.
+ */
+static __attribute__((noreturn)) void
+diff_range_thread(void *arg)
+{
+	dmu_diffarg_t *da = arg;
+	dmu_diffarg_t *parent = da->da_parent;
+	zbookmark_phys_t resume;
+	fstrans_cookie_t cookie = spl_fstrans_mark();
+
+	/*
+	 * Both da and parent may be freed as soon as the end marker of the
+	 * last range is enqueued, so nothing of them is used after that.
+	 */
+	uint64_t nranges = parent->da_nranges;
+	uint64_t nrange_args = parent->da_nrange_args;
+	uint64_t range_objects = parent->da_range_objects;
+
+	for (uint64_t r = da->da_range_idx; r < nranges; r += nrange_args) {
+		if (!da->da_cancel && da->da_err == 0) {
+			da->da_start_object = r * range_objects;
+			da->da_end_object = (r + 1 == nranges) ? 0 :
+			    (r + 1) * range_objects;
+			da->da_ddr.ddr_type = DDR_NONE;
+			da->da_ddr.ddr_first = da->da_ddr.ddr_last = 0;
+			SET_BOOKMARK(&resume, da->da_ds->ds_object,
+			    da->da_start_object, 0, 0);
+
+			int err = traverse_dataset_resume(da->da_ds,
+			    da->da_fromtxg, &resume, DIFF_TRAVERSE_FLAGS,
+			    diff_cb, da);
+			/* EINTR also marks reaching the end of the range */
+			if (err != 0 && err != EINTR)
+				da->da_err = err;
+			else
+				(void) write_record(da);
+		}
+		enqueue_record(da, NULL, B_TRUE);
+	}
+	spl_fstrans_unmark(cookie);
+	thread_exit();
+}
+
+/*
+ * Split the objects of the dataset into ranges for zfs_diff_traverse_threads
+ * range threads, and start them.  Returns B_FALSE if there are too few
+ * objects to split.
+ */
+static boolean_t
+setup_range_threads(dmu_diffarg_t *da, dsl_dataset_t *ds, uint64_t fromtxg)
+{
+	uint_t nthreads = zfs_diff_traverse_threads;
+	objset_t *os;
+	uint64_t end;
+
+	if (nthreads < 2 || dmu_objset_from_ds(ds, &os) != 0)
+		return (B_FALSE);
+	end = (DMU_META_DNODE(os)->dn_maxblkid + 1) * DNODES_PER_BLOCK;
+	if (end <= DNODES_PER_BLOCK)
+		return (B_FALSE);
+
+	da->da_range_objects = roundup(howmany(end,
+	    (uint64_t)nthreads * DIFF_RANGES_PER_THREAD), DNODES_PER_BLOCK);
+	da->da_nranges = howmany(end, da->da_range_objects);
+	da->da_nrange_args = MIN(nthreads, da->da_nranges);
+	da->da_range_args = kmem_zalloc(da->da_nrange_args *
+	    sizeof (*da->da_range_args), KM_SLEEP);
+
+	for (uint_t i = 0; i < da->da_nrange_args; i++) {
+		dmu_diffarg_t *rda = &da->da_range_args[i];
+
+		VERIFY0(bqueue_init(&rda->da_q, 20, DIFF_QUEUE_LENGTH,
+		    offsetof(diff_range_record_t, drr_ln)));
+		rda->da_parent = da;
+		rda->da_ds = ds;
+		rda->da_fromtxg = fromtxg;
+		rda->da_range_idx = i;
+	}
+	for (uint_t i = 0; i < da->da_nrange_args; i++) {
+		(void) thread_create(NULL, 0, diff_range_thread,
+		    &da->da_range_args[i], 0, curproc, TS_RUN, minclsyspri);
+	}
+	return (B_TRUE);
+}
+
+static void
+diff_ranges_cancel(dmu_diffarg_t *da)
+{
+	for (uint_t i = 0; i < da->da_nrange_args; i++)
+		da->da_range_args[i].da_cancel = B_TRUE;
+}
+
+/*
+ * Traversing the meta-dnode of a dataset with hundreds of millions of objects
+ * from a single thread is bound by the latency of reading its blocks one
+ * after the other.  With zfs_diff_traverse_threads above one, the objects are
+ * split into ranges that range threads traverse concurrently, each into a
+ * queue of its own.  This takes the records of each range off its thread's
+ * queue in turn and coalesces them with those of the range before, so the
+ * records written are the same as if a single thread had traversed the
+ * whole meta-dnode.
+ */
+static int
+dmu_diff_ranges(dmu_diffarg_t *da)
+{
+	diff_range_record_t *rec;
+
+	for (uint64_t r = 0; r < da->da_nranges; r++) {
+		dmu_diffarg_t *rda = &da->da_range_args[r % da->da_nrange_args];
+
+		for (rec = bqueue_dequeue(&rda->da_q); !rec->drr_eos;
+		    rec = bqueue_dequeue(&rda->da_q)) {
+			dmu_diff_record_t *ddr = &rec->drr_ddr;
+
+			if (da->da_err == 0 && issig())
+				da->da_err = SET_ERROR(EINTR);
+			if (da->da_err != 0) {
+				diff_ranges_cancel(da);
+			} else if (ddr->ddr_type == da->da_ddr.ddr_type &&
+			    ddr->ddr_first == da->da_ddr.ddr_last + 1) {
+				da->da_ddr.ddr_last = ddr->ddr_last;
+			} else if (write_record(da) == 0) {
+				da->da_ddr = *ddr;
+			}
+			kmem_free(rec, sizeof (*rec));
+		}
+		kmem_free(rec, sizeof (*rec));
+
+		if (da->da_err == 0)
+			da->da_err = rda->da_err;
+		if (da->da_err != 0)
+			diff_ranges_cancel(da);
+	}
+
+	for (uint_t i = 0; i < da->da_nrange_args; i++)
+		bqueue_destroy(&da->da_range_args[i].da_q);
+	kmem_free(da->da_range_args,
+	    da->da_nrange_args * sizeof (*da->da_range_args));
+	da->da_range_args = NULL;
+
+	if (da->da_err == 0)
+		(void) write_record(da);
+	return (da->da_err);
+}
+
 int
 dmu_diff(const char *tosnap_name, const char *fromsnap_name,
     zfs_file_t *fp, offset_t *offp)
@@ -199,11 +430,10 @@ dmu_diff(const char *tosnap_name, const char *fromsnap_name,
 	dsl_dataset_long_hold(tosnap, FTAG);
 	dsl_pool_rele(dp, FTAG);
 
+	memset(&da, 0, sizeof (da));
 	da.da_fp = fp;
 	da.da_offp = offp;
 	da.da_ddr.ddr_type = DDR_NONE;
-	da.da_ddr.ddr_first = da.da_ddr.ddr_last = 0;
-	da.da_err = 0;
 
 	/*
 	 * Since zfs diff only looks at dnodes which are stored in plaintext
@@ -213,11 +443,10 @@ dmu_diff(const char *tosnap_name, const char *fromsnap_name,
 	 * dataset isn't mounted and because it will fail when it attempts to
 	 * call the ZFS_IOC_OBJ_TO_STATS ioctl.
 	 */
-	error = traverse_dataset(tosnap, fromtxg,
-	    TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA | TRAVERSE_NO_DECRYPT |
-	    TRAVERSE_LOGICAL, diff_cb, &da);
-
-	if (error != 0) {
+	if (setup_range_threads(&da, tosnap, fromtxg)) {
+		(void) dmu_diff_ranges(&da);
+	} else if ((error = traverse_dataset(tosnap, fromtxg,
+	    DIFF_TRAVERSE_FLAGS, diff_cb, &da)) != 0) {
 		da.da_err = error;
 	} else {
 		/* we set the da.da_err we return as side-effect */
@@ -229,3 +458,6 @@ dmu_diff(const char *tosnap_name, const char *fromsnap_name,
 
 	return (da.da_err);
 }
+
+ZFS_MODULE_PARAM(zfs, zfs_, diff_traverse_threads, UINT, ZMOD_RW,
+	"Number of threads traversing object ranges of one diff");
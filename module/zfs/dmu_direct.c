@@ -389,6 +389,61 @@ dmu_write_uio_direct(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
 
 	return (err);
 }
+
+/*
+ * Direct I/O write of part of a block: read the whole block without caching
+ * it, merge in the new data, and write the block out directly.  Reading
+ * through dmu_read_abd() picks up any cached or dirty copy of the block,
+ * which dmu_write_direct() then undirties and drops.  The caller must hold
+ * the range lock over the whole block.
+ */
+int
+dmu_write_uio_direct_rmw(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
+    dmu_flags_t flags, dmu_tx_t *tx)
+{
+	offset_t offset = zfs_uio_offset(uio);
+	offset_t page_index = (offset - zfs_uio_soffset(uio)) >> PAGESHIFT;
+	spa_t *spa = dn->dn_objset->os_spa;
+	dmu_buf_t **dbp;
+	int numbufs, err;
+
+	ASSERT(uio->uio_extflg & UIO_DIRECT);
+	ASSERT3U(page_index, <, uio->uio_dio.npages);
+
+	err = dmu_buf_hold_array_by_dnode(dn, offset, size, B_FALSE, FTAG,
+	    &numbufs, &dbp, flags);
+	if (err)
+		return (err);
+
+	VERIFY3S(numbufs, ==, 1);
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[0];
+	uint64_t blkoff = offset - db->db.db_offset;
+	ASSERT3U(blkoff + size, <=, db->db.db_size);
+
+	abd_t *buf = abd_alloc_for_io(db->db.db_size, B_FALSE);
+	err = dmu_read_abd(dn, db->db.db_offset, db->db.db_size, buf, flags);
+	if (err) {
+		abd_free(buf);
+		dmu_buf_rele_array(dbp, numbufs, FTAG);
+		return (err);
+	}
+
+	abd_t *data = abd_alloc_from_pages(&uio->uio_dio.pages[page_index],
+	    offset & (PAGESIZE - 1), size);
+	abd_copy_off(buf, data, blkoff, 0, size);
+	abd_free(data);
+
+	/* The write frees buf when it is done. */
+	zfs_racct_write(spa, db->db.db_size, 1, flags);
+	err = dmu_write_direct(NULL, db, buf, tx);
+
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+
+	if (err == 0)
+		zfs_uioskip(uio, size);
+
+	return (err);
+}
 #endif /* _KERNEL */
 
 EXPORT_SYMBOL(dmu_read_abd);
@@ -61,11 +61,13 @@
 #include <sys/zfs_file.h>
 #include <sys/cred.h>
 #include <sys/fs/zfs.h>
+#include <cityhash.h>
 
 static uint_t zfs_recv_queue_length = SPA_MAXBLOCKSIZE;
 static uint_t zfs_recv_queue_ff = 20;
 static uint_t zfs_recv_write_batch_size = 1024 * 1024;
 static uint_t zfs_recv_defer_batch_size = 32 * 1024 * 1024;
+static uint_t zfs_recv_writer_threads = 4;
 static int zfs_recv_best_effort_corrective = 0;
 
 static const void *const dmu_recv_tag = "dmu_recv_tag";
@@ -91,6 +93,7 @@ struct receive_record_arg {
 	int payload_size;
 	uint64_t bytes_read; /* bytes read from stream when record created */
 	boolean_t eos_marker; /* Marks the end of the stream */
+	boolean_t barrier_marker; /* Flushes a writer shard */
 	bqueue_node_t node;
 };
 
@@ -120,6 +123,7 @@ struct receive_writer_arg {
 	int err;
 	const char *tofs;
 	boolean_t heal;
+	boolean_t uncached; /* write whole blocks with Direct I/O */
 	boolean_t resumable;
 	boolean_t raw;   /* DMU_BACKUP_FEATURE_RAW set */
 	boolean_t spill; /* DRR_FLAG_SPILL_BLOCK set */
@@ -129,6 +133,7 @@ struct receive_writer_arg {
 	uint64_t last_offset;
 	uint64_t max_object; /* highest object ID referenced in stream */
 	uint64_t bytes_read; /* bytes read when current record created */
+	uint64_t uncached_bytes; /* data written without going through ARC */
 
 	list_t write_batch;
 
@@ -159,11 +164,41 @@ struct receive_writer_arg {
 	uint64_t defer_first_bytes_read;
 	uint64_t defer_max_free_txg;
 	boolean_t defer_replaying;
+
+	/*
+	 * Writer shards the records of individual objects are handed to,
+	 * see receive_shard_dispatch().  shard_lock protects the inflight
+	 * counts and positions of every shard, the resume state they save,
+	 * and defer_first_object and defer_first_bytes_read above.
+	 */
+	struct receive_writer_arg *shards;
+	uint_t nshards;
+	uint64_t shard_max_object; /* highest object dispatched since drain */
+	uint64_t shard_last_object;
+	uint64_t shard_last_offset;
+	kmutex_t shard_lock;
+	kcondvar_t shard_cv;
+
+	/*
+	 * On a shard: the writer dispatching to it, the number of records
+	 * dispatched to it and not yet applied, and a lower bound on the
+	 * stream position of the first of them.
+	 */
+	struct receive_writer_arg *parent;
+	uint64_t inflight;
+	uint64_t inflight_object;
+	uint64_t inflight_bytes;
+
+	/* See receive_resume_bound() */
+	uint64_t bound_object;
+	uint64_t bound_bytes;
 };
 
 static int receive_process_record(struct receive_writer_arg *rwa,
     struct receive_record_arg *rrd);
 static int flush_write_batch(struct receive_writer_arg *rwa);
+static void receive_record_done(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd);
 
 typedef struct dmu_recv_begin_arg {
 	const char *drba_origin;
@@ -1328,9 +1363,9 @@ dmu_recv_resume_begin_sync(void *arg, dmu_tx_t *tx)
 int
 dmu_recv_begin(const char *tofs, const char *tosnap,
     dmu_replay_record_t *drr_begin, boolean_t force, boolean_t heal,
-    boolean_t resumable, nvlist_t *localprops, nvlist_t *hidden_args,
-    const char *origin, dmu_recv_cookie_t *drc, zfs_file_t *fp,
-    offset_t *voffp)
+    boolean_t uncached, boolean_t resumable, nvlist_t *localprops,
+    nvlist_t *hidden_args, const char *origin, dmu_recv_cookie_t *drc,
+    zfs_file_t *fp, offset_t *voffp)
 {
 	dmu_recv_begin_arg_t drba = { 0 };
 	int err = 0;
@@ -1345,6 +1380,7 @@ dmu_recv_begin(const char *tofs, const char *tosnap,
 	drc->drc_tofs = tofs;
 	drc->drc_force = force;
 	drc->drc_heal = heal;
+	drc->drc_uncached = uncached;
 	drc->drc_resumable = resumable;
 	drc->drc_cred = cr;
 	drc->drc_clone = (origin != NULL);
@@ -1692,6 +1728,83 @@ deduce_nblkptr(dmu_object_type_t bonus_type, uint64_t bonus_size,
 	}
 }
 
+/*
+ * When records are applied by several writer shards, records of other
+ * objects that are earlier in the stream may still be in flight on other
+ * shards while this one saves its resume state, or parked by the main
+ * writer.  Take the lowest stream position any of them can be at, to hold
+ * the saved state back to.  This must be done before the tx the state is
+ * saved in is assigned: whatever was applied before then is in the same
+ * txg or an earlier one, while records applied after it may land in a
+ * later txg.
+ */
+static void
+receive_resume_bound(struct receive_writer_arg *rwa)
+{
+	struct receive_writer_arg *mrwa =
+	    rwa->parent != NULL ? rwa->parent : rwa;
+
+	if (!rwa->resumable || mrwa->nshards == 0)
+		return;
+
+	rwa->bound_object = UINT64_MAX;
+	rwa->bound_bytes = UINT64_MAX;
+
+	mutex_enter(&mrwa->shard_lock);
+	for (uint_t i = 0; i < mrwa->nshards; i++) {
+		struct receive_writer_arg *s = &mrwa->shards[i];
+
+		if (s != rwa && s->inflight != 0 &&
+		    s->inflight_object < rwa->bound_object) {
+			rwa->bound_object = s->inflight_object;
+			rwa->bound_bytes = s->inflight_bytes;
+		}
+	}
+	if (mrwa->defer_first_object != 0 &&
+	    mrwa->defer_first_object < rwa->bound_object) {
+		rwa->bound_object = mrwa->defer_first_object;
+		rwa->bound_bytes = mrwa->defer_first_bytes_read;
+	}
+	mutex_exit(&mrwa->shard_lock);
+}
+
+/*
+ * save_resume_state() for a receive applied by several writer shards.  The
+ * position saved is held back to the bound taken by receive_resume_bound().
+ * Shards save their state into the same txg concurrently and not in stream
+ * order, so it is only ever advanced.  Any position saved in a txg is safe
+ * to resume from, and the highest one loses the least work.
+ */
+static void
+save_resume_state_sharded(struct receive_writer_arg *rwa,
+    uint64_t object, uint64_t offset, dmu_tx_t *tx)
+{
+	struct receive_writer_arg *mrwa =
+	    rwa->parent != NULL ? rwa->parent : rwa;
+	dsl_dataset_t *ds = rwa->os->os_dsl_dataset;
+	int txgoff = dmu_tx_get_txg(tx) & TXG_MASK;
+	uint64_t bytes = rwa->bytes_read;
+
+	if (rwa->bound_object < object ||
+	    (rwa->bound_object == object && offset != 0)) {
+		object = rwa->bound_object;
+		offset = 0;
+		bytes = MIN(bytes, rwa->bound_bytes);
+	}
+	ASSERT(bytes != 0);
+	ASSERT(object != 0);
+
+	mutex_enter(&mrwa->shard_lock);
+	if (object > ds->ds_resume_object[txgoff] ||
+	    (object == ds->ds_resume_object[txgoff] &&
+	    offset > ds->ds_resume_offset[txgoff])) {
+		ds->ds_resume_object[txgoff] = object;
+		ds->ds_resume_offset[txgoff] = offset;
+		ds->ds_resume_bytes[txgoff] = bytes;
+	}
+	mutex_exit(&mrwa->shard_lock);
+}
+
 static void
 save_resume_state(struct receive_writer_arg *rwa,
     uint64_t object, uint64_t offset, dmu_tx_t *tx)
@@ -1702,6 +1815,11 @@ save_resume_state(struct receive_writer_arg *rwa,
 	if (!rwa->resumable)
 		return;
 
+	if (rwa->parent != NULL || rwa->nshards > 0) {
+		save_resume_state_sharded(rwa, object, offset, tx);
+		return;
+	}
+
 	/*
 	 * While records are parked on the defer list (including while
 	 * they are being replayed), the resume point must not advance
@@ -2795,6 +2913,20 @@ receive_defer_overlaps(struct receive_writer_arg *rwa, uint64_t first,
 
 static int receive_defer_flush(struct receive_writer_arg *rwa);
 
+/*
+ * Set the resume-state pin.  Writer shards read it from receive_resume_bound()
+ * under shard_lock.
+ */
+static void
+receive_defer_pin(struct receive_writer_arg *rwa, uint64_t object,
+    uint64_t bytes)
+{
+	mutex_enter(&rwa->shard_lock);
+	rwa->defer_first_object = object;
+	rwa->defer_first_bytes_read = bytes;
+	mutex_exit(&rwa->shard_lock);
+}
+
 /*
  * Park a record for replay after the next defer flush.  The caller must
  * return EAGAIN without touching the record again: once the batch cap is
@@ -2820,8 +2952,7 @@ receive_defer_park(struct receive_writer_arg *rwa,
 		 * valid stream position for a DRR_OBJECT.
 		 */
 		ASSERT3U(rrd->header.drr_type, ==, DRR_OBJECT);
-		rwa->defer_first_object = object;
-		rwa->defer_first_bytes_read = rrd->bytes_read;
+		receive_defer_pin(rwa, object, rrd->bytes_read);
 	}
 	list_insert_tail(&rwa->defer_records, rrd);
 	rwa->defer_nrecords++;
@@ -2922,8 +3053,7 @@ receive_defer_flush(struct receive_writer_arg *rwa)
 	rwa->defer_replaying = B_FALSE;
 	rwa->defer_bytes = 0;
 	rwa->defer_nrecords = 0;
-	rwa->defer_first_object = 0;
-	rwa->defer_first_bytes_read = 0;
+	receive_defer_pin(rwa, 0, 0);
 	rwa->defer_max_free_txg = 0;
 
 	return (err);
@@ -2955,8 +3085,7 @@ receive_defer_cleanup(struct receive_writer_arg *rwa)
 		kmem_free(rdr, sizeof (*rdr));
 	rwa->defer_bytes = 0;
 	rwa->defer_nrecords = 0;
-	rwa->defer_first_object = 0;
-	rwa->defer_first_bytes_read = 0;
+	receive_defer_pin(rwa, 0, 0);
 	rwa->defer_max_free_txg = 0;
 }
 
@@ -3443,6 +3572,7 @@ receive_object(struct receive_writer_arg *rwa, struct drr_object *drro,
 	if (defer)
 		return (EAGAIN);
 
+	receive_resume_bound(rwa);
 	tx = dmu_tx_create(rwa->os);
 	dmu_tx_hold_bonus(tx, object_to_hold);
 	dmu_tx_hold_write(tx, object_to_hold, 0, 0);
@@ -3627,6 +3757,34 @@ receive_freeobjects(struct receive_writer_arg *rwa,
 	return (0);
 }
 
+/*
+ * Write a WRITE record whose size does not match the object's block size,
+ * from a linear abd of its logical size.  For an uncached receive, the
+ * record is written with Direct I/O if dmu_write_by_dnode() can, i.e. if it
+ * covers whole blocks, which bypasses the dbufs and so the ARC entirely.
+ * Anything else is written through the dbufs, which are evicted once the
+ * write has synced.
+ */
+static int
+receive_write_unmatched(struct receive_writer_arg *rwa, dnode_t *dn,
+    struct drr_write *drrw, abd_t *abd, dmu_tx_t *tx)
+{
+	dmu_flags_t flags = DMU_READ_NO_PREFETCH | DMU_UNCACHEDIO;
+	void *buf = abd_to_buf(abd);
+	int err;
+
+	if (rwa->uncached && !rwa->raw)
+		flags |= DMU_DIRECTIO;
+
+	err = dmu_write_by_dnode(dn, drrw->drr_offset, drrw->drr_logical_size,
+	    buf, tx, flags);
+	if (err == 0 && (flags & DMU_DIRECTIO) && zfs_dio_page_aligned(buf) &&
+	    zfs_dio_aligned(drrw->drr_offset, drrw->drr_logical_size,
+	    dn->dn_datablksz))
+		rwa->uncached_bytes += drrw->drr_logical_size;
+	return (err);
+}
+
 /*
  * Note: if this fails, the caller will clean up any records left on the
  * rwa->write_batch list.
@@ -3662,6 +3820,7 @@ flush_write_batch_impl(struct receive_writer_arg *rwa)
 		return (SET_ERROR(EINVAL));
 	}
 
+	receive_resume_bound(rwa);
 	dmu_tx_t *tx = dmu_tx_create(rwa->os);
 	dmu_tx_hold_write_by_dnode(tx, dn, first_drrw->drr_offset, hold_len +
 	    last_drrw->drr_logical_size);
@@ -3694,7 +3853,8 @@ flush_write_batch_impl(struct receive_writer_arg *rwa)
 			 * than the block size.  Either way a lightweight
 			 * write is not possible (those must cover exactly
 			 * one block), so we decompress the data (if
-			 * compressed) and do a normal dmu_write().
+			 * compressed) and write it with
+			 * receive_write_unmatched().
 			 */
 			if (DRR_WRITE_COMPRESSED(drrw)) {
 				abd_t *decomp_abd =
@@ -3708,21 +3868,13 @@ flush_write_batch_impl(struct receive_writer_arg *rwa)
 				    abd_get_size(decomp_abd), NULL);
 
 				if (err == 0) {
-					dmu_write_by_dnode(dn,
-					    drrw->drr_offset,
-					    drrw->drr_logical_size,
-					    abd_to_buf(decomp_abd), tx,
-					    DMU_READ_NO_PREFETCH |
-					    DMU_UNCACHEDIO);
+					err = receive_write_unmatched(rwa, dn,
+					    drrw, decomp_abd, tx);
 				}
 				abd_free(decomp_abd);
 			} else {
-				dmu_write_by_dnode(dn,
-				    drrw->drr_offset,
-				    drrw->drr_logical_size,
-				    abd_to_buf(abd), tx,
-				    DMU_READ_NO_PREFETCH |
-				    DMU_UNCACHEDIO);
+				err = receive_write_unmatched(rwa, dn, drrw,
+				    abd, tx);
 			}
 			if (err == 0)
 				abd_free(abd);
@@ -3783,6 +3935,8 @@ flush_write_batch_impl(struct receive_writer_arg *rwa)
 			 */
 			err = dmu_lightweight_write_by_dnode(dn,
 			    drrw->drr_offset, abd, &zp, zio_flags, tx);
+			if (err == 0)
+				rwa->uncached_bytes += drrw->drr_logical_size;
 		}
 
 		if (err != 0) {
@@ -3802,7 +3956,7 @@ flush_write_batch_impl(struct receive_writer_arg *rwa)
 		save_resume_state(rwa, drrw->drr_object, drrw->drr_offset, tx);
 
 		list_remove(&rwa->write_batch, rrd);
-		kmem_free(rrd, sizeof (*rrd));
+		receive_record_done(rwa, rrd);
 	}
 
 	dmu_tx_commit(tx);
@@ -3822,7 +3976,7 @@ flush_write_batch(struct receive_writer_arg *rwa)
 		struct receive_record_arg *rrd;
 		while ((rrd = list_remove_head(&rwa->write_batch)) != NULL) {
 			abd_free(rrd->abd);
-			kmem_free(rrd, sizeof (*rrd));
+			receive_record_done(rwa, rrd);
 		}
 	}
 	ASSERT(list_is_empty(&rwa->write_batch));
@@ -3943,6 +4097,7 @@ receive_write_embedded(struct receive_writer_arg *rwa,
 	if (drrwe->drr_object > rwa->max_object)
 		rwa->max_object = drrwe->drr_object;
 
+	receive_resume_bound(rwa);
 	tx = dmu_tx_create(rwa->os);
 
 	dmu_tx_hold_write(tx, drrwe->drr_object,
@@ -4606,6 +4761,181 @@ dprintf_drr(struct receive_record_arg *rrd, int err)
 #endif
 }
 
+/*
+ * Once an object exists, its records are independent of those of other
+ * objects.  With zfs_recv_writer_threads above one, the writer thread hands
+ * the data records of each object (DRR_WRITE, DRR_WRITE_EMBEDDED, DRR_FREE,
+ * DRR_SPILL and DRR_REDACT) to one of several writer shards, chosen by
+ * object number.  Each shard is a receive_writer_arg of its own running
+ * receive_writer_thread() on its own queue and write batch, so the records
+ * of an object are still applied in stream order and batched together.
+ *
+ * Everything else, which is to say DRR_OBJECT and DRR_FREEOBJECTS records
+ * and the deferred claims of receive_defer_park(), stays on the writer
+ * thread.  Before applying a record that touches objects a shard may still
+ * hold records of, it drains the shards.  Senders emit objects in ascending
+ * order, so the records held by the shards normally all belong to lower
+ * objects and this wait is rare.
+ *
+ * Raw and healing receives are not sharded: DRR_OBJECT_RANGE encryption
+ * parameters apply to the objects that follow them, and healing only
+ * rewrites blocks found damaged, which is not worth spreading out.
+ */
+
+/*
+ * The (first) object a record applies to.
+ */
+static uint64_t
+receive_record_object(const struct receive_record_arg *rrd)
+{
+	switch (rrd->header.drr_type) {
+	case DRR_OBJECT:
+		return (rrd->header.drr_u.drr_object.drr_object);
+	case DRR_FREEOBJECTS:
+		return (rrd->header.drr_u.drr_freeobjects.drr_firstobj);
+	case DRR_WRITE:
+		return (rrd->header.drr_u.drr_write.drr_object);
+	case DRR_WRITE_EMBEDDED:
+		return (rrd->header.drr_u.drr_write_embedded.drr_object);
+	case DRR_FREE:
+		return (rrd->header.drr_u.drr_free.drr_object);
+	case DRR_SPILL:
+		return (rrd->header.drr_u.drr_spill.drr_object);
+	case DRR_OBJECT_RANGE:
+		return (rrd->header.drr_u.drr_object_range.drr_firstobj);
+	case DRR_REDACT:
+		return (rrd->header.drr_u.drr_redact.drr_object);
+	default:
+		return (0);
+	}
+}
+
+static boolean_t
+receive_record_shardable(const struct receive_record_arg *rrd)
+{
+	switch (rrd->header.drr_type) {
+	case DRR_WRITE:
+	case DRR_WRITE_EMBEDDED:
+	case DRR_FREE:
+	case DRR_SPILL:
+	case DRR_REDACT:
+		return (receive_record_object(rrd) != 0);
+	default:
+		return (B_FALSE);
+	}
+}
+
+/*
+ * Free a record that has been applied, or dropped after an error.  On a
+ * shard, this also takes it off the records in flight there.  The shard
+ * applies its records in order, so the ones still in flight are of this
+ * record's object or later ones.
+ */
+static void
+receive_record_done(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd)
+{
+	struct receive_writer_arg *mrwa = rwa->parent;
+
+	if (mrwa != NULL) {
+		mutex_enter(&mrwa->shard_lock);
+		ASSERT3U(rwa->inflight, >, 0);
+		if (--rwa->inflight == 0) {
+			cv_broadcast(&mrwa->shard_cv);
+		} else {
+			rwa->inflight_object = receive_record_object(rrd);
+			rwa->inflight_bytes = rrd->bytes_read;
+		}
+		mutex_exit(&mrwa->shard_lock);
+	}
+	kmem_free(rrd, sizeof (*rrd));
+}
+
+/*
+ * The first error any shard has hit.  Each shard is the only writer of its
+ * err, so as with the writer thread's own err it's read without locks.
+ */
+static int
+receive_shards_error(struct receive_writer_arg *rwa)
+{
+	for (uint_t i = 0; i < rwa->nshards; i++) {
+		if (rwa->shards[i].err != 0)
+			return (rwa->shards[i].err);
+	}
+	return (0);
+}
+
+/*
+ * Queue a data record on the shard applying the records of its object.
+ * Shards only see the records of their own objects, so the stream order of
+ * DRR_WRITE records checked by receive_process_write_record() is checked
+ * here as well.
+ */
+static int
+receive_shard_dispatch(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd)
+{
+	uint64_t object = receive_record_object(rrd);
+	struct receive_writer_arg *s;
+
+	if (rrd->header.drr_type == DRR_WRITE) {
+		uint64_t offset = rrd->header.drr_u.drr_write.drr_offset;
+
+		if (object < rwa->shard_last_object ||
+		    (object == rwa->shard_last_object &&
+		    offset < rwa->shard_last_offset))
+			return (SET_ERROR(EINVAL));
+		rwa->shard_last_object = object;
+		rwa->shard_last_offset = offset;
+	}
+
+	s = &rwa->shards[cityhash1(object) % rwa->nshards];
+	mutex_enter(&rwa->shard_lock);
+	if (s->inflight++ == 0) {
+		s->inflight_object = object;
+		s->inflight_bytes = rrd->bytes_read;
+	}
+	mutex_exit(&rwa->shard_lock);
+	rwa->shard_max_object = MAX(rwa->shard_max_object, object);
+
+	bqueue_enqueue(&s->q, rrd, sizeof (*rrd) + rrd->payload_size);
+	return (0);
+}
+
+/*
+ * Wait for the shards to apply every record dispatched to them, including
+ * those still waiting in their write batches.
+ */
+static int
+receive_shards_drain(struct receive_writer_arg *rwa)
+{
+	for (uint_t i = 0; i < rwa->nshards; i++) {
+		struct receive_writer_arg *s = &rwa->shards[i];
+		struct receive_record_arg *rrd;
+		boolean_t busy;
+
+		mutex_enter(&rwa->shard_lock);
+		busy = (s->inflight != 0);
+		mutex_exit(&rwa->shard_lock);
+		if (!busy)
+			continue;
+
+		rrd = kmem_zalloc(sizeof (*rrd), KM_SLEEP);
+		rrd->barrier_marker = B_TRUE;
+		bqueue_enqueue_flush(&s->q, rrd, 1);
+	}
+
+	mutex_enter(&rwa->shard_lock);
+	for (uint_t i = 0; i < rwa->nshards; i++) {
+		while (rwa->shards[i].inflight != 0)
+			cv_wait(&rwa->shard_cv, &rwa->shard_lock);
+	}
+	mutex_exit(&rwa->shard_lock);
+	rwa->shard_max_object = 0;
+
+	return (receive_shards_error(rwa));
+}
+
 /*
  * Commit the records to the pool.
  */
@@ -4647,6 +4977,36 @@ receive_process_record(struct receive_writer_arg *rwa,
 			return (err);
 	}
 
+	/*
+	 * Hand data records to the shards.  Records replayed by the defer
+	 * flush are applied here: the shards were never given any records
+	 * of the objects they touch.  Anything else waits for the shards if
+	 * they may hold records of the objects it touches.
+	 */
+	if (rwa->nshards > 0) {
+		err = 0;
+		if (!rwa->defer_replaying && receive_record_shardable(rrd)) {
+			err = receive_shard_dispatch(rwa, rrd);
+			if (err == 0)
+				return (EAGAIN);
+		} else if (rwa->shard_max_object != 0 &&
+		    receive_record_object(rrd) <= rwa->shard_max_object) {
+			err = receive_shards_drain(rwa);
+		}
+
+		if (err != 0) {
+			if (rrd->abd != NULL) {
+				abd_free(rrd->abd);
+				rrd->abd = NULL;
+				rrd->payload = NULL;
+			} else if (rrd->payload != NULL) {
+				vmem_free(rrd->payload, rrd->payload_size);
+				rrd->payload = NULL;
+			}
+			return (err);
+		}
+	}
+
 	if (!rwa->heal && rrd->header.drr_type != DRR_WRITE) {
 		err = flush_write_batch(rwa);
 		if (err != 0) {
@@ -4759,9 +5119,77 @@ receive_process_record(struct receive_writer_arg *rwa,
 	return (err);
 }
 
+static void
+receive_writer_init(struct receive_writer_arg *rwa, size_t queue_length)
+{
+	(void) bqueue_init(&rwa->q, zfs_recv_queue_ff,
+	    MAX(queue_length, 2 * zfs_max_recordsize),
+	    offsetof(struct receive_record_arg, node));
+	cv_init(&rwa->cv, NULL, CV_DEFAULT, NULL);
+	mutex_init(&rwa->mutex, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&rwa->shard_cv, NULL, CV_DEFAULT, NULL);
+	mutex_init(&rwa->shard_lock, NULL, MUTEX_DEFAULT, NULL);
+	list_create(&rwa->write_batch, sizeof (struct receive_record_arg),
+	    offsetof(struct receive_record_arg, node.bqn_node));
+	list_create(&rwa->defer_records, sizeof (struct receive_record_arg),
+	    offsetof(struct receive_record_arg, node.bqn_node));
+	avl_create(&rwa->defer_ranges, receive_defer_range_compare,
+	    sizeof (receive_defer_range_t),
+	    offsetof(receive_defer_range_t, rdr_node));
+}
+
+static void
+receive_writer_fini(struct receive_writer_arg *rwa)
+{
+	cv_destroy(&rwa->cv);
+	mutex_destroy(&rwa->mutex);
+	cv_destroy(&rwa->shard_cv);
+	mutex_destroy(&rwa->shard_lock);
+	bqueue_destroy(&rwa->q);
+	list_destroy(&rwa->write_batch);
+	list_destroy(&rwa->defer_records);
+	avl_destroy(&rwa->defer_ranges);
+}
+
+/*
+ * Stop the writer shards once they have applied everything dispatched to
+ * them, and fold their results into the writer thread's.
+ */
+static void
+receive_shards_fini(struct receive_writer_arg *rwa)
+{
+	for (uint_t i = 0; i < rwa->nshards; i++) {
+		struct receive_record_arg *rrd;
+
+		rrd = kmem_zalloc(sizeof (*rrd), KM_SLEEP);
+		rrd->eos_marker = B_TRUE;
+		bqueue_enqueue_flush(&rwa->shards[i].q, rrd, 1);
+	}
+
+	for (uint_t i = 0; i < rwa->nshards; i++) {
+		struct receive_writer_arg *s = &rwa->shards[i];
+
+		mutex_enter(&s->mutex);
+		while (!s->done)
+			cv_wait(&s->cv, &s->mutex);
+		mutex_exit(&s->mutex);
+
+		if (rwa->err == 0)
+			rwa->err = s->err;
+		rwa->max_object = MAX(rwa->max_object, s->max_object);
+		rwa->uncached_bytes += s->uncached_bytes;
+		receive_writer_fini(s);
+	}
+
+	kmem_free(rwa->shards, rwa->nshards * sizeof (*rwa->shards));
+	rwa->shards = NULL;
+	rwa->nshards = 0;
+}
+
 /*
  * dmu_recv_stream's worker thread; pull records off the queue, and then call
  * receive_process_record  When we're done, signal the main thread and exit.
+ * This also runs the writer shards, see receive_shard_dispatch().
  */
 static __attribute__((noreturn)) void
 receive_writer_thread(void *arg)
@@ -4772,13 +5200,24 @@ receive_writer_thread(void *arg)
 
 	for (rrd = bqueue_dequeue(&rwa->q); !rrd->eos_marker;
 	    rrd = bqueue_dequeue(&rwa->q)) {
+		if (rrd->barrier_marker) {
+			/* See receive_shards_drain() */
+			int err = flush_write_batch(rwa);
+			if (rwa->err == 0)
+				rwa->err = err;
+			kmem_free(rrd, sizeof (*rrd));
+			continue;
+		}
+
 		/*
 		 * If there's an error, the main thread will stop putting things
 		 * on the queue, but we need to clear everything in it before we
-		 * can exit.
+		 * can exit.  Shards stop applying records once the writer
+		 * thread feeding them has failed.
 		 */
 		int err = 0;
-		if (rwa->err == 0) {
+		if (rwa->err == 0 &&
+		    (rwa->parent == NULL || rwa->parent->err == 0)) {
 			err = receive_process_record(rwa, rrd);
 		} else if (rrd->abd != NULL) {
 			abd_free(rrd->abd);
@@ -4790,17 +5229,19 @@ receive_writer_thread(void *arg)
 		}
 		/*
 		 * EAGAIN indicates that ownership of this record has
-		 * moved: it was either saved on rwa->write_batch, or
-		 * parked on the defer list to be replayed and freed by
-		 * the defer flush (or by the defer cleanup on error).
-		 * Either way we don't free it here.
+		 * moved: it was either saved on rwa->write_batch, handed
+		 * to a shard, or parked on the defer list to be replayed
+		 * and freed by the defer flush (or by the defer cleanup on
+		 * error).  Either way we don't free it here.
 		 * When healing data we always need to free the record.
 		 */
 		if (err != EAGAIN || rwa->heal) {
 			if (rwa->err == 0)
 				rwa->err = err;
-			kmem_free(rrd, sizeof (*rrd));
+			receive_record_done(rwa, rrd);
 		}
+		if (rwa->err == 0 && rwa->nshards > 0)
+			rwa->err = receive_shards_error(rwa);
 	}
 	kmem_free(rrd, sizeof (*rrd));
 
@@ -4816,6 +5257,8 @@ receive_writer_thread(void *arg)
 		if (rwa->err == 0)
 			rwa->err = err;
 	}
+	if (rwa->nshards > 0)
+		receive_shards_fini(rwa);
 	receive_defer_cleanup(rwa);
 	mutex_enter(&rwa->mutex);
 	rwa->done = B_TRUE;
@@ -4825,6 +5268,34 @@ receive_writer_thread(void *arg)
 	thread_exit();
 }
 
+static void
+receive_shards_init(struct receive_writer_arg *rwa, uint_t nshards)
+{
+	rwa->shards = kmem_zalloc(nshards * sizeof (*rwa->shards), KM_SLEEP);
+	rwa->nshards = nshards;
+
+	for (uint_t i = 0; i < nshards; i++) {
+		struct receive_writer_arg *s = &rwa->shards[i];
+
+		receive_writer_init(s, zfs_recv_queue_length / nshards);
+		s->os = rwa->os;
+		s->byteswap = rwa->byteswap;
+		s->tofs = rwa->tofs;
+		s->uncached = rwa->uncached;
+		s->resumable = rwa->resumable;
+		s->raw = rwa->raw;
+		s->spill = rwa->spill;
+		s->full = rwa->full;
+		s->featureflags = rwa->featureflags;
+		s->parent = rwa;
+	}
+
+	for (uint_t i = 0; i < nshards; i++) {
+		(void) thread_create(NULL, 0, receive_writer_thread,
+		    &rwa->shards[i], 0, curproc, TS_RUN, minclsyspri);
+	}
+}
+
 static int
 resume_check(dmu_recv_cookie_t *drc, nvlist_t *begin_nvl)
 {
@@ -4947,14 +5418,11 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, offset_t *voffp)
 	 */
 	drc->drc_should_save = B_TRUE;
 
-	(void) bqueue_init(&rwa->q, zfs_recv_queue_ff,
-	    MAX(zfs_recv_queue_length, 2 * zfs_max_recordsize),
-	    offsetof(struct receive_record_arg, node));
-	cv_init(&rwa->cv, NULL, CV_DEFAULT, NULL);
-	mutex_init(&rwa->mutex, NULL, MUTEX_DEFAULT, NULL);
+	receive_writer_init(rwa, zfs_recv_queue_length);
 	rwa->os = drc->drc_os;
 	rwa->byteswap = drc->drc_byteswap;
 	rwa->heal = drc->drc_heal;
+	rwa->uncached = drc->drc_uncached;
 	rwa->tofs = drc->drc_tofs;
 	rwa->resumable = drc->drc_resumable;
 	rwa->raw = drc->drc_raw;
@@ -4966,13 +5434,10 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, offset_t *voffp)
 		rwa->heal_pio = zio_root(drc->drc_os->os_spa, NULL, NULL,
 		    ZIO_FLAG_GODFATHER);
 	}
-	list_create(&rwa->write_batch, sizeof (struct receive_record_arg),
-	    offsetof(struct receive_record_arg, node.bqn_node));
-	list_create(&rwa->defer_records, sizeof (struct receive_record_arg),
-	    offsetof(struct receive_record_arg, node.bqn_node));
-	avl_create(&rwa->defer_ranges, receive_defer_range_compare,
-	    sizeof (receive_defer_range_t),
-	    offsetof(receive_defer_range_t, rdr_node));
+
+	uint_t nshards = MIN(zfs_recv_writer_threads, max_ncpus);
+	if (!rwa->raw && !rwa->heal && nshards > 1)
+		receive_shards_init(rwa, nshards);
 
 	(void) thread_create(NULL, 0, receive_writer_thread, rwa, 0, curproc,
 	    TS_RUN, minclsyspri);
@@ -5056,14 +5521,10 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, offset_t *voffp)
 		}
 	}
 
-	cv_destroy(&rwa->cv);
-	mutex_destroy(&rwa->mutex);
-	bqueue_destroy(&rwa->q);
-	list_destroy(&rwa->write_batch);
-	list_destroy(&rwa->defer_records);
-	avl_destroy(&rwa->defer_ranges);
+	receive_writer_fini(rwa);
 	if (err == 0)
 		err = rwa->err;
+	drc->drc_uncached_bytes = rwa->uncached_bytes;
 
 out:
 	/*
@@ -5430,5 +5891,8 @@ ZFS_MODULE_PARAM(zfs_recv, zfs_recv_, defer_batch_size, UINT, ZMOD_RW,
 	"Maximum bytes of records parked behind one txg sync while "
 	"receiving reallocated dnodes (0 to sync per object)");
 
+ZFS_MODULE_PARAM(zfs_recv, zfs_recv_, writer_threads, UINT, ZMOD_RW,
+	"Number of threads the records of different objects are applied by");
+
 ZFS_MODULE_PARAM(zfs_recv, zfs_recv_, best_effort_corrective, INT, ZMOD_RW,
 	"Ignore errors during corrective receive");
@@ -85,6 +85,17 @@ static uint_t zfs_send_no_prefetch_queue_length = 1024 * 1024;
 static uint_t zfs_send_queue_ff = 20;
 static uint_t zfs_send_no_prefetch_queue_ff = 20;
 
+/*
+ * The number of threads that traverse the dataset for one send stream.  With
+ * more than one, the meta-dnode is split into object ranges that are traversed
+ * concurrently, and their records are passed on in object order.  See
+ * send_traverse_ranges_thread().
+ */
+static uint_t zfs_send_traverse_threads = 1;
+
+/* Number of object ranges to split a send into per traversal thread */
+#define	SEND_RANGES_PER_THREAD	16
+
 /*
  * Use this to override the recordsize calculation for fast zfs send estimates.
  */
@@ -115,6 +126,28 @@ struct send_thread_arg {
 	boolean_t	cancel;
 	zbookmark_phys_t resume;
 	uint64_t	*num_blocks_visited;
+
+	/*
+	 * When the traversal is split into object ranges: the ranges, the
+	 * threads traversing them, and the range currently being passed on.
+	 */
+	struct send_thread_arg *range_args;
+	uint_t		nrange_args;
+	uint64_t	range_first;	/* First object of range 1 and up */
+	uint64_t	range_objects;	/* Objects per range */
+	uint64_t	nranges;
+	uint64_t	range_cur;
+
+	/*
+	 * On a range thread: the thread passing its records on, and the
+	 * object range being traversed.  Data of ranges after range_cur is
+	 * prefetched into the ARC.
+	 */
+	struct send_thread_arg *range_parent;
+	uint64_t	range_idx;
+	uint64_t	start_object;
+	uint64_t	end_object;	/* 0 for the last range */
+	boolean_t	prefetch;
 };
 
 struct redact_list_thread_arg {
@@ -1053,6 +1086,28 @@ range_alloc(enum type type, uint64_t object, uint64_t start_blkid,
 	return (range);
 }
 
+/*
+ * Prefetch a data block of an object range whose records are not being passed
+ * on yet, so that the reads of several ranges are in flight at once.  The
+ * reader thread finds the block in the ARC once the range is passed on.
+ */
+static void
+send_prefetch_data(struct send_thread_arg *sta, const blkptr_t *bp,
+    const zbookmark_phys_t *zb)
+{
+	zio_flag_t zioflags = ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE;
+	arc_flags_t aflags = ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH |
+	    ARC_FLAG_PRESCIENT_PREFETCH;
+
+	if (BP_IS_EMBEDDED(bp))
+		return;
+	if ((sta->flags & TRAVERSE_NO_DECRYPT) && BP_IS_PROTECTED(bp))
+		zioflags |= ZIO_FLAG_RAW;
+
+	(void) arc_read(NULL, sta->os->os_spa, bp, NULL, NULL,
+	    ZIO_PRIORITY_ASYNC_READ, zioflags, &aflags, zb);
+}
+
 /*
  * This is the callback function to traverse_dataset that acts as a worker
  * thread for dmu_send_impl.
@@ -1083,6 +1138,9 @@ send_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	if (zb->zb_object != DMU_META_DNODE_OBJECT &&
 	    DMU_OBJECT_IS_SPECIAL(zb->zb_object))
 		return (0);
+	/* A range thread stops at the first object past its range. */
+	if (sta->end_object != 0 && zb->zb_object >= sta->end_object)
+		return (SET_ERROR(EINTR));
 	atomic_inc_64(sta->num_blocks_visited);
 
 	if (zb->zb_level == ZB_DNODE_LEVEL) {
@@ -1098,6 +1156,9 @@ send_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	}
 	if (zb->zb_level == 0 && zb->zb_object == DMU_META_DNODE_OBJECT &&
 	    !BP_IS_HOLE(bp)) {
+		if (sta->end_object != 0 &&
+		    zb->zb_blkid * DNODES_PER_BLOCK >= sta->end_object)
+			return (SET_ERROR(EINTR));
 		record = range_alloc(OBJECT_RANGE, 0, zb->zb_blkid,
 		    zb->zb_blkid + 1, B_FALSE);
 		record->sru.object_range.bp = *bp;
@@ -1110,7 +1171,7 @@ send_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 		return (0);
 
 	uint64_t span = bp_span_in_blocks(dnp->dn_indblkshift, zb->zb_level);
-	uint64_t start;
+	uint64_t start, end;
 
 	/*
 	 * If this multiply overflows, we don't need to send this block.
@@ -1127,6 +1188,27 @@ send_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	if (zb->zb_blkid == DMU_SPILL_BLKID)
 		ASSERT3U(BP_GET_TYPE(bp), ==, DMU_OT_SA);
 
+	end = (start + span < start ? 0 : start + span);
+
+	/*
+	 * Holes in the meta-dnode can extend past either end of the object
+	 * range of a range thread.  Clip them to it, so that the records of
+	 * consecutive ranges follow each other in order.  Ranges start and
+	 * end on dnode block boundaries, except where the send is resumed.
+	 */
+	if (zb->zb_object == DMU_META_DNODE_OBJECT &&
+	    sta->range_parent != NULL) {
+		uint64_t first = sta->start_object / DNODES_PER_BLOCK;
+		uint64_t last = sta->end_object / DNODES_PER_BLOCK;
+
+		if (sta->end_object != 0 && start >= last)
+			return (SET_ERROR(EINTR));
+		start = MAX(start, first);
+		if (sta->end_object != 0 && (end == 0 || end > last))
+			end = last;
+		ASSERT(end == 0 || start < end);
+	}
+
 	enum type record_type = DATA;
 	if (BP_IS_HOLE(bp))
 		record_type = HOLE;
@@ -1135,11 +1217,11 @@ send_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	else
 		record_type = DATA;
 
-	record = range_alloc(record_type, zb->zb_object, start,
-	    (start + span < start ? 0 : start + span), B_FALSE);
+	record = range_alloc(record_type, zb->zb_object, start, end, B_FALSE);
 
 	uint64_t datablksz = (zb->zb_blkid == DMU_SPILL_BLKID ?
 	    BP_GET_LSIZE(bp) : dnp->dn_datablkszsec << SPA_MINBLOCKSHIFT);
+	size_t size = sizeof (*record);
 
 	if (BP_IS_HOLE(bp)) {
 		record->sru.hole.datablksz = datablksz;
@@ -1149,9 +1231,20 @@ send_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 		record->sru.data.datablksz = datablksz;
 		record->sru.data.obj_type = dnp->dn_type;
 		record->sru.data.bp = *bp;
+
+		/*
+		 * A range thread's queue is sized by the data it may have
+		 * prefetched, to bound how far ahead it reads.
+		 */
+		if (sta->range_parent != NULL) {
+			if (sta->prefetch &&
+			    sta->range_idx > sta->range_parent->range_cur)
+				send_prefetch_data(sta, bp, zb);
+			size = datablksz;
+		}
 	}
 
-	bqueue_enqueue(&sta->q, record, sizeof (*record));
+	bqueue_enqueue(&sta->q, record, size);
 	return (0);
 }
 
@@ -1210,6 +1303,123 @@ send_traverse_thread(void *arg)
 	thread_exit();
 }
 
+/*
+ * Set up a range thread to traverse object range r.  The first range starts
+ * where the send does, which may be in the middle of an object when it is
+ * resumed; the others start at the beginning of a dnode block.
+ */
+static void
+send_range_setup(struct send_thread_arg *parent, struct send_thread_arg *sta,
+    uint64_t r)
+{
+	if (r == 0) {
+		sta->resume = parent->resume;
+	} else {
+		SET_BOOKMARK(&sta->resume,
+		    parent->os->os_dsl_dataset->ds_object,
+		    parent->range_first + r * parent->range_objects, 0, 0);
+	}
+	sta->range_idx = r;
+	sta->start_object = sta->resume.zb_object;
+	sta->end_object = (r + 1 == parent->nranges) ? 0 :
+	    parent->range_first + (r + 1) * parent->range_objects;
+}
+
+/*
+ * A range thread traverses every nrange_args'th object range, starting with
+ * its own index, and ends each range with an End of Stream record.  Once the
+ * send is cancelled or the traversal fails, it only ends the remaining ranges,
+ * so that send_traverse_ranges_thread() can still drain them in order.
+ */
+static __attribute__((noreturn)) void
+send_traverse_range_thread(void *arg)
+{
+	struct send_thread_arg *st_arg = arg;
+	struct send_thread_arg *parent = st_arg->range_parent;
+	struct send_range *data;
+	fstrans_cookie_t cookie = spl_fstrans_mark();
+
+	for (uint64_t r = st_arg->range_idx; r < parent->nranges;
+	    r += parent->nrange_args) {
+		if (!st_arg->cancel && st_arg->error_code == 0) {
+			send_range_setup(parent, st_arg, r);
+			int err = traverse_dataset_resume(
+			    st_arg->os->os_dsl_dataset, st_arg->fromtxg,
+			    &st_arg->resume, st_arg->flags | TRAVERSE_LOGICAL,
+			    send_cb, st_arg);
+			/* EINTR also marks reaching the end of the range */
+			if (err != EINTR)
+				st_arg->error_code = err;
+		}
+		data = range_alloc(DATA, 0, 0, 0, B_TRUE);
+		bqueue_enqueue_flush(&st_arg->q, data, sizeof (*data));
+	}
+	spl_fstrans_unmark(cookie);
+	thread_exit();
+}
+
+static void
+send_ranges_cancel(struct send_thread_arg *st_arg)
+{
+	for (uint_t i = 0; i < st_arg->nrange_args; i++)
+		st_arg->range_args[i].cancel = B_TRUE;
+}
+
+/*
+ * Traversing a dataset with billions of blocks from a single thread is bound
+ * by the latency of reading its indirect blocks one after the other.  With
+ * zfs_send_traverse_threads above one, the objects of the dataset are split
+ * into ranges that range threads traverse concurrently, each into a queue of
+ * its own.  This thread takes the records of each range off its thread's
+ * queue in turn, and passes them on as if a single thread had traversed the
+ * whole dataset.  Range threads that are ahead of the range being passed on
+ * prefetch the data of their blocks, so that the data reads of several parts
+ * of the dataset are in flight at once as well.
+ */
+static __attribute__((noreturn)) void
+send_traverse_ranges_thread(void *arg)
+{
+	struct send_thread_arg *st_arg = arg;
+	struct send_range *range;
+	int err = 0;
+	fstrans_cookie_t cookie = spl_fstrans_mark();
+
+	for (uint64_t r = 0; r < st_arg->nranges; r++) {
+		struct send_thread_arg *sta =
+		    &st_arg->range_args[r % st_arg->nrange_args];
+
+		st_arg->range_cur = r;
+		for (range = bqueue_dequeue(&sta->q); !range->eos_marker;
+		    range = bqueue_dequeue(&sta->q)) {
+			if (err == 0 && !st_arg->cancel) {
+				bqueue_enqueue(&st_arg->q, range,
+				    sizeof (*range));
+				continue;
+			}
+			range_free(range);
+			send_ranges_cancel(st_arg);
+		}
+		range_free(range);
+
+		if (err == 0)
+			err = sta->error_code;
+		if (err != 0 || st_arg->cancel)
+			send_ranges_cancel(st_arg);
+	}
+
+	for (uint_t i = 0; i < st_arg->nrange_args; i++)
+		bqueue_destroy(&st_arg->range_args[i].q);
+	kmem_free(st_arg->range_args,
+	    st_arg->nrange_args * sizeof (*st_arg->range_args));
+	st_arg->range_args = NULL;
+
+	st_arg->error_code = err;
+	range = range_alloc(DATA, 0, 0, 0, B_TRUE);
+	bqueue_enqueue_flush(&st_arg->q, range, sizeof (*range));
+	spl_fstrans_unmark(cookie);
+	thread_exit();
+}
+
 /*
  * Utility function that causes End of Stream records to compare after of all
  * others, so that other threads' comparison logic can stay simple.
@@ -2064,9 +2274,56 @@ create_begin_record(struct dmu_send_params *dspp, objset_t *os,
 	return (drr);
 }
 
+/*
+ * Split the objects from where the send starts up to the end of the
+ * meta-dnode into ranges for zfs_send_traverse_threads range threads, and
+ * start them.  Returns B_FALSE if there are too few objects to split.
+ */
+static boolean_t
+setup_range_threads(struct send_thread_arg *to_arg, boolean_t issue_reads)
+{
+	uint_t nthreads = zfs_send_traverse_threads;
+	uint64_t first = P2ALIGN_TYPED(to_arg->resume.zb_object,
+	    DNODES_PER_BLOCK, uint64_t);
+	uint64_t end = (DMU_META_DNODE(to_arg->os)->dn_maxblkid + 1) *
+	    DNODES_PER_BLOCK;
+
+	if (nthreads < 2 || end <= first + DNODES_PER_BLOCK)
+		return (B_FALSE);
+
+	to_arg->range_first = first;
+	to_arg->range_objects = roundup(howmany(end - first,
+	    (uint64_t)nthreads * SEND_RANGES_PER_THREAD), DNODES_PER_BLOCK);
+	to_arg->nranges = howmany(end - first, to_arg->range_objects);
+	to_arg->nrange_args = MIN(nthreads, to_arg->nranges);
+	to_arg->range_args = kmem_zalloc(to_arg->nrange_args *
+	    sizeof (*to_arg->range_args), KM_SLEEP);
+
+	for (uint_t i = 0; i < to_arg->nrange_args; i++) {
+		struct send_thread_arg *sta = &to_arg->range_args[i];
+
+		VERIFY0(bqueue_init(&sta->q, zfs_send_queue_ff,
+		    MAX(zfs_send_queue_length, 2 * zfs_max_recordsize),
+		    offsetof(struct send_range, ln)));
+		sta->os = to_arg->os;
+		sta->fromtxg = to_arg->fromtxg;
+		sta->flags = to_arg->flags;
+		sta->num_blocks_visited = to_arg->num_blocks_visited;
+		sta->range_parent = to_arg;
+		sta->range_idx = i;
+		sta->prefetch = issue_reads;
+	}
+	for (uint_t i = 0; i < to_arg->nrange_args; i++) {
+		(void) thread_create(NULL, 0, send_traverse_range_thread,
+		    &to_arg->range_args[i], 0, curproc, TS_RUN, minclsyspri);
+	}
+	return (B_TRUE);
+}
+
 static void
 setup_to_thread(struct send_thread_arg *to_arg, objset_t *to_os,
-    dmu_sendstatus_t *dssp, uint64_t fromtxg, boolean_t rawok)
+    dmu_sendstatus_t *dssp, uint64_t fromtxg, boolean_t rawok,
+    boolean_t issue_reads)
 {
 	VERIFY0(bqueue_init(&to_arg->q, zfs_send_no_prefetch_queue_ff,
 	    MAX(zfs_send_no_prefetch_queue_length, 2 * zfs_max_recordsize),
@@ -2081,8 +2338,13 @@ setup_to_thread(struct send_thread_arg *to_arg, objset_t *to_os,
 	if (zfs_send_corrupt_data)
 		to_arg->flags |= TRAVERSE_HARD;
 	to_arg->num_blocks_visited = &dssp->dss_blocks;
-	(void) thread_create(NULL, 0, send_traverse_thread, to_arg, 0,
-	    curproc, TS_RUN, minclsyspri);
+	if (setup_range_threads(to_arg, issue_reads)) {
+		(void) thread_create(NULL, 0, send_traverse_ranges_thread,
+		    to_arg, 0, curproc, TS_RUN, minclsyspri);
+	} else {
+		(void) thread_create(NULL, 0, send_traverse_thread, to_arg, 0,
+		    curproc, TS_RUN, minclsyspri);
+	}
 }
 
 static void
@@ -2583,7 +2845,8 @@ dmu_send_impl(struct dmu_send_params *dspp)
 		goto out;
 	}
 
-	setup_to_thread(to_arg, os, dssp, fromtxg, dspp->rawok);
+	setup_to_thread(to_arg, os, dssp, fromtxg, dspp->rawok,
+	    !dspp->dso->dso_dryrun);
 	setup_from_thread(from_arg, from_rl, dssp);
 	setup_redact_list_thread(rlt_arg, dspp, redact_rl, dssp);
 	setup_merge_thread(smt_arg, dspp, from_arg, to_arg, rlt_arg, os);
@@ -3159,5 +3422,8 @@ ZFS_MODULE_PARAM(zfs_send, zfs_send_, queue_ff, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_send, zfs_send_, no_prefetch_queue_ff, UINT, ZMOD_RW,
 	"Send queue fill fraction for non-prefetch queues");
 
+ZFS_MODULE_PARAM(zfs_send, zfs_send_, traverse_threads, UINT, ZMOD_RW,
+	"Number of threads traversing object ranges of one send stream");
+
 ZFS_MODULE_PARAM(zfs_send, zfs_, override_estimate_recordsize, UINT, ZMOD_RW,
 	"Override block size estimate with fixed size");
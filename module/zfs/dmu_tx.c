@@ -959,18 +959,43 @@ static const hrtime_t zfs_delay_max_ns = 100 * MICROSEC; /* 100 milliseconds */
  * ensuring that the appropriate limits are set for the I/O scheduler to reach
  * optimal throughput on the backend storage, and then by changing the value
  * of zfs_delay_scale to increase the steepness of the curve.
+ *
+ * With zfs_delay_adaptive set, max is the dirty data limit derived from the
+ * measured sync bandwidth (see dsl_pool_dirty_max()), and the scale is the
+ * time needed to sync the transaction's own dirty data at that bandwidth.
+ * At the midpoint of the curve writers are then throttled to exactly the
+ * rate at which the pool syncs, whatever the backend storage.
  */
+static uint64_t
+dmu_tx_delay_scale(dmu_tx_t *tx)
+{
+	uint64_t bw = tx->tx_pool->dp_sync_bw;
+	uint64_t size = 0;
+
+	if (!zfs_delay_adaptive || bw == 0)
+		return (zfs_delay_scale);
+
+	for (dmu_tx_hold_t *txh = list_head(&tx->tx_holds); txh != NULL;
+	    txh = list_next(&tx->tx_holds, txh)) {
+		size += zfs_refcount_count(&txh->txh_space_towrite);
+		size += zfs_refcount_count(&txh->txh_memory_tohold);
+	}
+	size = MAX(size, SPA_MINBLOCKSIZE);
+
+	return (MIN(size * NANOSEC / bw, zfs_delay_max_ns));
+}
+
 static void
 dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty)
 {
 	dsl_pool_t *dp = tx->tx_pool;
-	uint64_t delay_min_bytes, wrlog;
+	uint64_t delay_min_bytes, dirty_max, wrlog;
 	hrtime_t wakeup, tx_time = 0, now;
 
 	/* Calculate minimum transaction time for the dirty data amount. */
-	delay_min_bytes =
-	    zfs_dirty_data_max * zfs_delay_min_dirty_percent / 100;
-	if (dirty >= zfs_dirty_data_max) {
+	dirty_max = dsl_pool_dirty_max(dp);
+	delay_min_bytes = dirty_max * zfs_delay_min_dirty_percent / 100;
+	if (dirty >= dirty_max) {
 		/*
 		 * The caller has already waited until the dirty data is
 		 * under the max, but the sync context reservations added
@@ -978,8 +1003,8 @@ dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty)
 		 */
 		tx_time = zfs_delay_max_ns;
 	} else if (dirty > delay_min_bytes) {
-		tx_time = zfs_delay_scale * (dirty - delay_min_bytes) /
-		    (zfs_dirty_data_max - dirty);
+		tx_time = dmu_tx_delay_scale(tx) * (dirty - delay_min_bytes) /
+		    (dirty_max - dirty);
 	}
 
 	/* Calculate minimum transaction time for the TX_WRITE log size. */
@@ -1007,6 +1032,7 @@ dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty)
 	mutex_enter(&dp->dp_lock);
 	wakeup = MAX(tx->tx_start + tx_time, dp->dp_last_wakeup + tx_time);
 	dp->dp_last_wakeup = wakeup;
+	dsl_pool_delay_count(dp, wakeup - now);
 	mutex_exit(&dp->dp_lock);
 
 	zfs_sleep_until(wakeup);
@@ -1360,9 +1386,9 @@ dmu_tx_wait(dmu_tx_t *tx)
 		 * space.
 		 */
 		mutex_enter(&dp->dp_lock);
-		if (dp->dp_dirty_total >= zfs_dirty_data_max)
+		if (dp->dp_dirty_total >= dsl_pool_dirty_max(dp))
 			DMU_TX_STAT_BUMP(dmu_tx_dirty_over_max);
-		while (dp->dp_dirty_total >= zfs_dirty_data_max)
+		while (dp->dp_dirty_total >= dsl_pool_dirty_max(dp))
 			cv_wait(&dp->dp_spaceavail_cv, &dp->dp_lock);
 		dirty = dp->dp_dirty_total + dp->dp_sync_reserve_total;
 		mutex_exit(&dp->dp_lock);
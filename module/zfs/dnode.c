@@ -2790,6 +2790,280 @@ out:
 	return (error);
 }
 
+static void
+dnode_range_union_cb(void *arg, uint64_t start, uint64_t size)
+{
+	zfs_range_tree_t *rt = arg;
+
+	zfs_range_tree_clear(rt, start, size);
+	zfs_range_tree_add(rt, start, size);
+}
+
+/*
+ * Return B_TRUE if the dirty record of a level 0 block holds only zeros,
+ * which the write policy turns into a hole when compression (or dedup) is
+ * enabled.
+ */
+static boolean_t
+dnode_dirty_is_zero(dbuf_dirty_record_t *dr)
+{
+	arc_buf_t *buf = dr->dt.dl.dr_data;
+
+	if (buf == NULL || dr->dt.dl.dr_override_state != DR_NOT_OVERRIDDEN ||
+	    dr->dt.dl.dr_brtwrite || arc_is_encrypted(buf) ||
+	    arc_get_compression(buf) != ZIO_COMPRESS_OFF)
+		return (B_FALSE);
+
+	const uint64_t *data = buf->b_data;
+	for (uint64_t i = 0; i < arc_buf_lsize(buf) / sizeof (*data); i++) {
+		if (data[i] != 0)
+			return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
+/*
+ * Return B_TRUE if a txg this dnode is dirty in has started syncing and
+ * is not done yet.  The dnode leaves the dirty list of a txg when its
+ * blocks are issued, but dn_dirtycnt only drops once they are written.
+ */
+static boolean_t
+dnode_is_syncing(dnode_t *dn)
+{
+	int unsynced = 0;
+
+	for (int i = 0; i < TXG_SIZE; i++) {
+		if (multilist_link_active(&dn->dn_dirty_link[i]))
+			unsynced++;
+	}
+
+	mutex_enter(&dn->dn_mtx);
+	boolean_t syncing = (dn->dn_dirtycnt > unsynced);
+	mutex_exit(&dn->dn_mtx);
+
+	return (syncing);
+}
+
+/*
+ * Find the first level 0 block of dn from blkid through end with a dirty
+ * record, and set *zero if the block will be written as a hole.  Only the
+ * dbufs up to that block are looked at, so that a seek in a large cached
+ * file doesn't walk all of its dbufs while holding dn_dbufs_mtx.
+ */
+static boolean_t
+dnode_next_dirty_block(dnode_t *dn, dmu_buf_impl_t *db_search,
+    boolean_t zero_holes, uint64_t blkid, uint64_t end, uint64_t *dblkid,
+    boolean_t *zero)
+{
+	dmu_buf_impl_t *db;
+	avl_index_t where;
+	boolean_t found = B_FALSE;
+
+	db_search->db_blkid = blkid;
+
+	mutex_enter(&dn->dn_dbufs_mtx);
+	db = avl_find(&dn->dn_dbufs, db_search, &where);
+	ASSERT0P(db);
+	for (db = avl_nearest(&dn->dn_dbufs, where, AVL_AFTER);
+	    db != NULL && db->db_level == 0 && db->db_blkid <= end &&
+	    db->db_blkid != DMU_SPILL_BLKID;
+	    db = AVL_NEXT(&dn->dn_dbufs, db)) {
+		mutex_enter(&db->db_mtx);
+		dbuf_dirty_record_t *dr = list_head(&db->db_dirty_records);
+		if (dr != NULL) {
+			*dblkid = db->db_blkid;
+			*zero = zero_holes && dnode_dirty_is_zero(dr);
+			found = B_TRUE;
+		}
+		mutex_exit(&db->db_mtx);
+		if (found)
+			break;
+	}
+	mutex_exit(&dn->dn_dbufs_mtx);
+
+	return (found);
+}
+
+/*
+ * Find the next hole or data at or after *offset like dnode_next_offset()
+ * does for a file, but for a dirty dnode, without waiting for its changes
+ * to be synced.  Level 0 blocks with dirty records are data, unless they
+ * will be written as holes, blocks freed in a txg which is not synced yet
+ * (and not dirtied again) are holes, and the remaining blocks are looked up
+ * in the block tree on disk.
+ *
+ * The block tree on disk is searched first, and the dirty blocks are only
+ * looked at up to the block it found, or for a hole past it as long as
+ * they are written one after another.  The search stops at the first block
+ * that decides the answer.
+ *
+ * While a txg this dnode is dirty in is being synced, the block pointers
+ * and fill counts of its tree are only partially updated, and written
+ * blocks no longer have dirty records, so we can't tell.  EAGAIN is
+ * returned in that case, and the caller needs to wait for the txg.
+ *
+ * The caller must hold dn_struct_rwlock, and should prevent the dnode
+ * from being dirtied concurrently (e.g. with a range lock).
+ */
+int
+dnode_next_offset_dirty(dnode_t *dn, boolean_t hole, uint64_t *offset)
+{
+	spa_t *spa = dmu_objset_spa(dn->dn_objset);
+	uint64_t blksz = dn->dn_datablksz;
+	uint64_t off = *offset, start, size, txg;
+	uint64_t blkid, dblkid, noff, nblkid;
+	objset_t *os = dn->dn_objset;
+	zfs_range_tree_t *freed;
+	dmu_buf_impl_t *db_search;
+	zfs_range_seg_t *rs;
+	boolean_t zero_holes, zero;
+	int error = 0;
+
+	ASSERT(RW_LOCK_HELD(&dn->dn_struct_rwlock));
+
+	txg = spa_last_synced_txg(spa);
+	if (dn->dn_free_txg != 0 || dnode_is_syncing(dn))
+		return (SET_ERROR(EAGAIN));
+
+	freed = zfs_range_tree_create(NULL, ZFS_RANGE_SEG64, NULL, 0, 0);
+	zero_holes = (zio_compress_select(spa, dn->dn_compress,
+	    os->os_compress) != ZIO_COMPRESS_OFF ||
+	    os->os_dedup_checksum != ZIO_CHECKSUM_OFF);
+
+	db_search = kmem_alloc(sizeof (dmu_buf_impl_t), KM_SLEEP);
+	db_search->db_level = 0;
+	db_search->db_state = DB_SEARCH;
+
+	mutex_enter(&dn->dn_mtx);
+	for (int i = 0; i < TXG_SIZE; i++) {
+		if (dn->dn_free_ranges[i] != NULL) {
+			zfs_range_tree_walk(dn->dn_free_ranges[i],
+			    dnode_range_union_cb, freed);
+		}
+	}
+	mutex_exit(&dn->dn_mtx);
+
+	/*
+	 * A block freed and written again is data.  This includes blocks
+	 * freed after being written in an earlier txg, which will be holes,
+	 * but reporting data for a hole is always safe.  Blocks only
+	 * written with zeros will be holes either way.
+	 */
+	for (;;) {
+		blkid = off / blksz;
+		noff = off;
+
+		if (hole) {
+			error = dnode_next_offset(dn,
+			    DNODE_FIND_HAVELOCK | DNODE_FIND_HOLE, &noff,
+			    1, 1, 0);
+			if (error == ESRCH) {
+				/* Past the end of a single block object */
+				error = 0;
+				break;
+			}
+			if (error != 0)
+				break;
+			nblkid = noff / blksz;
+
+			/*
+			 * The blocks before nblkid are data on disk, unless
+			 * they are freed or written with zeros, and nblkid is
+			 * a hole unless it is written.  Past nblkid, written
+			 * blocks are followed until the first one that isn't.
+			 */
+			while (dnode_next_dirty_block(dn, db_search, zero_holes,
+			    blkid, MAX(blkid, nblkid), &dblkid, &zero)) {
+				if (blkid < dblkid && zfs_range_tree_find_in(
+				    freed, blkid, dblkid - blkid, &start,
+				    &size)) {
+					off = MAX(off, start * blksz);
+					goto out;
+				}
+				if (zero) {
+					off = MAX(off, dblkid * blksz);
+					goto out;
+				}
+				blkid = dblkid + 1;
+			}
+			if (blkid <= nblkid) {
+				if (blkid < nblkid && zfs_range_tree_find_in(
+				    freed, blkid, nblkid - blkid,
+				    &start, &size)) {
+					off = MAX(off, start * blksz);
+				} else {
+					off = noff;
+				}
+				break;
+			}
+			off = blkid * blksz;
+			if (zfs_range_tree_contains(freed, blkid, 1))
+				break;
+		} else {
+			error = dnode_next_offset(dn, DNODE_FIND_HAVELOCK,
+			    &noff, 1, 1, 0);
+			if (error != 0 && error != ESRCH)
+				break;
+			nblkid = (error == ESRCH) ? UINT64_MAX : noff / blksz;
+
+			/* Blocks written up to the data on disk come first. */
+			while (dnode_next_dirty_block(dn, db_search, zero_holes,
+			    blkid, nblkid, &dblkid, &zero)) {
+				if (!zero) {
+					error = 0;
+					off = MAX(off, dblkid * blksz);
+					goto out;
+				}
+				blkid = dblkid + 1;
+			}
+			if (error != 0)
+				break;
+			if (blkid > nblkid) {
+				/* The data on disk is written with zeros. */
+				off = blkid * blksz;
+				continue;
+			}
+
+			/* Data on disk may be pending to be freed. */
+			rs = zfs_range_tree_find(freed, nblkid, 1);
+			if (rs == NULL) {
+				off = noff;
+				break;
+			}
+			blkid = nblkid + 1;
+			nblkid = zfs_rs_get_end(rs, freed);
+			while (blkid < nblkid && dnode_next_dirty_block(dn,
+			    db_search, zero_holes, blkid, nblkid - 1, &dblkid,
+			    &zero)) {
+				if (!zero) {
+					off = dblkid * blksz;
+					goto out;
+				}
+				blkid = dblkid + 1;
+			}
+			off = nblkid * blksz;
+		}
+	}
+
+out:
+	kmem_free(db_search, sizeof (dmu_buf_impl_t));
+	zfs_range_tree_vacate(freed, NULL, NULL);
+	zfs_range_tree_destroy(freed);
+
+	/*
+	 * If one of our txgs started syncing meanwhile, the block tree may
+	 * have been looked at in an inconsistent state.
+	 */
+	if (error == 0 && (dnode_is_syncing(dn) ||
+	    spa_last_synced_txg(spa) != txg))
+		error = SET_ERROR(EAGAIN);
+	if (error == 0)
+		*offset = off;
+
+	return (error);
+}
+
 #if defined(_KERNEL)
 EXPORT_SYMBOL(dnode_hold);
 EXPORT_SYMBOL(dnode_rele);
@@ -83,6 +83,12 @@
  *
  * The delay is also calculated based on the amount of dirty data.  See the
  * comment above dmu_tx_delay() for details.
+ *
+ * With zfs_delay_adaptive set, dsl_pool_sync_throttle() measures how fast
+ * each txg's dirty data is synced, and the dirty space limit becomes the
+ * amount of dirty data the pool can sync in zfs_txg_synctime_ms, capped at
+ * zfs_dirty_data_max.  dsl_pool_dirty_max() returns the limit in effect,
+ * which every threshold above is a percentage of.
  */
 
 /*
@@ -131,6 +137,23 @@ uint_t zfs_delay_min_dirty_percent = 60;
  */
 uint64_t zfs_delay_scale = 1000 * 1000 * 1000 / 2000;
 
+/*
+ * Derive the dirty data limit and the transaction delay from the sync
+ * bandwidth measured over recent txgs, so that a txg syncs in about
+ * zfs_txg_synctime_ms, instead of from zfs_dirty_data_max and
+ * zfs_delay_scale alone.
+ */
+int zfs_delay_adaptive = 0;
+uint_t zfs_txg_synctime_ms = 1000;
+
+/*
+ * The adaptive dirty data limit is never set below this fraction of
+ * zfs_dirty_data_max, and txgs with less than a quarter of that much dirty
+ * data, which are dominated by fixed costs, are not used to estimate the
+ * sync bandwidth.
+ */
+#define	DSL_POOL_DIRTY_TARGET_MIN_SHIFT	5
+
 /*
  * These tunables determine the behavior of how zil_itxg_clean() is
  * called via zil_clean() in the context of spa_sync(). When an itxg
@@ -603,7 +626,7 @@ dsl_pool_dirty_delta(dsl_pool_t *dp, int64_t delta)
 	 * Note: we signal even when increasing dp_dirty_total.
 	 * This ensures forward progress -- each thread wakes the next waiter.
 	 */
-	if (dp->dp_dirty_total < zfs_dirty_data_max)
+	if (dp->dp_dirty_total < dsl_pool_dirty_max(dp))
 		cv_signal(&dp->dp_spaceavail_cv);
 }
 
@@ -961,11 +984,79 @@ dsl_pool_deferred_space(dsl_pool_t *dp)
 	return (metaslab_class_get_deferred(spa_normal_class(dp->dp_spa)));
 }
 
+/*
+ * Return the dirty space limit in effect: zfs_dirty_data_max, or with
+ * zfs_delay_adaptive the limit derived from the measured sync bandwidth.
+ */
+uint64_t
+dsl_pool_dirty_max(dsl_pool_t *dp)
+{
+	uint64_t target = dp->dp_dirty_target;
+
+	if (!zfs_delay_adaptive || target == 0)
+		return (zfs_dirty_data_max);
+	return (MIN(target, zfs_dirty_data_max));
+}
+
+/*
+ * Account a transaction delay to the open txg, for the txgs kstat.
+ */
+void
+dsl_pool_delay_count(dsl_pool_t *dp, hrtime_t delay)
+{
+	uint64_t txg = dp->dp_tx.tx_open_txg;
+
+	ASSERT(MUTEX_HELD(&dp->dp_lock));
+
+	dp->dp_delays_pertxg[txg & TXG_MASK]++;
+	dp->dp_delay_time_pertxg[txg & TXG_MASK] += delay;
+}
+
+/*
+ * Called after txg has synced, with the dirty data it carried and the time
+ * spa_sync() took.  Updates the sync bandwidth estimate and the adaptive
+ * dirty space limit, and records the throttle state in ts, if any.
+ */
+void
+dsl_pool_sync_throttle(dsl_pool_t *dp, uint64_t txg, uint64_t dirty,
+    hrtime_t synctime, txg_stat_t *ts)
+{
+	uint64_t target_min = zfs_dirty_data_max >>
+	    DSL_POOL_DIRTY_TARGET_MIN_SHIFT;
+
+	mutex_enter(&dp->dp_lock);
+	if (dirty >= target_min / 4 && NSEC2USEC(synctime) > 0) {
+		uint64_t bw = dirty * MICROSEC / NSEC2USEC(synctime);
+
+		/* Weigh the last txg by 1/4 against its predecessors. */
+		if (dp->dp_sync_bw == 0)
+			dp->dp_sync_bw = bw;
+		else
+			dp->dp_sync_bw = (3 * dp->dp_sync_bw + bw) / 4;
+
+		dp->dp_dirty_target = MAX(target_min,
+		    dp->dp_sync_bw * zfs_txg_synctime_ms / MILLISEC);
+
+		/* The limit may have been raised; wake any waiters. */
+		cv_broadcast(&dp->dp_spaceavail_cv);
+	}
+
+	if (ts != NULL) {
+		ts->dirty_max = dsl_pool_dirty_max(dp);
+		ts->sync_bw = dp->dp_sync_bw;
+		ts->delays = dp->dp_delays_pertxg[txg & TXG_MASK];
+		ts->delay_time = dp->dp_delay_time_pertxg[txg & TXG_MASK];
+	}
+	dp->dp_delays_pertxg[txg & TXG_MASK] = 0;
+	dp->dp_delay_time_pertxg[txg & TXG_MASK] = 0;
+	mutex_exit(&dp->dp_lock);
+}
+
 boolean_t
 dsl_pool_need_dirty_delay(dsl_pool_t *dp)
 {
 	uint64_t delay_min_bytes =
-	    zfs_dirty_data_max * zfs_delay_min_dirty_percent / 100;
+	    dsl_pool_dirty_max(dp) * zfs_delay_min_dirty_percent / 100;
 
 	/*
 	 * We are not taking the dp_lock here and few other places, since torn
@@ -981,7 +1072,7 @@ static boolean_t
 dsl_pool_need_dirty_sync(dsl_pool_t *dp, uint64_t txg)
 {
 	uint64_t dirty_min_bytes =
-	    zfs_dirty_data_max * zfs_dirty_data_sync_percent / 100;
+	    dsl_pool_dirty_max(dp) * zfs_dirty_data_sync_percent / 100;
 	uint64_t dirty = dp->dp_dirty_pertxg[txg & TXG_MASK] +
 	    dp->dp_sync_reserve_pertxg[txg & TXG_MASK];
 
@@ -1565,6 +1656,12 @@ ZFS_MODULE_PARAM(zfs, zfs_, dirty_data_sync_percent, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs, zfs_, delay_scale, U64, ZMOD_RW,
 	"How quickly delay approaches infinity");
 
+ZFS_MODULE_PARAM(zfs, zfs_, delay_adaptive, INT, ZMOD_RW,
+	"Derive the write throttle from the measured txg sync bandwidth");
+
+ZFS_MODULE_PARAM(zfs_txg, zfs_txg_, synctime_ms, UINT, ZMOD_RW,
+	"Target txg sync time in milliseconds for zfs_delay_adaptive");
+
 ZFS_MODULE_PARAM(zfs_zil, zfs_zil_, clean_taskq_nthr_pct, INT, ZMOD_RW,
 	"Max percent of CPUs that are used per dp_sync_taskq");
 
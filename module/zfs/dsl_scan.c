@@ -1779,7 +1779,7 @@ dsl_scan_check_suspend(dsl_scan_t *scn, const zbookmark_phys_t *zb)
 	uint64_t scan_time_ns = curr_time_ns - scn->scn_sync_start_time;
 	uint64_t sync_time_ns = curr_time_ns -
 	    scn->scn_dp->dp_spa->spa_sync_starttime;
-	uint64_t dirty_min_bytes = zfs_dirty_data_max *
+	uint64_t dirty_min_bytes = dsl_pool_dirty_max(scn->scn_dp) *
 	    zfs_vdev_async_write_active_min_dirty_percent / 100;
 	uint_t mintime = (scn->scn_phys.scn_func == POOL_SCAN_RESILVER) ?
 	    zfs_resilver_min_time_ms : zfs_scrub_min_time_ms;
@@ -3353,7 +3353,7 @@ scan_io_queue_check_suspend(dsl_scan_t *scn)
 	uint64_t scan_time_ns = curr_time_ns - scn->scn_sync_start_time;
 	uint64_t sync_time_ns = curr_time_ns -
 	    scn->scn_dp->dp_spa->spa_sync_starttime;
-	uint64_t dirty_min_bytes = zfs_dirty_data_max *
+	uint64_t dirty_min_bytes = dsl_pool_dirty_max(scn->scn_dp) *
 	    zfs_vdev_async_write_active_min_dirty_percent / 100;
 	uint_t mintime = (scn->scn_phys.scn_func == POOL_SCAN_RESILVER) ?
 	    zfs_resilver_min_time_ms : zfs_scrub_min_time_ms;
@@ -683,7 +683,7 @@ metaslab_class_rotate(metaslab_group_t *mg, int allocator, uint64_t psize,
 	dsl_pool_t *dp = spa_get_dsl(spa);
 	if (dp == NULL)
 		return;
-	uint64_t busy_thresh = zfs_dirty_data_max *
+	uint64_t busy_thresh = dsl_pool_dirty_max(dp) *
 	    (zfs_vdev_async_write_active_min_dirty_percent +
 	    zfs_vdev_async_write_active_max_dirty_percent) / 200;
 	if (dp->dp_dirty_total > busy_thresh || spa_has_pending_synctask(spa))
@@ -733,6 +733,12 @@ metaslab_class_get_deferred(metaslab_class_t *mc)
 	    atomic_load_64(&mc->mc_deferred));
 }
 
+uint64_t
+metaslab_class_get_groups(metaslab_class_t *mc)
+{
+	return (mc->mc_groups);
+}
+
 uint64_t
 metaslab_class_get_space(metaslab_class_t *mc)
 {
@@ -194,6 +194,10 @@ typedef struct spa_txg_history {
 	uint64_t	reads;		/* number of read operations */
 	uint64_t	writes;		/* number of write operations */
 	uint64_t	ndirty;		/* number of dirty bytes */
+	uint64_t	dirty_max;	/* dirty data limit after sync */
+	uint64_t	sync_bw;	/* estimated sync bytes/sec */
+	uint64_t	delays;		/* number of delayed transactions */
+	uint64_t	delay_time;	/* total transaction delay */
 	hrtime_t	times[TXG_STATE_COMMITTED]; /* completion times */
 	procfs_list_node_t	sth_node;
 } spa_txg_history_t;
@@ -202,9 +206,10 @@ static int
 spa_txg_history_show_header(struct seq_file *f)
 {
 	seq_printf(f, "%-8s %-16s %-5s %-12s %-12s %-12s "
-	    "%-8s %-8s %-12s %-12s %-12s %-12s\n", "txg", "birth", "state",
-	    "ndirty", "nread", "nwritten", "reads", "writes",
-	    "otime", "qtime", "wtime", "stime");
+	    "%-8s %-8s %-12s %-12s %-12s %-12s %-12s %-12s %-8s %-12s\n",
+	    "txg", "birth", "state", "ndirty", "nread", "nwritten", "reads",
+	    "writes", "otime", "qtime", "wtime", "stime", "dmax", "syncbw",
+	    "delays", "dtime");
 	return (0);
 }
 
@@ -242,13 +247,16 @@ spa_txg_history_show(struct seq_file *f, void *data)
 		    sth->times[TXG_STATE_WAIT_FOR_SYNC];
 
 	seq_printf(f, "%-8llu %-16llu %-5c %-12llu "
-	    "%-12llu %-12llu %-8llu %-8llu %-12llu %-12llu %-12llu %-12llu\n",
+	    "%-12llu %-12llu %-8llu %-8llu %-12llu %-12llu %-12llu %-12llu "
+	    "%-12llu %-12llu %-8llu %-12llu\n",
 	    (longlong_t)sth->txg, sth->times[TXG_STATE_BIRTH], state,
 	    (u_longlong_t)sth->ndirty,
 	    (u_longlong_t)sth->nread, (u_longlong_t)sth->nwritten,
 	    (u_longlong_t)sth->reads, (u_longlong_t)sth->writes,
 	    (u_longlong_t)open, (u_longlong_t)quiesce, (u_longlong_t)wait,
-	    (u_longlong_t)sync);
+	    (u_longlong_t)sync, (u_longlong_t)sth->dirty_max,
+	    (u_longlong_t)sth->sync_bw, (u_longlong_t)sth->delays,
+	    (u_longlong_t)sth->delay_time);
 
 	return (0);
 }
@@ -364,8 +372,8 @@ spa_txg_history_set(spa_t *spa, uint64_t txg, txg_state_t completed_state,
  * Set txg IO stats.
  */
 static int
-spa_txg_history_set_io(spa_t *spa, uint64_t txg, uint64_t nread,
-    uint64_t nwritten, uint64_t reads, uint64_t writes, uint64_t ndirty)
+spa_txg_history_set_io(spa_t *spa, txg_stat_t *ts, uint64_t nread,
+    uint64_t nwritten, uint64_t reads, uint64_t writes)
 {
 	spa_history_list_t *shl = &spa->spa_stats.txg_history;
 	spa_txg_history_t *sth;
@@ -377,12 +385,16 @@ spa_txg_history_set_io(spa_t *spa, uint64_t txg, uint64_t nread,
 	mutex_enter(&shl->procfs_list.pl_lock);
 	for (sth = list_tail(&shl->procfs_list.pl_list); sth != NULL;
 	    sth = list_prev(&shl->procfs_list.pl_list, sth)) {
-		if (sth->txg == txg) {
+		if (sth->txg == ts->txg) {
 			sth->nread = nread;
 			sth->nwritten = nwritten;
 			sth->reads = reads;
 			sth->writes = writes;
-			sth->ndirty = ndirty;
+			sth->ndirty = ts->ndirty;
+			sth->dirty_max = ts->dirty_max;
+			sth->sync_bw = ts->sync_bw;
+			sth->delays = ts->delays;
+			sth->delay_time = ts->delay_time;
 			error = 0;
 			break;
 		}
@@ -400,7 +412,7 @@ spa_txg_history_init_io(spa_t *spa, uint64_t txg, dsl_pool_t *dp)
 	if (zfs_txg_history == 0)
 		return (NULL);
 
-	ts = kmem_alloc(sizeof (txg_stat_t), KM_SLEEP);
+	ts = kmem_zalloc(sizeof (txg_stat_t), KM_SLEEP);
 
 	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
 	vdev_get_stats(spa->spa_root_vdev, &ts->vs1);
@@ -430,12 +442,11 @@ spa_txg_history_fini_io(spa_t *spa, txg_stat_t *ts)
 	spa_config_exit(spa, SCL_CONFIG, FTAG);
 
 	spa_txg_history_set(spa, ts->txg, TXG_STATE_SYNCED, gethrtime());
-	spa_txg_history_set_io(spa, ts->txg,
+	spa_txg_history_set_io(spa, ts,
 	    ts->vs2.vs_bytes[ZIO_TYPE_READ] - ts->vs1.vs_bytes[ZIO_TYPE_READ],
 	    ts->vs2.vs_bytes[ZIO_TYPE_WRITE] - ts->vs1.vs_bytes[ZIO_TYPE_WRITE],
 	    ts->vs2.vs_ops[ZIO_TYPE_READ] - ts->vs1.vs_ops[ZIO_TYPE_READ],
-	    ts->vs2.vs_ops[ZIO_TYPE_WRITE] - ts->vs1.vs_ops[ZIO_TYPE_WRITE],
-	    ts->ndirty);
+	    ts->vs2.vs_ops[ZIO_TYPE_WRITE] - ts->vs1.vs_ops[ZIO_TYPE_WRITE]);
 
 	kmem_free(ts, sizeof (txg_stat_t));
 }
@@ -589,9 +589,13 @@ txg_sync_thread(void *arg)
 		mutex_exit(&tx->tx_sync_lock);
 
 		txg_stat_t *ts = spa_txg_history_init_io(spa, txg, dp);
+		uint64_t dirty = dp->dp_dirty_pertxg[txg & TXG_MASK];
+		hrtime_t synctime = gethrtime();
 		start = ddi_get_lbolt();
 		spa_sync(spa, txg);
 		delta = ddi_get_lbolt() - start;
+		synctime = gethrtime() - synctime;
+		dsl_pool_sync_throttle(dp, txg, dirty, synctime, ts);
 		spa_txg_history_fini_io(spa, ts);
 
 		mutex_enter(&tx->tx_sync_lock);
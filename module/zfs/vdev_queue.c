@@ -303,10 +303,6 @@ vdev_queue_max_async_writes(spa_t *spa)
 	uint_t writes;
 	uint64_t dirty = 0;
 	dsl_pool_t *dp = spa_get_dsl(spa);
-	uint64_t min_bytes = zfs_dirty_data_max *
-	    zfs_vdev_async_write_active_min_dirty_percent / 100;
-	uint64_t max_bytes = zfs_dirty_data_max *
-	    zfs_vdev_async_write_active_max_dirty_percent / 100;
 
 	/*
 	 * Async writes may occur before the assignment of the spa's
@@ -316,6 +312,11 @@ vdev_queue_max_async_writes(spa_t *spa)
 	if (dp == NULL)
 		return (zfs_vdev_async_write_max_active);
 
+	uint64_t min_bytes = dsl_pool_dirty_max(dp) *
+	    zfs_vdev_async_write_active_min_dirty_percent / 100;
+	uint64_t max_bytes = dsl_pool_dirty_max(dp) *
+	    zfs_vdev_async_write_active_max_dirty_percent / 100;
+
 	/*
 	 * Sync tasks correspond to interactive user actions. To reduce the
 	 * execution time of those actions we push data out as fast as possible.
@@ -1060,7 +1061,7 @@ boolean_t
 vdev_queue_pool_busy(spa_t *spa)
 {
 	dsl_pool_t *dp = spa_get_dsl(spa);
-	uint64_t min_bytes = zfs_dirty_data_max *
+	uint64_t min_bytes = dsl_pool_dirty_max(dp) *
 	    zfs_vdev_async_write_active_min_dirty_percent / 100;
 
 	return (dp->dp_dirty_total > min_bytes);
@@ -79,6 +79,13 @@ static int zap_iterate_prefetch = B_TRUE;
  */
 int zap_shrink_enabled = B_TRUE;
 
+/*
+ * Split leaves with the ZAP's zap_rwlock held as reader, so that adds to
+ * other leaves can proceed concurrently.  Only pointer table growth then
+ * requires the zap_rwlock as writer.
+ */
+static int zap_shared_split = B_TRUE;
+
 int fzap_default_block_shift = 14; /* 16k blocksize */
 
 static uint64_t zap_allocate_blocks(zap_t *zap, int nblocks);
@@ -107,6 +114,7 @@ fzap_upgrade(zap_t *zap, dmu_tx_t *tx, zap_flags_t flags)
 	zap->zap_dbu.dbu_evict_func_async = NULL;
 
 	mutex_init(&zap->zap_f.zap_num_entries_mtx, 0, MUTEX_DEFAULT, 0);
+	mutex_init(&zap->zap_f.zap_split_mtx, 0, MUTEX_DEFAULT, 0);
 	zap->zap_f.zap_block_shift = highbit64(zap->zap_dbuf->db_size) - 1;
 
 	zap_phys_t *zp = zap_f_phys(zap);
@@ -387,7 +395,8 @@ zap_increment_num_entries(zap_t *zap, int delta, dmu_tx_t *tx)
 static uint64_t
 zap_allocate_blocks(zap_t *zap, int nblocks)
 {
-	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
+	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock) ||
+	    MUTEX_HELD(&zap->zap_f.zap_split_mtx));
 	uint64_t newblk = zap_f_phys(zap)->zap_freeblk;
 	zap_f_phys(zap)->zap_freeblk += nblocks;
 	return (newblk);
@@ -405,9 +414,13 @@ zap_leaf_evict_sync(void *dbu)
 static zap_leaf_t *
 zap_create_leaf(zap_t *zap, dmu_tx_t *tx)
 {
-	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
+	ASSERT(RW_LOCK_HELD(&zap->zap_rwlock));
 
+	mutex_enter(&zap->zap_f.zap_split_mtx);
 	uint64_t blkid = zap_allocate_blocks(zap, 1);
+	zap_f_phys(zap)->zap_num_leafs++;
+	mutex_exit(&zap->zap_f.zap_split_mtx);
+
 	dmu_buf_t *db = NULL;
 
 	VERIFY0(dmu_buf_hold_by_dnode(zap->zap_dnode,
@@ -439,8 +452,6 @@ zap_create_leaf(zap_t *zap, dmu_tx_t *tx)
 
 	zap_leaf_init(l, zap->zap_normflags != 0);
 
-	zap_f_phys(zap)->zap_num_leafs++;
-
 	return (l);
 }
 
@@ -581,7 +592,7 @@ static int
 zap_set_idx_to_blk(zap_t *zap, uint64_t idx, uint64_t blk, dmu_tx_t *tx)
 {
 	ASSERT(tx != NULL);
-	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
+	ASSERT(RW_LOCK_HELD(&zap->zap_rwlock));
 
 	if (zap_f_phys(zap)->zap_ptrtbl.zt_blk == 0) {
 		ZAP_EMBEDDED_PTRTBL_ENT(zap, idx) = blk;
@@ -675,15 +686,30 @@ zap_deref_leaf(zap_t *zap, uint64_t h, dmu_tx_t *tx, krw_t lt, zap_leaf_t **lp)
 	}
 
 	uint64_t idx = ZAP_HASH_IDX(h, zap_f_phys(zap)->zap_ptrtbl.zt_shift);
-	int err = zap_idx_to_blk(zap, idx, &blk);
-	if (err != 0)
-		return (err);
-	err = zap_get_leaf_byblk(zap, blk, tx, lt, lp);
+	for (uint64_t prevblk = 0; ; prevblk = blk) {
+		int err = zap_idx_to_blk(zap, idx, &blk);
+		if (err != 0)
+			return (err);
+		if (blk == prevblk)
+			return (SET_ERROR(EIO));
+		err = zap_get_leaf_byblk(zap, blk, tx, lt, lp);
+		if (err != 0)
+			return (err);
 
-	ASSERT(err ||
-	    ZAP_HASH_IDX(h, zap_leaf_phys(*lp)->l_hdr.lh_prefix_len) ==
-	    zap_leaf_phys(*lp)->l_hdr.lh_prefix);
-	return (err);
+		if (ZAP_HASH_IDX(h, zap_leaf_phys(*lp)->l_hdr.lh_prefix_len) ==
+		    zap_leaf_phys(*lp)->l_hdr.lh_prefix)
+			return (0);
+
+		/*
+		 * The leaf was split while we waited for its lock, and the
+		 * hash now belongs to the new leaf.  The pointer to it was
+		 * set before the leaf was unlocked, so look it up again.  If
+		 * the pointer did not change, the pointer table is corrupt.
+		 */
+		ASSERT(!RW_WRITE_HELD(&zap->zap_rwlock));
+		zap_put_leaf(*lp);
+		*lp = NULL;
+	}
 }
 
 static int
@@ -700,8 +726,16 @@ zap_expand_leaf(zap_name_t *zn, zap_leaf_t *l, dmu_tx_t *tx, zap_leaf_t **lp)
 	ASSERT3U(ZAP_HASH_IDX(hash, old_prefix_len), ==,
 	    zap_leaf_phys(l)->l_hdr.lh_prefix);
 
-	if (zap_lock_try_upgrade(zap, tx) == 0 ||
-	    old_prefix_len == zap_f_phys(zap)->zap_ptrtbl.zt_shift) {
+	/*
+	 * Splitting a leaf only changes the leaf, a new leaf and the range of
+	 * pointers to the leaf, none of which anyone else can change while we
+	 * hold the leaf as writer.  Unless the pointer table must grow to
+	 * give the new leaf its own pointers, this does not need the
+	 * zap_rwlock as writer; the new block is allocated under
+	 * zap_split_mtx instead.
+	 */
+	if (old_prefix_len == zap_f_phys(zap)->zap_ptrtbl.zt_shift ||
+	    (!zap_shared_split && zap_lock_try_upgrade(zap, tx) == 0)) {
 		/* We failed to upgrade, or need to grow the pointer table */
 		zap_put_leaf(l);
 		*lp = l = NULL;
@@ -725,7 +759,6 @@ zap_expand_leaf(zap_name_t *zn, zap_leaf_t *l, dmu_tx_t *tx, zap_leaf_t **lp)
 			return (0);
 		}
 	}
-	ASSERT(RW_WRITE_HELD(&zap->zap_rwlock));
 	ASSERT3U(old_prefix_len, <, zap_f_phys(zap)->zap_ptrtbl.zt_shift);
 	ASSERT3U(ZAP_HASH_IDX(hash, old_prefix_len), ==,
 	    zap_leaf_phys(l)->l_hdr.lh_prefix);
@@ -744,6 +777,13 @@ zap_expand_leaf(zap_name_t *zn, zap_leaf_t *l, dmu_tx_t *tx, zap_leaf_t **lp)
 		ASSERT3U(blk, ==, l->l_blkid);
 	}
 
+	/*
+	 * The header block is dirtied by zap_lock_impl() and
+	 * zap_lock_upgrade() only for writers.
+	 */
+	if (!RW_WRITE_HELD(&zap->zap_rwlock))
+		dmu_buf_will_dirty(zap->zap_dbuf, tx);
+
 	zap_leaf_t *nl = zap_create_leaf(zap, tx);
 	zap_leaf_split(l, nl, zap->zap_normflags != 0);
 
@@ -1446,3 +1486,6 @@ ZFS_MODULE_PARAM(zfs, , zap_iterate_prefetch, INT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs, , zap_shrink_enabled, INT, ZMOD_RW,
 	"Enable ZAP shrinking");
+
+ZFS_MODULE_PARAM(zfs, , zap_shared_split, INT, ZMOD_RW,
+	"Split ZAP leaves without exclusive access to the ZAP");
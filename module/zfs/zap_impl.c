@@ -461,10 +461,12 @@ zap_evict_sync(void *dbu)
 
 	rw_destroy(&zap->zap_rwlock);
 
-	if (zap->zap_ismicro)
+	if (zap->zap_ismicro) {
 		mze_destroy(zap);
-	else
+	} else {
 		mutex_destroy(&zap->zap_f.zap_num_entries_mtx);
+		mutex_destroy(&zap->zap_f.zap_split_mtx);
+	}
 
 	kmem_free(zap, sizeof (zap_t));
 }
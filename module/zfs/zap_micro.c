@@ -235,6 +235,7 @@ mzap_open(dmu_buf_t *db)
 	if (zap_block_type != ZBT_MICRO) {
 		mutex_init(&zap->zap_f.zap_num_entries_mtx, 0, MUTEX_DEFAULT,
 		    0);
+		mutex_init(&zap->zap_f.zap_split_mtx, 0, MUTEX_DEFAULT, 0);
 		zap->zap_f.zap_block_shift = highbit64(db->db_size) - 1;
 		if (zap_block_type != ZBT_HEADER || zap_magic != ZAP_MAGIC) {
 			winner = NULL;	/* No actual winner here... */
@@ -307,8 +308,10 @@ mzap_open(dmu_buf_t *db)
 handle_winner:
 	rw_exit(&zap->zap_rwlock);
 	rw_destroy(&zap->zap_rwlock);
-	if (!zap->zap_ismicro)
+	if (!zap->zap_ismicro) {
 		mutex_destroy(&zap->zap_f.zap_num_entries_mtx);
+		mutex_destroy(&zap->zap_f.zap_split_mtx);
+	}
 	kmem_free(zap, sizeof (zap_t));
 	return (winner);
 }
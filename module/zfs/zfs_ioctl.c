@@ -2301,15 +2301,18 @@ zfs_ioc_obj_to_path(zfs_cmd_t *zc)
  * inputs:
  * zc_name		name of filesystem
  * zc_obj		object to find
+ * zc_flags		ZFS_OBJ_STATS_NAME for the name in the parent directory
  *
  * outputs:
  * zc_stat		stats on object
- * zc_value		path to object
+ * zc_value		path to object, or its name with ZFS_OBJ_STATS_NAME
+ * zc_cookie		parent directory object, with ZFS_OBJ_STATS_NAME
  */
 static int
 zfs_ioc_obj_to_stats(zfs_cmd_t *zc)
 {
 	objset_t *os;
+	uint64_t pobj = 0;
 	int error;
 
 	/* XXX reading from objset not owned */
@@ -2321,7 +2324,10 @@ zfs_ioc_obj_to_stats(zfs_cmd_t *zc)
 		return (SET_ERROR(EINVAL));
 	}
 	error = zfs_obj_to_stats(os, zc->zc_obj, &zc->zc_stat, zc->zc_value,
-	    sizeof (zc->zc_value));
+	    sizeof (zc->zc_value),
+	    (zc->zc_flags & ZFS_OBJ_STATS_NAME) ? &pobj : NULL);
+	if (error == 0 && (zc->zc_flags & ZFS_OBJ_STATS_NAME))
+		zc->zc_cookie = pobj;
 	dmu_objset_rele_flags(os, B_TRUE, FTAG);
 
 	return (error);
@@ -5741,9 +5747,9 @@ static boolean_t zfs_ioc_recv_inject_err;
 static int
 zfs_ioc_recv_impl(char *tofs, char *tosnap, const char *origin,
     nvlist_t *recvprops, nvlist_t *localprops, nvlist_t *hidden_args,
-    boolean_t force, boolean_t heal, boolean_t resumable, int input_fd,
-    dmu_replay_record_t *begin_record, uint64_t *read_bytes,
-    uint64_t *errflags, nvlist_t **errors)
+    boolean_t force, boolean_t heal, boolean_t uncached, boolean_t resumable,
+    int input_fd, dmu_replay_record_t *begin_record, uint64_t *read_bytes,
+    uint64_t *uncached_bytes, uint64_t *errflags, nvlist_t **errors)
 {
 	dmu_recv_cookie_t drc;
 	int error = 0;
@@ -5759,6 +5765,7 @@ zfs_ioc_recv_impl(char *tofs, char *tosnap, const char *origin,
 	zfs_file_t *input_fp;
 
 	*read_bytes = 0;
+	*uncached_bytes = 0;
 	*errflags = 0;
 	*errors = fnvlist_alloc();
 	off = 0;
@@ -5768,8 +5775,8 @@ zfs_ioc_recv_impl(char *tofs, char *tosnap, const char *origin,
 
 	noff = off = zfs_file_off(input_fp);
 	error = dmu_recv_begin(tofs, tosnap, begin_record, force, heal,
-	    resumable, localprops, hidden_args, origin, &drc, input_fp,
-	    &off);
+	    uncached, resumable, localprops, hidden_args, origin, &drc,
+	    input_fp, &off);
 	if (error != 0)
 		goto out;
 	drc.drc_errors = *errors;
@@ -5884,6 +5891,7 @@ zfs_ioc_recv_impl(char *tofs, char *tosnap, const char *origin,
 	}
 
 	error = dmu_recv_stream(&drc, &off);
+	*uncached_bytes = drc.drc_uncached_bytes;
 
 	if (error == 0) {
 		zfsvfs_t *zfsvfs = NULL;
@@ -6099,6 +6107,7 @@ zfs_ioc_recv(zfs_cmd_t *zc)
 	const char *origin = NULL;
 	char *tosnap;
 	char tofs[ZFS_MAX_DATASET_NAME_LEN];
+	uint64_t uncached_bytes;
 	int error = 0;
 
 	if (dataset_namecheck(zc->zc_value, NULL, NULL) != 0 ||
@@ -6131,8 +6140,9 @@ zfs_ioc_recv(zfs_cmd_t *zc)
 	begin_record.drr_u.drr_begin = zc->zc_begin_record;
 
 	error = zfs_ioc_recv_impl(tofs, tosnap, origin, recvdprops, localprops,
-	    NULL, zc->zc_guid, B_FALSE, B_FALSE, zc->zc_cookie, &begin_record,
-	    &zc->zc_cookie, &zc->zc_obj, &errors);
+	    NULL, zc->zc_guid, B_FALSE, B_FALSE, B_FALSE, zc->zc_cookie,
+	    &begin_record, &zc->zc_cookie, &uncached_bytes, &zc->zc_obj,
+	    &errors);
 
 	/*
 	 * Now that all props, initial and delayed, are set, report the prop
@@ -6169,6 +6179,7 @@ out:
  *     "input_fd" -> file descriptor to read stream from (int32)
  *     (optional) "force" -> force flag (value ignored)
  *     (optional) "heal" -> use send stream to heal data corruption
+ *     (optional) "uncached" -> write whole blocks with Direct I/O
  *     (optional) "resumable" -> resumable flag (value ignored)
  *     (optional) "cleanup_fd" -> unused
  *     (optional) "action_handle" -> unused
@@ -6177,6 +6188,8 @@ out:
  *
  * outnvl: {
  *     "read_bytes" -> number of bytes read
+ *     (optional) "uncached_bytes" -> bytes written without going through
+ *         the ARC, when "uncached" was given
  *     "error_flags" -> zprop_errflags_t
  *     "errors" -> error for each unapplied received property (nvlist)
  * }
@@ -6190,6 +6203,7 @@ static const zfs_ioc_key_t zfs_keys_recv_new[] = {
 	{"input_fd",		DATA_TYPE_INT32,	0},
 	{"force",		DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
 	{"heal",		DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
+	{"uncached",		DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
 	{"resumable",		DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
 	{"cleanup_fd",		DATA_TYPE_INT32,	ZK_OPTIONAL},
 	{"action_handle",	DATA_TYPE_UINT64,	ZK_OPTIONAL},
@@ -6211,8 +6225,10 @@ zfs_ioc_recv_new(const char *fsname, nvlist_t *innvl, nvlist_t *outnvl)
 	char tofs[ZFS_MAX_DATASET_NAME_LEN];
 	boolean_t force;
 	boolean_t heal;
+	boolean_t uncached;
 	boolean_t resumable;
 	uint64_t read_bytes = 0;
+	uint64_t uncached_bytes = 0;
 	uint64_t errflags = 0;
 	int input_fd = -1;
 	int error;
@@ -6242,6 +6258,7 @@ zfs_ioc_recv_new(const char *fsname, nvlist_t *innvl, nvlist_t *outnvl)
 
 	force = nvlist_exists(innvl, "force");
 	heal = nvlist_exists(innvl, "heal");
+	uncached = nvlist_exists(innvl, "uncached");
 	resumable = nvlist_exists(innvl, "resumable");
 
 	/* we still use "props" here for backwards compatibility */
@@ -6258,10 +6275,12 @@ zfs_ioc_recv_new(const char *fsname, nvlist_t *innvl, nvlist_t *outnvl)
 		goto out;
 
 	error = zfs_ioc_recv_impl(tofs, tosnap, origin, recvprops, localprops,
-	    hidden_args, force, heal, resumable, input_fd, begin_record,
-	    &read_bytes, &errflags, &errors);
+	    hidden_args, force, heal, uncached, resumable, input_fd,
+	    begin_record, &read_bytes, &uncached_bytes, &errflags, &errors);
 
 	fnvlist_add_uint64(outnvl, "read_bytes", read_bytes);
+	if (uncached)
+		fnvlist_add_uint64(outnvl, "uncached_bytes", uncached_bytes);
 	fnvlist_add_uint64(outnvl, "error_flags", errflags);
 	fnvlist_add_nvlist(outnvl, "errors", errors);
 
@@ -99,11 +99,65 @@
  * So if the block size needs to be grown then the whole file is
  * exclusively locked, then later the caller will reduce the lock
  * range to just the range to be written using rangelock_reduce().
+ *
+ * Sharding
+ * --------
+ * All locks of a file serialize on rl_lock, which becomes the bottleneck
+ * when many threads do small I/Os on different parts of the same large file
+ * (VM images, databases).  So the first time rl_lock is found contended by
+ * a lock beyond the first stripe of zfs_rangelock_shard_shift bytes, the
+ * file is striped across zfs_rangelock_shards shards, each with its own
+ * mutex and AVL tree, and stripe n is mapped to shard n % rl_nshards.
+ * A range is then locked in each of the shards its stripes map to (every
+ * shard for ranges of rl_nshards stripes or more).  Each shard holds the
+ * whole range, so two overlapping ranges always meet in the shards of the
+ * stripes they share, whichever shards they span, and the AVL tree code
+ * above applies to each shard unchanged.  The lock returned to the caller
+ * is the one in the first shard, and the locks in the others are chained
+ * to it through lr_next.
+ *
+ * A thread never sleeps in a shard while holding part of the same range:
+ * only the first shard is waited for, the others are only tried, and on
+ * conflict every shard locked so far is unlocked before waiting for the
+ * conflicting one and starting over.  Shard order alone would not be
+ * enough, as callers such as zfs_clone_range() hold a whole range while
+ * locking another one of the same file, in offset order.
+ *
+ * Locks taken in rl_tree are not visible in the shards, so the shards are
+ * allocated when rl_lock is contended but only installed once rl_tree is
+ * empty, by the thread releasing its last lock; until then, locks are
+ * still taken in rl_tree.  Waiting for rl_tree to drain instead would hang
+ * a thread that already holds a lock in rl_tree and takes a second one.
+ * Once installed, rl_tree is not used again, and threads waiting in rl_tree
+ * give up and retry in the shards.
+ *
+ * The callback can't be invoked under the mutex of every shard, so for
+ * sharded locks it is invoked with no mutex held, and again once the range
+ * is locked: if the range it then computes differs (e.g. the end of file
+ * moved in the meantime for RL_APPEND), the range is unlocked and the lock
+ * retried.
+ *
+ * The shards are allocated on demand because most files are small or not
+ * accessed concurrently, and are kept until zfs_rangelock_fini().
  */
 
 #include <sys/zfs_context.h>
 #include <sys/zfs_rlock.h>
 
+/*
+ * Number of shards to spread the locks of a file across when rl_lock is
+ * contended, 0 or 1 to never shard.
+ */
+static uint_t zfs_rangelock_shards = 16;
+
+/*
+ * log2 of the size of the stripes of a file mapped to each shard.
+ */
+static uint_t zfs_rangelock_shard_shift = 20;
+
+#define	ZFS_RANGELOCK_SHARDS_MAX	64
+#define	ZFS_RANGELOCK_SHARD_SHIFT_MIN	12
+#define	ZFS_RANGELOCK_SHARD_SHIFT_MAX	40
 
 /*
  * AVL comparison function used to order range locks
@@ -131,6 +185,20 @@ zfs_rangelock_init(zfs_rangelock_t *rl, zfs_rangelock_cb_t *cb, void *arg)
 	    sizeof (zfs_locked_range_t), offsetof(zfs_locked_range_t, lr_node));
 	rl->rl_cb = cb;
 	rl->rl_arg = arg;
+	rl->rl_shards = NULL;
+	rl->rl_shards_pending = NULL;
+	rl->rl_nshards = 0;
+	rl->rl_shard_shift = 0;
+}
+
+static void
+zfs_rangelock_free_shards(zfs_rangelock_shard_t *shards, uint_t nshards)
+{
+	for (uint_t i = 0; i < nshards; i++) {
+		mutex_destroy(&shards[i].rls_lock);
+		avl_destroy(&shards[i].rls_tree);
+	}
+	kmem_free(shards, nshards * sizeof (zfs_rangelock_shard_t));
 }
 
 void
@@ -138,17 +206,25 @@ zfs_rangelock_fini(zfs_rangelock_t *rl)
 {
 	mutex_destroy(&rl->rl_lock);
 	avl_destroy(&rl->rl_tree);
+
+	if (rl->rl_shards != NULL)
+		zfs_rangelock_free_shards(rl->rl_shards, rl->rl_nshards);
+	if (rl->rl_shards_pending != NULL)
+		zfs_rangelock_free_shards(rl->rl_shards_pending,
+		    rl->rl_nshards);
 }
 
 /*
  * Check if a write lock can be grabbed.  If not, fail immediately or sleep and
  * recheck until available, depending on the value of the "nonblock" parameter.
+ * When locking in rl_tree, also fail if the rangelock got sharded while
+ * sleeping; in a shard, the callback has already been invoked by the caller.
  */
 static boolean_t
-zfs_rangelock_enter_writer(zfs_rangelock_t *rl, zfs_locked_range_t *new,
-    boolean_t nonblock)
+zfs_rangelock_enter_writer(zfs_rangelock_t *rl, avl_tree_t *tree,
+    kmutex_t *lock, zfs_locked_range_t *new, boolean_t nonblock)
 {
-	avl_tree_t *tree = &rl->rl_tree;
+	boolean_t root = (tree == &rl->rl_tree);
 	zfs_locked_range_t *lr;
 	avl_index_t where;
 	uint64_t orig_off = new->lr_offset;
@@ -161,7 +237,7 @@ zfs_rangelock_enter_writer(zfs_rangelock_t *rl, zfs_locked_range_t *new,
 		 * Note, the callback is used by the ZPL to handle appending
 		 * and changing blocksizes.  It isn't needed for zvols.
 		 */
-		if (rl->rl_cb != NULL) {
+		if (root && rl->rl_cb != NULL) {
 			rl->rl_cb(new, rl->rl_arg);
 		}
 
@@ -205,12 +281,16 @@ wait:
 			cv_init(&lr->lr_write_cv, NULL, CV_DEFAULT, NULL);
 			lr->lr_write_wanted = B_TRUE;
 		}
-		cv_wait(&lr->lr_write_cv, &rl->rl_lock);
+		cv_wait(&lr->lr_write_cv, lock);
+		if (!root)
+			continue;
 
 		/* reset to original */
 		new->lr_offset = orig_off;
 		new->lr_length = orig_len;
 		new->lr_type = orig_type;
+		if (rl->rl_shards != NULL)
+			return (B_FALSE);
 	}
 }
 
@@ -388,21 +468,32 @@ zfs_rangelock_add_reader(avl_tree_t *tree, zfs_locked_range_t *new,
 /*
  * Check if a reader lock can be grabbed.  If not, fail immediately or sleep and
  * recheck until available, depending on the value of the "nonblock" parameter.
+ * When locking in rl_tree, also fail if the rangelock got sharded while
+ * sleeping.
  */
 static boolean_t
-zfs_rangelock_enter_reader(zfs_rangelock_t *rl, zfs_locked_range_t *new,
-    boolean_t nonblock)
+zfs_rangelock_enter_reader(zfs_rangelock_t *rl, avl_tree_t *tree,
+    kmutex_t *lock, zfs_locked_range_t *new, boolean_t nonblock)
 {
-	avl_tree_t *tree = &rl->rl_tree;
 	zfs_locked_range_t *prev, *next;
 	avl_index_t where;
 	uint64_t off = new->lr_offset;
 	uint64_t len = new->lr_length;
 
+	/*
+	 * First check for the usual case of no locks
+	 */
+	if (avl_numnodes(tree) == 0) {
+		avl_add(tree, new);
+		return (B_TRUE);
+	}
+
 	/*
 	 * Look for any writer locks in the range.
 	 */
 retry:
+	if (tree == &rl->rl_tree && rl->rl_shards != NULL)
+		return (B_FALSE);
 	prev = avl_find(tree, new, &where);
 	if (prev == NULL)
 		prev = avl_nearest(tree, where, AVL_BEFORE);
@@ -419,7 +510,7 @@ retry:
 				    NULL, CV_DEFAULT, NULL);
 				prev->lr_read_wanted = B_TRUE;
 			}
-			cv_wait(&prev->lr_read_cv, &rl->rl_lock);
+			cv_wait(&prev->lr_read_cv, lock);
 			goto retry;
 		}
 		if (off + len < prev->lr_offset + prev->lr_length)
@@ -445,7 +536,7 @@ retry:
 				    NULL, CV_DEFAULT, NULL);
 				next->lr_read_wanted = B_TRUE;
 			}
-			cv_wait(&next->lr_read_cv, &rl->rl_lock);
+			cv_wait(&next->lr_read_cv, lock);
 			goto retry;
 		}
 		if (off + len <= next->lr_offset + next->lr_length)
@@ -461,6 +552,190 @@ got_lock:
 	return (B_TRUE);
 }
 
+static zfs_locked_range_t *
+zfs_rangelock_alloc(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
+    zfs_rangelock_type_t type)
+{
+	zfs_locked_range_t *new;
+
+	new = kmem_alloc(sizeof (zfs_locked_range_t), KM_SLEEP);
+	new->lr_rangelock = rl;
+	new->lr_shard = NULL;
+	new->lr_next = NULL;
+	new->lr_offset = off;
+	new->lr_length = len;
+	new->lr_count = 1; /* assume it's going to be in the tree */
+	new->lr_type = type;
+	new->lr_proxy = B_FALSE;
+	new->lr_write_wanted = B_FALSE;
+	new->lr_read_wanted = B_FALSE;
+	return (new);
+}
+
+/*
+ * Called when rl_lock is contended: shard the rangelock if it is worth it
+ * for the range being locked, i.e. if the range starts past the first stripe
+ * of the file.  The shards are only installed right away if rl_tree is
+ * empty, and otherwise by zfs_rangelock_exit() once it empties.  Returns
+ * B_TRUE if the rangelock is sharded.
+ */
+static boolean_t
+zfs_rangelock_shard(zfs_rangelock_t *rl, uint64_t off)
+{
+	zfs_rangelock_shard_t *shards;
+	uint_t nshards = MIN(zfs_rangelock_shards, ZFS_RANGELOCK_SHARDS_MAX);
+	uint_t shift = zfs_rangelock_shard_shift;
+	boolean_t sharded;
+
+	shift = MAX(shift, ZFS_RANGELOCK_SHARD_SHIFT_MIN);
+	shift = MIN(shift, ZFS_RANGELOCK_SHARD_SHIFT_MAX);
+	if (nshards < 2 || (off >> shift) == 0)
+		return (B_FALSE);
+	if (rl->rl_shards_pending != NULL)
+		return (B_FALSE);
+
+	shards = kmem_zalloc(nshards * sizeof (zfs_rangelock_shard_t),
+	    KM_SLEEP);
+	for (uint_t i = 0; i < nshards; i++) {
+		mutex_init(&shards[i].rls_lock, NULL, MUTEX_DEFAULT, NULL);
+		avl_create(&shards[i].rls_tree, zfs_rangelock_compare,
+		    sizeof (zfs_locked_range_t),
+		    offsetof(zfs_locked_range_t, lr_node));
+	}
+
+	mutex_enter(&rl->rl_lock);
+	if (rl->rl_shards == NULL && rl->rl_shards_pending == NULL) {
+		rl->rl_nshards = nshards;
+		rl->rl_shard_shift = shift;
+		if (avl_numnodes(&rl->rl_tree) == 0) {
+			membar_producer();
+			rl->rl_shards = shards;
+		} else {
+			rl->rl_shards_pending = shards;
+		}
+		shards = NULL;
+	}
+	sharded = (rl->rl_shards != NULL);
+	mutex_exit(&rl->rl_lock);
+
+	if (shards != NULL)
+		zfs_rangelock_free_shards(shards, nshards);
+	return (sharded);
+}
+
+static void zfs_rangelock_exit_sharded(zfs_locked_range_t *);
+
+/*
+ * Lock a range in a single shard.
+ */
+static boolean_t
+zfs_rangelock_enter_shard(zfs_rangelock_t *rl, zfs_rangelock_shard_t *rls,
+    zfs_locked_range_t *lr, boolean_t nonblock)
+{
+	boolean_t locked;
+
+	lr->lr_shard = rls;
+	mutex_enter(&rls->rls_lock);
+	if (lr->lr_type == RL_READER) {
+		locked = zfs_rangelock_enter_reader(rl, &rls->rls_tree,
+		    &rls->rls_lock, lr, nonblock);
+	} else {
+		locked = zfs_rangelock_enter_writer(rl, &rls->rls_tree,
+		    &rls->rls_lock, lr, nonblock);
+	}
+	mutex_exit(&rls->rls_lock);
+	return (locked);
+}
+
+/*
+ * Lock a range in each of the shards its stripes map to, waiting only in
+ * the first one.  See the comment at the top of the file.
+ */
+static zfs_locked_range_t *
+zfs_rangelock_enter_sharded(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
+    zfs_rangelock_type_t type, boolean_t nonblock)
+{
+	zfs_locked_range_t *new, *lr, **lrp, check;
+
+	membar_consumer();
+	uint_t nshards = rl->rl_nshards;
+	uint_t shift = rl->rl_shard_shift;
+	for (;;) {
+		zfs_rangelock_shard_t *busy = NULL;
+
+		new = zfs_rangelock_alloc(rl, off, len, type);
+		if (type != RL_READER && rl->rl_cb != NULL)
+			rl->rl_cb(new, rl->rl_arg);
+		ASSERT(new->lr_type == RL_READER || new->lr_type == RL_WRITER);
+
+		uint64_t first = new->lr_offset >> shift;
+		uint64_t last = new->lr_length == 0 ? first :
+		    (new->lr_offset + new->lr_length - 1) >> shift;
+		uint_t base = first % nshards;
+
+		lr = NULL;
+		lrp = &new;
+		for (uint_t i = 0; i < nshards; i++) {
+			if (last - first < nshards - 1 &&
+			    (i + nshards - base) % nshards > last - first)
+				continue;
+
+			boolean_t held = (lr != NULL);
+			if (!held) {
+				lr = new;
+			} else {
+				lr = zfs_rangelock_alloc(rl, new->lr_offset,
+				    new->lr_length, new->lr_type);
+			}
+
+			if (!zfs_rangelock_enter_shard(rl, &rl->rl_shards[i],
+			    lr, nonblock || held)) {
+				kmem_free(lr, sizeof (zfs_locked_range_t));
+				if (lr != new)
+					zfs_rangelock_exit_sharded(new);
+				if (nonblock)
+					return (NULL);
+				busy = &rl->rl_shards[i];
+				break;
+			}
+			*lrp = lr;
+			lrp = &lr->lr_next;
+		}
+
+		if (busy != NULL) {
+			/*
+			 * Wait for the conflicting lock with nothing held,
+			 * then start over.
+			 */
+			lr = zfs_rangelock_alloc(rl, off, len, type);
+			if (type != RL_READER && rl->rl_cb != NULL)
+				rl->rl_cb(lr, rl->rl_arg);
+			VERIFY(zfs_rangelock_enter_shard(rl, busy, lr,
+			    B_FALSE));
+			zfs_rangelock_exit_sharded(lr);
+			continue;
+		}
+
+		if (type == RL_READER || rl->rl_cb == NULL)
+			return (new);
+
+		/*
+		 * Check that the callback still agrees with the range locked,
+		 * now that no conflicting lock can change the file.
+		 */
+		check.lr_rangelock = rl;
+		check.lr_offset = off;
+		check.lr_length = len;
+		check.lr_type = type;
+		rl->rl_cb(&check, rl->rl_arg);
+		if (check.lr_offset == new->lr_offset &&
+		    check.lr_length == new->lr_length)
+			return (new);
+
+		zfs_rangelock_exit_sharded(new);
+	}
+}
+
 /*
  * Lock a range (offset, length) as either shared (RL_READER) or exclusive
  * (RL_WRITER or RL_APPEND).  If RL_APPEND is specified, rl_cb() will convert
@@ -474,37 +749,47 @@ zfs_rangelock_enter_impl(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
     zfs_rangelock_type_t type, boolean_t nonblock)
 {
 	zfs_locked_range_t *new;
+	boolean_t locked;
 
 	ASSERT(type == RL_READER || type == RL_WRITER || type == RL_APPEND);
 
-	new = kmem_alloc(sizeof (zfs_locked_range_t), KM_SLEEP);
-	new->lr_rangelock = rl;
-	new->lr_offset = off;
 	if (len + off < off)	/* overflow */
 		len = UINT64_MAX - off;
-	new->lr_length = len;
-	new->lr_count = 1; /* assume it's going to be in the tree */
-	new->lr_type = type;
-	new->lr_proxy = B_FALSE;
-	new->lr_write_wanted = B_FALSE;
-	new->lr_read_wanted = B_FALSE;
 
-	mutex_enter(&rl->rl_lock);
+	if (rl->rl_shards != NULL)
+		return (zfs_rangelock_enter_sharded(rl, off, len, type,
+		    nonblock));
+
+	if (!mutex_tryenter(&rl->rl_lock)) {
+		if (zfs_rangelock_shard(rl, off))
+			return (zfs_rangelock_enter_sharded(rl, off, len, type,
+			    nonblock));
+		mutex_enter(&rl->rl_lock);
+	}
+	if (rl->rl_shards != NULL) {
+		mutex_exit(&rl->rl_lock);
+		return (zfs_rangelock_enter_sharded(rl, off, len, type,
+		    nonblock));
+	}
+
+	new = zfs_rangelock_alloc(rl, off, len, type);
 	if (type == RL_READER) {
-		/*
-		 * First check for the usual case of no locks
-		 */
-		if (avl_numnodes(&rl->rl_tree) == 0) {
-			avl_add(&rl->rl_tree, new);
-		} else if (!zfs_rangelock_enter_reader(rl, new, nonblock)) {
-			kmem_free(new, sizeof (*new));
-			new = NULL;
-		}
-	} else if (!zfs_rangelock_enter_writer(rl, new, nonblock)) {
-		kmem_free(new, sizeof (*new));
-		new = NULL;
+		locked = zfs_rangelock_enter_reader(rl, &rl->rl_tree,
+		    &rl->rl_lock, new, nonblock);
+	} else {
+		locked = zfs_rangelock_enter_writer(rl, &rl->rl_tree,
+		    &rl->rl_lock, new, nonblock);
 	}
 	mutex_exit(&rl->rl_lock);
+
+	if (!locked) {
+		kmem_free(new, sizeof (*new));
+		/* Failing to lock without nonblock means sharding started. */
+		if (nonblock)
+			return (NULL);
+		return (zfs_rangelock_enter_sharded(rl, off, len, type,
+		    nonblock));
+	}
 	return (new);
 }
 
@@ -541,10 +826,9 @@ zfs_rangelock_free(zfs_locked_range_t *lr)
  * Unlock a reader lock
  */
 static void
-zfs_rangelock_exit_reader(zfs_rangelock_t *rl, zfs_locked_range_t *remove,
+zfs_rangelock_exit_reader(avl_tree_t *tree, zfs_locked_range_t *remove,
     list_t *free_list)
 {
-	avl_tree_t *tree = &rl->rl_tree;
 	uint64_t len;
 
 	/*
@@ -599,6 +883,57 @@ zfs_rangelock_exit_reader(zfs_rangelock_t *rl, zfs_locked_range_t *remove,
 	}
 }
 
+/*
+ * Unlock range in a tree, deferring the frees to free_list.
+ */
+static void
+zfs_rangelock_exit_tree(avl_tree_t *tree, zfs_locked_range_t *lr,
+    list_t *free_list)
+{
+	if (lr->lr_type == RL_WRITER) {
+		/* writer locks can't be shared or split */
+		avl_remove(tree, lr);
+		if (lr->lr_write_wanted)
+			cv_broadcast(&lr->lr_write_cv);
+		if (lr->lr_read_wanted)
+			cv_broadcast(&lr->lr_read_cv);
+		list_insert_tail(free_list, lr);
+	} else {
+		/*
+		 * lock may be shared, let rangelock_exit_reader()
+		 * release the lock and free the zfs_locked_range_t.
+		 */
+		zfs_rangelock_exit_reader(tree, lr, free_list);
+	}
+}
+
+/*
+ * Unlock a range locked in the shards, from each shard it is chained in.
+ */
+static void
+zfs_rangelock_exit_sharded(zfs_locked_range_t *lr)
+{
+	zfs_locked_range_t *next, *free_lr;
+	list_t free_list;
+
+	list_create(&free_list, sizeof (zfs_locked_range_t),
+	    offsetof(zfs_locked_range_t, lr_node));
+
+	for (; lr != NULL; lr = next) {
+		zfs_rangelock_shard_t *rls = lr->lr_shard;
+
+		next = lr->lr_next;
+		mutex_enter(&rls->rls_lock);
+		zfs_rangelock_exit_tree(&rls->rls_tree, lr, &free_list);
+		mutex_exit(&rls->rls_lock);
+	}
+
+	while ((free_lr = list_remove_head(&free_list)) != NULL)
+		zfs_rangelock_free(free_lr);
+
+	list_destroy(&free_list);
+}
+
 /*
  * Unlock range and destroy range lock structure.
  */
@@ -613,6 +948,11 @@ zfs_rangelock_exit(zfs_locked_range_t *lr)
 	ASSERT(lr->lr_count == 1 || lr->lr_count == 0);
 	ASSERT(!lr->lr_proxy);
 
+	if (lr->lr_shard != NULL) {
+		zfs_rangelock_exit_sharded(lr);
+		return;
+	}
+
 	/*
 	 * The free list is used to defer the cv_destroy() and
 	 * subsequent kmem_free until after the mutex is dropped.
@@ -621,20 +961,13 @@ zfs_rangelock_exit(zfs_locked_range_t *lr)
 	    offsetof(zfs_locked_range_t, lr_node));
 
 	mutex_enter(&rl->rl_lock);
-	if (lr->lr_type == RL_WRITER) {
-		/* writer locks can't be shared or split */
-		avl_remove(&rl->rl_tree, lr);
-		if (lr->lr_write_wanted)
-			cv_broadcast(&lr->lr_write_cv);
-		if (lr->lr_read_wanted)
-			cv_broadcast(&lr->lr_read_cv);
-		list_insert_tail(&free_list, lr);
-	} else {
-		/*
-		 * lock may be shared, let rangelock_exit_reader()
-		 * release the lock and free the zfs_locked_range_t.
-		 */
-		zfs_rangelock_exit_reader(rl, lr, &free_list);
+	zfs_rangelock_exit_tree(&rl->rl_tree, lr, &free_list);
+	if (rl->rl_shards_pending != NULL &&
+	    avl_numnodes(&rl->rl_tree) == 0) {
+		/* Nothing can be missed by the shards anymore. */
+		membar_producer();
+		rl->rl_shards = rl->rl_shards_pending;
+		rl->rl_shards_pending = NULL;
 	}
 	mutex_exit(&rl->rl_lock);
 
@@ -654,22 +987,36 @@ zfs_rangelock_reduce(zfs_locked_range_t *lr, uint64_t off, uint64_t len)
 {
 	zfs_rangelock_t *rl = lr->lr_rangelock;
 
-	/* Ensure there are no other locks */
-	ASSERT3U(avl_numnodes(&rl->rl_tree), ==, 1);
+	if (lr->lr_shard == NULL) {
+		/* Ensure there are no other locks */
+		ASSERT3U(avl_numnodes(&rl->rl_tree), ==, 1);
+	}
 	ASSERT0(lr->lr_offset);
 	ASSERT3U(lr->lr_type, ==, RL_WRITER);
 	ASSERT(!lr->lr_proxy);
 	ASSERT3U(lr->lr_length, ==, UINT64_MAX);
 	ASSERT3U(lr->lr_count, ==, 1);
 
-	mutex_enter(&rl->rl_lock);
-	lr->lr_offset = off;
-	lr->lr_length = len;
-	mutex_exit(&rl->rl_lock);
-	if (lr->lr_write_wanted)
-		cv_broadcast(&lr->lr_write_cv);
-	if (lr->lr_read_wanted)
-		cv_broadcast(&lr->lr_read_cv);
+	/*
+	 * A sharded lock of the whole file is in every shard, and simply
+	 * stays there: a lock in a shard that none of its stripes map to
+	 * can only meet locks which overlap it anyway.
+	 */
+	for (; lr != NULL; lr = lr->lr_next) {
+		kmutex_t *lock = lr->lr_shard != NULL ?
+		    &lr->lr_shard->rls_lock : &rl->rl_lock;
+
+		ASSERT(lr->lr_shard == NULL ||
+		    avl_numnodes(&lr->lr_shard->rls_tree) == 1);
+		mutex_enter(lock);
+		lr->lr_offset = off;
+		lr->lr_length = len;
+		mutex_exit(lock);
+		if (lr->lr_write_wanted)
+			cv_broadcast(&lr->lr_write_cv);
+		if (lr->lr_read_wanted)
+			cv_broadcast(&lr->lr_read_cv);
+	}
 }
 
 #if defined(_KERNEL)
@@ -680,3 +1027,9 @@ EXPORT_SYMBOL(zfs_rangelock_tryenter);
 EXPORT_SYMBOL(zfs_rangelock_exit);
 EXPORT_SYMBOL(zfs_rangelock_reduce);
 #endif
+
+ZFS_MODULE_PARAM(zfs, zfs_, rangelock_shards, UINT, ZMOD_RW,
+	"Number of shards to spread the range locks of contended files across");
+
+ZFS_MODULE_PARAM(zfs, zfs_, rangelock_shard_shift, UINT, ZMOD_RW,
+	"log2 of the stripe size of a file mapped to each range lock shard");
@@ -90,6 +90,13 @@ static int zfs_dio_enabled = 1;
  */
 static int zfs_dio_strict = 0;
 
+/*
+ * Do not keep the data of memory mapped files in the ARC as well as in the
+ * page cache: fill pages with uncached reads, and make writes to mapped
+ * ranges uncached, so the ARC drops its copy once the I/O is done.
+ */
+int zfs_mmap_uncached = 0;
+
 
 /*
  * Maximum bytes to read per chunk in zfs_read().
@@ -274,10 +281,12 @@ zfs_setup_direct(struct znode *zp, zfs_uio_t *uio, zfs_uio_rw_t rw,
 	}
 
 	/*
-	 * For short writes the page mapping of Direct I/O makes no sense.
+	 * For short writes the page mapping of Direct I/O makes no sense,
+	 * unless they are merged into their blocks by zfs_dio_write_rmw.
 	 * Direct them through the ARC as uncached I/O.
 	 */
-	if (rw == UIO_WRITE && zfs_uio_resid(uio) < zp->z_blksz)
+	if (rw == UIO_WRITE && zfs_uio_resid(uio) < zp->z_blksz &&
+	    !zfs_dio_write_rmw)
 		goto out;
 
 	error = zfs_uio_get_dio_pages_alloc(uio, rw);
@@ -290,6 +299,37 @@ out:
 	return (error);
 }
 
+/*
+ * Lock the blocks a write of len bytes at off touches.  The block size can
+ * only change while the whole file is locked, so once any range is locked
+ * it is stable; retry if it changed before the lock was taken.  Returns
+ * NULL if nowait is set and the range is locked by someone else.
+ */
+static zfs_locked_range_t *
+zfs_rangelock_enter_blocks(znode_t *zp, uint64_t off, uint64_t len,
+    boolean_t nowait)
+{
+	for (;;) {
+		uint64_t blksz = zp->z_blksz;
+		uint64_t start = off - off % blksz;
+		uint64_t end = roundup(off + len, blksz);
+		zfs_locked_range_t *lr;
+
+		if (nowait) {
+			lr = zfs_rangelock_tryenter(&zp->z_rangelock, start,
+			    end - start, RL_WRITER);
+			if (lr == NULL)
+				return (NULL);
+		} else {
+			lr = zfs_rangelock_enter(&zp->z_rangelock, start,
+			    end - start, RL_WRITER);
+		}
+		if (lr->lr_length == UINT64_MAX || zp->z_blksz == blksz)
+			return (lr);
+		zfs_rangelock_exit(lr);
+	}
+}
+
 /*
  * Read bytes from specified file into supplied buffer.
  *
@@ -298,6 +338,7 @@ out:
  *			  and return buffer.
  *		ioflag	- O_SYNC flags; used to provide FRSYNC semantics.
  *			  O_DIRECT flag; used to bypass page cache.
+ *			  ZFS_IO_NOWAIT flag; EAGAIN rather than block.
  *		cr	- credentials of caller.
  *
  *	OUT:	uio	- updated offset and range, buffer filled.
@@ -314,6 +355,7 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	int error = 0;
 	boolean_t frsync = B_FALSE;
 	boolean_t dio_checksum_failure = B_FALSE;
+	boolean_t nowait = !!(ioflag & ZFS_IO_NOWAIT);
 
 	zfsvfs_t *zfsvfs = ZTOZSB(zp);
 	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
@@ -359,6 +401,10 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 #endif
 	if (zfsvfs->z_log &&
 	    (frsync || zfsvfs->z_os->os_sync == ZFS_SYNC_ALWAYS)) {
+		if (nowait) {
+			zfs_exit(zfsvfs, FTAG);
+			return (SET_ERROR(EAGAIN));
+		}
 		error = zil_commit(zfsvfs->z_log, zp->z_id);
 		if (error != 0) {
 			zfs_exit(zfsvfs, FTAG);
@@ -369,8 +415,18 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	/*
 	 * Lock the range against changes.
 	 */
-	zfs_locked_range_t *lr = zfs_rangelock_enter(&zp->z_rangelock,
-	    zfs_uio_offset(uio), zfs_uio_resid(uio), RL_READER);
+	zfs_locked_range_t *lr;
+	if (nowait) {
+		lr = zfs_rangelock_tryenter(&zp->z_rangelock,
+		    zfs_uio_offset(uio), zfs_uio_resid(uio), RL_READER);
+		if (lr == NULL) {
+			zfs_exit(zfsvfs, FTAG);
+			return (SET_ERROR(EAGAIN));
+		}
+	} else {
+		lr = zfs_rangelock_enter(&zp->z_rangelock,
+		    zfs_uio_offset(uio), zfs_uio_resid(uio), RL_READER);
+	}
 
 	/*
 	 * If we are reading past end-of-file we can skip
@@ -390,6 +446,14 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		goto out;
 	}
 
+	/*
+	 * Only reads served from the ARC can complete without waiting.
+	 */
+	if (nowait && (uio->uio_extflg & UIO_DIRECT)) {
+		error = SET_ERROR(EAGAIN);
+		goto out;
+	}
+
 #if defined(__linux__)
 	ssize_t start_offset = zfs_uio_offset(uio);
 #endif
@@ -402,6 +466,8 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	dmu_flags_t dflags = DMU_READ_PREFETCH;
 	if (ioflag & O_DIRECT)
 		dflags |= DMU_UNCACHEDIO;
+	if (nowait)
+		dflags |= DMU_NOWAIT;
 	if (uio->uio_extflg & UIO_DIRECT) {
 		/*
 		 * All pages for an O_DIRECT request ahve already been mapped
@@ -440,13 +506,25 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 #endif
 		if (zn_has_cached_data(zp, zfs_uio_offset(uio),
 		    zfs_uio_offset(uio) + nbytes - 1)) {
-			error = mappedread(zp, nbytes, uio);
+			if (nowait)
+				error = SET_ERROR(EAGAIN);
+			else
+				error = mappedread(zp, nbytes, uio);
 		} else {
 			error = dmu_read_uio_dbuf(sa_get_db(zp->z_sa_hdl),
 			    uio, nbytes, dflags);
 		}
 
 		if (error) {
+			/*
+			 * A short read is better than none, and the caller
+			 * retries the rest with blocking allowed.
+			 */
+			if (error == EAGAIN && n != start_resid) {
+				error = 0;
+				break;
+			}
+
 			/* convert checksum errors into IO errors */
 			if (error == ECKSUM) {
 				/*
@@ -530,6 +608,135 @@ out:
 	return (error);
 }
 
+typedef struct zfs_read_async {
+	znode_t			*zra_zp;
+	zfs_uio_t		*zra_uio;
+	zfs_locked_range_t	*zra_lr;
+	ssize_t			zra_start_resid;
+	zfs_read_done_t		*zra_done;
+	void			*zra_arg;
+} zfs_read_async_t;
+
+static void
+zfs_read_async_done(void *arg, int error)
+{
+	zfs_read_async_t *zra = arg;
+	zfs_read_done_t *done = zra->zra_done;
+	void *done_arg = zra->zra_arg;
+
+	/* convert checksum errors into IO errors */
+	if (error == ECKSUM)
+		error = SET_ERROR(EIO);
+
+	zfsvfs_t *zfsvfs = ZTOZSB(zra->zra_zp);
+	int64_t nread = zra->zra_start_resid - zfs_uio_resid(zra->zra_uio);
+	dataset_kstats_update_read_kstats(&zfsvfs->z_kstat, nread);
+	zfs_rangelock_exit(zra->zra_lr);
+	kmem_free(zra, sizeof (*zra));
+
+	/* The file system may be torn down from here on. */
+	mutex_enter(&zfsvfs->z_async_lock);
+	if (--zfsvfs->z_async_reads == 0)
+		cv_broadcast(&zfsvfs->z_async_cv);
+	mutex_exit(&zfsvfs->z_async_lock);
+
+	done(done_arg, error);
+}
+
+/*
+ * Wait for the reads issued by zfs_read_async() to complete.  Called with
+ * z_teardown_lock held as writer, so that no more reads can be issued.
+ */
+void
+zfs_read_async_wait(zfsvfs_t *zfsvfs)
+{
+	ASSERT(ZFS_TEARDOWN_WRITE_HELD(zfsvfs));
+
+	mutex_enter(&zfsvfs->z_async_lock);
+	while (zfsvfs->z_async_reads != 0)
+		cv_wait(&zfsvfs->z_async_cv, &zfsvfs->z_async_lock);
+	mutex_exit(&zfsvfs->z_async_lock);
+}
+
+/*
+ * Asynchronous zfs_read() for AIO: the read is issued, and done() is called
+ * once the data has been copied, from zio completion context, or before
+ * returning.  The uio must describe kernel memory and stay valid until
+ * then, and the caller must keep the file open.
+ *
+ * Only reads of up to a DMU_MAX_ACCESS / 2 chunk of data through the ARC
+ * are asynchronous, which for O_DIRECT means uncached.  ENOTSUP is returned
+ * for anything needing more care, like mmap'ed pages or a ZIL commit, which
+ * the caller should pass to zfs_read().
+ *
+ *	RETURN:	0 if done() will be called, error code otherwise.
+ */
+int
+zfs_read_async(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr,
+    zfs_read_done_t *done, void *arg)
+{
+	(void) cr;
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	int error;
+
+	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
+		return (error);
+
+	boolean_t frsync = B_FALSE;
+#ifdef FRSYNC
+	frsync = !!(ioflag & FRSYNC);
+#endif
+	if ((zp->z_pflags & ZFS_AV_QUARANTINED) || Z_ISDIR(ZTOTYPE(zp)) ||
+	    zfs_uio_offset(uio) < 0 || zfs_uio_resid(uio) == 0 ||
+	    zfs_uio_resid(uio) > DMU_MAX_ACCESS / 2 ||
+	    (ioflag & ZFS_IO_NOWAIT) ||
+	    ((ioflag & O_DIRECT) && zfs_dio_strict) || (zfsvfs->z_log &&
+	    (frsync || zfsvfs->z_os->os_sync == ZFS_SYNC_ALWAYS))) {
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(ENOTSUP));
+	}
+
+	zfs_locked_range_t *lr = zfs_rangelock_enter(&zp->z_rangelock,
+	    zfs_uio_offset(uio), zfs_uio_resid(uio), RL_READER);
+	if (zfs_uio_offset(uio) >= zp->z_size ||
+	    zn_has_cached_data(zp, zfs_uio_offset(uio),
+	    MIN(zfs_uio_offset(uio) + zfs_uio_resid(uio), zp->z_size) - 1)) {
+		zfs_rangelock_exit(lr);
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(ENOTSUP));
+	}
+
+	dmu_flags_t dflags = DMU_READ_PREFETCH;
+	if ((ioflag & O_DIRECT) || zfsvfs->z_os->os_direct == ZFS_DIRECT_ALWAYS)
+		dflags |= DMU_UNCACHEDIO;
+
+	zfs_read_async_t *zra = kmem_alloc(sizeof (*zra), KM_SLEEP);
+	zra->zra_zp = zp;
+	zra->zra_uio = uio;
+	zra->zra_lr = lr;
+	zra->zra_start_resid = zfs_uio_resid(uio);
+	zra->zra_done = done;
+	zra->zra_arg = arg;
+
+	/*
+	 * z_teardown_lock can only be released by the thread which took it,
+	 * so the read is counted instead, and the file system is not torn
+	 * down until zfs_read_async_done() is done with the znode and the
+	 * dbufs.  Once issued, the znode may be gone as soon as done() is
+	 * called.
+	 */
+	mutex_enter(&zfsvfs->z_async_lock);
+	zfsvfs->z_async_reads++;
+	mutex_exit(&zfsvfs->z_async_lock);
+	ZFS_ACCESSTIME_STAMP(zfsvfs, zp);
+	dmu_read_uio_dbuf_async(sa_get_db(zp->z_sa_hdl), uio,
+	    MIN(zfs_uio_resid(uio), zp->z_size - zfs_uio_offset(uio)),
+	    dflags, zfs_read_async_done, zra);
+
+	zfs_exit(zfsvfs, FTAG);
+	return (0);
+}
+
 static void
 zfs_clear_setid_bits_if_necessary(zfsvfs_t *zfsvfs, znode_t *zp, cred_t *cr,
     uint64_t *clear_setid_bits_txgp, dmu_tx_t *tx)
@@ -593,6 +800,7 @@ zfs_clear_setid_bits_if_necessary(zfsvfs_t *zfsvfs, znode_t *zp, cred_t *cr,
  *			  and data buffer.
  *		ioflag	- O_APPEND flag set if in append mode.
  *			  O_DIRECT flag; used to bypass page cache.
+ *			  ZFS_IO_NOWAIT flag; EAGAIN rather than block.
  *		cr	- credentials of caller.
  *
  *	OUT:	uio	- updated offset and range.
@@ -610,6 +818,7 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	ssize_t start_resid = zfs_uio_resid(uio);
 	uint64_t clear_setid_bits_txg = 0;
 	boolean_t o_direct_defer = B_FALSE;
+	boolean_t nowait = !!(ioflag & ZFS_IO_NOWAIT);
 
 	/*
 	 * Fasttrack empty write
@@ -665,6 +874,15 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		return (SET_ERROR(EINVAL));
 	}
 
+	/*
+	 * Synchronous writes always wait for the ZIL.
+	 */
+	if (nowait && ((ioflag & (O_SYNC | O_DSYNC)) ||
+	    zfsvfs->z_os->os_sync == ZFS_SYNC_ALWAYS)) {
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(EAGAIN));
+	}
+
 	/*
 	 * Setting up Direct I/O if requested.
 	 */
@@ -673,6 +891,11 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		zfs_exit(zfsvfs, FTAG);
 		return (SET_ERROR(error));
 	}
+	if (nowait && (uio->uio_extflg & UIO_DIRECT)) {
+		zfs_uio_free_dio_pages(uio, UIO_WRITE);
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(EAGAIN));
+	}
 
 	/*
 	 * Pre-fault the pages to ensure slow (eg NFS) pages
@@ -688,12 +911,47 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	 * If in append mode, set the io offset pointer to eof.
 	 */
 	zfs_locked_range_t *lr;
-	if (ioflag & O_APPEND) {
+	if ((ioflag & O_APPEND) &&
+	    (uio->uio_extflg & UIO_DIRECT) && zfs_dio_write_rmw) {
+		/*
+		 * A Direct I/O append rewrites the whole last block of the
+		 * file, including the bytes before the end of file, so lock
+		 * whole blocks as below rather than from the end of file.
+		 * Retry if the end of file moved out of them meanwhile.
+		 */
+		for (;;) {
+			lr = zfs_rangelock_enter_blocks(zp, zp->z_size, n,
+			    nowait);
+			if (lr == NULL) {
+				zfs_uio_free_dio_pages(uio, UIO_WRITE);
+				zfs_exit(zfsvfs, FTAG);
+				return (SET_ERROR(EAGAIN));
+			}
+			woff = zp->z_size;
+			if (lr->lr_length == UINT64_MAX ||
+			    (woff >= lr->lr_offset &&
+			    woff + n <= lr->lr_offset + lr->lr_length))
+				break;
+			zfs_rangelock_exit(lr);
+		}
+		zfs_uio_setoffset(uio, woff);
+		zfs_uio_setsoffset(uio, woff);
+	} else if (ioflag & O_APPEND) {
 		/*
 		 * Obtain an appending range lock to guarantee file append
 		 * semantics.  We reset the write offset once we have the lock.
 		 */
-		lr = zfs_rangelock_enter(&zp->z_rangelock, 0, n, RL_APPEND);
+		if (nowait) {
+			lr = zfs_rangelock_tryenter(&zp->z_rangelock, 0, n,
+			    RL_APPEND);
+			if (lr == NULL) {
+				zfs_exit(zfsvfs, FTAG);
+				return (SET_ERROR(EAGAIN));
+			}
+		} else {
+			lr = zfs_rangelock_enter(&zp->z_rangelock, 0, n,
+			    RL_APPEND);
+		}
 		woff = lr->lr_offset;
 		if (lr->lr_length == UINT64_MAX) {
 			/*
@@ -710,13 +968,44 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		 * layers.
 		 */
 		zfs_uio_setsoffset(uio, woff);
+	} else if ((uio->uio_extflg & UIO_DIRECT) && zfs_dio_write_rmw) {
+		/*
+		 * Direct I/O writes of parts of blocks rewrite the whole
+		 * blocks, so lock all of the blocks the write touches.
+		 */
+		lr = zfs_rangelock_enter_blocks(zp, woff, n, nowait);
+		if (lr == NULL) {
+			zfs_uio_free_dio_pages(uio, UIO_WRITE);
+			zfs_exit(zfsvfs, FTAG);
+			return (SET_ERROR(EAGAIN));
+		}
 	} else {
 		/*
 		 * Note that if the file block size will change as a result of
 		 * this write, then this range lock will lock the entire file
 		 * so that we can re-write the block safely.
 		 */
-		lr = zfs_rangelock_enter(&zp->z_rangelock, woff, n, RL_WRITER);
+		if (nowait) {
+			lr = zfs_rangelock_tryenter(&zp->z_rangelock, woff, n,
+			    RL_WRITER);
+			if (lr == NULL) {
+				zfs_exit(zfsvfs, FTAG);
+				return (SET_ERROR(EAGAIN));
+			}
+		} else {
+			lr = zfs_rangelock_enter(&zp->z_rangelock, woff, n,
+			    RL_WRITER);
+		}
+	}
+
+	/*
+	 * Growing the block size and updating mapped pages may both wait.
+	 */
+	if (nowait && (lr->lr_length == UINT64_MAX ||
+	    zn_has_cached_data(zp, woff, woff + n - 1))) {
+		zfs_rangelock_exit(lr);
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(EAGAIN));
 	}
 
 	if (zn_rlimit_fsize_uio(zp, uio)) {
@@ -844,6 +1133,18 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 			}
 		}
 
+		/*
+		 * Neither holding the range for write, nor dirtying it, may
+		 * read blocks from disk, and the txg must have room for it.
+		 */
+		if (nowait && !dmu_write_is_cached(sa_get_db(zp->z_sa_hdl),
+		    woff, nbytes)) {
+			if (abuf != NULL)
+				dmu_return_arcbuf(abuf);
+			error = SET_ERROR(EAGAIN);
+			break;
+		}
+
 		/*
 		 * Start a transaction.
 		 */
@@ -854,11 +1155,13 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		dmu_tx_hold_write_by_dnode(tx, DB_DNODE(db), woff, nbytes);
 		DB_DNODE_EXIT(db);
 		zfs_sa_upgrade_txholds(tx, zp);
-		error = dmu_tx_assign(tx, DMU_TX_WAIT);
+		error = dmu_tx_assign(tx, nowait ? DMU_TX_NOWAIT : DMU_TX_WAIT);
 		if (error) {
 			dmu_tx_abort(tx);
 			if (abuf != NULL)
 				dmu_return_arcbuf(abuf);
+			if (error == ERESTART)
+				error = SET_ERROR(EAGAIN);
 			break;
 		}
 
@@ -875,11 +1178,19 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		 */
 		if (lr->lr_length == UINT64_MAX) {
 			zfs_grow_blocksize(zp, blksz, tx);
-			zfs_rangelock_reduce(lr, woff, n);
+			if (o_direct_defer && zfs_dio_write_rmw) {
+				/* Keep the partial blocks locked, as above. */
+				uint64_t start = woff - woff % zp->z_blksz;
+				zfs_rangelock_reduce(lr, start,
+				    roundup(woff + n, zp->z_blksz) - start);
+			} else {
+				zfs_rangelock_reduce(lr, woff, n);
+			}
 		}
 
 		dmu_flags_t dflags = DMU_READ_PREFETCH;
-		if (ioflag & O_DIRECT)
+		if ((ioflag & O_DIRECT) || (zfs_mmap_uncached &&
+		    zn_has_cached_data(zp, woff, woff + nbytes - 1)))
 			dflags |= DMU_UNCACHEDIO;
 		if (uio->uio_extflg & UIO_DIRECT)
 			dflags |= DMU_DIRECTIO;
@@ -1010,8 +1321,8 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		}
 		/*
 		 * If we are replaying and eof is non zero then force
-		 * the file size to the specified eof. Note, there's no
-		 * concurrency during replay.
+		 * the file size to the specified eof. Note, writes which
+		 * set an eof are never replayed concurrently.
 		 */
 		if (zfsvfs->z_replay && zfsvfs->z_replay_eof != 0)
 			zp->z_size = zfsvfs->z_replay_eof;
@@ -1653,46 +1964,19 @@ zfs_clone_range_precheck(znode_t *inzp, znode_t *outzp)
 }
 
 /*
- * Clone a range of blocks from inzp into outzp.  The caller must have entered
- * both datasets, resolved the request against the source EOF, and be holding a
- * RL_READER range lock on inzp and a RL_WRITER range lock (outlr) on outzp.
- * The number of bytes cloned is returned via donep; the caller is responsible
- * for the trailing accounting (access time, zil_commit) and for dropping the
- * range locks.
- *
- * When dedup is set the caller is implementing FIDEDUPERANGE, where the file
- * content is unchanged: in that case we must not update the destination's
- * mtime/ctime or strip its setid bits, matching the Linux convention that
- * REMAP_FILE_DEDUP skips file_modified().
+ * Checks of a clone of len bytes from inoff in inzp to outoff in outzp that
+ * need the range locks: the caller must be holding a RL_READER range lock on
+ * inzp and the RL_WRITER range lock outlr on outzp.
  */
 static int
-zfs_clone_range_locked(znode_t *inzp, uint64_t inoff, znode_t *outzp,
-    uint64_t outoff, uint64_t len, cred_t *cr, zfs_locked_range_t *outlr,
-    boolean_t dedup, uint64_t *donep)
+zfs_clone_range_check(znode_t *inzp, uint64_t inoff, znode_t *outzp,
+    uint64_t outoff, uint64_t len, zfs_locked_range_t *outlr)
 {
 	zfsvfs_t	*inzfsvfs = ZTOZSB(inzp);
 	zfsvfs_t	*outzfsvfs = ZTOZSB(outzp);
 	objset_t	*inos = inzfsvfs->z_os;
 	objset_t	*outos = outzfsvfs->z_os;
-	dmu_buf_impl_t	*db;
-	dmu_tx_t	*tx;
-	zilog_t		*zilog = outzfsvfs->z_log;
-	uint64_t	done = 0;
-	uint64_t	outsize, size;
-	int		error = 0;
-	int		count = 0;
-	sa_bulk_attr_t	bulk[5];
-	uint64_t	mtime[2], ctime[2];
-	uint64_t	uid, gid, projid;
-	blkptr_t	*bps;
-	size_t		maxblocks, nbps;
-	uint_t		inblksz;
-	uint64_t	clear_setid_bits_txg = 0;
-	uint64_t	last_synced_txg = 0;
-
-	*donep = 0;
-
-	inblksz = inzp->z_blksz;
+	uint_t		inblksz = inzp->z_blksz;
 
 	/*
 	 * Cloning between datasets with different special_small_blocks would
@@ -1756,13 +2040,111 @@ zfs_clone_range_locked(znode_t *inzp, uint64_t inoff, znode_t *outzp,
 	    outzp->z_size <= inblksz && outoff + len > inblksz)
 		return (SET_ERROR(EINVAL));
 
-	error = zn_rlimit_fsize(outoff + len);
+	int error = zn_rlimit_fsize(outoff + len);
 	if (error != 0)
 		return (error);
 
 	if (inoff >= MAXOFFSET_T || outoff >= MAXOFFSET_T)
 		return (SET_ERROR(EFBIG));
 
+	return (0);
+}
+
+static boolean_t
+zfs_clone_range_overquota(znode_t *outzp)
+{
+	zfsvfs_t	*outzfsvfs = ZTOZSB(outzp);
+	uint64_t	uid = KUID_TO_SUID(ZTOUID(outzp));
+	uint64_t	gid = KGID_TO_SGID(ZTOGID(outzp));
+	uint64_t	projid = outzp->z_projid;
+
+	return (zfs_id_overblockquota(outzfsvfs, DMU_USERUSED_OBJECT, uid) ||
+	    zfs_id_overblockquota(outzfsvfs, DMU_GROUPUSED_OBJECT, gid) ||
+	    (projid != ZFS_DEFAULT_PROJID &&
+	    zfs_id_overblockquota(outzfsvfs, DMU_PROJECTUSED_OBJECT, projid)));
+}
+
+/*
+ * Read the block pointers of size bytes at inoff in inzp into bps, which has
+ * room for *nbpsp of them, and return their number in *nbpsp.
+ */
+static int
+zfs_clone_range_read_bps(znode_t *inzp, uint64_t inoff, uint64_t size,
+    boolean_t dedup, blkptr_t *bps, size_t *nbpsp)
+{
+	objset_t	*inos = ZTOZSB(inzp)->z_os;
+	size_t		maxbps = *nbpsp;
+	uint64_t	last_synced_txg;
+	int		error;
+
+	for (;;) {
+		*nbpsp = maxbps;
+		last_synced_txg = spa_last_synced_txg(dmu_objset_spa(inos));
+		error = dmu_read_l0_bps(inos, inzp->z_id, inoff, size, bps,
+		    nbpsp);
+
+		/*
+		 * If we are trying to clone a block that was created in the
+		 * current transaction group, the error will be EAGAIN here.
+		 * Based on zfs_bclone_wait_dirty either return a shortened
+		 * range to the caller so it can fallback, or wait for the next
+		 * TXG and check again.  A dedupe always waits: it has no
+		 * fallback, so the EAGAIN would surface to the FIDEDUPERANGE
+		 * caller, and the comparison already read this very data.
+		 */
+		if (error != EAGAIN || !(dedup || zfs_bclone_wait_dirty))
+			return (error);
+
+		txg_wait_flag_t wait_flags =
+		    spa_get_failmode(dmu_objset_spa(inos)) ==
+		    ZIO_FAILURE_MODE_CONTINUE ? TXG_WAIT_SUSPEND : 0;
+		error = txg_wait_synced_flags(dmu_objset_pool(inos),
+		    last_synced_txg + 1, wait_flags);
+		if (error != 0) {
+			ASSERT3U(error, ==, ESHUTDOWN);
+			return (SET_ERROR(EIO));
+		}
+	}
+}
+
+static void
+zfs_clone_range_hold(dmu_tx_t *tx, znode_t *outzp, uint64_t outoff,
+    uint64_t size, uint_t inblksz)
+{
+	dmu_buf_impl_t	*db;
+
+	dmu_tx_hold_sa(tx, outzp->z_sa_hdl, ZFS_SEQ_MAY_GROW(outzp));
+	db = (dmu_buf_impl_t *)sa_get_db(outzp->z_sa_hdl);
+	DB_DNODE_ENTER(db);
+	dmu_tx_hold_clone_by_dnode(tx, DB_DNODE(db), outoff, size, inblksz);
+	DB_DNODE_EXIT(db);
+	zfs_sa_upgrade_txholds(tx, outzp);
+}
+
+/*
+ * Clone size bytes to outoff in outzp, whose source block pointers are in bps,
+ * in tx, which zfs_clone_range_hold() held for it, and log it.  len is what is
+ * left of the whole clone, size included.  The blocks are not added to the
+ * BRT: *clonedp is set once they are, and the caller must then pass bps to
+ * brt_pending_add_many() before committing tx.
+ */
+static int
+zfs_clone_range_apply(znode_t *inzp, znode_t *outzp, uint64_t outoff,
+    uint64_t size, uint64_t len, const blkptr_t *bps, size_t nbps,
+    zfs_locked_range_t *outlr, cred_t *cr, boolean_t dedup,
+    uint64_t *clear_setid_bits_txgp, dmu_tx_t *tx, boolean_t *clonedp)
+{
+	zfsvfs_t	*outzfsvfs = ZTOZSB(outzp);
+	objset_t	*outos = outzfsvfs->z_os;
+	uint_t		inblksz = inzp->z_blksz;
+	sa_bulk_attr_t	bulk[5];
+	uint64_t	mtime[2], ctime[2];
+	uint64_t	outsize;
+	int		count = 0;
+	int		error = 0;
+
+	*clonedp = B_FALSE;
+
 	/*
 	 * A dedupe leaves the destination's content and metadata alone: it can
 	 * only replace blocks with identical ones.  The times must not move,
@@ -1784,180 +2166,178 @@ zfs_clone_range_locked(znode_t *inzp, uint64_t inoff, znode_t *outzp,
 			    NULL, &outzp->z_seq, 8);
 	}
 
-	maxblocks = zil_max_log_data(zilog, sizeof (lr_clone_range_t)) /
-	    sizeof (bps[0]);
+	/*
+	 * Copy source znode's block size. This is done only if the
+	 * whole znode is locked (see zfs_rangelock_cb()) and only
+	 * on the first iteration since zfs_rangelock_reduce() will
+	 * shrink down lr_length to the appropriate size.
+	 */
+	if (outlr->lr_length == UINT64_MAX) {
+		zfs_grow_blocksize(outzp, inblksz, tx);
 
-	uid = KUID_TO_SUID(ZTOUID(outzp));
-	gid = KGID_TO_SGID(ZTOGID(outzp));
-	projid = outzp->z_projid;
+		/*
+		 * Block growth may fail for many reasons we can not
+		 * predict here. If it happens, the cloning is doomed.
+		 */
+		if (inblksz != outzp->z_blksz)
+			return (SET_ERROR(EINVAL));
 
-	bps = vmem_alloc(sizeof (bps[0]) * maxblocks, KM_SLEEP);
+		/*
+		 * Round range lock up to the block boundary, so we
+		 * prevent appends until we are done.
+		 */
+		zfs_rangelock_reduce(outlr, outoff,
+		    ((len - 1) / inblksz + 1) * inblksz);
+	}
+
+	error = dmu_brt_clone_nopending(outos, outzp->z_id, outoff, size, tx,
+	    bps, nbps);
+	if (error != 0)
+		return (error);
+	*clonedp = B_TRUE;
 
 	/*
-	 * Clone the file in reasonable size chunks.  Each chunk is cloned
-	 * in a separate transaction; this keeps the intent log records small
-	 * and allows us to do more fine-grained space accounting.
+	 * A dedupe replaces the destination's blocks with blocks
+	 * holding the same bytes, so a page already cached for this
+	 * range stays correct and there is nothing to refresh.  The
+	 * only page whose contents can differ from the DMU is one
+	 * carrying an mmap store made after the pre-compare flush,
+	 * and refreshing that would discard the store, which is a
+	 * modification a dedupe must never make.
 	 */
-	while (len > 0) {
-		size = MIN(inblksz * maxblocks, len);
+	if (!dedup && zn_has_cached_data(outzp, outoff, outoff + size - 1))
+		update_pages(outzp, outoff, size, outos);
 
-		if (zfs_id_overblockquota(outzfsvfs, DMU_USERUSED_OBJECT,
-		    uid) ||
-		    zfs_id_overblockquota(outzfsvfs, DMU_GROUPUSED_OBJECT,
-		    gid) ||
-		    (projid != ZFS_DEFAULT_PROJID &&
-		    zfs_id_overblockquota(outzfsvfs, DMU_PROJECTUSED_OBJECT,
-		    projid))) {
-			error = SET_ERROR(EDQUOT);
-			break;
-		}
+	if (!dedup) {
+		zfs_clear_setid_bits_if_necessary(outzfsvfs, outzp, cr,
+		    clear_setid_bits_txgp, tx);
 
-		nbps = maxblocks;
-		last_synced_txg = spa_last_synced_txg(dmu_objset_spa(inos));
-		error = dmu_read_l0_bps(inos, inzp->z_id, inoff, size, bps,
-		    &nbps);
-		if (error != 0) {
-			/*
-			 * If we are trying to clone a block that was created
-			 * in the current transaction group, the error will be
-			 * EAGAIN here.  Based on zfs_bclone_wait_dirty either
-			 * return a shortened range to the caller so it can
-			 * fallback, or wait for the next TXG and check again.
-			 * A dedupe always waits: it has no fallback, so the
-			 * EAGAIN would surface to the FIDEDUPERANGE caller,
-			 * and the comparison already read this very data.
-			 */
-			if (error == EAGAIN &&
-			    (dedup || zfs_bclone_wait_dirty)) {
-				txg_wait_flag_t wait_flags =
-				    spa_get_failmode(dmu_objset_spa(inos)) ==
-				    ZIO_FAILURE_MODE_CONTINUE ?
-				    TXG_WAIT_SUSPEND : 0;
-				error = txg_wait_synced_flags(
-				    dmu_objset_pool(inos), last_synced_txg + 1,
-				    wait_flags);
-				if (error == 0)
-					continue;
-				ASSERT3U(error, ==, ESHUTDOWN);
-				error = SET_ERROR(EIO);
-			}
+		zfs_tstamp_update_setup(outzp, CONTENT_MODIFIED, mtime, ctime);
 
-			break;
-		}
+		if (outzp->z_is_sa)
+			outzp->z_has_seq = B_TRUE;
 
 		/*
-		 * Start a transaction.
+		 * Update the file size (zp_size) if it has changed;
+		 * account for possible concurrent updates.
 		 */
-		tx = dmu_tx_create(outos);
-		dmu_tx_hold_sa(tx, outzp->z_sa_hdl, ZFS_SEQ_MAY_GROW(outzp));
-		db = (dmu_buf_impl_t *)sa_get_db(outzp->z_sa_hdl);
-		DB_DNODE_ENTER(db);
-		dmu_tx_hold_clone_by_dnode(tx, DB_DNODE(db), outoff, size,
-		    inblksz);
-		DB_DNODE_EXIT(db);
-		zfs_sa_upgrade_txholds(tx, outzp);
-		error = dmu_tx_assign(tx, DMU_TX_WAIT);
-		if (error != 0) {
-			dmu_tx_abort(tx);
-			break;
+		while ((outsize = outzp->z_size) < outoff + size) {
+			(void) atomic_cas_64(&outzp->z_size, outsize,
+			    outoff + size);
 		}
+	} else {
+		/* A dedupe can only ever rewrite blocks in place. */
+		ASSERT3U(outoff + size, <=, outzp->z_size);
+	}
 
-		/*
-		 * Copy source znode's block size. This is done only if the
-		 * whole znode is locked (see zfs_rangelock_cb()) and only
-		 * on the first iteration since zfs_rangelock_reduce() will
-		 * shrink down lr_length to the appropriate size.
-		 */
-		if (outlr->lr_length == UINT64_MAX) {
-			zfs_grow_blocksize(outzp, inblksz, tx);
+	if (count > 0) {
+		ASSERT3S(count, <=, ARRAY_SIZE(bulk));
+		error = sa_bulk_update(outzp->z_sa_hdl, bulk, count, tx);
+	}
 
-			/*
-			 * Block growth may fail for many reasons we can not
-			 * predict here. If it happens, the cloning is doomed.
-			 */
-			if (inblksz != outzp->z_blksz) {
-				error = SET_ERROR(EINVAL);
-				dmu_tx_commit(tx);
-				break;
-			}
+	/*
+	 * A dedupe is not logged.  It replaces the destination's blocks
+	 * with blocks holding the very same bytes, so if the txg is
+	 * lost to a crash and never replayed, the destination simply
+	 * keeps its own copy of that identical content: nothing a
+	 * reader can observe is lost, only the sharing.  Sharing is all
+	 * FIDEDUPERANGE promises anyway, and it is the cheaper of the
+	 * alternatives.  Logging a plain TX_CLONE_RANGE would restamp
+	 * the destination's mtime/ctime on replay, and telling a dedupe
+	 * apart with a record of its own would be an on-disk ZIL format
+	 * change: an old kernel meeting an unknown txtype fails
+	 * zil_parse(), and zil_replay() then destroys the whole log,
+	 * discarding every later record - including synced writes.
+	 */
+	if (!dedup) {
+		zfs_log_clone_range(outzfsvfs->z_log, tx, TX_CLONE_RANGE,
+		    outzp, outoff, size, inblksz, bps, nbps);
+	}
 
-			/*
-			 * Round range lock up to the block boundary, so we
-			 * prevent appends until we are done.
-			 */
-			zfs_rangelock_reduce(outlr, outoff,
-			    ((len - 1) / inblksz + 1) * inblksz);
-		}
+	return (error);
+}
 
-		error = dmu_brt_clone(outos, outzp->z_id, outoff, size, tx,
-		    bps, nbps);
-		if (error != 0) {
-			dmu_tx_commit(tx);
-			break;
-		}
+/*
+ * Clone a range of blocks from inzp into outzp.  The caller must have entered
+ * both datasets, resolved the request against the source EOF, and be holding a
+ * RL_READER range lock on inzp and a RL_WRITER range lock (outlr) on outzp.
+ * The number of bytes cloned is returned via donep; the caller is responsible
+ * for the trailing accounting (access time, zil_commit) and for dropping the
+ * range locks.
+ *
+ * When dedup is set the caller is implementing FIDEDUPERANGE, where the file
+ * content is unchanged: in that case we must not update the destination's
+ * mtime/ctime or strip its setid bits, matching the Linux convention that
+ * REMAP_FILE_DEDUP skips file_modified().
+ */
+static int
+zfs_clone_range_locked(znode_t *inzp, uint64_t inoff, znode_t *outzp,
+    uint64_t outoff, uint64_t len, cred_t *cr, zfs_locked_range_t *outlr,
+    boolean_t dedup, uint64_t *donep)
+{
+	zfsvfs_t	*outzfsvfs = ZTOZSB(outzp);
+	objset_t	*outos = outzfsvfs->z_os;
+	dmu_tx_t	*tx;
+	zilog_t		*zilog = outzfsvfs->z_log;
+	uint64_t	done = 0;
+	uint64_t	size;
+	int		error = 0;
+	blkptr_t	*bps;
+	size_t		maxblocks, nbps;
+	uint_t		inblksz;
+	uint64_t	clear_setid_bits_txg = 0;
+	boolean_t	cloned;
 
-		/*
-		 * A dedupe replaces the destination's blocks with blocks
-		 * holding the same bytes, so a page already cached for this
-		 * range stays correct and there is nothing to refresh.  The
-		 * only page whose contents can differ from the DMU is one
-		 * carrying an mmap store made after the pre-compare flush,
-		 * and refreshing that would discard the store, which is a
-		 * modification a dedupe must never make.
-		 */
-		if (!dedup &&
-		    zn_has_cached_data(outzp, outoff, outoff + size - 1)) {
-			update_pages(outzp, outoff, size, outos);
-		}
+	*donep = 0;
+
+	inblksz = inzp->z_blksz;
 
-		if (!dedup) {
-			zfs_clear_setid_bits_if_necessary(outzfsvfs, outzp, cr,
-			    &clear_setid_bits_txg, tx);
+	error = zfs_clone_range_check(inzp, inoff, outzp, outoff, len, outlr);
+	if (error != 0)
+		return (error);
 
-			zfs_tstamp_update_setup(outzp, CONTENT_MODIFIED, mtime,
-			    ctime);
+	maxblocks = zil_max_log_data(zilog, sizeof (lr_clone_range_t)) /
+	    sizeof (bps[0]);
 
-			if (outzp->z_is_sa)
-				outzp->z_has_seq = B_TRUE;
+	bps = vmem_alloc(sizeof (bps[0]) * maxblocks, KM_SLEEP);
 
-			/*
-			 * Update the file size (zp_size) if it has changed;
-			 * account for possible concurrent updates.
-			 */
-			while ((outsize = outzp->z_size) < outoff + size) {
-				(void) atomic_cas_64(&outzp->z_size, outsize,
-				    outoff + size);
-			}
-		} else {
-			/* A dedupe can only ever rewrite blocks in place. */
-			ASSERT3U(outoff + size, <=, outzp->z_size);
-		}
+	/*
+	 * Clone the file in reasonable size chunks.  Each chunk is cloned
+	 * in a separate transaction; this keeps the intent log records small
+	 * and allows us to do more fine-grained space accounting.
+	 */
+	while (len > 0) {
+		size = MIN(inblksz * maxblocks, len);
 
-		if (count > 0) {
-			ASSERT3S(count, <=, ARRAY_SIZE(bulk));
-			error = sa_bulk_update(outzp->z_sa_hdl, bulk, count,
-			    tx);
+		if (zfs_clone_range_overquota(outzp)) {
+			error = SET_ERROR(EDQUOT);
+			break;
 		}
 
+		nbps = maxblocks;
+		error = zfs_clone_range_read_bps(inzp, inoff, size, dedup,
+		    bps, &nbps);
+		if (error != 0)
+			break;
+
 		/*
-		 * A dedupe is not logged.  It replaces the destination's blocks
-		 * with blocks holding the very same bytes, so if the txg is
-		 * lost to a crash and never replayed, the destination simply
-		 * keeps its own copy of that identical content: nothing a
-		 * reader can observe is lost, only the sharing.  Sharing is all
-		 * FIDEDUPERANGE promises anyway, and it is the cheaper of the
-		 * alternatives.  Logging a plain TX_CLONE_RANGE would restamp
-		 * the destination's mtime/ctime on replay, and telling a dedupe
-		 * apart with a record of its own would be an on-disk ZIL format
-		 * change: an old kernel meeting an unknown txtype fails
-		 * zil_parse(), and zil_replay() then destroys the whole log,
-		 * discarding every later record - including synced writes.
+		 * Start a transaction.
 		 */
-		if (!dedup) {
-			zfs_log_clone_range(zilog, tx, TX_CLONE_RANGE, outzp,
-			    outoff, size, inblksz, bps, nbps);
+		tx = dmu_tx_create(outos);
+		zfs_clone_range_hold(tx, outzp, outoff, size, inblksz);
+		error = dmu_tx_assign(tx, DMU_TX_WAIT);
+		if (error != 0) {
+			dmu_tx_abort(tx);
+			break;
 		}
 
+		error = zfs_clone_range_apply(inzp, outzp, outoff, size, len,
+		    bps, nbps, outlr, cr, dedup, &clear_setid_bits_txg, tx,
+		    &cloned);
+		if (cloned)
+			brt_pending_add_many(dmu_objset_spa(outos), bps, nbps,
+			    tx);
+
 		dmu_tx_commit(tx);
 
 		if (error != 0)
@@ -1982,6 +2362,67 @@ zfs_clone_range_locked(znode_t *inzp, uint64_t inoff, znode_t *outzp,
 	return (error);
 }
 
+/*
+ * Checks of a clone shared by zfs_clone_range() and zfs_clone_ranges() that
+ * are done before taking the range locks.  Both datasets must already be
+ * entered with zfs_enter_two().  *lenp is clamped to the source EOF, and is
+ * zero if there is nothing to clone.
+ */
+static int
+zfs_clone_range_prepare(znode_t *inzp, uint64_t inoff, znode_t *outzp,
+    uint64_t outoff, uint64_t *lenp)
+{
+	zfsvfs_t	*outzfsvfs = ZTOZSB(outzp);
+	uint64_t	len = *lenp;
+	int		error;
+
+	error = zfs_clone_range_precheck(inzp, outzp);
+	if (error != 0)
+		return (error);
+
+	/*
+	 * The range to clone must lie within the source file.  Clamp it to the
+	 * source EOF and treat an empty range as a no-op.
+	 */
+	if (inoff >= inzp->z_size) {
+		*lenp = 0;
+		return (0);
+	}
+	if (len > inzp->z_size - inoff)
+		len = inzp->z_size - inoff;
+	*lenp = len;
+	if (len == 0)
+		return (0);
+
+	/*
+	 * Callers might not be able to detect properly that we are read-only,
+	 * so check it explicitly here.
+	 */
+	if (zfs_is_readonly(outzfsvfs))
+		return (SET_ERROR(EROFS));
+
+	/*
+	 * If immutable then return EPERM.  Intentionally allow ZFS_READONLY
+	 * through here.  See zfs_zaccess_common().
+	 */
+	if ((outzp->z_pflags & ZFS_IMMUTABLE) != 0)
+		return (SET_ERROR(EPERM));
+
+	/*
+	 * No overlapping if we are cloning within the same file.
+	 */
+	if (inzp == outzp) {
+		if (inoff < outoff + len && outoff < inoff + len)
+			return (SET_ERROR(EINVAL));
+	}
+
+	/* Flush any mmap()'d data to disk */
+	if (zn_has_cached_data(inzp, inoff, inoff + len - 1))
+		zn_flush_cached_data(inzp, B_TRUE);
+
+	return (0);
+}
+
 /*
  * Clone part of inzp file into outzp file. This must be done under range locks
  * held on both files so as to prevent it from being modified while the clone
@@ -2029,57 +2470,14 @@ zfs_clone_range(znode_t *inzp, uint64_t *inoffp, znode_t *outzp,
 	 */
 	zilog = outzfsvfs->z_log;
 
-	error = zfs_clone_range_precheck(inzp, outzp);
+	error = zfs_clone_range_prepare(inzp, inoff, outzp, outoff, &len);
 	if (error != 0)
 		goto out;
-
-	/*
-	 * The range to clone must lie within the source file.  Clamp it to the
-	 * source EOF and treat an empty range as a no-op.
-	 */
-	if (inoff >= inzp->z_size) {
-		*lenp = 0;
-		goto out;
-	}
-	if (len > inzp->z_size - inoff)
-		len = inzp->z_size - inoff;
 	if (len == 0) {
 		*lenp = 0;
 		goto out;
 	}
 
-	/*
-	 * Callers might not be able to detect properly that we are read-only,
-	 * so check it explicitly here.
-	 */
-	if (zfs_is_readonly(outzfsvfs)) {
-		error = SET_ERROR(EROFS);
-		goto out;
-	}
-
-	/*
-	 * If immutable then return EPERM.  Intentionally allow ZFS_READONLY
-	 * through here.  See zfs_zaccess_common().
-	 */
-	if ((outzp->z_pflags & ZFS_IMMUTABLE) != 0) {
-		error = SET_ERROR(EPERM);
-		goto out;
-	}
-
-	/*
-	 * No overlapping if we are cloning within the same file.
-	 */
-	if (inzp == outzp) {
-		if (inoff < outoff + len && outoff < inoff + len) {
-			error = SET_ERROR(EINVAL);
-			goto out;
-		}
-	}
-
-	/* Flush any mmap()'d data to disk */
-	if (zn_has_cached_data(inzp, inoff, inoff + len - 1))
-		zn_flush_cached_data(inzp, B_TRUE);
-
 	/*
 	 * Maintain predictable lock order.
 	 */
@@ -2129,6 +2527,392 @@ out:
 	return (error);
 }
 
+/*
+ * Most clones zfs_clone_ranges() does in one transaction.
+ */
+#define	ZFS_CLONE_RANGES_CHUNK	64
+
+typedef struct zfs_clone_ranges_ent {
+	zfs_clone_range_t	*zre_zcr;
+	zfs_locked_range_t	*zre_inlr;
+	zfs_locked_range_t	*zre_outlr;
+	blkptr_t		*zre_bps;
+	size_t			zre_nbps;
+	uint64_t		zre_done;
+} zfs_clone_ranges_ent_t;
+
+typedef struct zfs_clone_ranges_lock {
+	znode_t			*zrl_zp;
+	uint64_t		zrl_off;
+	uint64_t		zrl_len;
+	zfs_rangelock_type_t	zrl_type;
+	zfs_locked_range_t	**zrl_lrp;
+} zfs_clone_ranges_lock_t;
+
+typedef struct zfs_clone_ranges_chunk {
+	zfs_clone_ranges_ent_t	*zrc_ents[ZFS_CLONE_RANGES_CHUNK];
+	zfs_clone_ranges_lock_t	zrc_locks[2 * ZFS_CLONE_RANGES_CHUNK];
+	uint_t			zrc_nents;
+} zfs_clone_ranges_chunk_t;
+
+/*
+ * Order clones by destination dataset, then source dataset, so that clones
+ * done together are adjacent, and then by destination object and offset.
+ */
+static int
+zfs_clone_ranges_compare(const void *x1, const void *x2)
+{
+	const zfs_clone_range_t *zcr1 =
+	    ((const zfs_clone_ranges_ent_t *)x1)->zre_zcr;
+	const zfs_clone_range_t *zcr2 =
+	    ((const zfs_clone_ranges_ent_t *)x2)->zre_zcr;
+	int cmp;
+
+	cmp = TREE_PCMP(ZTOZSB(zcr1->zcr_outzp), ZTOZSB(zcr2->zcr_outzp));
+	if (cmp == 0) {
+		cmp = TREE_PCMP(ZTOZSB(zcr1->zcr_inzp),
+		    ZTOZSB(zcr2->zcr_inzp));
+	}
+	if (cmp == 0)
+		cmp = TREE_CMP(zcr1->zcr_outzp->z_id, zcr2->zcr_outzp->z_id);
+	if (cmp == 0)
+		cmp = TREE_CMP(zcr1->zcr_outoff, zcr2->zcr_outoff);
+	return (cmp);
+}
+
+/*
+ * Order range locks like zfs_clone_range() takes its two: by znode, and by
+ * offset within a znode.
+ */
+static int
+zfs_clone_ranges_lock_compare(const void *x1, const void *x2)
+{
+	const zfs_clone_ranges_lock_t *zrl1 = x1, *zrl2 = x2;
+	int cmp;
+
+	cmp = TREE_PCMP(zrl1->zrl_zp, zrl2->zrl_zp);
+	if (cmp == 0)
+		cmp = TREE_CMP(zrl1->zrl_off, zrl2->zrl_off);
+	return (cmp);
+}
+
+/*
+ * Whether zcr would lock a znode a clone of the chunk already locks, other
+ * than for reading both times: range locks are not recursive.
+ */
+static boolean_t
+zfs_clone_ranges_conflict(const zfs_clone_ranges_chunk_t *zrc,
+    const zfs_clone_range_t *zcr)
+{
+	for (uint_t i = 0; i < zrc->zrc_nents; i++) {
+		const zfs_clone_range_t *other = zrc->zrc_ents[i]->zre_zcr;
+
+		if (zcr->zcr_outzp == other->zcr_outzp ||
+		    zcr->zcr_outzp == other->zcr_inzp ||
+		    zcr->zcr_inzp == other->zcr_outzp)
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+/*
+ * Clone a chunk of the n clones of ents, which all clone into one dataset,
+ * and return how many were done.  The chunk is made of the first clones
+ * that come from one dataset, lock no znode another one writes, and fit in
+ * one ZIL record together.  Their range locks are all taken first, then the
+ * clones done in one tx, and their blocks added to the BRT at once.  A clone
+ * found too large under the locks is done on its own, like zfs_clone_range().
+ */
+static uint_t
+zfs_clone_ranges_chunk(zfs_clone_ranges_chunk_t *zrc,
+    zfs_clone_ranges_ent_t *ents, uint_t n, cred_t *cr, boolean_t *commitp)
+{
+	zfs_clone_range_t *zcr = ents[0].zre_zcr;
+	zfsvfs_t	*inzfsvfs = ZTOZSB(zcr->zcr_inzp);
+	zfsvfs_t	*outzfsvfs = ZTOZSB(zcr->zcr_outzp);
+	objset_t	*outos;
+	zilog_t		*zilog;
+	dmu_tx_t	*tx;
+	blkptr_t	*bps;
+	size_t		maxblocks, nblocks, used;
+	uint_t		i, nlocks;
+	int		error;
+
+	error = zfs_enter_two(inzfsvfs, outzfsvfs, FTAG);
+	if (error != 0) {
+		zcr->zcr_error = error;
+		zcr->zcr_len = 0;
+		return (1);
+	}
+	outos = outzfsvfs->z_os;
+	zilog = outzfsvfs->z_log;
+
+	maxblocks = zil_max_log_data(zilog, sizeof (lr_clone_range_t)) /
+	    sizeof (bps[0]);
+
+	zrc->zrc_nents = 0;
+	nblocks = 0;
+	for (i = 0; i < n && zrc->zrc_nents < ZFS_CLONE_RANGES_CHUNK; i++) {
+		zfs_clone_ranges_ent_t *ent = &ents[i];
+
+		zcr = ent->zre_zcr;
+		ASSERT3P(ZTOZSB(zcr->zcr_outzp), ==, outzfsvfs);
+		if (ZTOZSB(zcr->zcr_inzp) != inzfsvfs ||
+		    zfs_clone_ranges_conflict(zrc, zcr))
+			break;
+
+		error = zfs_clone_range_prepare(zcr->zcr_inzp, zcr->zcr_inoff,
+		    zcr->zcr_outzp, zcr->zcr_outoff, &zcr->zcr_len);
+		if (error != 0 || zcr->zcr_len == 0) {
+			zcr->zcr_error = error;
+			zcr->zcr_len = 0;
+			continue;
+		}
+
+		size_t blocks = howmany(zcr->zcr_len, zcr->zcr_inzp->z_blksz);
+		if (zrc->zrc_nents > 0 && nblocks + blocks > maxblocks)
+			break;
+		nblocks += blocks;
+
+		ent->zre_inlr = ent->zre_outlr = NULL;
+		ent->zre_bps = NULL;
+		ent->zre_nbps = 0;
+		ent->zre_done = 0;
+		zrc->zrc_ents[zrc->zrc_nents++] = ent;
+	}
+	n = i;
+
+	/*
+	 * Take all the range locks in one order, so that neither another
+	 * batch nor zfs_clone_range() can be holding one of them while
+	 * waiting for another we hold.
+	 */
+	nlocks = 0;
+	for (i = 0; i < zrc->zrc_nents; i++) {
+		zfs_clone_ranges_ent_t *ent = zrc->zrc_ents[i];
+
+		zcr = ent->zre_zcr;
+		zrc->zrc_locks[nlocks++] = (zfs_clone_ranges_lock_t) {
+			.zrl_zp = zcr->zcr_inzp,
+			.zrl_off = zcr->zcr_inoff,
+			.zrl_len = zcr->zcr_len,
+			.zrl_type = RL_READER,
+			.zrl_lrp = &ent->zre_inlr,
+		};
+		zrc->zrc_locks[nlocks++] = (zfs_clone_ranges_lock_t) {
+			.zrl_zp = zcr->zcr_outzp,
+			.zrl_off = zcr->zcr_outoff,
+			.zrl_len = zcr->zcr_len,
+			.zrl_type = RL_WRITER,
+			.zrl_lrp = &ent->zre_outlr,
+		};
+	}
+	qsort(zrc->zrc_locks, nlocks, sizeof (zrc->zrc_locks[0]),
+	    zfs_clone_ranges_lock_compare);
+	for (i = 0; i < nlocks; i++) {
+		zfs_clone_ranges_lock_t *zrl = &zrc->zrc_locks[i];
+
+		*zrl->zrl_lrp = zfs_rangelock_enter(&zrl->zrl_zp->z_rangelock,
+		    zrl->zrl_off, zrl->zrl_len, zrl->zrl_type);
+	}
+
+	bps = vmem_alloc(sizeof (bps[0]) * maxblocks, KM_SLEEP);
+	used = 0;
+	for (i = 0; i < zrc->zrc_nents; i++) {
+		zfs_clone_ranges_ent_t *ent = zrc->zrc_ents[i];
+		znode_t *inzp, *outzp;
+
+		zcr = ent->zre_zcr;
+		inzp = zcr->zcr_inzp;
+		outzp = zcr->zcr_outzp;
+
+		error = zfs_clone_range_check(inzp, zcr->zcr_inoff, outzp,
+		    zcr->zcr_outoff, zcr->zcr_len, ent->zre_outlr);
+		if (error == 0 && zfs_clone_range_overquota(outzp))
+			error = SET_ERROR(EDQUOT);
+		if (error != 0) {
+			zcr->zcr_error = error;
+			continue;
+		}
+
+		size_t blocks = howmany(zcr->zcr_len, inzp->z_blksz);
+		if (blocks > maxblocks - used) {
+			zcr->zcr_error = zfs_clone_range_locked(inzp,
+			    zcr->zcr_inoff, outzp, zcr->zcr_outoff,
+			    zcr->zcr_len, cr, ent->zre_outlr, B_FALSE,
+			    &ent->zre_done);
+			continue;
+		}
+
+		ent->zre_nbps = blocks;
+		error = zfs_clone_range_read_bps(inzp, zcr->zcr_inoff,
+		    zcr->zcr_len, B_FALSE, &bps[used], &ent->zre_nbps);
+		if (error != 0) {
+			zcr->zcr_error = error;
+			continue;
+		}
+		ent->zre_bps = &bps[used];
+		used += ent->zre_nbps;
+	}
+
+	if (used > 0) {
+		tx = dmu_tx_create(outos);
+		for (i = 0; i < zrc->zrc_nents; i++) {
+			zfs_clone_ranges_ent_t *ent = zrc->zrc_ents[i];
+
+			zcr = ent->zre_zcr;
+			if (ent->zre_bps != NULL) {
+				zfs_clone_range_hold(tx, zcr->zcr_outzp,
+				    zcr->zcr_outoff, zcr->zcr_len,
+				    zcr->zcr_inzp->z_blksz);
+			}
+		}
+		error = dmu_tx_assign(tx, DMU_TX_WAIT);
+		if (error != 0)
+			dmu_tx_abort(tx);
+	}
+
+	for (i = 0; used > 0 && i < zrc->zrc_nents; i++) {
+		zfs_clone_ranges_ent_t *ent = zrc->zrc_ents[i];
+		uint64_t clear_setid_bits_txg = 0;
+		boolean_t cloned = B_FALSE;
+
+		zcr = ent->zre_zcr;
+		if (ent->zre_bps == NULL)
+			continue;
+
+		if (error == 0) {
+			zcr->zcr_error = zfs_clone_range_apply(zcr->zcr_inzp,
+			    zcr->zcr_outzp, zcr->zcr_outoff, zcr->zcr_len,
+			    zcr->zcr_len, ent->zre_bps, ent->zre_nbps,
+			    ent->zre_outlr, cr, B_FALSE,
+			    &clear_setid_bits_txg, tx, &cloned);
+			if (zcr->zcr_error == 0)
+				ent->zre_done = zcr->zcr_len;
+			zfs_znode_update_vfs(zcr->zcr_outzp);
+		} else {
+			zcr->zcr_error = error;
+		}
+
+		/* Holes are skipped by brt_pending_add_many(). */
+		if (!cloned) {
+			for (size_t j = 0; j < ent->zre_nbps; j++)
+				BP_ZERO(&ent->zre_bps[j]);
+		}
+	}
+
+	if (used > 0 && error == 0) {
+		brt_pending_add_many(dmu_objset_spa(outos), bps, used, tx);
+		dmu_tx_commit(tx);
+	}
+	vmem_free(bps, sizeof (bps[0]) * maxblocks);
+
+	for (i = 0; i < zrc->zrc_nents; i++) {
+		zfs_clone_ranges_ent_t *ent = zrc->zrc_ents[i];
+
+		zcr = ent->zre_zcr;
+		zfs_rangelock_exit(ent->zre_outlr);
+		zfs_rangelock_exit(ent->zre_inlr);
+
+		zcr->zcr_len = ent->zre_done;
+		if (ent->zre_done > 0) {
+			zcr->zcr_error = 0;
+			ZFS_ACCESSTIME_STAMP(inzfsvfs, zcr->zcr_inzp);
+			if (outos->os_sync == ZFS_SYNC_ALWAYS)
+				*commitp = B_TRUE;
+		} else {
+			ASSERT3S(zcr->zcr_error, !=, 0);
+		}
+	}
+
+	zfs_exit_two(inzfsvfs, outzfsvfs, FTAG);
+
+	return (n);
+}
+
+/*
+ * Fail the successful clones of ents if the ZIL commit they wait for fails:
+ * none of them is done before it is on stable storage.
+ */
+static void
+zfs_clone_ranges_commit(zfs_clone_ranges_ent_t *ents, uint_t n,
+    zfsvfs_t *zfsvfs)
+{
+	int error;
+
+	if ((error = zfs_enter(zfsvfs, FTAG)) == 0) {
+		error = zil_commit(zfsvfs->z_log, 0);
+		zfs_exit(zfsvfs, FTAG);
+	}
+
+	for (uint_t i = 0; error != 0 && i < n; i++) {
+		zfs_clone_range_t *zcr = ents[i].zre_zcr;
+
+		if (zcr->zcr_error == 0) {
+			zcr->zcr_error = error;
+			zcr->zcr_len = 0;
+		}
+	}
+}
+
+/*
+ * Clone a batch of ranges, possibly between many different files.  Each clone
+ * is checked and done as by zfs_clone_range(), clamped to the source EOF, and
+ * gets its own error and length cloned in zcr_error and zcr_len; a failing
+ * clone does not stop the others.
+ *
+ * The clones are grouped by destination dataset and sorted by destination
+ * object and offset.  Those of a group are done a chunk at a time, each chunk
+ * in a single transaction, and a dataset with sync=always is then committed
+ * to the ZIL once for the whole group.
+ */
+void
+zfs_clone_ranges(zfs_clone_range_t *zcrs, uint_t n, cred_t *cr)
+{
+	zfs_clone_ranges_chunk_t *zrc;
+	zfs_clone_ranges_ent_t *ents;
+	uint_t first, last, i;
+
+	if (n == 0)
+		return;
+
+	ents = vmem_zalloc(n * sizeof (ents[0]), KM_SLEEP);
+	for (i = 0; i < n; i++) {
+		ents[i].zre_zcr = &zcrs[i];
+		zcrs[i].zcr_error = 0;
+	}
+	qsort(ents, n, sizeof (ents[0]), zfs_clone_ranges_compare);
+
+	zrc = kmem_alloc(sizeof (*zrc), KM_SLEEP);
+	for (first = 0; first < n; first = last) {
+		zfsvfs_t *outzfsvfs = ZTOZSB(ents[first].zre_zcr->zcr_outzp);
+		boolean_t commit = B_FALSE;
+
+		last = first + 1;
+		while (last < n &&
+		    ZTOZSB(ents[last].zre_zcr->zcr_outzp) == outzfsvfs)
+			last++;
+
+		for (i = first; i < last; ) {
+			i += zfs_clone_ranges_chunk(zrc, &ents[i], last - i, cr,
+			    &commit);
+			if (i < last && issig()) {
+				for (; i < last; i++) {
+					ents[i].zre_zcr->zcr_error =
+					    SET_ERROR(EINTR);
+					ents[i].zre_zcr->zcr_len = 0;
+				}
+			}
+		}
+
+		if (commit)
+			zfs_clone_ranges_commit(&ents[first], last - first,
+			    outzfsvfs);
+	}
+	kmem_free(zrc, sizeof (*zrc));
+	vmem_free(ents, n * sizeof (ents[0]));
+}
+
 /*
  * Compare two ranges by copying them out of the DMU into buffers and comparing
  * those.  Only used where the dbuf comparison below cannot go; see there.
@@ -2953,6 +3737,7 @@ EXPORT_SYMBOL(zfs_write);
 EXPORT_SYMBOL(zfs_getsecattr);
 EXPORT_SYMBOL(zfs_setsecattr);
 EXPORT_SYMBOL(zfs_clone_range);
+EXPORT_SYMBOL(zfs_clone_ranges);
 EXPORT_SYMBOL(zfs_clone_range_replay);
 EXPORT_SYMBOL(zfs_dedupe_range);
 
@@ -2973,3 +3758,6 @@ ZFS_MODULE_PARAM(zfs, zfs_, dio_enabled, INT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs, zfs_, dio_strict, INT, ZMOD_RW,
 	"Return errors on misaligned Direct I/O");
+
+ZFS_MODULE_PARAM(zfs, zfs_, mmap_uncached, INT, ZMOD_RW,
+	"Do not keep data of memory mapped files in the ARC");
@@ -160,9 +160,14 @@ zfs_obj_to_stats_impl(sa_handle_t *hdl, sa_attr_type_t *sa_table,
 	return (sa_bulk_lookup(hdl, bulk, count));
 }
 
+/*
+ * Given an object number, return its path.  With pobjp, return only its name
+ * in its parent directory and the parent's object number instead, which is
+ * the object itself for the root directory, whose name is empty.
+ */
 static int
 zfs_obj_to_path_impl(objset_t *osp, uint64_t obj, sa_handle_t *hdl,
-    sa_attr_type_t *sa_table, char *buf, int len)
+    sa_attr_type_t *sa_table, char *buf, int len, uint64_t *pobjp)
 {
 	sa_handle_t *sa_hdl;
 	sa_handle_t *prevhdl = NULL;
@@ -202,7 +207,9 @@ zfs_obj_to_path_impl(objset_t *osp, uint64_t obj, sa_handle_t *hdl,
 			break;
 
 		if (pobj == obj) {
-			if (path[0] != '/')
+			if (pobjp != NULL)
+				*pobjp = pobj;
+			else if (path[0] != '/')
 				*--path = '/';
 			break;
 		}
@@ -222,6 +229,11 @@ zfs_obj_to_path_impl(objset_t *osp, uint64_t obj, sa_handle_t *hdl,
 		path -= complen;
 		ASSERT3P(path, >=, buf);
 		memcpy(path, component, complen);
+		if (pobjp != NULL) {
+			*pobjp = pobj;
+			path++;
+			break;
+		}
 		obj = pobj;
 
 		if (sa_hdl != hdl) {
@@ -264,7 +276,7 @@ zfs_obj_to_path(objset_t *osp, uint64_t obj, char *buf, int len)
 	if (error != 0)
 		return (error);
 
-	error = zfs_obj_to_path_impl(osp, obj, hdl, sa_table, buf, len);
+	error = zfs_obj_to_path_impl(osp, obj, hdl, sa_table, buf, len, NULL);
 
 	zfs_release_sa_handle(hdl, db, FTAG);
 	return (error);
@@ -272,7 +284,7 @@ zfs_obj_to_path(objset_t *osp, uint64_t obj, char *buf, int len)
 
 int
 zfs_obj_to_stats(objset_t *osp, uint64_t obj, zfs_stat_t *sb,
-    char *buf, int len)
+    char *buf, int len, uint64_t *pobjp)
 {
 	char *path = buf + len - 1;
 	sa_attr_type_t *sa_table;
@@ -296,7 +308,8 @@ zfs_obj_to_stats(objset_t *osp, uint64_t obj, zfs_stat_t *sb,
 		return (error);
 	}
 
-	error = zfs_obj_to_path_impl(osp, obj, hdl, sa_table, buf, len);
+	error = zfs_obj_to_path_impl(osp, obj, hdl, sa_table, buf, len,
+	    pobjp);
 
 	zfs_release_sa_handle(hdl, db, FTAG);
 	return (error);
@@ -95,6 +95,8 @@ static zil_kstat_values_t zil_stats = {
 	{ "zil_commit_stall_count",		KSTAT_DATA_UINT64 },
 	{ "zil_commit_suspend_count",		KSTAT_DATA_UINT64 },
 	{ "zil_commit_crash_count",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_object_count",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_deferred_count",		KSTAT_DATA_UINT64 },
 	{ "zil_itx_count",			KSTAT_DATA_UINT64 },
 	{ "zil_itx_indirect_count",		KSTAT_DATA_UINT64 },
 	{ "zil_itx_indirect_bytes",		KSTAT_DATA_UINT64 },
@@ -134,6 +136,15 @@ static int zil_nocacheflush = 0;
  */
 static uint64_t zil_slog_bulk = 64 * 1024 * 1024;
 
+/*
+ * Commit only the records an object depends on when zil_commit() is called
+ * for that object (e.g. fsync), instead of every pending synchronous record
+ * of the dataset.  Out-of-order records (TX_OOO) of other objects are left
+ * on the sync lists, so an fsync of a small file no longer waits behind
+ * unrelated O_SYNC writes.  See zil_get_commit_list() for the rules.
+ */
+static int zil_commit_per_object = 0;
+
 static kmem_cache_t *zil_lwb_cache;
 static kmem_cache_t *zil_zcw_cache;
 
@@ -360,6 +371,8 @@ zil_sums_init(zil_sums_t *zs)
 	wmsum_init(&zs->zil_commit_stall_count, 0);
 	wmsum_init(&zs->zil_commit_suspend_count, 0);
 	wmsum_init(&zs->zil_commit_crash_count, 0);
+	wmsum_init(&zs->zil_commit_object_count, 0);
+	wmsum_init(&zs->zil_commit_deferred_count, 0);
 	wmsum_init(&zs->zil_itx_count, 0);
 	wmsum_init(&zs->zil_itx_indirect_count, 0);
 	wmsum_init(&zs->zil_itx_indirect_bytes, 0);
@@ -386,6 +399,8 @@ zil_sums_fini(zil_sums_t *zs)
 	wmsum_fini(&zs->zil_commit_stall_count);
 	wmsum_fini(&zs->zil_commit_suspend_count);
 	wmsum_fini(&zs->zil_commit_crash_count);
+	wmsum_fini(&zs->zil_commit_object_count);
+	wmsum_fini(&zs->zil_commit_deferred_count);
 	wmsum_fini(&zs->zil_itx_count);
 	wmsum_fini(&zs->zil_itx_indirect_count);
 	wmsum_fini(&zs->zil_itx_indirect_bytes);
@@ -418,6 +433,10 @@ zil_kstat_values_update(zil_kstat_values_t *zs, zil_sums_t *zil_sums)
 	    wmsum_value(&zil_sums->zil_commit_suspend_count);
 	zs->zil_commit_crash_count.value.ui64 =
 	    wmsum_value(&zil_sums->zil_commit_crash_count);
+	zs->zil_commit_object_count.value.ui64 =
+	    wmsum_value(&zil_sums->zil_commit_object_count);
+	zs->zil_commit_deferred_count.value.ui64 =
+	    wmsum_value(&zil_sums->zil_commit_deferred_count);
 	zs->zil_itx_count.value.ui64 =
 	    wmsum_value(&zil_sums->zil_itx_count);
 	zs->zil_itx_indirect_count.value.ui64 =
@@ -1772,6 +1791,12 @@ zil_lwb_write_open(zilog_t *zilog, lwb_t *lwb)
  */
 static uint_t zil_maxblocksize = SPA_OLD_MAXBLOCKSIZE;
 
+/*
+ * Split log write bursts into at least one block per SLOG vdev, so that
+ * all of them are written in parallel (see zil_lwb_plan()).
+ */
+static int zil_slog_stripe = 1;
+
 /*
  * Plan splitting of the provided burst size between several blocks.
  */
@@ -1782,7 +1807,18 @@ zil_lwb_plan(zilog_t *zilog, uint64_t size, uint_t *minsize)
 	uint_t waste = zil_max_waste_space(zilog);
 	waste = MAX(waste, zilog->zl_cur_max);
 
-	if (size <= md) {
+	/*
+	 * Log blocks are allocated from the SLOG vdevs in turn and written
+	 * in parallel, so a burst split into one block per SLOG completes
+	 * in a fraction of the time it takes when it fills only the first
+	 * few of them.  Don't go below a quarter of the maximum block size
+	 * (or the space we may waste) doing so, where per-block overhead
+	 * would start to dominate.
+	 */
+	uint64_t stripes = MIN(zil_slog_stripe ? metaslab_class_get_groups(
+	    spa_log_class(zilog->zl_spa)) : 1, size / MAX(md / 4, waste));
+
+	if (size <= md && stripes < 2) {
 		/*
 		 * Small bursts are written as-is in one block.
 		 */
@@ -1806,9 +1842,11 @@ zil_lwb_plan(zilog_t *zilog, uint64_t size, uint_t *minsize)
 	 */
 	uint_t s = size;
 	uint_t n = DIV_ROUND_UP(s, md - sizeof (lr_write_t));
+	n = MAX(n, stripes);
 	uint_t chunk = DIV_ROUND_UP(s, n);
 	if (chunk <= md - waste) {
-		*minsize = MAX(s - (md - waste) * (n - 1), waste);
+		uint64_t rest = (uint64_t)(md - waste) * (n - 1);
+		*minsize = MAX(s > rest ? s - rest : 0, waste);
 		return (chunk);
 	} else {
 		*minsize = waste;
@@ -2585,6 +2623,158 @@ zil_itx_destroy(itx_t *itx, int err)
 	zio_data_buf_free(itx, itx->itx_size);
 }
 
+/*
+ * Return the objects a namespace itx involves in oids (at most
+ * ZIL_ITX_DEP_MAX), either as the entry being created, linked, removed or
+ * renamed, or as one of the directories being modified.  Returns their
+ * number, 0 for other itxs, or -1 for itxs every object depends on: the
+ * target of a TX_RENAME_EXCHANGE is not in the record, and unknown record
+ * types are conservatively treated the same.
+ */
+#define	ZIL_ITX_DEP_MAX	4
+
+static int
+zil_itx_dep_objects(const itx_t *itx, uint64_t *oids)
+{
+	const lr_t *lr = &itx->itx_lr;
+	uint64_t txtype = lr->lrc_txtype & ~TX_CI;
+
+	switch (txtype) {
+	case TX_COMMIT:
+	case TX_WRITE:
+	case TX_TRUNCATE:
+	case TX_SETATTR:
+	case TX_ACL_V0:
+	case TX_ACL:
+	case TX_WRITE2:
+	case TX_SETSAXATTR:
+	case TX_CLONE_RANGE:
+		return (0);
+	case TX_CREATE:
+	case TX_MKDIR:
+	case TX_MKXATTR:
+	case TX_SYMLINK:
+	case TX_CREATE_ACL:
+	case TX_CREATE_ATTR:
+	case TX_CREATE_ACL_ATTR:
+	case TX_MKDIR_ACL:
+	case TX_MKDIR_ATTR:
+	case TX_MKDIR_ACL_ATTR: {
+		const _lr_create_t *lrc = (const _lr_create_t *)lr;
+		oids[0] = lrc->lr_doid;
+		oids[1] = LR_FOID_GET_OBJ(lrc->lr_foid);
+		return (2);
+	}
+	case TX_REMOVE:
+	case TX_RMDIR:
+		oids[0] = ((const lr_remove_t *)lr)->lr_doid;
+		oids[1] = itx->itx_oid;
+		return (2);
+	case TX_LINK:
+		oids[0] = ((const lr_link_t *)lr)->lr_doid;
+		oids[1] = ((const lr_link_t *)lr)->lr_link_obj;
+		return (2);
+	case TX_RENAME:
+	case TX_RENAME_WHITEOUT: {
+		const _lr_rename_t *lrr = (const _lr_rename_t *)lr;
+		oids[0] = lrr->lr_sdoid;
+		oids[1] = lrr->lr_tdoid;
+		oids[2] = itx->itx_oid;
+		if (txtype == TX_RENAME)
+			return (3);
+		oids[3] = LR_FOID_GET_OBJ(
+		    ((const lr_rename_whiteout_t *)lr)->lr_wfoid);
+		return (4);
+	}
+	default:
+		return (-1);
+	}
+}
+
+/*
+ * Index a namespace itx just put on the sync list of itxs by the objects
+ * it involves.  Called with the itxg_lock held.
+ */
+static void
+zil_itx_dep_add(itxs_t *itxs, itx_t *itx)
+{
+	uint64_t oids[ZIL_ITX_DEP_MAX];
+	int n = zil_itx_dep_objects(itx, oids);
+
+	if (n == 0)
+		return;
+
+	uint64_t seq = ++itxs->i_dep_seq;
+	if (n < 0) {
+		itxs->i_dep_all = itx;
+		itxs->i_dep_all_seq = seq;
+		return;
+	}
+
+	for (int i = 0; i < n; i++) {
+		itx_dep_node_t *idn, search;
+		avl_index_t where;
+
+		search.id_oid = oids[i];
+		idn = avl_find(&itxs->i_dep_tree, &search, &where);
+		if (idn == NULL) {
+			idn = kmem_alloc(sizeof (itx_dep_node_t), KM_SLEEP);
+			idn->id_oid = oids[i];
+			avl_insert(&itxs->i_dep_tree, idn, where);
+		}
+		idn->id_itx = itx;
+		idn->id_seq = seq;
+	}
+}
+
+/*
+ * Return the last itx still on the sync list of itxs that the given object
+ * depends on, and its sequence number in seqp, or NULL if there is none.
+ * Called with the itxg_lock held.
+ */
+static itx_t *
+zil_itx_dep_find(itxs_t *itxs, uint64_t foid, uint64_t *seqp)
+{
+	itx_dep_node_t *idn, search;
+	itx_t *itx = NULL;
+	uint64_t seq = itxs->i_dep_done;
+
+	search.id_oid = foid;
+	idn = avl_find(&itxs->i_dep_tree, &search, NULL);
+	if (idn != NULL) {
+		if (idn->id_seq > seq) {
+			itx = idn->id_itx;
+			seq = idn->id_seq;
+		} else {
+			avl_remove(&itxs->i_dep_tree, idn);
+			kmem_free(idn, sizeof (itx_dep_node_t));
+		}
+	}
+	if (itxs->i_dep_all != NULL && itxs->i_dep_all_seq > seq) {
+		itx = itxs->i_dep_all;
+		seq = itxs->i_dep_all_seq;
+	}
+
+	if (seqp != NULL)
+		*seqp = seq;
+	return (itx);
+}
+
+/*
+ * Forget the namespace itxs of itxs, once its whole sync list is gone.
+ */
+static void
+zil_itx_dep_clear(itxs_t *itxs)
+{
+	itx_dep_node_t *idn;
+	void *cookie = NULL;
+
+	while ((idn = avl_destroy_nodes(&itxs->i_dep_tree, &cookie)) != NULL)
+		kmem_free(idn, sizeof (itx_dep_node_t));
+	itxs->i_dep_all = NULL;
+	itxs->i_dep_done = itxs->i_dep_seq;
+}
+
 /*
  * Free up the sync and async itxs. The itxs_t has already been detached
  * so no locks are needed.
@@ -2640,6 +2830,9 @@ zil_itxg_clean(void *arg)
 	}
 	avl_destroy(t);
 
+	zil_itx_dep_clear(itxs);
+	avl_destroy(&itxs->i_dep_tree);
+
 	kmem_free(itxs, sizeof (itxs_t));
 }
 
@@ -2652,6 +2845,15 @@ zil_aitx_compare(const void *x1, const void *x2)
 	return (TREE_CMP(o1, o2));
 }
 
+static int
+zil_itx_dep_compare(const void *x1, const void *x2)
+{
+	const uint64_t o1 = ((itx_dep_node_t *)x1)->id_oid;
+	const uint64_t o2 = ((itx_dep_node_t *)x2)->id_oid;
+
+	return (TREE_CMP(o1, o2));
+}
+
 /*
  * Remove all async itx with the given oid.
  */
@@ -2741,9 +2943,13 @@ zil_itx_assign(zilog_t *zilog, itx_t *itx, dmu_tx_t *tx)
 		avl_create(&itxs->i_async_tree, zil_aitx_compare,
 		    sizeof (itx_async_node_t),
 		    offsetof(itx_async_node_t, ia_node));
+		avl_create(&itxs->i_dep_tree, zil_itx_dep_compare,
+		    sizeof (itx_dep_node_t),
+		    offsetof(itx_dep_node_t, id_node));
 	}
 	if (itx->itx_sync) {
 		list_insert_tail(&itxs->i_sync_list, itx);
+		zil_itx_dep_add(itxs, itx);
 	} else {
 		avl_tree_t *t = &itxs->i_async_tree;
 		uint64_t foid =
@@ -2890,14 +3096,106 @@ zil_clean(zilog_t *zilog, uint64_t synced_txg)
 		zil_itxg_clean(clean_me);
 }
 
+/*
+ * Return the object an itx applies to if it may be committed out of order
+ * with respect to the records of other objects, or 0 if it may not.
+ * Commit itxs carry the object passed to zil_commit() in itx_oid.
+ */
+static uint64_t
+zil_itx_ooo_object(const itx_t *itx)
+{
+	uint64_t txtype = itx->itx_lr.lrc_txtype & ~TX_CI;
+
+	if (txtype == TX_COMMIT)
+		return (itx->itx_oid);
+	if (TX_OOO(txtype))
+		return (LR_FOID_GET_OBJ(((lr_ooo_t *)&itx->itx_lr)->lr_foid));
+	return (0);
+}
+
+/*
+ * Find the last txg whose sync list holds a record the given object
+ * depends on.  Returns 0 if there is none.
+ */
+static uint64_t
+zil_get_commit_dep_txg(zilog_t *zilog, uint64_t otxg, uint64_t foid)
+{
+	for (uint64_t txg = otxg + TXG_CONCURRENT_STATES - 1; txg >= otxg;
+	    txg--) {
+		itxg_t *itxg = &zilog->zl_itxg[txg & TXG_MASK];
+		boolean_t found = B_FALSE;
+
+		mutex_enter(&itxg->itxg_lock);
+		if (itxg->itxg_txg == txg) {
+			found = (zil_itx_dep_find(itxg->itxg_itxs, foid,
+			    NULL) != NULL);
+		}
+		mutex_exit(&itxg->itxg_lock);
+
+		if (found)
+			return (txg);
+	}
+	return (0);
+}
+
+/*
+ * Move the itxs needed to commit the given object from a sync list onto
+ * the commit list: when "deps" is set, everything up to and including the
+ * last record the object depends on, and then the out-of-order records
+ * of the object itself.  All other itxs stay on the sync list, in order,
+ * for a later commit (or zil_clean()).  Returns the number of records
+ * left behind, not counting commit itxs.
+ */
+static uint64_t
+zil_get_commit_list_object(zilog_t *zilog, itxs_t *itxs, uint64_t foid,
+    boolean_t deps)
+{
+	list_t *commit_list = &zilog->zl_itx_commit_list;
+	list_t *sync_list = &itxs->i_sync_list;
+	uint64_t deferred = 0, seq;
+	itx_t *itx, *next;
+
+	itx = deps ? zil_itx_dep_find(itxs, foid, &seq) : NULL;
+	if (itx != NULL) {
+		itx_t *head;
+		do {
+			head = list_remove_head(sync_list);
+			list_insert_tail(commit_list, head);
+		} while (head != itx);
+		itxs->i_dep_done = seq;
+	}
+
+	for (itx = list_head(sync_list); itx != NULL; itx = next) {
+		next = list_next(sync_list, itx);
+		if (zil_itx_ooo_object(itx) == foid) {
+			list_remove(sync_list, itx);
+			list_insert_tail(commit_list, itx);
+		} else if (itx->itx_lr.lrc_txtype != TX_COMMIT) {
+			deferred++;
+		}
+	}
+	return (deferred);
+}
+
 /*
  * This function will traverse the queue of itxs that need to be
  * committed, and move them onto the ZIL's zl_itx_commit_list.
+ *
+ * If zil_commit_per_object is set and a specific object is being
+ * committed, only the records that object depends on are moved.  These
+ * are its own out-of-order records, and every record logged before the
+ * last namespace operation involving it (see zil_itx_dep_objects()), since
+ * such an operation may in turn depend on anything logged before it (e.g.
+ * the data of a renamed file, or the creation of its new parent).  Sync
+ * lists of txgs before the one holding that operation are moved as a
+ * whole for the same reason.  Out-of-order records of other objects may
+ * then be written after later records of this one, which replay already
+ * tolerates.
  */
 static uint64_t
-zil_get_commit_list(zilog_t *zilog)
+zil_get_commit_list(zilog_t *zilog, uint64_t foid)
 {
-	uint64_t otxg, txg, wtxg = 0;
+	uint64_t otxg, txg, wtxg = 0, dtxg = 0, deferred = 0;
 	list_t *commit_list = &zilog->zl_itx_commit_list;
 
 	ASSERT(MUTEX_HELD(&zilog->zl_issuer_lock));
@@ -2907,6 +3205,13 @@ zil_get_commit_list(zilog_t *zilog)
 	else
 		otxg = spa_last_synced_txg(zilog->zl_spa) + 1;
 
+	if (!zil_commit_per_object)
+		foid = 0;
+	if (foid != 0) {
+		ZIL_STAT_BUMP(zilog, zil_commit_object_count);
+		dtxg = zil_get_commit_dep_txg(zilog, otxg, foid);
+	}
+
 	/*
 	 * This is inherently racy, since there is nothing to prevent
 	 * the last synced txg from changing. That's okay since we'll
@@ -2942,8 +3247,16 @@ zil_get_commit_list(zilog_t *zilog)
 			if (!list_is_empty(sync_list))
 				wtxg = MAX(wtxg, txg);
 		} else {
-			itx = list_head(sync_list);
-			list_move_tail(commit_list, sync_list);
+			itx = list_tail(commit_list);
+			if (foid == 0 || txg < dtxg) {
+				list_move_tail(commit_list, sync_list);
+				zil_itx_dep_clear(itxg->itxg_itxs);
+			} else {
+				deferred += zil_get_commit_list_object(zilog,
+				    itxg->itxg_itxs, foid, txg == dtxg);
+			}
+			itx = (itx == NULL) ? list_head(commit_list) :
+			    list_next(commit_list, itx);
 		}
 
 		mutex_exit(&itxg->itxg_lock);
@@ -2957,6 +3270,8 @@ zil_get_commit_list(zilog_t *zilog)
 			itx = list_next(commit_list, itx);
 		}
 	}
+	if (deferred != 0)
+		ZIL_STAT_INCR(zilog, zil_commit_deferred_count, deferred);
 	return (wtxg);
 }
 
@@ -3397,7 +3712,7 @@ zil_process_commit_list(zilog_t *zilog, zil_commit_waiter_t *zcw, list_t *ilwbs)
  * the lwb, or the timeout mechanism found in zil_commit_waiter().
  */
 static uint64_t
-zil_commit_writer(zilog_t *zilog, zil_commit_waiter_t *zcw)
+zil_commit_writer(zilog_t *zilog, zil_commit_waiter_t *zcw, uint64_t foid)
 {
 	list_t ilwbs;
 	lwb_t *lwb;
@@ -3431,7 +3746,7 @@ zil_commit_writer(zilog_t *zilog, zil_commit_waiter_t *zcw)
 
 	ZIL_STAT_BUMP(zilog, zil_commit_writer_count);
 
-	wtxg = zil_get_commit_list(zilog);
+	wtxg = zil_get_commit_list(zilog, foid);
 	zil_prune_commit_list(zilog);
 	zil_process_commit_list(zilog, zcw, &ilwbs);
 
@@ -3721,7 +4036,7 @@ zil_free_commit_waiter(zil_commit_waiter_t *zcw)
  * zil_process_commit_list() is called.
  */
 static void
-zil_commit_itx_assign(zilog_t *zilog, zil_commit_waiter_t *zcw)
+zil_commit_itx_assign(zilog_t *zilog, zil_commit_waiter_t *zcw, uint64_t foid)
 {
 	dmu_tx_t *tx = dmu_tx_create(zilog->zl_os);
 
@@ -3737,6 +4052,7 @@ zil_commit_itx_assign(zilog_t *zilog, zil_commit_waiter_t *zcw)
 	itx_t *itx = zil_itx_create(TX_COMMIT, sizeof (lr_t));
 	itx->itx_sync = B_TRUE;
 	itx->itx_private = zcw;
+	itx->itx_oid = foid;
 
 	zil_itx_assign(zilog, itx, tx);
 
@@ -4085,9 +4401,9 @@ zil_commit_impl(zilog_t *zilog, uint64_t foid)
 	 * zil_commit_waiter().
 	 */
 	zil_commit_waiter_t *zcw = zil_alloc_commit_waiter();
-	zil_commit_itx_assign(zilog, zcw);
+	zil_commit_itx_assign(zilog, zcw, foid);
 
-	uint64_t wtxg = zil_commit_writer(zilog, zcw);
+	uint64_t wtxg = zil_commit_writer(zilog, zcw, foid);
 	zil_commit_waiter(zilog, zcw);
 
 	int err = 0;
@@ -4154,7 +4470,8 @@ zil_sync(zilog_t *zilog, dmu_tx_t *tx)
 	ASSERT0(zilog->zl_stop_sync);
 
 	if (*replayed_seq != 0) {
-		ASSERT(zh->zh_replay_seq < *replayed_seq);
+		/* Records replayed in parallel may repeat the last seq. */
+		ASSERT3U(zh->zh_replay_seq, <=, *replayed_seq);
 		zh->zh_replay_seq = *replayed_seq;
 		*replayed_seq = 0;
 	}
@@ -4658,31 +4975,180 @@ zil_resume(void *cookie)
 	dsl_dataset_rele(dmu_objset_ds(os), suspend_tag);
 }
 
+/*
+ * Number of threads used to replay the intent log of a dataset.  Records
+ * that may be logged out of order are spread over them by object, so that
+ * all records of an object are still applied in log order by the same
+ * thread.  Any other record waits for those in flight to complete before
+ * being applied, as it may depend on them.  Set to 0 or 1 to replay one
+ * record at a time.
+ */
+static uint_t zil_replay_threads = 8;
+
+/*
+ * Limit on the total size of the records queued to the replay threads.
+ */
+#define	ZIL_REPLAY_QUEUED_MAX	(64ULL << 20)
+
 typedef struct zil_replay_arg {
+	zilog_t		*zr_zilog;
 	zil_replay_func_t *const *zr_replay;
 	void		*zr_arg;
 	boolean_t	zr_byteswap;
 	char		*zr_lr;
+	uint_t		zr_ntq;		/* number of replay threads */
+	taskq_t		**zr_tq;	/* single-threaded taskq per thread */
+	kmutex_t	zr_lock;	/* protects below */
+	kcondvar_t	zr_cv;		/* broadcast as queued records end */
+	uint64_t	zr_queued;	/* bytes of records queued */
+	int		zr_error;	/* first error of a queued record */
+	uint64_t	zr_records;	/* number of records replayed */
+	uint64_t	zr_bytes;	/* bytes of records replayed */
 } zil_replay_arg_t;
 
-static int
-zil_replay_error(zilog_t *zilog, const lr_t *lr, int error)
+typedef struct zil_replay_task {
+	zil_replay_arg_t *zrt_zr;
+	taskq_ent_t	zrt_tqent;
+	size_t		zrt_size;	/* allocated size of this task */
+	uint64_t	zrt_seq;	/* lrc_seq, as found in the log */
+	uint64_t	zrt_txtype;	/* lrc_txtype, as found in the log */
+	uint64_t	zrt_lr[];	/* copy of the log record */
+} zil_replay_task_t;
+
+static void
+zil_replay_report(zilog_t *zilog, uint64_t seq, uint64_t txtype, int error)
 {
 	char name[ZFS_MAX_DATASET_NAME_LEN];
 
-	zilog->zl_replaying_seq--;	/* didn't actually replay this one */
-
 	dmu_objset_name(zilog->zl_os, name);
 
 	cmn_err(CE_WARN, "ZFS replay transaction error %d, "
 	    "dataset %s, seq 0x%llx, txtype %llu %s\n", error, name,
-	    (u_longlong_t)lr->lrc_seq,
-	    (u_longlong_t)(lr->lrc_txtype & ~TX_CI),
-	    (lr->lrc_txtype & TX_CI) ? "CI" : "");
+	    (u_longlong_t)seq, (u_longlong_t)(txtype & ~TX_CI),
+	    (txtype & TX_CI) ? "CI" : "");
+}
+
+static int
+zil_replay_error(zilog_t *zilog, const lr_t *lr, int error)
+{
+	zilog->zl_replaying_seq--;	/* didn't actually replay this one */
+
+	zil_replay_report(zilog, lr->lrc_seq, lr->lrc_txtype, error);
+
+	return (error);
+}
+
+/*
+ * Return B_TRUE if the record may be applied concurrently with records of
+ * other objects.  Attributes and ACLs may carry FUID domains, and indirect
+ * writes a new end of file, through per-dataset state of the ZPL replay
+ * vectors (z_fuid_replay and z_replay_eof), so these are applied one at a
+ * time like the namespace operations.
+ */
+static boolean_t
+zil_replay_parallel_ok(const lr_t *lr, uint64_t txtype)
+{
+	switch (txtype) {
+	case TX_WRITE:
+		return (lr->lrc_reclen > sizeof (lr_write_t));
+	case TX_WRITE2:
+	case TX_TRUNCATE:
+	case TX_CLONE_RANGE:
+		return (B_TRUE);
+	default:
+		return (B_FALSE);
+	}
+}
+
+static void
+zil_replay_task(void *arg)
+{
+	zil_replay_task_t *zrt = arg;
+	zil_replay_arg_t *zr = zrt->zrt_zr;
+	zilog_t *zilog = zr->zr_zilog;
+	uint64_t txtype = zrt->zrt_txtype & ~TX_CI;
+	int error;
+
+	/* See zil_replay_log_record() for why we retry. */
+	error = zr->zr_replay[txtype](zr->zr_arg, zrt->zrt_lr, zr->zr_byteswap);
+	if (error != 0) {
+		txg_wait_synced(spa_get_dsl(zilog->zl_spa), 0);
+		error = zr->zr_replay[txtype](zr->zr_arg, zrt->zrt_lr, B_FALSE);
+		if (error != 0) {
+			zil_replay_report(zilog, zrt->zrt_seq, zrt->zrt_txtype,
+			    error);
+		}
+	}
+
+	mutex_enter(&zr->zr_lock);
+	if (zr->zr_error == 0)
+		zr->zr_error = error;
+	zr->zr_queued -= zrt->zrt_size;
+	cv_broadcast(&zr->zr_cv);
+	mutex_exit(&zr->zr_lock);
+
+	vmem_free(zrt, zrt->zrt_size);
+}
+
+/*
+ * Wait for all queued records to be applied, and return the first error
+ * any of them ran into.
+ */
+static int
+zil_replay_wait(zil_replay_arg_t *zr)
+{
+	int error;
+
+	mutex_enter(&zr->zr_lock);
+	while (zr->zr_queued > 0)
+		cv_wait(&zr->zr_cv, &zr->zr_lock);
+	error = zr->zr_error;
+	mutex_exit(&zr->zr_lock);
 
 	return (error);
 }
 
+/*
+ * Queue a record to the replay thread of its object.
+ */
+static int
+zil_replay_dispatch(zil_replay_arg_t *zr, const lr_t *lr, uint64_t foid)
+{
+	uint64_t reclen = lr->lrc_reclen;
+	size_t size = offsetof(zil_replay_task_t, zrt_lr) + reclen;
+	zil_replay_task_t *zrt;
+	int error;
+
+	mutex_enter(&zr->zr_lock);
+	while (zr->zr_queued > 0 && zr->zr_error == 0 &&
+	    zr->zr_queued + size > ZIL_REPLAY_QUEUED_MAX)
+		cv_wait(&zr->zr_cv, &zr->zr_lock);
+	error = zr->zr_error;
+	if (error == 0)
+		zr->zr_queued += size;
+	mutex_exit(&zr->zr_lock);
+	if (error != 0)
+		return (error);
+
+	zrt = vmem_alloc(size, KM_SLEEP);
+	zrt->zrt_zr = zr;
+	zrt->zrt_size = size;
+	zrt->zrt_seq = lr->lrc_seq;
+	zrt->zrt_txtype = lr->lrc_txtype;
+	memcpy(zrt->zrt_lr, lr, reclen);
+	if (zr->zr_byteswap)
+		byteswap_uint64_array(zrt->zrt_lr, reclen);
+
+	taskq_init_ent(&zrt->zrt_tqent);
+	taskq_dispatch_ent(zr->zr_tq[foid % zr->zr_ntq], zil_replay_task, zrt,
+	    0, &zrt->zrt_tqent);
+
+	zr->zr_records++;
+	zr->zr_bytes += reclen;
+
+	return (0);
+}
+
 static int
 zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
     uint64_t claim_txg)
@@ -4691,10 +5157,9 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 	const zil_header_t *zh = zilog->zl_header;
 	uint64_t reclen = lr->lrc_reclen;
 	uint64_t txtype = lr->lrc_txtype;
+	uint64_t bytes = reclen;
 	int error = 0;
 
-	zilog->zl_replaying_seq = lr->lrc_seq;
-
 	if (lr->lrc_seq <= zh->zh_replay_seq)	/* already replayed */
 		return (0);
 
@@ -4704,6 +5169,27 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 	/* Strip case-insensitive bit, still present in log record */
 	txtype &= ~TX_CI;
 
+	/*
+	 * Records of different objects which can be logged out of order
+	 * are handed to the replay threads.  While any are in flight,
+	 * zl_replaying_seq stays at the last record known to be replayed
+	 * along with all records before it, which is what the replay
+	 * vectors store as zh_replay_seq.  Should we crash, the records
+	 * after it are replayed again, in order, which is harmless.
+	 */
+	if (zr->zr_ntq > 0 && zil_replay_parallel_ok(lr, txtype)) {
+		uint64_t foid = LR_FOID_GET_OBJ(((lr_ooo_t *)lr)->lr_foid);
+
+		error = dmu_object_info(zilog->zl_os, foid, NULL);
+		if (error == ENOENT || error == EEXIST)
+			return (0);
+		return (zil_replay_dispatch(zr, lr, foid));
+	}
+	if (zr->zr_ntq > 0 && (error = zil_replay_wait(zr)) != 0)
+		return (error);
+
+	zilog->zl_replaying_seq = lr->lrc_seq;
+
 	if (txtype == 0 || txtype >= TX_MAX_TYPE)
 		return (zil_replay_error(zilog, lr, EINVAL));
 
@@ -4731,6 +5217,7 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 		    zr->zr_lr + reclen);
 		if (error != 0)
 			return (zil_replay_error(zilog, lr, error));
+		bytes += BP_GET_LSIZE(&((lr_write_t *)lr)->lr_blkptr);
 	}
 
 	/*
@@ -4763,6 +5250,8 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 		if (error != 0)
 			return (zil_replay_error(zilog, lr, error));
 	}
+	zr->zr_records++;
+	zr->zr_bytes += bytes;
 	return (0);
 }
 
@@ -4776,6 +5265,31 @@ zil_incr_blks(zilog_t *zilog, const blkptr_t *bp, void *arg, uint64_t claim_txg)
 	return (0);
 }
 
+/*
+ * Record what was replayed, and how fast, in the internal pool history
+ * (see "zpool history -i").
+ */
+static void
+zil_replay_log_history(zilog_t *zilog, zil_replay_arg_t *zr, hrtime_t delta)
+{
+	dsl_pool_t *dp = zilog->zl_dmu_pool;
+	uint64_t ms = MAX(NSEC2MSEC(delta), 1);
+	dmu_tx_t *tx;
+
+	tx = dmu_tx_create_dd(dp->dp_mos_dir);
+	if (dmu_tx_assign(tx, DMU_TX_WAIT) != 0) {
+		dmu_tx_abort(tx);
+		return;
+	}
+	spa_history_log_internal_ds(dmu_objset_ds(zilog->zl_os), "replay", tx,
+	    "records=%llu bytes=%llu blocks=%llu threads=%u time=%llums "
+	    "rate=%lluKiB/s", (u_longlong_t)zr->zr_records,
+	    (u_longlong_t)zr->zr_bytes, (u_longlong_t)zilog->zl_replay_blks,
+	    MAX(zr->zr_ntq, 1), (u_longlong_t)ms,
+	    (u_longlong_t)(zr->zr_bytes * 1000 / 1024 / ms));
+	dmu_tx_commit(tx);
+}
+
 /*
  * If this dataset has a non-empty intent log, replay it and destroy it.
  * Return B_TRUE if there were any entries to replay.
@@ -4786,16 +5300,31 @@ zil_replay(objset_t *os, void *arg,
 {
 	zilog_t *zilog = dmu_objset_zil(os);
 	const zil_header_t *zh = zilog->zl_header;
-	zil_replay_arg_t zr;
+	zil_replay_arg_t zr = { 0 };
+	hrtime_t start;
 
 	if ((zh->zh_flags & ZIL_REPLAY_NEEDED) == 0) {
 		return (zil_destroy(zilog, B_TRUE));
 	}
 
+	zr.zr_zilog = zilog;
 	zr.zr_replay = replay_func;
 	zr.zr_arg = arg;
 	zr.zr_byteswap = BP_SHOULD_BYTESWAP(&zh->zh_log);
 	zr.zr_lr = vmem_alloc(2 * SPA_MAXBLOCKSIZE, KM_SLEEP);
+	mutex_init(&zr.zr_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zr.zr_cv, NULL, CV_DEFAULT, NULL);
+	zr.zr_ntq = MIN(zil_replay_threads, boot_ncpus);
+	if (zr.zr_ntq > 1) {
+		zr.zr_tq = kmem_alloc(zr.zr_ntq * sizeof (taskq_t *),
+		    KM_SLEEP);
+		for (uint_t i = 0; i < zr.zr_ntq; i++) {
+			zr.zr_tq[i] = taskq_create("z_zil_replay", 1,
+			    defclsyspri, 1, INT_MAX, TASKQ_PREPOPULATE);
+		}
+	} else {
+		zr.zr_ntq = 0;
+	}
 
 	/*
 	 * Wait for in-progress removes to sync before starting replay.
@@ -4804,11 +5333,25 @@ zil_replay(objset_t *os, void *arg,
 
 	zilog->zl_replay = B_TRUE;
 	zilog->zl_replay_time = ddi_get_lbolt();
+	zilog->zl_replaying_seq = zh->zh_replay_seq;
 	ASSERT0(zilog->zl_replay_blks);
+	start = gethrtime();
 	(void) zil_parse(zilog, zil_incr_blks, zil_replay_log_record, &zr,
 	    zh->zh_claim_txg, B_TRUE);
 	vmem_free(zr.zr_lr, 2 * SPA_MAXBLOCKSIZE);
 
+	if (zr.zr_ntq > 0) {
+		(void) zil_replay_wait(&zr);
+		for (uint_t i = 0; i < zr.zr_ntq; i++)
+			taskq_destroy(zr.zr_tq[i]);
+		kmem_free(zr.zr_tq, zr.zr_ntq * sizeof (taskq_t *));
+	}
+	cv_destroy(&zr.zr_cv);
+	mutex_destroy(&zr.zr_lock);
+
+	if (zr.zr_records > 0)
+		zil_replay_log_history(zilog, &zr, gethrtime() - start);
+
 	zil_destroy(zilog, B_FALSE);
 	txg_wait_synced(zilog->zl_dmu_pool, zilog->zl_destroy_txg);
 	zilog->zl_replay = B_FALSE;
@@ -4878,9 +5421,18 @@ ZFS_MODULE_PARAM(zfs, zfs_, commit_timeout_pct, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_zil, zil_, replay_disable, INT, ZMOD_RW,
 	"Disable intent logging replay");
 
+ZFS_MODULE_PARAM(zfs_zil, zil_, replay_threads, UINT, ZMOD_RW,
+	"Number of threads to replay the intent log of a dataset with");
+
 ZFS_MODULE_PARAM(zfs_zil, zil_, nocacheflush, INT, ZMOD_RW,
 	"Disable ZIL cache flushes");
 
+ZFS_MODULE_PARAM(zfs_zil, zil_, commit_per_object, INT, ZMOD_RW,
+	"Only commit the records an object depends on when it is synced");
+
+ZFS_MODULE_PARAM(zfs_zil, zil_, slog_stripe, INT, ZMOD_RW,
+	"Split log write bursts between SLOG vdevs");
+
 ZFS_MODULE_PARAM(zfs_zil, zil_, slog_bulk, U64, ZMOD_RW,
 	"Limit in bytes slog sync writes per commit");
 
@@ -70,6 +70,12 @@
  * That is why one can be sure that first, zvol_state_t for a given zvol is
  * allocated and placed on zvol_state_list, and then other minor operations for
  * this zvol are going to proceed in the order of issue.
+ *
+ * Creating the minors of many zvols, as at pool import, is the exception:
+ * the task creating them hands them to a taskq of its own, see
+ * zvol_create_minors_impl(). It waits for them all before it returns, so
+ * minor operations remain serialized per pool, and no two of its jobs are
+ * for the same zvol.
  */
 
 #include <sys/dataset_kstats.h>
@@ -94,6 +100,7 @@ unsigned int zvol_volmode = ZFS_VOLMODE_GEOM;
 unsigned int zvol_threads = 0;
 unsigned int zvol_num_taskqs = 0;
 unsigned int zvol_request_sync = 0;
+static unsigned int zvol_create_minors_threads = 0;
 
 struct hlist_head *zvol_htable;
 static list_t zvol_state_list;
@@ -118,6 +125,7 @@ typedef struct {
 	uint64_t zt_value;
 	uint32_t zt_total;
 	uint32_t zt_done;
+	uint32_t zt_pending;	/* Operations dispatched, not yet done */
 	int32_t zt_status;
 	int zt_error;
 } zvol_task_t;
@@ -1333,12 +1341,30 @@ zvol_last_close(zvol_state_t *zv)
 typedef struct minors_job {
 	list_t *list;
 	list_node_t link;
+	avl_node_t node;
 	/* input */
 	char *name;
+	struct minors_create *create;
 	/* output */
 	int error;
 } minors_job_t;
 
+/*
+ * Shared by the jobs of a task that creates its minors in parallel.
+ * mc_lock protects the counts of mc_task, and mc_cv is signalled as each
+ * job completes.
+ */
+typedef struct minors_create {
+	zvol_task_t *mc_task;
+	kmutex_t mc_lock;
+	kcondvar_t mc_cv;
+} minors_create_t;
+
+/*
+ * Seconds between the progress reports of a task creating minors.
+ */
+#define	ZVOL_MINORS_REPORT_SECS	10
+
 /*
  * Prefetch zvol dnodes for the minors_job
  */
@@ -1531,7 +1557,6 @@ zvol_task_update_status(zvol_task_t *task, uint64_t total, uint64_t done,
 static void
 zvol_task_report_status(zvol_task_t *task)
 {
-#ifdef ZFS_DEBUG
 	static const char *const msg[] = {
 		"create",
 		"remove",
@@ -1540,22 +1565,56 @@ zvol_task_report_status(zvol_task_t *task)
 		"set volmode",
 		"unknown",
 	};
+	zvol_async_op_t op = MIN(task->zt_op, ZVOL_ASYNC_MAX);
 
+	if (task->zt_pending != 0) {
+		zfs_dbgmsg("The %s minors zvol task for %s has done %u of %u",
+		    msg[op], task->zt_name1, task->zt_done,
+		    task->zt_total + task->zt_pending);
+		return;
+	}
+
+#ifdef ZFS_DEBUG
 	if (task->zt_status == 0)
 		return;
 
-	zvol_async_op_t op = MIN(task->zt_op, ZVOL_ASYNC_MAX);
 	if (task->zt_error) {
 		dprintf("The %s minors zvol task was not ok, last error %d\n",
 		    msg[op], task->zt_error);
 	} else {
 		dprintf("The %s minors zvol task was not ok\n", msg[op]);
 	}
-#else
-	(void) task;
 #endif
 }
 
+static int
+minors_job_compare(const void *a, const void *b)
+{
+	const minors_job_t *ja = a;
+	const minors_job_t *jb = b;
+
+	return (TREE_ISIGN(strcmp(ja->name, jb->name)));
+}
+
+/*
+ * Create the minor of a minors_job whose prefetch succeeded.
+ */
+static void
+zvol_create_minor_job(void *arg)
+{
+	minors_job_t *job = arg;
+	minors_create_t *mc = job->create;
+	int error;
+
+	error = zvol_os_create_minor(job->name);
+
+	mutex_enter(&mc->mc_lock);
+	zvol_task_update_status(mc->mc_task, 1, error == 0, error);
+	mc->mc_task->zt_pending--;
+	cv_signal(&mc->mc_cv);
+	mutex_exit(&mc->mc_lock);
+}
+
 /*
  * Create minors for the specified dataset, including children and snapshots.
  * Pay attention to the 'snapdev' property and iterate over the snapshots
@@ -1578,9 +1637,15 @@ zvol_create_minors_impl(zvol_task_t *task)
 {
 	const char *name = task->zt_name1;
 	list_t minors_list;
-	minors_job_t *job;
+	avl_tree_t minors_names;
+	minors_create_t mc;
+	minors_job_t *job, *next;
+	avl_index_t where;
 	uint64_t snapdev;
-	int total = 0, done = 0, last_error, error;
+	uint_t njobs = 0, nthreads;
+	taskq_t *tq = NULL;
+	void *avl_cookie;
+	int error;
 
 	/*
 	 * Note: the dsl_pool_config_lock must not be held.
@@ -1612,12 +1677,7 @@ zvol_create_minors_impl(zvol_task_t *task)
 		error = dsl_prop_get_integer(name, "snapdev", &snapdev, NULL);
 		if (error == 0 && snapdev == ZFS_SNAPDEV_VISIBLE) {
 			error = zvol_os_create_minor(name);
-			if (error == 0) {
-				done++;
-			} else {
-				last_error = error;
-			}
-			total++;
+			zvol_task_update_status(task, 1, error == 0, error);
 		}
 	} else {
 		fstrans_cookie_t cookie = spl_fstrans_mark();
@@ -1629,34 +1689,89 @@ zvol_create_minors_impl(zvol_task_t *task)
 	taskq_wait_outstanding(system_taskq, 0);
 
 	/*
-	 * Prefetch is completed, we can do zvol_os_create_minor
-	 * sequentially.
+	 * Prefetch is completed.  A zvol that is also the clone of another
+	 * one can be on the list twice, so drop its later jobs before the
+	 * minors are created in parallel.
 	 */
-	while ((job = list_remove_head(&minors_list)) != NULL) {
-		if (!job->error) {
-			error = zvol_os_create_minor(job->name);
-			if (error == 0) {
-				done++;
-			} else {
-				last_error = error;
-			}
-		} else if (job->error == EINVAL) {
+	avl_create(&minors_names, minors_job_compare, sizeof (minors_job_t),
+	    offsetof(minors_job_t, node));
+	for (job = list_head(&minors_list); job != NULL; job = next) {
+		next = list_next(&minors_list, job);
+		if (avl_find(&minors_names, job, &where) != NULL) {
+			list_remove(&minors_list, job);
+			kmem_strfree(job->name);
+			kmem_free(job, sizeof (minors_job_t));
+			continue;
+		}
+		avl_insert(&minors_names, job, where);
+		njobs++;
+	}
+
+	/*
+	 * Creating a minor mostly waits for the disk to be added and
+	 * announced, so create up to zvol_create_minors_threads of them at
+	 * a time on a taskq of this task's own.
+	 */
+	nthreads = zvol_create_minors_threads;
+	if (nthreads == 0)
+		nthreads = MIN(max_ncpus, 16);
+	nthreads = MIN(nthreads, njobs);
+	if (nthreads > 1) {
+		tq = taskq_create("z_zvol_minors", nthreads, defclsyspri,
+		    nthreads, INT_MAX, TASKQ_PREPOPULATE);
+	}
+
+	mc.mc_task = task;
+	mutex_init(&mc.mc_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&mc.mc_cv, NULL, CV_DEFAULT, NULL);
+
+	for (job = list_head(&minors_list); job != NULL;
+	    job = list_next(&minors_list, job)) {
+		if (job->error != 0) {
 			/*
-			 * The objset, with the name requested by current job
-			 * exist, but have the type different from zvol.
-			 * Just ignore this sort of errors.
+			 * EINVAL means the objset, with the name requested by
+			 * current job exist, but have the type different from
+			 * zvol. Just ignore this sort of errors.
 			 */
-			done++;
-		} else {
-			last_error = job->error;
+			mutex_enter(&mc.mc_lock);
+			zvol_task_update_status(task, 1,
+			    job->error == EINVAL, job->error);
+			mutex_exit(&mc.mc_lock);
+			continue;
 		}
-		total++;
+
+		job->create = &mc;
+		mutex_enter(&mc.mc_lock);
+		task->zt_pending++;
+		mutex_exit(&mc.mc_lock);
+		if (tq == NULL || taskq_dispatch(tq, zvol_create_minor_job,
+		    job, TQ_SLEEP) == TASKQID_INVALID)
+			zvol_create_minor_job(job);
+	}
+
+	mutex_enter(&mc.mc_lock);
+	while (task->zt_pending != 0) {
+		if (cv_timedwait(&mc.mc_cv, &mc.mc_lock, ddi_get_lbolt() +
+		    SEC_TO_TICK(ZVOL_MINORS_REPORT_SECS)) == -1)
+			zvol_task_report_status(task);
+	}
+	mutex_exit(&mc.mc_lock);
+
+	if (tq != NULL)
+		taskq_destroy(tq);
+	cv_destroy(&mc.mc_cv);
+	mutex_destroy(&mc.mc_lock);
+
+	avl_cookie = NULL;
+	while (avl_destroy_nodes(&minors_names, &avl_cookie) != NULL)
+		;
+	avl_destroy(&minors_names);
+
+	while ((job = list_remove_head(&minors_list)) != NULL) {
 		kmem_strfree(job->name);
 		kmem_free(job, sizeof (minors_job_t));
 	}
-
 	list_destroy(&minors_list);
-	zvol_task_update_status(task, total, done, last_error);
 }
 
 /*
@@ -2321,3 +2436,6 @@ ZFS_MODULE_PARAM(zfs_vol, zvol_, num_taskqs, UINT, ZMOD_RW,
 	"Number of zvol taskqs");
 ZFS_MODULE_PARAM(zfs_vol, zvol_, request_sync, UINT, ZMOD_RW,
 	"Synchronously handle bio requests");
+ZFS_MODULE_PARAM(zfs_vol, zvol_, create_minors_threads, UINT, ZMOD_RW,
+	"Number of threads creating the minors of a pool or dataset. "
+	"Set to 0 to use all active CPUs, up to 16");
@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * https://opensource.org/license/CDDL-1.0.
+ */
+
+/*
+ * Clone every regular file of SRCDIR into a new file of the same name in
+ * DSTDIR, either with one FICLONE ioctl per file (the default), or with
+ * ZFS_IOC_CLONE_RANGES batches of up to -b files per call.  The time spent
+ * cloning (excluding opening and creating the files) is printed in seconds,
+ * so that both paths can be compared on the same set of files.
+ *
+ * With -e, pass the given SRC:SRCOFF:DST:DSTOFF:LEN entries to a single
+ * ZFS_IOC_CLONE_RANGES call instead, and print the errno and the length
+ * cloned of each, one entry per line.  A file named - is a closed fd.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <linux/fs.h>
+#include <sys/fs/zfs.h>
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr,
+	    "usage: clone_files [-b batch] SRCDIR DSTDIR\n"
+	    "       clone_files -e SRC:SRCOFF:DST:DSTOFF:LEN ...\n");
+	exit(2);
+}
+
+static int
+open_entry_file(const char *path, int flags)
+{
+	int fd;
+
+	if (strcmp(path, "-") == 0)
+		return (-1);
+	if ((fd = open(path, flags, 0644)) < 0)
+		err(1, "%s", path);
+	return (fd);
+}
+
+static int
+clone_entries(int argc, char *argv[])
+{
+	zfs_clone_range_entry_t *ents;
+	zfs_clone_ranges_args_t args = { 0 };
+	char *src, *dst, *srcoff, *dstoff, *len;
+	int fd = -1;
+
+	if (argc == 0 || argc > ZFS_CLONE_RANGES_MAX)
+		usage();
+	if ((ents = calloc(argc, sizeof (*ents))) == NULL)
+		err(1, "calloc");
+
+	for (int i = 0; i < argc; i++) {
+		src = strtok(argv[i], ":");
+		srcoff = strtok(NULL, ":");
+		dst = strtok(NULL, ":");
+		dstoff = strtok(NULL, ":");
+		len = strtok(NULL, ":");
+		if (len == NULL)
+			usage();
+
+		ents[i].src_fd = open_entry_file(src, O_RDONLY);
+		ents[i].dst_fd = open_entry_file(dst, O_CREAT | O_WRONLY);
+		ents[i].src_off = strtoull(srcoff, NULL, 0);
+		ents[i].dst_off = strtoull(dstoff, NULL, 0);
+		ents[i].len = strtoull(len, NULL, 0);
+		if (fd < 0)
+			fd = ents[i].dst_fd;
+	}
+	if (fd < 0)
+		errx(1, "no entry has a destination file");
+
+	args.entries = (uint64_t)(uintptr_t)ents;
+	args.count = argc;
+	if (ioctl(fd, ZFS_IOC_CLONE_RANGES, &args) != 0)
+		err(1, "ZFS_IOC_CLONE_RANGES");
+
+	for (int i = 0; i < argc; i++) {
+		(void) printf("%d %llu\n", ents[i].error,
+		    (unsigned long long)ents[i].len);
+		if (ents[i].src_fd >= 0)
+			(void) close(ents[i].src_fd);
+		if (ents[i].dst_fd >= 0)
+			(void) close(ents[i].dst_fd);
+	}
+	free(ents);
+
+	return (0);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+int
+main(int argc, char *argv[])
+{
+	zfs_clone_range_entry_t *ents;
+	struct dirent *dirent;
+	unsigned long batch = 0, nents;
+	double elapsed = 0, start;
+	size_t nfiles = 0, n = 0;
+	int c, sdfd, ddfd, failed = 0, entries = 0;
+	DIR *sdir;
+
+	while ((c = getopt(argc, argv, "b:e")) != -1) {
+		switch (c) {
+		case 'b':
+			batch = strtoul(optarg, NULL, 0);
+			if (batch == 0 || batch > ZFS_CLONE_RANGES_MAX)
+				errx(2, "batch must be 1-%d",
+				    ZFS_CLONE_RANGES_MAX);
+			break;
+		case 'e':
+			entries = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (entries)
+		return (clone_entries(argc, argv));
+	if (argc != 2)
+		usage();
+
+	if ((sdir = opendir(argv[0])) == NULL)
+		err(1, "%s", argv[0]);
+	sdfd = dirfd(sdir);
+	if ((ddfd = open(argv[1], O_DIRECTORY)) < 0)
+		err(1, "%s", argv[1]);
+
+	nents = batch > 0 ? batch : 1;
+	ents = calloc(nents, sizeof (*ents));
+	if (ents == NULL)
+		err(1, "calloc");
+
+	for (;;) {
+		zfs_clone_range_entry_t *ent = &ents[n];
+		struct stat st;
+
+		dirent = readdir(sdir);
+		if (dirent != NULL) {
+			if (fstatat(sdfd, dirent->d_name, &st,
+			    AT_SYMLINK_NOFOLLOW) != 0)
+				err(1, "%s/%s", argv[0], dirent->d_name);
+			if (!S_ISREG(st.st_mode))
+				continue;
+
+			ent->src_fd = openat(sdfd, dirent->d_name, O_RDONLY);
+			if (ent->src_fd < 0)
+				err(1, "%s/%s", argv[0], dirent->d_name);
+			ent->dst_fd = openat(ddfd, dirent->d_name,
+			    O_CREAT | O_TRUNC | O_WRONLY, 0644);
+			if (ent->dst_fd < 0)
+				err(1, "%s/%s", argv[1], dirent->d_name);
+			ent->src_off = 0;
+			ent->dst_off = 0;
+			ent->len = 0;
+			ent->error = 0;
+			n++;
+			nfiles++;
+		}
+
+		if (n == 0 && dirent == NULL)
+			break;
+		if (dirent != NULL && n < nents)
+			continue;
+
+		start = now();
+		if (batch == 0) {
+			if (ioctl(ent->dst_fd, FICLONE, ent->src_fd) != 0)
+				ent->error = errno;
+		} else {
+			zfs_clone_ranges_args_t args = {
+				.entries = (uint64_t)(uintptr_t)ents,
+				.count = n,
+			};
+			if (ioctl(ents[0].dst_fd, ZFS_IOC_CLONE_RANGES,
+			    &args) != 0)
+				err(1, "ZFS_IOC_CLONE_RANGES");
+		}
+		elapsed += now() - start;
+
+		for (size_t i = 0; i < n; i++) {
+			if (ents[i].error != 0) {
+				warnx("clone of entry %zu failed: %s",
+				    nfiles - n + i, strerror(ents[i].error));
+				failed++;
+			}
+			(void) close(ents[i].src_fd);
+			(void) close(ents[i].dst_fd);
+		}
+		n = 0;
+	}
+
+	(void) printf("%zu files cloned in %.6f seconds\n", nfiles, elapsed);
+
+	free(ents);
+	(void) close(ddfd);
+	(void) closedir(sdir);
+
+	return (failed == 0 ? 0 : 1);
+}
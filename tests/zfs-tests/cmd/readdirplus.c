@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * https://opensource.org/license/CDDL-1.0.
+ */
+
+/*
+ * List the entries of DIR with zfs_readdirplus(), -b bytes at a time, one
+ * line per entry in the format of
+ *
+ *	stat -c '%n %i %s %f %h %u %g %Y %Z'
+ *
+ * so the output can be compared with stat(1) of the same entries.  With -q
+ * nothing is listed, and the number of entries and the time spent reading
+ * them are printed instead.
+ */
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libzfs.h>
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "usage: readdirplus [-q] [-b bufsize] DIR\n");
+	exit(2);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t bufsize = 64 * 1024, nents = 0;
+	uint64_t cookie = 0;
+	boolean_t eof = B_FALSE, quiet = B_FALSE;
+	double start;
+	int c, fd, failed = 0;
+	char *buf;
+
+	while ((c = getopt(argc, argv, "b:q")) != -1) {
+		switch (c) {
+		case 'b':
+			bufsize = strtoul(optarg, NULL, 0);
+			if (bufsize == 0)
+				errx(2, "bufsize must not be zero");
+			break;
+		case 'q':
+			quiet = B_TRUE;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1)
+		usage();
+
+	if ((fd = open(argv[0], O_RDONLY | O_DIRECTORY)) < 0)
+		err(1, "%s", argv[0]);
+	if ((buf = malloc(bufsize)) == NULL)
+		err(1, "malloc");
+
+	start = now();
+	while (!eof) {
+		uint32_t count;
+		char *p = buf;
+
+		if (zfs_readdirplus(fd, &cookie, buf, bufsize, &count,
+		    &eof) != 0)
+			err(1, "zfs_readdirplus");
+		if (count == 0 && !eof)
+			errx(1, "no progress at cookie %llu",
+			    (u_longlong_t)cookie);
+
+		for (uint32_t i = 0; i < count; i++) {
+			zfs_direntplus_t *de = (zfs_direntplus_t *)p;
+
+			p += de->reclen;
+			nents++;
+			if (de->error != 0) {
+				warnx("%s: %s", de->name, strerror(de->error));
+				failed++;
+				continue;
+			}
+			if (quiet)
+				continue;
+			(void) printf("%s %llu %llu %llx %llu %llu %llu "
+			    "%llu %llu\n", de->name, (u_longlong_t)de->ino,
+			    (u_longlong_t)de->size, (u_longlong_t)de->mode,
+			    (u_longlong_t)de->links, (u_longlong_t)de->uid,
+			    (u_longlong_t)de->gid, (u_longlong_t)de->mtime[0],
+			    (u_longlong_t)de->ctime[0]);
+		}
+	}
+
+	if (quiet)
+		(void) printf("%zu entries read in %.6f seconds\n", nents,
+		    now() - start);
+
+	free(buf);
+	(void) close(fd);
+
+	return (failed == 0 ? 0 : 1);
+}
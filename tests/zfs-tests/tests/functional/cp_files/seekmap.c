@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * https://opensource.org/license/CDDL-1.0.
+ */
+
+/*
+ * Print the data and hole extents of FILE as found with SEEK_DATA and
+ * SEEK_HOLE, one "data|hole <start> <end>" line each, and the number of
+ * lseek() calls made and the total time spent in them to stderr.
+ */
+
+#ifndef	_GNU_SOURCE
+#define	_GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* some older uClibc's lack the defines, so we'll manually define them */
+#ifdef	__UCLIBC__
+#ifndef	SEEK_DATA
+#define	SEEK_DATA 3
+#endif
+#ifndef	SEEK_HOLE
+#define	SEEK_HOLE 4
+#endif
+#endif
+
+static int nseeks;
+static double elapsed;
+
+static off_t
+seek(int fd, off_t off, int whence)
+{
+	struct timespec start, end;
+	off_t ret;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = lseek(fd, off, whence);
+	(void) clock_gettime(CLOCK_MONOTONIC, &end);
+
+	nseeks++;
+	elapsed += (end.tv_sec - start.tv_sec) +
+	    (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	if (ret < 0 && errno != ENXIO) {
+		perror("lseek");
+		exit(1);
+	}
+
+	return (ret);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct stat st;
+	off_t off = 0, data, hole;
+	int fd;
+
+	if (argc != 2) {
+		(void) fprintf(stderr, "usage: seekmap <file>\n");
+		exit(2);
+	}
+
+	if ((fd = open(argv[1], O_RDONLY)) < 0 || fstat(fd, &st) != 0) {
+		perror(argv[1]);
+		exit(1);
+	}
+
+	while (off < st.st_size) {
+		data = seek(fd, off, SEEK_DATA);
+		if (data < 0)
+			data = st.st_size;
+		if (data > off)
+			(void) printf("hole %jd %jd\n", (intmax_t)off,
+			    (intmax_t)data);
+		if (data >= st.st_size)
+			break;
+
+		hole = seek(fd, data, SEEK_HOLE);
+		if (hole < 0)
+			hole = st.st_size;
+		(void) printf("data %jd %jd\n", (intmax_t)data,
+		    (intmax_t)hole);
+		off = hole;
+	}
+
+	(void) fprintf(stderr, "%d seeks in %.6f seconds\n", nseeks, elapsed);
+	(void) close(fd);
+
+	return (0);
+}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * https://opensource.org/license/CDDL-1.0.
+ */
+
+/*
+ * Read (or with -w, overwrite with a pattern) LENGTH bytes of FILE at
+ * OFFSET with a single preadv2() or pwritev2() call with RWF_NOWAIT, and
+ * print the number of bytes transferred, or EAGAIN if the call would have
+ * blocked.  Exits with 3 if RWF_NOWAIT is not supported.
+ */
+
+#ifndef	_GNU_SOURCE
+#define	_GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "usage: nowait_rw [-w] FILE OFFSET LENGTH\n");
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct iovec iov;
+	ssize_t ret;
+	int c, fd, wr = 0;
+
+	while ((c = getopt(argc, argv, "w")) != -1) {
+		switch (c) {
+		case 'w':
+			wr = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 3)
+		usage();
+
+	off_t off = strtoll(argv[1], NULL, 0);
+	iov.iov_len = strtoull(argv[2], NULL, 0);
+	if ((iov.iov_base = malloc(iov.iov_len)) == NULL) {
+		perror("malloc");
+		return (1);
+	}
+	memset(iov.iov_base, 0x5a, iov.iov_len);
+
+	if ((fd = open(argv[0], wr ? O_WRONLY : O_RDONLY)) < 0) {
+		perror(argv[0]);
+		return (1);
+	}
+
+#ifdef RWF_NOWAIT
+	if (wr)
+		ret = pwritev2(fd, &iov, 1, off, RWF_NOWAIT);
+	else
+		ret = preadv2(fd, &iov, 1, off, RWF_NOWAIT);
+#else
+	ret = -1;
+	errno = EOPNOTSUPP;
+#endif
+	if (ret < 0) {
+		if (errno == EAGAIN) {
+			(void) printf("EAGAIN\n");
+			return (0);
+		}
+		perror(wr ? "pwritev2" : "preadv2");
+		return (errno == EOPNOTSUPP || errno == ENOSYS ? 3 : 1);
+	}
+	(void) printf("%zd\n", ret);
+
+	free(iov.iov_base);
+	(void) close(fd);
+	return (0);
+}